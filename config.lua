@@ -30,6 +30,7 @@ render =
     antialias_samples = 4;                      -- Maximum depends and is limited by hardware capabilities.
     z_depth = 24;                               -- Maximum and recommended is 24.
     texture_border = 16;
+    texture_format = 0;                         -- Atlas pages: 0 - RGBA8, 1 - 16 bit, 2 - compressed (S3TC, 16 bit if not supported).
     fog_color = {r = 255, g = 255, b = 255};
 }
 
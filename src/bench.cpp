@@ -0,0 +1,955 @@
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+#include "core/system.h"
+#include "core/gl_util.h"
+#include "core/gl_stats.h"
+#include "core/vmath.h"
+#include "render/camera.h"
+#include "render/render.h"
+#include "script/script.h"
+#include "vt/tr_versions.h"
+#include "skeletal_model.h"
+#include "room.h"
+#include "world.h"
+#include "entity.h"
+#include "character_controller.h"
+#include "engine.h"
+#include "game.h"
+#include "bench.h"
+
+#define BENCH_WARMUP_FRAMES         (16)
+#define BENCH_TICK_STEP             (16)                                        // fixed shader time step, ms
+#define BENCH_HASH_INIT             (14695981039346656037ULL)
+
+
+typedef struct bench_point_s
+{
+    float                       pos[3];
+    float                       target[3];
+}bench_point_t, *bench_point_p;
+
+typedef struct bench_path_s
+{
+    struct flyby_camera_sequence_s *flyby;                                      // if NULL - points path
+    bench_point_p                   points;
+    uint32_t                        points_count;
+}bench_path_t, *bench_path_p;
+
+typedef struct bench_frame_s
+{
+    double                      gen_ms;
+    double                      draw_ms;
+    double                      finish_ms;
+    float                       gpu_ms;                                         // < 0 if not measured
+    uint32_t                    stats_frame;                                    // GL stats frame, to match late timer results
+    uint32_t                    draw_calls;
+    uint32_t                    vertices;
+    uint32_t                    texture_binds;
+    uint64_t                    hash;
+}bench_frame_t, *bench_frame_p;
+
+
+static uint64_t Bench_Hash(uint64_t hash, const uint8_t *data, size_t size)
+{
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static bench_point_p Bench_ReadPath(const char *file_name, uint32_t *count)
+{
+    FILE *f = fopen(file_name, "r");
+    bench_point_p points = NULL;
+    uint32_t size = 0;
+    bench_point_t p;
+
+    *count = 0;
+    if(f == NULL)
+    {
+        fprintf(stderr, "bench: can not open camera path \"%s\"\n", file_name);
+        return NULL;
+    }
+
+    while(6 == fscanf(f, "%f %f %f %f %f %f", p.pos + 0, p.pos + 1, p.pos + 2, p.target + 0, p.target + 1, p.target + 2))
+    {
+        if(*count >= size)
+        {
+            uint32_t new_size = (size > 0) ? (size * 2) : (64);
+            bench_point_p new_points = (bench_point_p)realloc(points, new_size * sizeof(bench_point_t));
+            if(new_points == NULL)
+            {
+                break;
+            }
+            points = new_points;
+            size = new_size;
+        }
+        points[(*count)++] = p;
+    }
+    fclose(f);
+
+    return points;
+}
+
+/**
+ * Camera goes from one room centre to the next one, looking ahead.
+ */
+static bench_point_p Bench_RoomsPath(uint32_t *count)
+{
+    room_p rooms = NULL;
+    uint32_t rooms_count = 0;
+    bench_point_p points;
+
+    *count = 0;
+    World_GetRoomInfo(&rooms, &rooms_count);
+    points = (rooms_count > 0) ? ((bench_point_p)malloc(rooms_count * sizeof(bench_point_t))) : (NULL);
+    if(points == NULL)
+    {
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < rooms_count; i++)
+    {
+        room_p r = rooms + i;
+        if(r->real_room == r)
+        {
+            bench_point_p p = points + *count;
+            p->pos[0] = (r->bb_min[0] + r->bb_max[0]) / 2;
+            p->pos[1] = (r->bb_min[1] + r->bb_max[1]) / 2;
+            p->pos[2] = (r->bb_min[2] + r->bb_max[2]) / 2;
+            if(*count > 0)
+            {
+                vec3_copy(points[*count - 1].target, p->pos);
+            }
+            (*count)++;
+        }
+    }
+
+    if(*count > 0)
+    {
+        bench_point_p last = points + *count - 1;
+        vec3_copy(last->target, (*count > 1) ? (points[0].pos) : (last->pos));
+        last->target[0] += (*count > 1) ? (0.0f) : (BENCH_LOOK_DIST);
+    }
+
+    return points;
+}
+
+
+static void Bench_SetCamera(bench_path_p path, uint32_t frame, uint32_t frames)
+{
+    camera_p cam = &engine_camera;
+
+    if(path->flyby)
+    {
+        float max_t = path->flyby->pos_x->base_points_count - 1;
+        FlyBySequence_SetCamera(path->flyby, cam, (frames > 1) ? (max_t * frame / (frames - 1)) : (0.0f));
+    }
+    else
+    {
+        float t = (frames > 1) ? ((float)(path->points_count - 1) * frame / (frames - 1)) : (0.0f);
+        uint32_t i = t;
+        bench_point_p a = path->points + ((i < path->points_count) ? (i) : (path->points_count - 1));
+        bench_point_p b = (i + 1 < path->points_count) ? (a + 1) : (a);
+        float to[3];
+
+        t -= i;
+        vec3_interpolate_macro(cam->gl_transform + 12, a->pos, b->pos, t, 1.0f - t);
+        vec3_interpolate_macro(to, a->target, b->target, t, 1.0f - t);
+        Cam_LookTo(cam, to);
+    }
+}
+
+
+/**
+ * A hidden window has no pixels owned by its default framebuffer, so the
+ * images are rendered into a FBO with the same size and stencil as the window.
+ */
+static GLuint Bench_CreateTarget(GLint viewport[4], GLuint renderbuffers[2])
+{
+    GLuint fbo = 0;
+    GLsizei w = viewport[0] + viewport[2];
+    GLsizei h = viewport[1] + viewport[3];
+
+    if(!qglGenFramebuffers || !qglGenRenderbuffers)
+    {
+        return 0;
+    }
+
+    qglGenRenderbuffers(2, renderbuffers);
+    qglBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    qglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    qglBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    qglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    qglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    qglGenFramebuffers(1, &fbo);
+    qglBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    qglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    qglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if(qglCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        qglBindFramebuffer(GL_FRAMEBUFFER, 0);
+        qglDeleteFramebuffers(1, &fbo);
+        qglDeleteRenderbuffers(2, renderbuffers);
+        return 0;
+    }
+
+    return fbo;
+}
+
+/**
+ * Timer results come some frames late; they are given to the recorded frame
+ * they were measured in.
+ */
+static void Bench_SetGPUTime(bench_frame_p frames, uint32_t frames_count)
+{
+    const gl_stats_t *stats = GLStats_GetLastFrame();
+    uint32_t first = (frames_count > GL_STATS_QUERY_FRAMES) ? (frames_count - GL_STATS_QUERY_FRAMES) : (0);
+
+    for(uint32_t i = first; i < frames_count; i++)
+    {
+        if(frames[i].stats_frame == stats->timed_frame)
+        {
+            frames[i].gpu_ms = stats->timed_ms;
+            break;
+        }
+    }
+}
+
+
+static void Bench_RenderFrame(bench_frame_p frame, uint8_t *pixels, GLint viewport[4])
+{
+    const gl_stats_t *stats;
+    Uint64 t0, t1, t2, t3;
+    double freq = (double)SDL_GetPerformanceFrequency();
+
+    qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Cam_Apply(&engine_camera);
+    Cam_RecalcClipPlanes(&engine_camera);
+
+    qglPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    qglEnableClientState(GL_NORMAL_ARRAY);
+    qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    qglFrontFace(GL_CW);
+
+    t0 = SDL_GetPerformanceCounter();
+    renderer.GenWorldList(&engine_camera);
+    t1 = SDL_GetPerformanceCounter();
+    renderer.DrawList();
+    t2 = SDL_GetPerformanceCounter();
+    qglFinish();
+    t3 = SDL_GetPerformanceCounter();
+    qglPopClientAttrib();
+
+    frame->gen_ms = 1000.0 * (t1 - t0) / freq;
+    frame->draw_ms = 1000.0 * (t2 - t1) / freq;
+    frame->finish_ms = 1000.0 * (t3 - t2) / freq;
+    frame->hash = BENCH_HASH_INIT;
+    if(pixels)
+    {
+        qglPixelStorei(GL_PACK_ALIGNMENT, 1);
+        qglReadPixels(viewport[0], viewport[1], viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        frame->hash = Bench_Hash(frame->hash, pixels, 4 * viewport[2] * viewport[3]);
+    }
+
+    Engine_GLSwapWindow();
+
+    stats = GLStats_GetLastFrame();
+    frame->gpu_ms = -1.0f;
+    frame->stats_frame = stats->frame;
+    frame->draw_calls = stats->draw_calls;
+    frame->vertices = stats->vertices;
+    frame->texture_binds = stats->texture_binds;
+}
+
+
+int Bench_Render(bench_render_params_p params)
+{
+    bench_path_p paths = NULL;
+    uint32_t paths_count = 0;
+    uint32_t frames = (params->frames > 0) ? (params->frames) : (BENCH_DEFAULT_FRAMES);
+    bench_point_p points = NULL;
+    uint32_t points_count = 0;
+    FILE *out = NULL;
+    uint8_t *pixels = NULL;
+    GLint viewport[4] = {0, 0, 0, 0};
+    GLfloat fov = engine_camera.fov;
+    bench_frame_t frame, total;
+    bench_frame_p records = NULL;
+    GLuint fbo = 0;
+    GLuint renderbuffers[2] = {0, 0};
+    uint32_t total_frames = 0;
+    uint64_t total_hash = BENCH_HASH_INIT;
+
+    if(!Engine_LoadMap(params->level))
+    {
+        fprintf(stderr, "bench: can not load level \"%s\"\n", params->level);
+        return 1;
+    }
+
+    if(params->path)
+    {
+        points = Bench_ReadPath(params->path, &points_count);
+        paths_count = (points_count > 0) ? (1) : (0);
+    }
+    else
+    {
+        for(flyby_camera_sequence_p s = World_GetFlyBySequences(); s; s = s->next)
+        {
+            paths_count++;
+        }
+        if(paths_count == 0)
+        {
+            points = Bench_RoomsPath(&points_count);
+            paths_count = (points_count > 0) ? (1) : (0);
+        }
+    }
+
+    paths = (paths_count > 0) ? ((bench_path_p)calloc(paths_count, sizeof(bench_path_t))) : (NULL);
+    if(paths == NULL)
+    {
+        fprintf(stderr, "bench: no camera paths\n");
+        free(points);
+        return 1;
+    }
+
+    records = (bench_frame_p)malloc(frames * sizeof(bench_frame_t));
+    if(records == NULL)
+    {
+        free(points);
+        free(paths);
+        return 1;
+    }
+
+    if(points)
+    {
+        paths->points = points;
+        paths->points_count = points_count;
+    }
+    else
+    {
+        bench_path_p p = paths;
+        for(flyby_camera_sequence_p s = World_GetFlyBySequences(); s; s = s->next, p++)
+        {
+            p->flyby = s;
+        }
+    }
+
+    if(params->out)
+    {
+        out = fopen(params->out, "w");
+        if(out == NULL)
+        {
+            fprintf(stderr, "bench: can not write \"%s\"\n", params->out);
+        }
+        else
+        {
+            fprintf(out, "path,frame,gen_ms,draw_ms,finish_ms,gpu_ms,draw_calls,vertices,texture_binds,hash\n");
+        }
+    }
+
+    qglGetIntegerv(GL_VIEWPORT, viewport);
+    fbo = Bench_CreateTarget(viewport, renderbuffers);
+    if(fbo)
+    {
+        pixels = (uint8_t*)malloc(4 * viewport[2] * viewport[3]);
+    }
+    else
+    {
+        fprintf(stderr, "bench: no framebuffer objects, images are not hashed\n");
+    }
+    GLStats_SetEnabled(1);
+    memset(&total, 0, sizeof(total));
+
+    for(uint32_t i = 0; i < paths_count; i++)
+    {
+        Cam_SetFovAspect(&engine_camera, fov, engine_camera.aspect);            // flyby may change it
+        for(uint32_t j = 0; j < ((i == 0) ? (BENCH_WARMUP_FRAMES) : (0)); j++)
+        {
+            renderer.SetFixedTick(0);
+            Bench_SetCamera(paths + i, 0, frames);
+            Bench_RenderFrame(&frame, NULL, viewport);
+        }
+
+        for(uint32_t j = 0; j < frames; j++)
+        {
+            renderer.SetFixedTick(j * BENCH_TICK_STEP);
+            Bench_SetCamera(paths + i, j, frames);
+            Bench_RenderFrame(records + j, pixels, viewport);
+            Bench_SetGPUTime(records, j + 1);
+        }
+
+        // not recorded frames, to get the timer results of the last ones
+        for(uint32_t j = 1; j < GL_STATS_QUERY_FRAMES; j++)
+        {
+            Bench_RenderFrame(&frame, NULL, viewport);
+            Bench_SetGPUTime(records, frames);
+        }
+
+        for(uint32_t j = 0; j < frames; j++)
+        {
+            bench_frame_p f = records + j;
+            if(out)
+            {
+                fprintf(out, "%d,%d,%.4f,%.4f,%.4f,%.4f,%d,%d,%d,%016llx\n", i, j, f->gen_ms, f->draw_ms, f->finish_ms, f->gpu_ms,
+                        f->draw_calls, f->vertices, f->texture_binds, (unsigned long long)f->hash);
+            }
+            total.gen_ms += f->gen_ms;
+            total.draw_ms += f->draw_ms;
+            total.finish_ms += f->finish_ms;
+            total.gpu_ms += (f->gpu_ms > 0.0f) ? (f->gpu_ms) : (0.0f);
+            total.draw_calls += f->draw_calls;
+            total_hash = Bench_Hash(total_hash, (const uint8_t*)&f->hash, sizeof(f->hash));
+            total_frames++;
+        }
+    }
+
+    renderer.SetFixedTick(-1);
+    GLStats_SetEnabled(0);
+    if(fbo)
+    {
+        qglBindFramebuffer(GL_FRAMEBUFFER, 0);
+        qglDeleteFramebuffers(1, &fbo);
+        qglDeleteRenderbuffers(2, renderbuffers);
+    }
+    if(out)
+    {
+        fclose(out);
+    }
+    free(records);
+    free(pixels);
+    free(points);
+    free(paths);
+
+    printf("bench: %s, %d paths, %d frames, %dx%d\n", params->level, paths_count, total_frames, viewport[2], viewport[3]);
+    printf("bench: avg gen = %.3f ms, draw = %.3f ms, finish = %.3f ms, gpu = %.3f ms, draw calls = %.1f\n",
+           total.gen_ms / total_frames, total.draw_ms / total_frames, total.finish_ms / total_frames,
+           total.gpu_ms / total_frames, (double)total.draw_calls / total_frames);
+    printf("bench: images hash = %016llx\n", (unsigned long long)total_hash);
+
+    return 0;
+}
+
+
+/*
+ * Physics benchmark scene: entities of the player model in 8 x 8 layers above
+ * the player; all numbers of a tick are kept as double for common statistics.
+ */
+#define BENCH_PHYSICS_DT            (1.0f / 60.0f)
+#define BENCH_SPAWN_STEP            (256.0f)
+#define BENCH_SPAWN_HEIGHT          (512.0f)
+#define BENCH_RAY_LENGTH            (8192.0f)
+#define BENCH_RAY_SEED              (0x2545F491)
+
+typedef struct bench_tick_s
+{
+    double                      tick_ms;                                        // whole game frame
+    double                      step_ms;                                        // Physics_StepSimulation
+    double                      ghosts_ms;
+    double                      rays_ms;
+    double                      batch_ms;
+    double                      ray_hits;
+    double                      ghost_contacts;
+    double                      pairs;
+    double                      manifolds;
+    double                      contacts;
+    double                      active_bodies;
+    double                      allocations;                                    // Bullet and contacts pool heap allocations
+}bench_tick_t, *bench_tick_p;
+
+static const struct
+{
+    const char                 *name;
+    size_t                      offset;
+}bench_tick_fields[] =
+{
+    {"tick_ms", offsetof(bench_tick_t, tick_ms)},
+    {"step_ms", offsetof(bench_tick_t, step_ms)},
+    {"ghosts_ms", offsetof(bench_tick_t, ghosts_ms)},
+    {"rays_ms", offsetof(bench_tick_t, rays_ms)},
+    {"batch_ms", offsetof(bench_tick_t, batch_ms)},
+    {"ray_hits", offsetof(bench_tick_t, ray_hits)},
+    {"ghost_contacts", offsetof(bench_tick_t, ghost_contacts)},
+    {"pairs", offsetof(bench_tick_t, pairs)},
+    {"manifolds", offsetof(bench_tick_t, manifolds)},
+    {"contacts", offsetof(bench_tick_t, contacts)},
+    {"active_bodies", offsetof(bench_tick_t, active_bodies)},
+    {"allocations", offsetof(bench_tick_t, allocations)}
+};
+
+#define BENCH_TICK_FIELDS_COUNT     (sizeof(bench_tick_fields) / sizeof(bench_tick_fields[0]))
+#define BENCH_TICK_FIELD(t, i)      (*(double*)((uint8_t*)(t) + bench_tick_fields[i].offset))
+
+
+static entity_p Bench_Spawn(uint32_t model_id, room_p room, float origin[3], uint32_t index)
+{
+    float pos[3];
+    room_p r;
+
+    pos[0] = origin[0] + ((float)(index % 8) - 3.5f) * BENCH_SPAWN_STEP;
+    pos[1] = origin[1] + ((float)((index / 8) % 8) - 3.5f) * BENCH_SPAWN_STEP;
+    pos[2] = origin[2] + BENCH_SPAWN_HEIGHT + (float)(index / 64) * BENCH_SPAWN_STEP;
+    r = World_FindRoomByPosCogerrence(pos, room);
+    r = (r) ? (r) : (room);
+
+    return World_GetEntityByID(World_SpawnEntity(model_id, r->id, pos, NULL, -1));
+}
+
+
+static entity_p Bench_SpawnCharacter(uint32_t model_id, room_p room, float origin[3], uint32_t index)
+{
+    entity_p ent = Bench_Spawn(model_id, room, origin, index);
+    if(ent)
+    {
+        Character_Create(ent);
+        ent->character->ai_zone = -1;                                           // no AI, just physics
+        Character_SetParamMaximum(ent, PARAM_HEALTH, 1.0f);
+        Character_SetParam(ent, PARAM_HEALTH, 1.0f);
+    }
+    return ent;
+}
+
+/**
+ * Runs the script expression, setup table is left on the stack.
+ */
+static int Bench_GetLuaSetup(const char *expr)
+{
+    int top = lua_gettop(engine_lua);
+    if(luaL_dostring(engine_lua, expr) || !lua_istable(engine_lua, -1))
+    {
+        lua_settop(engine_lua, top);
+        return 0;
+    }
+    return 1;
+}
+
+
+static int Bench_HairType()
+{
+    switch(World_GetVersion())
+    {
+        case TR_I:
+        case TR_I_DEMO:
+        case TR_I_UB:
+            return HAIR_TR1;
+
+        case TR_II:
+        case TR_II_DEMO:
+            return HAIR_TR2;
+
+        case TR_III:
+            return HAIR_TR3;
+
+        case TR_IV:
+        case TR_IV_DEMO:
+            return HAIR_TR4_OLD;
+    };
+    return HAIR_TR5_OLD;
+}
+
+
+static void Bench_SpawnPhysicsScene(bench_physics_params_p params, entity_p player, uint32_t *ghost_ids, uint32_t counts[4])
+{
+    uint32_t model_id = player->bf->animations.model->id;
+    room_p room = player->self->room;
+    float *origin = player->transform + 12;
+    uint32_t index = 0;
+    int top = lua_gettop(engine_lua);
+    char expr[64];
+
+    memset(counts, 0, 4 * sizeof(uint32_t));
+    for(uint32_t i = 0; i < params->balls; i++)
+    {
+        entity_p ent = Bench_Spawn(model_id, room, origin, index++);
+        if(ent)
+        {
+            ent->self->collision_group = COLLISION_GROUP_DYNAMICS;
+            ent->self->collision_shape = COLLISION_SHAPE_SINGLE_SPHERE;
+            Physics_GenRigidBody(ent->physics, ent->bf);
+            Physics_SetBodyMass(ent->physics, 1.0f, 0);
+            Physics_SetCollisionGroupAndMask(ent->physics, ent->self->collision_group, ent->self->collision_mask);
+            ent->type_flags |= ENTITY_TYPE_DYNAMIC;
+            counts[0]++;
+        }
+    }
+
+    for(uint32_t i = 0; i < params->ghosts; i++)
+    {
+        entity_p ent = Bench_Spawn(model_id, room, origin, index++);
+        if(ent)
+        {
+            Physics_CreateGhosts(ent->physics, ent->bf, NULL);
+            Entity_GhostUpdate(ent);
+            ghost_ids[counts[1]++] = ent->id;
+        }
+    }
+
+    for(uint32_t i = 0; i < params->ragdolls; i++)
+    {
+        entity_p ent = (Bench_GetLuaSetup("return getRagdollSetup(RD_TYPE_LARA)")) ? (Bench_SpawnCharacter(model_id, room, origin, index++)) : (NULL);
+        if(ent)
+        {
+            ent->character->ragdoll = Ragdoll_GetSetup(engine_lua, -1);
+            ent->character->state.dead = 0x01;
+            ent->character->state.ragdoll = 0x01;
+            if(ent->character->ragdoll && Ragdoll_Create(ent->physics, ent->bf, ent->character->ragdoll))
+            {
+                ent->type_flags |= ENTITY_TYPE_DYNAMIC;
+                counts[2]++;
+            }
+        }
+        lua_settop(engine_lua, top);
+    }
+
+    snprintf(expr, sizeof(expr), "return getHairSetup(%d)", Bench_HairType());
+    for(uint32_t i = 0; i < params->hairs; i++)
+    {
+        entity_p ent = (Bench_GetLuaSetup(expr)) ? (Bench_SpawnCharacter(model_id, room, origin, index++)) : (NULL);
+        struct hair_setup_s *setup = (ent) ? (Hair_GetSetup(engine_lua, -1)) : (NULL);
+        if(setup)
+        {
+            struct hair_s *hair = Hair_Create(setup, ent->physics, ent->bf);
+            if(hair)
+            {
+                ent->character->hairs = (struct hair_s**)malloc(sizeof(struct hair_s*));
+                ent->character->hairs[0] = hair;
+                ent->character->hair_count = 1;
+                counts[3]++;
+            }
+            Hair_DeleteSetup(setup);
+        }
+        lua_settop(engine_lua, top);
+    }
+}
+
+
+static void Bench_PhysicsTick(bench_tick_p tick, uint32_t *ghost_ids, uint32_t ghosts_count, float from[3], room_p room,
+                              physics_query_p queries, uint32_t rays)
+{
+    double freq = (double)SDL_GetPerformanceFrequency();
+    uint32_t allocations = Physics_GetHeapAllocations();
+    uint32_t seed = BENCH_RAY_SEED;
+    physics_step_info_t info;
+    engine_container_t cont;
+    collision_result_t cb;
+    Uint64 t0, t1, t2, t3, t4;
+
+    memset(tick, 0, sizeof(bench_tick_t));
+    memset(&cont, 0, sizeof(cont));                                             // no sector, not heavy
+    cont.room = room;
+    for(uint32_t i = 0; i < rays; i++)
+    {
+        physics_query_p q = queries + i;
+        float dir[3], len;
+        for(int j = 0; j < 3; j++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            dir[j] = (float)(seed >> 8) / (float)(1 << 23) - 1.0f;
+        }
+        len = vec3_abs(dir);
+        len = (len > 0.001f) ? (BENCH_RAY_LENGTH / len) : (0.0f);
+        q->type = PHYSICS_QUERY_RAY;
+        q->filter = COLLISION_MASK_ALL;
+        q->cont = &cont;
+        vec3_copy(q->from, from);
+        vec3_add_mul(q->to, from, dir, len);
+    }
+
+    Sys_ResetTempMem();
+    engine_frame_time = BENCH_PHYSICS_DT;
+    t0 = SDL_GetPerformanceCounter();
+    Game_Frame(BENCH_PHYSICS_DT);
+    t1 = SDL_GetPerformanceCounter();
+    for(uint32_t i = 0; i < ghosts_count; i++)
+    {
+        entity_p ent = World_GetEntityByID(ghost_ids[i]);
+        if(ent)
+        {
+            collision_node_p nodes;
+            Entity_GhostUpdate(ent);
+            for(uint16_t j = 0; j < ent->bf->bone_tag_count; j++)
+            {
+                tick->ghost_contacts += Physics_GetGhostCurrentCollision(ent->physics, j, COLLISION_MASK_ALL, &nodes);
+            }
+        }
+    }
+    t2 = SDL_GetPerformanceCounter();
+    for(uint32_t i = 0; i < rays; i++)
+    {
+        tick->ray_hits += Physics_RayTest(&cb, queries[i].from, queries[i].to, &cont, COLLISION_MASK_ALL);
+    }
+    t3 = SDL_GetPerformanceCounter();
+    Physics_QueryBatch(queries, rays);
+    t4 = SDL_GetPerformanceCounter();
+
+    Physics_GetStepInfo(&info);
+    tick->tick_ms = 1000.0 * (t1 - t0) / freq;
+    tick->step_ms = info.step_ms;
+    tick->ghosts_ms = 1000.0 * (t2 - t1) / freq;
+    tick->rays_ms = 1000.0 * (t3 - t2) / freq;
+    tick->batch_ms = 1000.0 * (t4 - t3) / freq;
+    tick->pairs = info.pairs;
+    tick->manifolds = info.manifolds;
+    tick->contacts = info.contacts;
+    tick->active_bodies = info.active_bodies;
+    tick->allocations = Physics_GetHeapAllocations() - allocations;
+}
+
+
+static void Bench_WriteJsonString(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for(; str && *str; str++)
+    {
+        if((*str == '"') || (*str == '\\'))
+        {
+            fputc('\\', f);
+        }
+        fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+
+static void Bench_WritePhysicsJson(FILE *f, bench_physics_params_p params, uint32_t counts[4], bench_tick_p ticks, uint32_t ticks_count)
+{
+    double rays_ms = 0.0, batch_ms = 0.0, allocations = 0.0;
+
+    for(uint32_t i = 0; i < ticks_count; i++)
+    {
+        rays_ms += ticks[i].rays_ms;
+        batch_ms += ticks[i].batch_ms;
+        allocations += ticks[i].allocations;
+    }
+
+    fprintf(f, "{\n  \"level\": ");
+    Bench_WriteJsonString(f, params->level);
+    fprintf(f, ",\n  \"ticks\": %d,\n  \"dt\": %.6f,\n", ticks_count, BENCH_PHYSICS_DT);
+    fprintf(f, "  \"spawned\": {\"balls\": %d, \"ghosts\": %d, \"ragdolls\": %d, \"hairs\": %d},\n", counts[0], counts[1], counts[2], counts[3]);
+    fprintf(f, "  \"rays_per_tick\": %d,\n", params->rays);
+    fprintf(f, "  \"rays_per_ms\": %.3f,\n", (rays_ms > 0.0) ? (params->rays * ticks_count / rays_ms) : (0.0));
+    fprintf(f, "  \"batch_rays_per_ms\": %.3f,\n", (batch_ms > 0.0) ? (params->rays * ticks_count / batch_ms) : (0.0));
+    fprintf(f, "  \"heap_allocations\": %.0f,\n", allocations);
+
+    fprintf(f, "  \"summary\": {");
+    for(uint32_t i = 0; i < BENCH_TICK_FIELDS_COUNT; i++)
+    {
+        double sum = 0.0, max = 0.0;
+        for(uint32_t j = 0; j < ticks_count; j++)
+        {
+            double v = BENCH_TICK_FIELD(ticks + j, i);
+            sum += v;
+            max = (v > max) ? (v) : (max);
+        }
+        fprintf(f, "%s\n    \"%s\": {\"avg\": %.4f, \"max\": %.4f}", (i > 0) ? (",") : (""), bench_tick_fields[i].name,
+                (ticks_count > 0) ? (sum / ticks_count) : (0.0), max);
+    }
+    fprintf(f, "\n  },\n");
+
+    fprintf(f, "  \"per_tick\": [");
+    for(uint32_t j = 0; j < ticks_count; j++)
+    {
+        fprintf(f, "%s\n    {", (j > 0) ? (",") : (""));
+        for(uint32_t i = 0; i < BENCH_TICK_FIELDS_COUNT; i++)
+        {
+            fprintf(f, "%s\"%s\": %.4g", (i > 0) ? (", ") : (""), bench_tick_fields[i].name, BENCH_TICK_FIELD(ticks + j, i));
+        }
+        fputc('}', f);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+
+int Bench_Physics(bench_physics_params_p params)
+{
+    uint32_t ticks_count = (params->ticks > 0) ? (params->ticks) : (BENCH_DEFAULT_FRAMES);
+    uint32_t counts[4];
+    uint32_t *ghost_ids = NULL;
+    bench_tick_p ticks = NULL;
+    physics_query_p queries = NULL;
+    entity_p player;
+    float from[3];
+    FILE *out = stdout;
+
+    if(!Engine_LoadMap(params->level))
+    {
+        fprintf(stderr, "bench: can not load level \"%s\"\n", params->level);
+        return 1;
+    }
+
+    player = World_GetPlayer();
+    if(!player || !player->self->room)
+    {
+        fprintf(stderr, "bench: no player in level \"%s\"\n", params->level);
+        return 1;
+    }
+
+    ghost_ids = (uint32_t*)malloc((params->ghosts + 1) * sizeof(uint32_t));
+    ticks = (bench_tick_p)malloc(ticks_count * sizeof(bench_tick_t));
+    queries = (physics_query_p)malloc((params->rays + 1) * sizeof(physics_query_t));
+    if(!ghost_ids || !ticks || !queries)
+    {
+        free(ghost_ids);
+        free(ticks);
+        free(queries);
+        return 1;
+    }
+
+    Bench_SpawnPhysicsScene(params, player, ghost_ids, counts);
+    vec3_copy(from, player->transform + 12);
+    from[2] += BENCH_SPAWN_HEIGHT * 0.5f;
+
+    for(uint32_t i = 0; i < ticks_count; i++)
+    {
+        Bench_PhysicsTick(ticks + i, ghost_ids, counts[1], from, player->self->room, queries, params->rays);
+    }
+
+    if(params->out)
+    {
+        out = fopen(params->out, "w");
+        if(out == NULL)
+        {
+            fprintf(stderr, "bench: can not write \"%s\"\n", params->out);
+            out = stdout;
+        }
+    }
+    Bench_WritePhysicsJson(out, params, counts, ticks, ticks_count);
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+
+    free(ghost_ids);
+    free(ticks);
+    free(queries);
+
+    return 0;
+}
+
+
+static void Bench_PortalsReport(const char *fmt, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, fmt);
+    vfprintf(stderr, fmt, argptr);
+    va_end(argptr);
+    fputc('\n', stderr);
+}
+
+
+void Bench_CheckPortalsRooms(struct camera_s *cam, bench_portals_result_p result, void (*report)(const char *fmt, ...))
+{
+    static const float pitches[] = {-45.0f, 0.0f, 45.0f};
+    room_p rooms = NULL;
+    uint32_t rooms_count = 0;
+    float old_transform[16], old_ang[3];
+    room_p old_room = cam->current_room;
+
+    memset(result, 0, sizeof(bench_portals_result_t));
+    memcpy(old_transform, cam->gl_transform, sizeof(old_transform));
+    vec3_copy(old_ang, cam->ang);
+    World_GetRoomInfo(&rooms, &rooms_count);
+    for(uint32_t i = 0; i < rooms_count; i++)
+    {
+        room_p r = rooms + i;
+        if(r->real_room != r)
+        {
+            continue;
+        }
+
+        for(uint32_t j = 0; j < BENCH_PORTALS_YAWS * sizeof(pitches) / sizeof(pitches[0]); j++)
+        {
+            float angles[3];
+            angles[0] = (float)(j % BENCH_PORTALS_YAWS) * 2.0f * M_PI / BENCH_PORTALS_YAWS;
+            angles[1] = pitches[j / BENCH_PORTALS_YAWS] * M_PI / 180.0f;
+            angles[2] = 0.0f;
+            Cam_SetRotation(cam, angles);
+            cam->gl_transform[12 + 0] = (r->bb_min[0] + r->bb_max[0]) / 2;
+            cam->gl_transform[12 + 1] = (r->bb_min[1] + r->bb_max[1]) / 2;
+            cam->gl_transform[12 + 2] = (r->bb_min[2] + r->bb_max[2]) / 2;
+            cam->current_room = r;
+            Cam_Apply(cam);
+            Cam_RecalcClipPlanes(cam);
+            switch(renderer.CheckParallelList(cam))
+            {
+                case 1:
+                    result->identical++;
+                    break;
+
+                case 0:
+                    result->different++;
+                    report("room %d, yaw %.1f, pitch %.1f: parallel list differs", r->id, angles[0] * 180.0f / M_PI, pitches[j / BENCH_PORTALS_YAWS]);
+                    break;
+
+                default:
+                    result->skipped++;
+                    break;
+            };
+        }
+    }
+
+    memcpy(cam->gl_transform, old_transform, sizeof(old_transform));
+    vec3_copy(cam->ang, old_ang);
+    cam->current_room = old_room;
+    Cam_Apply(cam);
+    Cam_RecalcClipPlanes(cam);
+}
+
+
+int Bench_CheckPortals(const char **levels, uint32_t levels_count)
+{
+    int ret = 0;
+
+    for(uint32_t i = 0; i < levels_count; i++)
+    {
+        bench_portals_result_t result;
+        if(!Engine_LoadMap(levels[i]))
+        {
+            fprintf(stderr, "check_portals: can not load level \"%s\"\n", levels[i]);
+            ret = 1;
+            continue;
+        }
+
+        Bench_CheckPortalsRooms(&engine_camera, &result, Bench_PortalsReport);
+        printf("check_portals: %s, identical = %d, different = %d, skipped = %d\n", levels[i], result.identical, result.different, result.skipped);
+        ret = ((result.different > 0) || (result.identical == 0)) ? (1) : (ret);  // nothing compared is a failure too
+    }
+
+    return ret;
+}
+
+
+int Bench_AddPathPoint(const char *file_name, struct camera_s *cam)
+{
+    FILE *f = fopen(file_name, "a");
+    float to[3];
+
+    if(f == NULL)
+    {
+        return 0;
+    }
+
+    vec3_add_mul(to, cam->gl_transform + 12, cam->gl_transform + 8, BENCH_LOOK_DIST);
+    fprintf(f, "%f %f %f %f %f %f\n", cam->gl_transform[12 + 0], cam->gl_transform[12 + 1], cam->gl_transform[12 + 2], to[0], to[1], to[2]);
+    fclose(f);
+
+    return 1;
+}
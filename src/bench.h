@@ -0,0 +1,87 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#define BENCH_DEFAULT_FRAMES        (300)                                       // frames per camera path
+#define BENCH_LOOK_DIST             (1024.0f)                                   // target distance for recorded points
+
+#define BENCH_PHYSICS_BALLS         (64)                                        // default physics scene
+#define BENCH_PHYSICS_GHOSTS        (8)
+#define BENCH_PHYSICS_RAGDOLLS      (4)
+#define BENCH_PHYSICS_HAIRS         (4)
+#define BENCH_PHYSICS_RAYS          (256)                                       // per tick
+
+#define BENCH_PORTALS_LEVELS_MAX    (16)                                        // -check_portals levels per run
+#define BENCH_PORTALS_YAWS          (8)                                         // directions per room centre, per pitch
+
+struct camera_s;
+
+typedef struct bench_portals_result_s
+{
+    uint32_t                    identical;
+    uint32_t                    different;
+    uint32_t                    skipped;                                        // parallel traversal was not taken
+}bench_portals_result_t, *bench_portals_result_p;
+
+typedef struct bench_render_params_s
+{
+    const char                 *level;                                          // relative to base path
+    const char                 *path;                                           // recorded camera path; NULL - level flybys or rooms walk
+    const char                 *out;                                            // per frame CSV; NULL - summary only
+    uint32_t                    frames;
+}bench_render_params_t, *bench_render_params_p;
+
+typedef struct bench_physics_params_s
+{
+    const char                 *level;                                          // relative to base path
+    const char                 *out;                                            // JSON results; NULL - stdout
+    uint32_t                    ticks;
+    uint32_t                    balls;                                          // COLLISION_GROUP_DYNAMICS spheres
+    uint32_t                    ghosts;                                         // kinematic entities, ghost contacts queried each tick
+    uint32_t                    ragdolls;
+    uint32_t                    hairs;                                          // characters carrying hair
+    uint32_t                    rays;
+}bench_physics_params_t, *bench_physics_params_p;
+
+/*
+ * Headless render benchmark: loads the level, flies the camera along the
+ * paths and measures each frame (GenWorldList and DrawList CPU time, GPU
+ * time, GL calls) with a hash of the read back image. Shader time is fixed,
+ * so the same build on the same driver gives the same hashes.
+ * Returns the process exit code.
+ */
+int  Bench_Render(bench_render_params_p params);
+
+/*
+ * Headless physics benchmark: loads the level, spawns the scene above the
+ * player and runs fixed time step game ticks, recording physics step time,
+ * ghost contacts, single and batched ray tests throughput, broadphase pairs,
+ * contacts and heap allocations of each tick. Spawn positions and rays are
+ * fixed, so runs are comparable between builds.
+ * Returns the process exit code.
+ */
+int  Bench_Physics(bench_physics_params_p params);
+
+/*
+ * Compares serial and parallel portal traversal (CRender::CheckParallelList)
+ * from every room centre of the current level, in BENCH_PORTALS_YAWS yaws for
+ * each of a few pitches; every mismatch is reported by the given function.
+ * Camera position, orientation and room are restored.
+ */
+void Bench_CheckPortalsRooms(struct camera_s *cam, bench_portals_result_p result, void (*report)(const char *fmt, ...));
+
+/*
+ * Headless portal traversal check of the given levels; returns 1 if any level
+ * can not be loaded, any list differs or nothing was compared, 0 otherwise.
+ */
+int  Bench_CheckPortals(const char **levels, uint32_t levels_count);
+
+/*
+ * Appends camera position and look target as "x y z tx ty tz" line;
+ * such files are the recorded paths of Bench_Render.
+ */
+int  Bench_AddPathPoint(const char *file_name, struct camera_s *cam);
+
+#endif
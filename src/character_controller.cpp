@@ -24,9 +24,11 @@
 #include "controls.h"
 #include "mesh.h"
 
-void Character_CollisionCallback(struct entity_s *ent, struct collision_node_s *cn);
+void Character_CollisionCallback(struct entity_s *ent, struct collision_node_s *cn, uint32_t count);
 void Character_FixByBox(struct entity_s *ent);
 
+static int character_sector_heights = 1;                                        // floor and ceiling from sectors data
+
 void Character_Create(struct entity_s *ent)
 {
     if(ent && !ent->character)
@@ -424,9 +426,9 @@ void Character_UpdateAI(struct entity_s *ent)
 }
 
 
-void Character_CollisionCallback(struct entity_s *ent, struct collision_node_s *cn)
+void Character_CollisionCallback(struct entity_s *ent, struct collision_node_s *cn, uint32_t count)
 {
-    for(; cn && cn->obj; cn = cn->next)
+    for(uint32_t i = 0; i < count; i++, cn++)
     {
         if(cn->obj->object_type == OBJECT_ENTITY)
         {
@@ -497,14 +499,29 @@ void Character_UpdateCurrentHeight(struct entity_s *ent)
     Character_GetHeightInfo(ent, from, hi, ent->character->height);
 }
 
+void Character_SetSectorHeights(int enabled)
+{
+    character_sector_heights = enabled;
+}
+
+
+int  Character_GetSectorHeights()
+{
+    return character_sector_heights;
+}
+
 /**
- * Start position are taken from ent->transform
+ * Start position are taken from ent->transform. Plain floor and ceiling come
+ * from sectors data when the column is free, otherwise from Bullet rays.
  */
 void Character_GetHeightInfo(struct entity_s *ent, float pos[3], struct height_info_s *fc, float v_offset)
 {
     float from[3], to[3];
+    physics_query_t heights[2];
+    collision_result_p dst[2];
+    uint32_t queries_count = 0;
     room_p r = (fc->self) ? (fc->self->room) : (NULL);
-    room_sector_p rs;
+    room_sector_p rs, start_rs = NULL;
 
     fc->floor_hit.hit = 0x00;
     fc->ceiling_hit.hit = 0x00;
@@ -516,6 +533,7 @@ void Character_GetHeightInfo(struct entity_s *ent, float pos[3], struct height_i
     if(r)
     {
         rs = Room_GetSectorXYZ(r, pos);                                         // if r != NULL then rs can not been NULL!!!
+        start_rs = rs;
         if(r->content->room_flags & TR_ROOM_FLAG_WATER)                         // in water - go up
         {
             while(rs->room_above)
@@ -583,12 +601,30 @@ void Character_GetHeightInfo(struct entity_s *ent, float pos[3], struct height_i
     vec3_copy(from, pos);
     to[0] = from[0];
     to[1] = from[1];
-    to[2] = from[2] - 8192.0f;
-
-    Physics_RayTestFiltered(&fc->floor_hit, from ,to, fc->self, COLLISION_FILTER_HEIGHT_TEST);
-
-    to[2] = from[2] + 4096.0f;
-    Physics_RayTestFiltered(&fc->ceiling_hit, from ,to, fc->self, COLLISION_FILTER_HEIGHT_TEST);
+    if(!character_sector_heights || !start_rs || !Sector_FloorTest(start_rs, fc->self, from, 8192.0f, &fc->floor_hit))
+    {
+        dst[queries_count] = &fc->floor_hit;
+        vec3_copy(heights[queries_count].to, from);
+        heights[queries_count++].to[2] -= 8192.0f;
+    }
+    if(!character_sector_heights || !start_rs || !Sector_CeilingTest(start_rs, fc->self, from, 4096.0f, &fc->ceiling_hit))
+    {
+        dst[queries_count] = &fc->ceiling_hit;
+        vec3_copy(heights[queries_count].to, from);
+        heights[queries_count++].to[2] += 4096.0f;
+    }
+    for(uint32_t i = 0; i < queries_count; i++)
+    {
+        heights[i].type = PHYSICS_QUERY_RAY_FILTERED;
+        heights[i].filter = COLLISION_FILTER_HEIGHT_TEST;
+        heights[i].cont = fc->self;
+        vec3_copy(heights[i].from, from);
+    }
+    Physics_QueryBatch(heights, queries_count);                                 // floor and ceiling share broadphase
+    for(uint32_t i = 0; i < queries_count; i++)
+    {
+        *dst[i] = heights[i].result;
+    }
 
     fc->slide = 0x00;
     if(fc->floor_hit.hit && (fc->floor_hit.normale[2] > 0.02) && (fc->floor_hit.normale[2] < ent->character->critical_slant_z_component))
@@ -2308,35 +2344,75 @@ int Character_IsTargetAccessible(struct entity_s *character, struct entity_s *ta
 }
 
 
+static int Character_IsTargetCandidate(struct entity_s *ent, struct entity_s *target, float *dot)
+{
+    if((target->type_flags & ENTITY_TYPE_ACTOR) && (target->state_flags & ENTITY_STATE_ACTIVE) &&
+       (!target->character || (target->character->parameters.param[PARAM_HEALTH] > 0.0f)))
+    {
+        float dir[3], t;
+        vec3_sub(dir, target->transform + 12, ent->transform + 12);
+        vec3_norm(dir, t);
+        *dot = vec3_dot(ent->transform + 4, dir);
+        return *dot > 0.0f;
+    }
+    return 0;
+}
+
+/**
+ * Targets in front are sorted by dot (stable, so the first found wins on
+ * equal); visibility rays go in that order and stop at the first visible one.
+ */
 struct entity_s *Character_FindTarget(struct entity_s *ent)
 {
     entity_p ret = NULL;
-    float max_dot = 0.0f;
-    collision_result_t cs;
+    float t;
+    uint32_t count = 0;
 
     for(int ri = -1; ri < ent->self->room->content->near_room_list_size; ++ri)
     {
         room_p r = (ri >= 0) ? (ent->self->room->content->near_room_list[ri]) : (ent->self->room);
         for(engine_container_p cont = r->containers; cont; cont = cont->next)
         {
-            if(cont->object_type == OBJECT_ENTITY)
+            count += (cont->object_type == OBJECT_ENTITY) && Character_IsTargetCandidate(ent, (entity_p)cont->object, &t);
+        }
+    }
+
+    if(count > 0)
+    {
+        size_t buf_size = count * (sizeof(float) + sizeof(entity_p));
+        entity_p *targets = (entity_p*)Sys_GetTempMem(buf_size);
+        float *dots = (float*)(targets + count);
+        collision_result_t cs;
+        uint32_t i = 0;
+
+        for(int ri = -1; ri < ent->self->room->content->near_room_list_size; ++ri)
+        {
+            room_p r = (ri >= 0) ? (ent->self->room->content->near_room_list[ri]) : (ent->self->room);
+            for(engine_container_p cont = r->containers; cont && (i < count); cont = cont->next)
             {
-                entity_p target = (entity_p)cont->object;
-                if((target->type_flags & ENTITY_TYPE_ACTOR) && (target->state_flags & ENTITY_STATE_ACTIVE) &&
-                   (!target->character || (target->character->parameters.param[PARAM_HEALTH] > 0.0f)))
+                if((cont->object_type == OBJECT_ENTITY) && Character_IsTargetCandidate(ent, (entity_p)cont->object, &t))
                 {
-                    float dir[3], t;
-                    vec3_sub(dir, target->transform + 12, ent->transform + 12);
-                    vec3_norm(dir, t);
-                    t = vec3_dot(ent->transform + 4, dir);
-                    if((t > max_dot) && (!Physics_RayTest(&cs, ent->obb->centre, target->obb->centre, ent->self, COLLISION_FILTER_CHARACTER) || (cs.obj == target->self)))
+                    uint32_t j = i++;
+                    for(; (j > 0) && (dots[j - 1] < t); j--)
                     {
-                        max_dot = t;
-                        ret = target;
+                        dots[j] = dots[j - 1];
+                        targets[j] = targets[j - 1];
                     }
+                    dots[j] = t;
+                    targets[j] = (entity_p)cont->object;
                 }
             }
         }
+
+        for(uint32_t j = 0; j < i; j++)
+        {
+            if(!Physics_RayTest(&cs, ent->obb->centre, targets[j]->obb->centre, ent->self, COLLISION_FILTER_CHARACTER) || (cs.obj == targets[j]->self))
+            {
+                ret = targets[j];
+                break;
+            }
+        }
+        Sys_ReturnTempMem(buf_size);
     }
 
     return ret;
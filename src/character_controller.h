@@ -317,6 +317,8 @@ void Character_UpdatePath(struct entity_s *ent, struct room_sector_s *target);
 void Character_GoByPathToTarget(struct entity_s *ent);
 void Character_UpdateAI(struct entity_s *ent);
 
+void Character_SetSectorHeights(int enabled);                                   // 0 - height tests always by Bullet rays
+int  Character_GetSectorHeights();
 void Character_GetHeightInfo(struct entity_s *ent, float pos[3], struct height_info_s *fc, float v_offset = 0.0);
 int  Character_CheckNextStep(struct entity_s *ent, float offset[3], struct height_info_s *nfc);
 int  Character_HasStopSlant(struct entity_s *ent, height_info_p next_fc);
@@ -495,6 +495,55 @@ void glf_get_string_bb(gl_tex_font_p glf, const char *text, int n, int32_t *x0,
 }
 
 
+uint32_t glf_get_string_quads(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym, gl_glyph_quad_p quads)
+{
+    uint32_t ret = 0;
+
+    if(glf && glf->ft_face && text && (text[0] != 0))
+    {
+        uint8_t *nch, *ch = (uint8_t*)text;
+        FT_Vector kern;
+        int32_t x_pt = 0;
+        int32_t y_pt = 0;
+        uint32_t curr_utf32, next_utf32;
+
+        nch = utf8_to_utf32(ch, &curr_utf32);
+        curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+        for(; *ch && n_sym--;)
+        {
+            char_info_p g;
+            uint8_t *nch2 = utf8_to_utf32(nch, &next_utf32);
+
+            next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
+            ch = nch;
+            nch = nch2;
+
+            g = glf->glyphs + curr_utf32;
+            FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+            curr_utf32 = next_utf32;
+
+            if(g->tex_index != 0)
+            {
+                gl_glyph_quad_p q = quads + ret++;
+                q->tex_index = g->tex_index;
+                q->rect[0] = x + g->left + x_pt / 64.0f;
+                q->rect[1] = y + g->top + y_pt / 64.0f;
+                q->rect[2] = q->rect[0] + g->width;
+                q->rect[3] = q->rect[1] - g->height;
+                q->tex_coord[0] = g->tex_x0;
+                q->tex_coord[1] = g->tex_y0;
+                q->tex_coord[2] = g->tex_x1;
+                q->tex_coord[3] = g->tex_y1;
+            }
+            x_pt += kern.x + g->advance_x_pt;
+            y_pt += kern.y + g->advance_y_pt;
+        }
+    }
+
+    return ret;
+}
+
+
 void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym)
 {
     if(glf && glf->ft_face && text && (text[0] != 0))
@@ -55,6 +55,14 @@ typedef struct gl_fontstyle_s
     uint8_t                     rect;
 } gl_fontstyle_t, *gl_fontstyle_p;
 
+// Positioned glyph of the laid out string; used for batched text rendering.
+typedef struct gl_glyph_quad_s
+{
+    GLuint                      tex_index;
+    GLfloat                     rect[4];    // x0, y0, x1, y1
+    GLfloat                     tex_coord[4];
+} gl_glyph_quad_t, *gl_glyph_quad_p;
+
 #define GUI_FONT_FADE_SPEED             1.0                 // Global fading style speed.
 #define GUI_FONT_FADE_MIN               0.3                 // Minimum fade multiplier.
 
@@ -77,6 +85,8 @@ int32_t  glf_get_ascender(gl_tex_font_p glf);  // size in 1 / 64 px
 uint16_t glf_get_font_size(gl_tex_font_p glf);
 void     glf_get_string_bb(gl_tex_font_p glf, const char *text, int n, int32_t *x0, int32_t *y0, int32_t *x1, int32_t *y1);  // size in 1 / 64 px
 
+uint32_t glf_get_string_quads(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym, gl_glyph_quad_p quads);  // quads must fit utf8_strlen(text) items
+
 void     glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym);     // UTF-8
 
 
@@ -0,0 +1,315 @@
+/*
+ * File:   gl_program_cache.c
+ *
+ * File layout: header (magic, version, driver hash, entries count), then
+ * entries (key, binary format, binary size, binary data). The whole file is
+ * read on Begin; programs linked from source are added to the table.
+ */
+
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gl_program_cache.h"
+#include "gl_util.h"
+#include "system.h"
+
+#define GL_PROGRAM_CACHE_MAGIC      (0x4350544F)                                // "OTPC"
+#define GL_PROGRAM_CACHE_VERSION    (1)
+#define GL_PROGRAM_CACHE_LOG        "gl_log.txt"
+
+
+typedef struct gl_program_cache_entry_s
+{
+    uint64_t                 key;
+    uint32_t                 format;
+    uint32_t                 size;
+    uint8_t                 *data;
+    int                      used;
+} gl_program_cache_entry_t, *gl_program_cache_entry_p;
+
+static struct
+{
+    int                      active;
+    int                      dirty;
+    char                     file_name[1024];
+    uint64_t                 driver_hash;
+    gl_program_cache_entry_p entries;
+    uint32_t                 entries_count;
+    uint32_t                 entries_size;
+    uint32_t                 hits;
+    uint32_t                 misses;
+} gl_program_cache;
+
+
+uint64_t GLProgramCache_Hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *ch = (const uint8_t*)data;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ ch[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t GLProgramCache_HashString(uint64_t hash, GLenum name)
+{
+    const char *str = (const char*)qglGetString(name);
+    if(str)
+    {
+        hash = GLProgramCache_Hash(hash, str, strlen(str));
+    }
+    return GLProgramCache_Hash(hash, "\n", 1);
+}
+
+
+static gl_program_cache_entry_p GLProgramCache_AddEntry(uint64_t key)
+{
+    if(gl_program_cache.entries_count >= gl_program_cache.entries_size)
+    {
+        uint32_t new_size = (gl_program_cache.entries_size > 0) ? (gl_program_cache.entries_size * 2) : (32);
+        gl_program_cache_entry_p new_entries = (gl_program_cache_entry_p)realloc(gl_program_cache.entries, new_size * sizeof(gl_program_cache_entry_t));
+        if(new_entries == NULL)
+        {
+            return NULL;
+        }
+        gl_program_cache.entries = new_entries;
+        gl_program_cache.entries_size = new_size;
+    }
+
+    gl_program_cache_entry_p entry = gl_program_cache.entries + gl_program_cache.entries_count++;
+    entry->key = key;
+    entry->format = 0;
+    entry->size = 0;
+    entry->data = NULL;
+    entry->used = 0;
+    return entry;
+}
+
+
+static gl_program_cache_entry_p GLProgramCache_FindEntry(uint64_t key)
+{
+    for(uint32_t i = 0; i < gl_program_cache.entries_count; i++)
+    {
+        if(gl_program_cache.entries[i].key == key)
+        {
+            return gl_program_cache.entries + i;
+        }
+    }
+    return NULL;
+}
+
+
+static void GLProgramCache_ReadFile()
+{
+    FILE *f = fopen(gl_program_cache.file_name, "rb");
+    uint32_t header[3];
+    uint64_t driver_hash;
+
+    if(f == NULL)
+    {
+        gl_program_cache.dirty = 1;
+        return;
+    }
+
+    if((fread(header, sizeof(uint32_t), 2, f) != 2) || (fread(&driver_hash, sizeof(uint64_t), 1, f) != 1) ||
+       (fread(header + 2, sizeof(uint32_t), 1, f) != 1) || (header[0] != GL_PROGRAM_CACHE_MAGIC) ||
+       (header[1] != GL_PROGRAM_CACHE_VERSION) || (driver_hash != gl_program_cache.driver_hash))
+    {
+        Sys_DebugLog(GL_PROGRAM_CACHE_LOG, "program cache \"%s\" is outdated", gl_program_cache.file_name);
+        gl_program_cache.dirty = 1;
+        fclose(f);
+        return;
+    }
+
+    for(uint32_t i = 0; i < header[2]; i++)
+    {
+        uint64_t key;
+        uint32_t format_size[2];
+        gl_program_cache_entry_p entry;
+        if((fread(&key, sizeof(uint64_t), 1, f) != 1) || (fread(format_size, sizeof(uint32_t), 2, f) != 2) ||
+           ((entry = GLProgramCache_AddEntry(key)) == NULL))
+        {
+            gl_program_cache.dirty = 1;
+            break;
+        }
+        entry->format = format_size[0];
+        entry->size = format_size[1];
+        entry->data = (uint8_t*)malloc(entry->size);
+        if((entry->data == NULL) || (fread(entry->data, 1, entry->size, f) != entry->size))
+        {
+            free(entry->data);
+            gl_program_cache.entries_count--;
+            gl_program_cache.dirty = 1;
+            break;
+        }
+    }
+    fclose(f);
+}
+
+
+static void GLProgramCache_WriteFile()
+{
+    FILE *f = fopen(gl_program_cache.file_name, "wb");
+    uint32_t header[3] = {GL_PROGRAM_CACHE_MAGIC, GL_PROGRAM_CACHE_VERSION, 0};
+
+    if(f == NULL)
+    {
+        Sys_DebugLog(GL_PROGRAM_CACHE_LOG, "can not write program cache \"%s\"", gl_program_cache.file_name);
+        return;
+    }
+
+    for(uint32_t i = 0; i < gl_program_cache.entries_count; i++)
+    {
+        header[2] += (gl_program_cache.entries[i].used) ? (1) : (0);
+    }
+
+    fwrite(header, sizeof(uint32_t), 2, f);
+    fwrite(&gl_program_cache.driver_hash, sizeof(uint64_t), 1, f);
+    fwrite(header + 2, sizeof(uint32_t), 1, f);
+    for(uint32_t i = 0; i < gl_program_cache.entries_count; i++)
+    {
+        gl_program_cache_entry_p entry = gl_program_cache.entries + i;
+        if(entry->used)
+        {
+            uint32_t format_size[2] = {entry->format, entry->size};
+            fwrite(&entry->key, sizeof(uint64_t), 1, f);
+            fwrite(format_size, sizeof(uint32_t), 2, f);
+            fwrite(entry->data, 1, entry->size, f);
+        }
+    }
+    fclose(f);
+}
+
+
+void GLProgramCache_Begin(const char *file_name)
+{
+    GLint formats_count = 0;
+
+    GLProgramCache_End();
+    if((qglGetProgramBinary == NULL) || (qglProgramBinary == NULL) || (qglProgramParameteri == NULL) || (qglGetProgramiv == NULL))
+    {
+        return;
+    }
+
+    qglGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats_count);
+    if(formats_count <= 0)
+    {
+        return;                                                                 // driver can not give us binaries
+    }
+
+    strncpy(gl_program_cache.file_name, file_name, sizeof(gl_program_cache.file_name) - 1);
+    gl_program_cache.file_name[sizeof(gl_program_cache.file_name) - 1] = 0;
+    gl_program_cache.driver_hash = GLProgramCache_HashString(GL_PROGRAM_CACHE_HASH_INIT, GL_VENDOR);
+    gl_program_cache.driver_hash = GLProgramCache_HashString(gl_program_cache.driver_hash, GL_RENDERER);
+    gl_program_cache.driver_hash = GLProgramCache_HashString(gl_program_cache.driver_hash, GL_VERSION);
+    gl_program_cache.driver_hash = GLProgramCache_HashString(gl_program_cache.driver_hash, GL_SHADING_LANGUAGE_VERSION);
+    gl_program_cache.hits = 0;
+    gl_program_cache.misses = 0;
+    gl_program_cache.dirty = 0;
+    gl_program_cache.active = 1;
+    GLProgramCache_ReadFile();
+}
+
+
+void GLProgramCache_End()
+{
+    if(gl_program_cache.active)
+    {
+        for(uint32_t i = 0; i < gl_program_cache.entries_count; i++)
+        {
+            gl_program_cache.dirty |= !gl_program_cache.entries[i].used;        // outdated shaders are dropped
+        }
+        if(gl_program_cache.dirty)
+        {
+            GLProgramCache_WriteFile();
+        }
+        Sys_DebugLog(GL_PROGRAM_CACHE_LOG, "program cache: %d loaded, %d linked", gl_program_cache.hits, gl_program_cache.misses);
+    }
+
+    for(uint32_t i = 0; i < gl_program_cache.entries_count; i++)
+    {
+        free(gl_program_cache.entries[i].data);
+    }
+    free(gl_program_cache.entries);
+    gl_program_cache.entries = NULL;
+    gl_program_cache.entries_count = 0;
+    gl_program_cache.entries_size = 0;
+    gl_program_cache.active = 0;
+}
+
+
+int GLProgramCache_IsActive()
+{
+    return gl_program_cache.active;
+}
+
+
+int GLProgramCache_Load(GLuint program, uint64_t key)
+{
+    gl_program_cache_entry_p entry = (gl_program_cache.active) ? (GLProgramCache_FindEntry(key)) : (NULL);
+    GLint linked = 0;
+
+    if(entry == NULL)
+    {
+        return 0;
+    }
+
+    qglProgramBinary(program, entry->format, entry->data, entry->size);
+    qglGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(!linked)
+    {
+        entry->key = ~entry->key;                                               // driver update or corrupted file; relink and replace
+        gl_program_cache.dirty = 1;
+        return 0;
+    }
+
+    entry->used = 1;
+    gl_program_cache.hits++;
+    return 1;
+}
+
+
+void GLProgramCache_Link(GLuint program, uint64_t key)
+{
+    GLint linked = 0, size = 0;
+    GLenum format = 0;
+
+    if(gl_program_cache.active)
+    {
+        qglProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    qglLinkProgramARB(program);
+    if(!gl_program_cache.active)
+    {
+        return;
+    }
+
+    gl_program_cache.misses++;
+    qglGetProgramiv(program, GL_LINK_STATUS, &linked);
+    qglGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(linked && (size > 0))
+    {
+        gl_program_cache_entry_p entry = GLProgramCache_FindEntry(key);
+        entry = (entry) ? (entry) : (GLProgramCache_AddEntry(key));
+        if(entry)
+        {
+            free(entry->data);
+            entry->data = (uint8_t*)malloc(size);
+            entry->size = 0;
+            entry->used = 0;
+            if(entry->data)
+            {
+                qglGetProgramBinary(program, size, &size, &format, entry->data);
+                entry->format = format;
+                entry->size = size;
+                entry->used = (size > 0);
+                gl_program_cache.dirty = 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * File:   gl_program_cache.h
+ *
+ * Linked shader programs cache (ARB_get_program_binary). Programs are keyed by
+ * the hash of their stages sources; the cache file is valid only for the
+ * driver that wrote it (vendor, renderer and version strings hash in header).
+ * Anything that does not load falls back to compiling and linking.
+ */
+
+#ifndef GL_PROGRAM_CACHE_H
+#define GL_PROGRAM_CACHE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+
+#define GL_PROGRAM_CACHE_FILENAME   "shader_cache.bin"
+#define GL_PROGRAM_CACHE_HASH_INIT  (14695981039346656037ULL)
+
+/*
+ * Cache is open between Begin and End; End writes the file if something was
+ * added or rejected, keeping only the programs used in this session.
+ */
+void GLProgramCache_Begin(const char *file_name);
+void GLProgramCache_End();
+int  GLProgramCache_IsActive();
+
+uint64_t GLProgramCache_Hash(uint64_t hash, const void *data, size_t size);    // FNV-1a, start with GL_PROGRAM_CACHE_HASH_INIT
+int  GLProgramCache_Load(GLuint program, uint64_t key);                         // 1 if program is linked from cache
+void GLProgramCache_Link(GLuint program, uint64_t key);                         // links attached stages and stores binary
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
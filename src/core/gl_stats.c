@@ -0,0 +1,470 @@
+/*
+ * File:   gl_stats.c
+ *
+ * GL call accounting. Enabling swaps the qgl* pointers used by draw code to
+ * wrappers which count the call and forward it to the driver function, so
+ * disabled stats cost nothing. Pass timers use GL_TIME_ELAPSED queries,
+ * kept GL_STATS_QUERY_FRAMES frames in flight to not wait for the GPU.
+ */
+
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gl_stats.h"
+#include "gl_stream.h"
+#include "gl_util.h"
+
+
+static struct
+{
+    PFNGLDRAWARRAYSPROC                 DrawArrays;
+    PFNGLDRAWELEMENTSPROC               DrawElements;
+    PFNGLENABLEPROC                     Enable;
+    PFNGLDISABLEPROC                    Disable;
+    PFNGLBLENDFUNCPROC                  BlendFunc;
+    PFNGLDEPTHMASKPROC                  DepthMask;
+    PFNGLPOLYGONMODEPROC                PolygonMode;
+    PFNGLSTENCILFUNCPROC                StencilFunc;
+    PFNGLSTENCILOPPROC                  StencilOp;
+    PFNGLBINDTEXTUREPROC                BindTexture;
+    PFNGLUSEPROGRAMOBJECTARBPROC        UseProgramObjectARB;
+    PFNGLBINDBUFFERARBPROC              BindBufferARB;
+    PFNGLUNIFORM1IARBPROC               Uniform1iARB;
+    PFNGLUNIFORM1FARBPROC               Uniform1fARB;
+    PFNGLUNIFORM4FARBPROC               Uniform4fARB;
+    PFNGLUNIFORM1FVARBPROC              Uniform1fvARB;
+    PFNGLUNIFORM2FVARBPROC              Uniform2fvARB;
+    PFNGLUNIFORM3FVARBPROC              Uniform3fvARB;
+    PFNGLUNIFORM4FVARBPROC              Uniform4fvARB;
+    PFNGLUNIFORMMATRIX4FVARBPROC        UniformMatrix4fvARB;
+    PFNGLBUFFERDATAARBPROC              BufferDataARB;
+    PFNGLBUFFERSUBDATAARBPROC           BufferSubDataARB;
+    PFNGLTEXIMAGE2DPROC                 TexImage2D;
+    PFNGLTEXSUBIMAGE2DPROC              TexSubImage2D;
+    PFNGLCOMPRESSEDTEXIMAGE2DARBPROC    CompressedTexImage2DARB;
+} gl_real;
+
+static struct
+{
+    int                 inited;
+    int                 enabled;
+    gl_stats_t          current;
+    gl_stats_t          last;
+    uint64_t            stream_bytes_start;
+
+    GLuint              queries[GL_STATS_QUERY_FRAMES][GL_STATS_PASS_COUNT];
+    uint8_t             issued[GL_STATS_QUERY_FRAMES][GL_STATS_PASS_COUNT];
+    uint16_t            query_frame;
+    uint32_t            query_frame_index[GL_STATS_QUERY_FRAMES];       // frames counter of the queries slot
+    uint32_t            frame;
+    int                 active_pass;
+    float               pass_time[GL_STATS_PASS_COUNT];
+} gl_stats;
+
+
+/*
+ * Counting wrappers
+ */
+static void APIENTRY GLStats_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    gl_stats.current.draw_calls++;
+    gl_stats.current.vertices += count;
+    gl_real.DrawArrays(mode, first, count);
+}
+
+static void APIENTRY GLStats_DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    gl_stats.current.draw_calls++;
+    gl_stats.current.vertices += count;
+    gl_real.DrawElements(mode, count, type, indices);
+}
+
+static void APIENTRY GLStats_Enable(GLenum cap)
+{
+    gl_stats.current.state_changes++;
+    gl_real.Enable(cap);
+}
+
+static void APIENTRY GLStats_Disable(GLenum cap)
+{
+    gl_stats.current.state_changes++;
+    gl_real.Disable(cap);
+}
+
+static void APIENTRY GLStats_BlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    gl_stats.current.state_changes++;
+    gl_real.BlendFunc(sfactor, dfactor);
+}
+
+static void APIENTRY GLStats_DepthMask(GLboolean flag)
+{
+    gl_stats.current.state_changes++;
+    gl_real.DepthMask(flag);
+}
+
+static void APIENTRY GLStats_PolygonMode(GLenum face, GLenum mode)
+{
+    gl_stats.current.state_changes++;
+    gl_real.PolygonMode(face, mode);
+}
+
+static void APIENTRY GLStats_StencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    gl_stats.current.state_changes++;
+    gl_real.StencilFunc(func, ref, mask);
+}
+
+static void APIENTRY GLStats_StencilOp(GLenum fail, GLenum zfail, GLenum zpass)
+{
+    gl_stats.current.state_changes++;
+    gl_real.StencilOp(fail, zfail, zpass);
+}
+
+static void APIENTRY GLStats_BindTexture(GLenum target, GLuint texture)
+{
+    gl_stats.current.texture_binds++;
+    gl_real.BindTexture(target, texture);
+}
+
+static void APIENTRY GLStats_UseProgramObjectARB(GLhandleARB program)
+{
+    gl_stats.current.program_binds++;
+    gl_real.UseProgramObjectARB(program);
+}
+
+static void APIENTRY GLStats_BindBufferARB(GLenum target, GLuint buffer)
+{
+    gl_stats.current.buffer_binds++;
+    gl_real.BindBufferARB(target, buffer);
+}
+
+static void APIENTRY GLStats_Uniform1iARB(GLint location, GLint v0)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform1iARB(location, v0);
+}
+
+static void APIENTRY GLStats_Uniform1fARB(GLint location, GLfloat v0)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform1fARB(location, v0);
+}
+
+static void APIENTRY GLStats_Uniform4fARB(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform4fARB(location, v0, v1, v2, v3);
+}
+
+static void APIENTRY GLStats_Uniform1fvARB(GLint location, GLsizei count, const GLfloat *value)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform1fvARB(location, count, value);
+}
+
+static void APIENTRY GLStats_Uniform2fvARB(GLint location, GLsizei count, const GLfloat *value)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform2fvARB(location, count, value);
+}
+
+static void APIENTRY GLStats_Uniform3fvARB(GLint location, GLsizei count, const GLfloat *value)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform3fvARB(location, count, value);
+}
+
+static void APIENTRY GLStats_Uniform4fvARB(GLint location, GLsizei count, const GLfloat *value)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.Uniform4fvARB(location, count, value);
+}
+
+static void APIENTRY GLStats_UniformMatrix4fvARB(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    gl_stats.current.uniform_uploads++;
+    gl_real.UniformMatrix4fvARB(location, count, transpose, value);
+}
+
+static void APIENTRY GLStats_BufferDataARB(GLenum target, GLsizeiptrARB size, const GLvoid *data, GLenum usage)
+{
+    gl_stats.current.buffer_uploads++;
+    gl_stats.current.upload_bytes += (data) ? (size) : (0);
+    gl_real.BufferDataARB(target, size, data, usage);
+}
+
+static void APIENTRY GLStats_BufferSubDataARB(GLenum target, GLintptrARB offset, GLsizeiptrARB size, const GLvoid *data)
+{
+    gl_stats.current.buffer_uploads++;
+    gl_stats.current.upload_bytes += size;
+    gl_real.BufferSubDataARB(target, offset, size, data);
+}
+
+static uint32_t GLStats_PixelSize(GLenum format, GLenum type)
+{
+    uint32_t channels = 4;
+
+    switch(format)
+    {
+        case GL_RED:
+        case GL_ALPHA:
+        case GL_LUMINANCE:
+        case GL_DEPTH_COMPONENT:
+            channels = 1;
+            break;
+
+        case GL_LUMINANCE_ALPHA:
+            channels = 2;
+            break;
+
+        case GL_RGB:
+        case GL_BGR:
+            channels = 3;
+            break;
+    };
+
+    switch(type)
+    {
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+        case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+            return 2;
+
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+            return 2 * channels;
+
+        case GL_UNSIGNED_INT:
+        case GL_INT:
+        case GL_FLOAT:
+            return 4 * channels;
+    };
+
+    return channels;
+}
+
+static void APIENTRY GLStats_TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    gl_stats.current.texture_uploads++;
+    gl_stats.current.upload_bytes += (pixels) ? (width * height * GLStats_PixelSize(format, type)) : (0);
+    gl_real.TexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+}
+
+static void APIENTRY GLStats_TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    gl_stats.current.texture_uploads++;
+    gl_stats.current.upload_bytes += width * height * GLStats_PixelSize(format, type);
+    gl_real.TexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+static void APIENTRY GLStats_CompressedTexImage2DARB(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data)
+{
+    gl_stats.current.texture_uploads++;
+    gl_stats.current.upload_bytes += imageSize;
+    gl_real.CompressedTexImage2DARB(target, level, internalformat, width, height, border, imageSize, data);
+}
+
+
+/*
+ * Dispatch table switching
+ */
+#define GL_STATS_HOOK(name) if(gl_real.name) { qgl##name = (enabled) ? (GLStats_##name) : (gl_real.name); }
+
+void GLStats_Init()
+{
+    gl_real.DrawArrays = qglDrawArrays;
+    gl_real.DrawElements = qglDrawElements;
+    gl_real.Enable = qglEnable;
+    gl_real.Disable = qglDisable;
+    gl_real.BlendFunc = qglBlendFunc;
+    gl_real.DepthMask = qglDepthMask;
+    gl_real.PolygonMode = qglPolygonMode;
+    gl_real.StencilFunc = qglStencilFunc;
+    gl_real.StencilOp = qglStencilOp;
+    gl_real.BindTexture = qglBindTexture;
+    gl_real.UseProgramObjectARB = qglUseProgramObjectARB;
+    gl_real.BindBufferARB = qglBindBufferARB;
+    gl_real.Uniform1iARB = qglUniform1iARB;
+    gl_real.Uniform1fARB = qglUniform1fARB;
+    gl_real.Uniform4fARB = qglUniform4fARB;
+    gl_real.Uniform1fvARB = qglUniform1fvARB;
+    gl_real.Uniform2fvARB = qglUniform2fvARB;
+    gl_real.Uniform3fvARB = qglUniform3fvARB;
+    gl_real.Uniform4fvARB = qglUniform4fvARB;
+    gl_real.UniformMatrix4fvARB = qglUniformMatrix4fvARB;
+    gl_real.BufferDataARB = qglBufferDataARB;
+    gl_real.BufferSubDataARB = qglBufferSubDataARB;
+    gl_real.TexImage2D = qglTexImage2D;
+    gl_real.TexSubImage2D = qglTexSubImage2D;
+    gl_real.CompressedTexImage2DARB = qglCompressedTexImage2DARB;
+
+    memset(&gl_stats, 0, sizeof(gl_stats));
+    gl_stats.active_pass = -1;
+    for(int i = 0; i < GL_STATS_PASS_COUNT; i++)
+    {
+        gl_stats.pass_time[i] = -1.0f;
+    }
+    if(GLStats_HasTimers())
+    {
+        qglGenQueries(GL_STATS_QUERY_FRAMES * GL_STATS_PASS_COUNT, gl_stats.queries[0]);
+    }
+    gl_stats.inited = 1;
+}
+
+
+void GLStats_Destroy()
+{
+    if(gl_stats.inited)
+    {
+        GLStats_SetEnabled(0);
+        if(GLStats_HasTimers())
+        {
+            qglDeleteQueries(GL_STATS_QUERY_FRAMES * GL_STATS_PASS_COUNT, gl_stats.queries[0]);
+        }
+        gl_stats.inited = 0;
+    }
+}
+
+
+void GLStats_SetEnabled(int enabled)
+{
+    if(!gl_stats.inited || (gl_stats.enabled == enabled))
+    {
+        return;
+    }
+
+    GLStats_EndPass();
+    GL_STATS_HOOK(DrawArrays);
+    GL_STATS_HOOK(DrawElements);
+    GL_STATS_HOOK(Enable);
+    GL_STATS_HOOK(Disable);
+    GL_STATS_HOOK(BlendFunc);
+    GL_STATS_HOOK(DepthMask);
+    GL_STATS_HOOK(PolygonMode);
+    GL_STATS_HOOK(StencilFunc);
+    GL_STATS_HOOK(StencilOp);
+    GL_STATS_HOOK(BindTexture);
+    GL_STATS_HOOK(UseProgramObjectARB);
+    GL_STATS_HOOK(BindBufferARB);
+    GL_STATS_HOOK(Uniform1iARB);
+    GL_STATS_HOOK(Uniform1fARB);
+    GL_STATS_HOOK(Uniform4fARB);
+    GL_STATS_HOOK(Uniform1fvARB);
+    GL_STATS_HOOK(Uniform2fvARB);
+    GL_STATS_HOOK(Uniform3fvARB);
+    GL_STATS_HOOK(Uniform4fvARB);
+    GL_STATS_HOOK(UniformMatrix4fvARB);
+    GL_STATS_HOOK(BufferDataARB);
+    GL_STATS_HOOK(BufferSubDataARB);
+    GL_STATS_HOOK(TexImage2D);
+    GL_STATS_HOOK(TexSubImage2D);
+    GL_STATS_HOOK(CompressedTexImage2DARB);
+
+    gl_stats.enabled = enabled;
+    memset(&gl_stats.current, 0, sizeof(gl_stats.current));
+    memset(gl_stats.issued, 0, sizeof(gl_stats.issued));
+    gl_stats.frame = 0;
+    gl_stats.stream_bytes_start = GLStream_GetMappedBytes();
+    for(int i = 0; i < GL_STATS_PASS_COUNT; i++)
+    {
+        gl_stats.pass_time[i] = -1.0f;
+    }
+}
+
+
+int GLStats_IsEnabled()
+{
+    return gl_stats.enabled;
+}
+
+
+int GLStats_HasTimers()
+{
+    return (qglGenQueries != NULL) && (qglGetQueryObjectui64v != NULL);
+}
+
+
+void GLStats_BeginPass(int pass)
+{
+    if(gl_stats.enabled && (pass >= 0) && (pass < GL_STATS_PASS_COUNT))
+    {
+        GLStats_EndPass();                                                      // only one GL_TIME_ELAPSED query may be active
+        if(GLStats_HasTimers())
+        {
+            qglBeginQuery(GL_TIME_ELAPSED, gl_stats.queries[gl_stats.query_frame][pass]);
+            gl_stats.issued[gl_stats.query_frame][pass] = 1;
+            gl_stats.active_pass = pass;
+        }
+    }
+}
+
+
+void GLStats_EndPass()
+{
+    if(gl_stats.active_pass >= 0)
+    {
+        qglEndQuery(GL_TIME_ELAPSED);
+        gl_stats.active_pass = -1;
+    }
+}
+
+
+void GLStats_EndFrame()
+{
+    if(!gl_stats.enabled)
+    {
+        return;
+    }
+
+    GLStats_EndPass();
+    gl_stats.current.frame = gl_stats.frame;
+    gl_stats.current.timed_ms = -1.0f;
+    if(GLStats_HasTimers())
+    {
+        // read the oldest frame in flight; its slot is reused by the next frame
+        gl_stats.query_frame_index[gl_stats.query_frame] = gl_stats.frame;
+        gl_stats.query_frame = (gl_stats.query_frame + 1) % GL_STATS_QUERY_FRAMES;
+        gl_stats.current.timed_frame = gl_stats.query_frame_index[gl_stats.query_frame];
+        for(int i = 0; i < GL_STATS_PASS_COUNT; i++)
+        {
+            if(gl_stats.issued[gl_stats.query_frame][i])
+            {
+                GLuint available = 0;
+                qglGetQueryObjectuiv(gl_stats.queries[gl_stats.query_frame][i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if(available)
+                {
+                    GLuint64 ns = 0;
+                    qglGetQueryObjectui64v(gl_stats.queries[gl_stats.query_frame][i], GL_QUERY_RESULT, &ns);
+                    gl_stats.pass_time[i] = (float)ns * 1.0e-6f;
+                    gl_stats.current.timed_ms = ((gl_stats.current.timed_ms < 0.0f) ? (0.0f) : (gl_stats.current.timed_ms)) + gl_stats.pass_time[i];
+                }
+                gl_stats.issued[gl_stats.query_frame][i] = 0;
+            }
+        }
+    }
+
+    gl_stats.current.stream_bytes = GLStream_GetMappedBytes() - gl_stats.stream_bytes_start;
+    gl_stats.stream_bytes_start += gl_stats.current.stream_bytes;
+    memcpy(gl_stats.current.pass_time, gl_stats.pass_time, sizeof(gl_stats.pass_time));
+    gl_stats.last = gl_stats.current;
+    memset(&gl_stats.current, 0, sizeof(gl_stats.current));
+    gl_stats.frame++;
+}
+
+
+const gl_stats_t *GLStats_GetLastFrame()
+{
+    return &gl_stats.last;
+}
+
+
+const char *GLStats_GetPassName(int pass)
+{
+    static const char *names[GL_STATS_PASS_COUNT] = {"sky", "rooms", "sprites", "transparency", "gui"};
+    return ((pass >= 0) && (pass < GL_STATS_PASS_COUNT)) ? (names[pass]) : ("unknown");
+}
@@ -0,0 +1,63 @@
+/*
+ * File:   gl_stats.h
+ *
+ * Optional GL call accounting: when enabled, the commonly used qgl* pointers
+ * are replaced by counting wrappers, and the main render passes are measured
+ * with GPU timer queries (if supported; results are some frames late).
+ */
+
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define GL_STATS_PASS_SKY           (0)
+#define GL_STATS_PASS_ROOMS         (1)
+#define GL_STATS_PASS_SPRITES       (2)
+#define GL_STATS_PASS_TRANSPARENCY  (3)
+#define GL_STATS_PASS_GUI           (4)
+#define GL_STATS_PASS_COUNT         (5)
+
+#define GL_STATS_QUERY_FRAMES       (4)     // timer queries in flight, per pass
+
+typedef struct gl_stats_s
+{
+    uint32_t    draw_calls;
+    uint32_t    vertices;                   // vertices and indices passed to draw calls
+    uint32_t    texture_binds;
+    uint32_t    program_binds;
+    uint32_t    buffer_binds;
+    uint32_t    state_changes;              // enable / disable, blend, depth, stencil, polygon mode
+    uint32_t    uniform_uploads;
+    uint32_t    buffer_uploads;
+    uint32_t    texture_uploads;
+    uint64_t    upload_bytes;               // buffer and texture data
+    uint64_t    stream_bytes;               // written to the stream buffer
+    uint32_t    frame;                      // frames counter since stats were enabled
+    uint32_t    timed_frame;                // frame the timed_ms result belongs to
+    float       timed_ms;                   // GPU ms of all passes of timed_frame, < 0 if not measured
+    float       pass_time[GL_STATS_PASS_COUNT];     // GPU ms, < 0 if not measured
+} gl_stats_t, *gl_stats_p;
+
+void GLStats_Init();
+void GLStats_Destroy();
+void GLStats_SetEnabled(int enabled);
+int  GLStats_IsEnabled();
+int  GLStats_HasTimers();
+
+void GLStats_BeginPass(int pass);
+void GLStats_EndPass();
+void GLStats_EndFrame();
+
+const gl_stats_t *GLStats_GetLastFrame();
+const char *GLStats_GetPassName(int pass);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
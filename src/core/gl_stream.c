@@ -0,0 +1,294 @@
+/*
+ * File:   gl_stream.c
+ *
+ * Ring buffer allocator for per-frame geometry. Positions in the ring grow
+ * monotonically (head / tail), physical offset is position % size. Data
+ * between tail and head may still be read by GPU; every frame end puts a
+ * fence with the current head, and signaled fences move the tail forward.
+ * Without sync objects the buffer is orphaned on every wrap instead.
+ */
+
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "gl_stream.h"
+#include "gl_util.h"
+
+
+typedef struct gl_stream_fence_s
+{
+    GLsync                   sync;
+    uint64_t                 end;                   // ring head when fence was placed
+} gl_stream_fence_t, *gl_stream_fence_p;
+
+static struct
+{
+    int                      mode;
+    GLuint                   vbo;
+    uint32_t                 size;
+    uint8_t                 *persistent_ptr;
+    uint8_t                 *staging;
+    uint64_t                 head;
+    uint64_t                 tail;
+
+    gl_stream_fence_t        fences[GL_STREAM_MAX_FENCES];
+    uint16_t                 fences_first;
+    uint16_t                 fences_count;
+
+    uint8_t                 *map_ptr;
+    uint32_t                 map_offset;
+    uint32_t                 map_size;
+    uint32_t                 stalls_count;
+    uint64_t                 mapped_bytes;
+} gl_stream;
+
+
+static int GLStream_IsFenced()
+{
+    return (gl_stream.mode != GL_STREAM_MODE_NONE) && (qglFenceSync != NULL);
+}
+
+
+static int GLStream_RetireFence(int wait)
+{
+    if(gl_stream.fences_count > 0)
+    {
+        gl_stream_fence_p fence = gl_stream.fences + gl_stream.fences_first;
+        GLenum res = qglClientWaitSync(fence->sync, 0, 0);
+        if(wait)
+        {
+            while((res != GL_ALREADY_SIGNALED) && (res != GL_CONDITION_SATISFIED) && (res != GL_WAIT_FAILED))
+            {
+                res = qglClientWaitSync(fence->sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+        }
+
+        if((res == GL_ALREADY_SIGNALED) || (res == GL_CONDITION_SATISFIED) || (res == GL_WAIT_FAILED))
+        {
+            qglDeleteSync(fence->sync);
+            fence->sync = NULL;
+            gl_stream.tail = fence->end;
+            gl_stream.fences_first = (gl_stream.fences_first + 1) % GL_STREAM_MAX_FENCES;
+            gl_stream.fences_count--;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void GLStream_PutFence()
+{
+    uint16_t last = (gl_stream.fences_first + gl_stream.fences_count + GL_STREAM_MAX_FENCES - 1) % GL_STREAM_MAX_FENCES;
+    if((gl_stream.fences_count > 0) && (gl_stream.fences[last].end == gl_stream.head))
+    {
+        return;
+    }
+
+    if(gl_stream.fences_count >= GL_STREAM_MAX_FENCES)
+    {
+        gl_stream.stalls_count++;
+        GLStream_RetireFence(1);
+    }
+
+    last = (gl_stream.fences_first + gl_stream.fences_count) % GL_STREAM_MAX_FENCES;
+    gl_stream.fences[last].sync = qglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl_stream.fences[last].end = gl_stream.head;
+    gl_stream.fences_count++;
+}
+
+
+void GLStream_Init(uint32_t size)
+{
+    GLStream_Destroy();
+
+    gl_stream.size = size - size % GL_STREAM_ALIGN;
+    qglGenBuffersARB(1, &gl_stream.vbo);
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_stream.vbo);
+
+    if(qglBufferStorage && qglMapBufferRange && qglFenceSync)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        qglBufferStorage(GL_ARRAY_BUFFER_ARB, gl_stream.size, NULL, flags);
+        gl_stream.persistent_ptr = (uint8_t*)qglMapBufferRange(GL_ARRAY_BUFFER_ARB, 0, gl_stream.size, flags);
+        if(gl_stream.persistent_ptr != NULL)
+        {
+            gl_stream.mode = GL_STREAM_MODE_PERSISTENT;
+        }
+        else
+        {
+            // immutable storage can not be reallocated; start from new buffer
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            qglDeleteBuffersARB(1, &gl_stream.vbo);
+            qglGenBuffersARB(1, &gl_stream.vbo);
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_stream.vbo);
+        }
+    }
+
+    if(gl_stream.mode == GL_STREAM_MODE_NONE)
+    {
+        qglBufferDataARB(GL_ARRAY_BUFFER_ARB, gl_stream.size, NULL, GL_STREAM_DRAW_ARB);
+        gl_stream.mode = (qglMapBufferRange) ? (GL_STREAM_MODE_MAP_RANGE) : (GL_STREAM_MODE_SUB_DATA);
+        gl_stream.staging = (uint8_t*)malloc(gl_stream.size);
+    }
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+    gl_stream.head = 0;
+    gl_stream.tail = 0;
+    gl_stream.fences_first = 0;
+    gl_stream.fences_count = 0;
+    gl_stream.map_ptr = NULL;
+    gl_stream.stalls_count = 0;
+}
+
+
+void GLStream_Destroy()
+{
+    if(gl_stream.mode != GL_STREAM_MODE_NONE)
+    {
+        while(gl_stream.fences_count > 0)
+        {
+            GLStream_RetireFence(1);
+        }
+
+        if(gl_stream.persistent_ptr)
+        {
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_stream.vbo);
+            qglUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            gl_stream.persistent_ptr = NULL;
+        }
+        qglDeleteBuffersARB(1, &gl_stream.vbo);
+        gl_stream.vbo = 0;
+    }
+
+    free(gl_stream.staging);
+    gl_stream.staging = NULL;
+    gl_stream.mode = GL_STREAM_MODE_NONE;
+}
+
+
+void GLStream_EndFrame()
+{
+    if(GLStream_IsFenced())
+    {
+        GLStream_PutFence();
+        while(GLStream_RetireFence(0));
+    }
+}
+
+
+void *GLStream_Map(uint32_t size, uint32_t *offset)
+{
+    uint32_t pos;
+
+    size = (size + GL_STREAM_ALIGN - 1) & ~(GL_STREAM_ALIGN - 1);
+    if((gl_stream.mode == GL_STREAM_MODE_NONE) || (size == 0) || (size > gl_stream.size))
+    {
+        return NULL;
+    }
+
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_stream.vbo);
+    pos = gl_stream.head % gl_stream.size;
+    if(pos + size > gl_stream.size)
+    {
+        gl_stream.head += gl_stream.size - pos;                                 // skip the ring tail
+        if(!GLStream_IsFenced())
+        {
+            // old storage stays with pending draws, driver gives us a fresh one
+            qglBufferDataARB(GL_ARRAY_BUFFER_ARB, gl_stream.size, NULL, GL_STREAM_DRAW_ARB);
+            gl_stream.tail = gl_stream.head;
+        }
+    }
+
+    while(GLStream_IsFenced() && (gl_stream.head + size - gl_stream.tail > gl_stream.size))
+    {
+        if(gl_stream.fences_count == 0)
+        {
+            GLStream_PutFence();                                                // whole ring used in this frame
+        }
+        gl_stream.stalls_count++;
+        GLStream_RetireFence(1);
+    }
+
+    pos = gl_stream.head % gl_stream.size;
+    gl_stream.head += size;
+    gl_stream.map_offset = pos;
+    gl_stream.map_size = size;
+    gl_stream.mapped_bytes += size;
+    *offset = pos;
+
+    switch(gl_stream.mode)
+    {
+        case GL_STREAM_MODE_PERSISTENT:
+            gl_stream.map_ptr = gl_stream.persistent_ptr + pos;
+            break;
+
+        case GL_STREAM_MODE_MAP_RANGE:
+            gl_stream.map_ptr = (uint8_t*)qglMapBufferRange(GL_ARRAY_BUFFER_ARB, pos, size,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if(gl_stream.map_ptr != NULL)
+            {
+                break;
+            }
+            // falls back to staging copy
+
+        default:
+            gl_stream.map_ptr = gl_stream.staging;
+            break;
+    };
+
+    return gl_stream.map_ptr;
+}
+
+
+void GLStream_Unmap()
+{
+    if(gl_stream.map_ptr == NULL)
+    {
+        return;
+    }
+
+    if(gl_stream.map_ptr == gl_stream.staging)
+    {
+        qglBufferSubDataARB(GL_ARRAY_BUFFER_ARB, gl_stream.map_offset, gl_stream.map_size, gl_stream.staging);
+    }
+    else if(gl_stream.mode == GL_STREAM_MODE_MAP_RANGE)
+    {
+        qglUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+    }
+    gl_stream.map_ptr = NULL;
+}
+
+
+GLuint GLStream_GetBuffer()
+{
+    return gl_stream.vbo;
+}
+
+
+uint32_t GLStream_GetSize()
+{
+    return gl_stream.size;
+}
+
+
+int GLStream_GetMode()
+{
+    return gl_stream.mode;
+}
+
+
+uint32_t GLStream_GetStallsCount()
+{
+    return gl_stream.stalls_count;
+}
+
+
+uint64_t GLStream_GetMappedBytes()
+{
+    return gl_stream.mapped_bytes;
+}
@@ -0,0 +1,51 @@
+/*
+ * File:   gl_stream.h
+ *
+ * Shared ring buffer for geometry generated every frame (transparency BSP,
+ * sprites, debug lines, GUI rects and text). Producers take a range with
+ * GLStream_Map(), write vertices into it, call GLStream_Unmap() and draw from
+ * the returned offset while the ring buffer is bound to GL_ARRAY_BUFFER.
+ */
+
+#ifndef GL_STREAM_H
+#define GL_STREAM_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+
+#define GL_STREAM_BUFFER_SIZE       (4 * 1024 * 1024)
+#define GL_STREAM_MAX_FENCES        (8)
+#define GL_STREAM_ALIGN             (64)
+
+#define GL_STREAM_MODE_NONE         (0)     // not initialised
+#define GL_STREAM_MODE_PERSISTENT   (1)     // ARB_buffer_storage: mapped once, fenced
+#define GL_STREAM_MODE_MAP_RANGE    (2)     // ARB_map_buffer_range: unsynchronized map per range
+#define GL_STREAM_MODE_SUB_DATA     (3)     // plain VBO: glBufferSubData from a staging copy
+
+void GLStream_Init(uint32_t size);
+void GLStream_Destroy();
+void GLStream_EndFrame();
+
+/*
+ * Returns write pointer for size bytes (NULL if size exceeds the ring) and the
+ * range offset in the ring buffer. Leaves the ring buffer bound to GL_ARRAY_BUFFER.
+ */
+void *GLStream_Map(uint32_t size, uint32_t *offset);
+void GLStream_Unmap();
+
+GLuint GLStream_GetBuffer();
+uint32_t GLStream_GetSize();
+int GLStream_GetMode();
+uint32_t GLStream_GetStallsCount();
+uint64_t GLStream_GetMappedBytes();                                             // total since init
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -11,14 +11,51 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "gl_text.h"
 #include "gl_font.h"
 #include "gl_util.h"
+#include "gl_stream.h"
+#include "utf8_32.h"
 
 
 #define vec4_copy(x, y) {(x)[0] = (y)[0]; (x)[1] = (y)[1]; (x)[2] = (y)[2]; (x)[3] = (y)[3];}
 
+#define GLTEXT_LAYOUT_CACHE_SIZE        (256)
+#define GLTEXT_LAYOUT_CACHE_PROBES      (8)
+
+typedef struct gl_text_layout_s
+{
+    char                    *text;                  // copy of laid out string
+    uint32_t                 hash;
+    uint32_t                 last_frame;
+    gl_tex_font_p            gl_font;
+    uint16_t                 font_size;
+    GLfloat                  line_width;
+    GLfloat                  line_height;
+    GLfloat                  rect[4];
+    uint32_t                 quads_count;
+    gl_glyph_quad_p          quads;                 // relative to the line origin
+    uint16_t                 lines_count;
+    uint32_t                *line_quads;            // quads count of every wrapped line, in drawing order
+} gl_text_layout_t, *gl_text_layout_p;
+
+typedef struct gl_text_draw_item_s
+{
+    gl_text_layout_p         layout;
+    gl_fontstyle_p           style;
+    GLfloat                  x;
+    GLfloat                  y;
+} gl_text_draw_item_t, *gl_text_draw_item_p;
+
+typedef struct gl_text_run_s
+{
+    GLuint                   tex_index;             // 0 - white texture for backgrounds
+    uint32_t                 first_vertex;
+    uint32_t                 vertex_count;
+} gl_text_run_t, *gl_text_run_p;
+
 static struct
 {
     gl_text_line_p           gl_base_lines;
@@ -29,11 +66,28 @@ static struct
 
     uint16_t                 max_fonts;
     struct gl_font_cont_s   *fonts;
+
+    uint32_t                 frame;
+    gl_text_layout_t         layouts[GLTEXT_LAYOUT_CACHE_SIZE];
+    uint32_t                 immediate_count;
+    uint32_t                 immediate_size;
+    gl_text_layout_p        *immediate;                                        // this frame only layouts, when all probed cache slots are in use
+    uint32_t                 items_count;
+    uint32_t                 items_size;
+    gl_text_draw_item_p      items;
+    uint32_t                 vertex_count;
+    uint32_t                 runs_count;
+    uint32_t                 runs_size;
+    gl_text_run_p            runs;                                             // same texture vertices in drawing order
+    uint32_t                 vertex_buffer_size;
+    GLfloat                 *vertex_buffer;                                    // fallback for text not fitting to stream buffer
 } font_data;
 
 static int screen_width = 0;
 static int screen_height = 0;
 
+static void GLText_ClearLayoutCache();
+
 
 void GLText_Init()
 {
@@ -80,6 +134,21 @@ void GLText_Init()
     }
 
     font_data.temp_lines_used = 0;
+
+    memset(font_data.layouts, 0x00, sizeof(font_data.layouts));
+    font_data.frame = 0;
+    font_data.items_count = 0;
+    font_data.items_size = 0;
+    font_data.items = NULL;
+    font_data.immediate_count = 0;
+    font_data.immediate_size = 0;
+    font_data.immediate = NULL;
+    font_data.vertex_count = 0;
+    font_data.runs_count = 0;
+    font_data.runs_size = 0;
+    font_data.runs = NULL;
+    font_data.vertex_buffer_size = 0;
+    font_data.vertex_buffer = NULL;
 }
 
 
@@ -97,6 +166,24 @@ void GLText_Destroy()
 
     font_data.temp_lines_used = GLTEXT_MAX_TEMP_LINES;
 
+    GLText_ClearLayoutCache();
+    for(uint32_t j = 0; j < font_data.immediate_size; j++)
+    {
+        free(font_data.immediate[j]);
+    }
+    free(font_data.immediate);
+    font_data.immediate = NULL;
+    font_data.immediate_size = 0;
+    free(font_data.items);
+    font_data.items = NULL;
+    font_data.items_size = 0;
+    free(font_data.runs);
+    font_data.runs = NULL;
+    font_data.runs_size = 0;
+    free(font_data.vertex_buffer);
+    font_data.vertex_buffer = NULL;
+    font_data.vertex_buffer_size = 0;
+
     for(i = 0; i < font_data.max_fonts; i++)
     {
         glf_free_font(font_data.fonts[i].gl_font);
@@ -118,6 +205,7 @@ void GLText_UpdateResize(int w, int h, float scale)
 {
     screen_width = w;
     screen_height = h;
+    GLText_ClearLayoutCache();                                                 // glyphs textures are recreated
     if(font_data.max_fonts > 0)
     {
         for(uint16_t i = 0; i < font_data.max_fonts; i++)
@@ -131,53 +219,219 @@ void GLText_UpdateResize(int w, int h, float scale)
 }
 
 
-void GLText_RenderStringLine(gl_text_line_p l)
+/*
+ * Layout cache: lines glyphs are laid out once and reused while the text,
+ * font and wrapping parameters stay the same (temp lines are refilled each
+ * frame, but usually with the same strings).
+ */
+static uint32_t GLText_HashString(const char *text)
 {
-    gl_tex_font_p gl_font = NULL;
-    gl_fontstyle_p style = NULL;
-    
-    if(l->show && (gl_font = GLText_GetFont(l->font_id)) && (style = GLText_GetFontStyle(l->style_id)))
+    uint32_t hash = 2166136261U;
+    for(; *text; text++)
     {
-        GLfloat real_x = 0.0f, real_y = 0.0f;
-        int32_t x0, y0, x1, y1;
-        GLfloat shadow_color[4];
-        int32_t w_pt = (l->line_width * 64.0f + 0.5f);
-        int32_t dy = l->line_height * gl_font->font_size;
-        int n_lines = 1;
-        char *begin = l->text;
-        char *end = begin;
-        
-        shadow_color[0] = 0.0f;
-        shadow_color[1] = 0.0f;
-        shadow_color[2] = 0.0f;
-        shadow_color[3] = (float)style->font_color[3] * GUI_FONT_SHADOW_TRANSPARENCY;
+        hash = (hash ^ (uint8_t)(*text)) * 16777619U;
+    }
+    return hash;
+}
+
+
+static void GLText_ClearLayout(gl_text_layout_p layout)
+{
+    free(layout->text);
+    free(layout->quads);
+    free(layout->line_quads);
+    layout->text = NULL;
+    layout->quads = NULL;
+    layout->quads_count = 0;
+    layout->line_quads = NULL;
+    layout->lines_count = 0;
+    layout->gl_font = NULL;
+}
+
 
-        if(l->line_width > 0.0f)
+static void GLText_ClearLayoutCache()
+{
+    for(int i = 0; i < GLTEXT_LAYOUT_CACHE_SIZE; i++)
+    {
+        GLText_ClearLayout(font_data.layouts + i);
+    }
+    for(uint32_t i = 0; i < font_data.immediate_count; i++)
+    {
+        GLText_ClearLayout(font_data.immediate[i]);
+    }
+    font_data.immediate_count = 0;
+}
+
+
+static void GLText_BuildLayout(gl_text_layout_p layout, gl_text_line_p l, gl_tex_font_p gl_font)
+{
+    int32_t x0, y0, x1, y1;
+    int32_t w_pt = (l->line_width * 64.0f + 0.5f);
+    int32_t dy = l->line_height * gl_font->font_size;
+    int n_lines = 1;
+    char *begin = l->text;
+    char *end = begin;
+
+    if(l->line_width > 0.0f)
+    {
+        int n_sym = 0;
+        n_lines = 0;
+        for(char *ch = glf_get_string_for_width(gl_font, l->text, w_pt, &n_sym); *begin; ch = glf_get_string_for_width(gl_font, ch, w_pt, &n_sym))
         {
-            int n_sym = 0;
-            n_lines = 0;
-            for(char *ch = glf_get_string_for_width(gl_font, l->text, w_pt, &n_sym); *begin; ch = glf_get_string_for_width(gl_font, ch, w_pt, &n_sym))
+            if(!n_lines)
             {
-                if(!n_lines)
-                {
-                    glf_get_string_bb(gl_font, l->text, n_sym, &x0, &y0, &x1, &y1);
-                }
-                ++n_lines;
-                begin = ch;
+                glf_get_string_bb(gl_font, l->text, n_sym, &x0, &y0, &x1, &y1);
             }
-            begin = l->text;
-            x1 = x0 + w_pt;
-            y1 = y0 + n_lines * gl_font->font_size * l->line_height * 64.0f;
+            ++n_lines;
+            begin = ch;
         }
-        else
+        begin = l->text;
+        x1 = x0 + w_pt;
+        y1 = y0 + n_lines * gl_font->font_size * l->line_height * 64.0f;
+    }
+    else
+    {
+        glf_get_string_bb(gl_font, l->text, -1, &x0, &y0, &x1, &y1);
+    }
+
+    layout->rect[0] = (GLfloat)x0 / 64.0f;
+    layout->rect[1] = (GLfloat)y0 / 64.0f;
+    layout->rect[2] = (GLfloat)x1 / 64.0f;
+    layout->rect[3] = (GLfloat)y1 / 64.0f;
+
+    layout->quads = (gl_glyph_quad_p)malloc((utf8_strlen(l->text) + 1) * sizeof(gl_glyph_quad_t));
+    layout->quads_count = 0;
+    layout->line_quads = (uint32_t*)malloc(n_lines * sizeof(uint32_t));
+    layout->lines_count = n_lines;
+    for(int line = n_lines - 1; line >= 0; --line)
+    {
+        int n_sym = -1;
+        if(n_lines > 1)
         {
-            glf_get_string_bb(gl_font, l->text, -1, &x0, &y0, &x1, &y1);
+            end = glf_get_string_for_width(gl_font, begin, w_pt, &n_sym);
         }
+        layout->line_quads[n_lines - 1 - line] = glf_get_string_quads(gl_font, 0.0f, line * dy, begin, n_sym, layout->quads + layout->quads_count);
+        layout->quads_count += layout->line_quads[n_lines - 1 - line];
+        begin = end;
+    }
+}
+
+
+static gl_text_layout_p GLText_GetLayout(gl_text_line_p l, gl_tex_font_p gl_font)
+{
+    uint32_t hash = GLText_HashString(l->text);
+    gl_text_layout_p victim = NULL;
+
+    for(int i = 0; i < GLTEXT_LAYOUT_CACHE_PROBES; i++)
+    {
+        gl_text_layout_p layout = font_data.layouts + (hash + i) % GLTEXT_LAYOUT_CACHE_SIZE;
+        if((layout->text != NULL) && (layout->hash == hash) && (layout->gl_font == gl_font) &&
+           (layout->font_size == gl_font->font_size) && (layout->line_width == l->line_width) &&
+           (layout->line_height == l->line_height) && (strcmp(layout->text, l->text) == 0))
+        {
+            layout->last_frame = font_data.frame;
+            return layout;
+        }
+        if((layout->text == NULL) || (layout->last_frame != font_data.frame))   // do not evict layouts queued in this frame
+        {
+            if((victim == NULL) || (victim->text && ((layout->text == NULL) || (layout->last_frame < victim->last_frame))))
+            {
+                victim = layout;
+            }
+        }
+    }
+
+    if(victim == NULL)
+    {
+        // every probed slot is queued in this frame; lay the line out for this frame only
+        if(font_data.immediate_count >= font_data.immediate_size)
+        {
+            uint32_t new_size = font_data.immediate_size + 16;
+            font_data.immediate = (gl_text_layout_p*)realloc(font_data.immediate, new_size * sizeof(gl_text_layout_p));
+            for(uint32_t i = font_data.immediate_size; i < new_size; i++)
+            {
+                font_data.immediate[i] = (gl_text_layout_p)calloc(1, sizeof(gl_text_layout_t));
+            }
+            font_data.immediate_size = new_size;
+        }
+        victim = font_data.immediate[font_data.immediate_count++];
+    }
+
+    GLText_ClearLayout(victim);
+    victim->text = strdup(l->text);
+    victim->hash = hash;
+    victim->gl_font = gl_font;
+    victim->font_size = gl_font->font_size;
+    victim->line_width = l->line_width;
+    victim->line_height = l->line_height;
+    victim->last_frame = font_data.frame;
+    GLText_BuildLayout(victim, l, gl_font);
+
+    return victim;
+}
+
+
+/**
+ * Appends vertices to the last run if it has the same texture, else starts a new run.
+ */
+static void GLText_AddRun(GLuint tex_index, uint32_t vertex_count)
+{
+    gl_text_run_p run = (font_data.runs_count > 0) ? (font_data.runs + font_data.runs_count - 1) : (NULL);
+    uint32_t first_vertex = (run) ? (run->first_vertex + run->vertex_count) : (0);
+
+    if(run && (run->tex_index == tex_index))
+    {
+        run->vertex_count += vertex_count;
+        return;
+    }
+
+    if(font_data.runs_count >= font_data.runs_size)
+    {
+        font_data.runs_size += 64;
+        font_data.runs = (gl_text_run_p)realloc(font_data.runs, font_data.runs_size * sizeof(gl_text_run_t));
+    }
+    run = font_data.runs + font_data.runs_count++;
+    run->tex_index = tex_index;
+    run->first_vertex = first_vertex;
+    run->vertex_count = vertex_count;
+}
+
+
+static GLfloat *GLText_WriteQuad(GLfloat *p, GLfloat x, GLfloat y, const GLfloat rect[4], const GLfloat tex_coord[4], const GLfloat color[4])
+{
+    GLfloat x0 = x + rect[0];
+    GLfloat y0 = y + rect[1];
+    GLfloat x1 = x + rect[2];
+    GLfloat y1 = y + rect[3];
+
+    *p++ = x0; *p++ = y0; *p++ = tex_coord[0]; *p++ = tex_coord[1]; vec4_copy(p, color); p += 4;
+    *p++ = x1; *p++ = y0; *p++ = tex_coord[2]; *p++ = tex_coord[1]; vec4_copy(p, color); p += 4;
+    *p++ = x1; *p++ = y1; *p++ = tex_coord[2]; *p++ = tex_coord[3]; vec4_copy(p, color); p += 4;
+    *p++ = x0; *p++ = y0; *p++ = tex_coord[0]; *p++ = tex_coord[1]; vec4_copy(p, color); p += 4;
+    *p++ = x1; *p++ = y1; *p++ = tex_coord[2]; *p++ = tex_coord[3]; vec4_copy(p, color); p += 4;
+    *p++ = x0; *p++ = y1; *p++ = tex_coord[0]; *p++ = tex_coord[3]; vec4_copy(p, color); p += 4;
+
+    return p;
+}
+
+
+/**
+ * Queues the line into the current frame text buffer; all queued lines are
+ * drawn by GLText_RenderStrings() in queue order, with one draw call per run
+ * of vertices that use the same texture.
+ */
+void GLText_RenderStringLine(gl_text_line_p l)
+{
+    gl_tex_font_p gl_font = NULL;
+    gl_fontstyle_p style = NULL;
+
+    if(l->show && l->text && l->text[0] && (gl_font = GLText_GetFont(l->font_id)) && (style = GLText_GetFontStyle(l->style_id)))
+    {
+        gl_text_layout_p layout = GLText_GetLayout(l, gl_font);
+        gl_text_draw_item_p item;
+        GLfloat real_x = 0.0f, real_y = 0.0f;
 
-        l->rect[0] = (GLfloat)x0 / 64.0f;
-        l->rect[1] = (GLfloat)y0 / 64.0f;
-        l->rect[2] = (GLfloat)x1 / 64.0f;
-        l->rect[3] = (GLfloat)y1 / 64.0f;
+        vec4_copy(l->rect, layout->rect);
 
         switch(l->x_align)
         {
@@ -205,62 +459,19 @@ void GLText_RenderStringLine(gl_text_line_p l)
                 break;
         }
 
-        if(style->rect)  // it is BS
+        if(font_data.items_count >= font_data.items_size)
         {
-            BindWhiteTexture();
-            GLfloat x0 = l->rect[0] + real_x - style->rect_border * screen_width;
-            GLfloat y0 = l->rect[1] + real_y - style->rect_border * screen_height;
-            GLfloat x1 = l->rect[2] + real_x + style->rect_border * screen_width;
-            GLfloat y1 = l->rect[3] + real_y + style->rect_border * screen_height;
-            GLfloat *v, backgroundArray[32];
-
-            v = backgroundArray;
-           *v++ = x0; *v++ = y0;
-            vec4_copy(v, style->rect_color);
-            v += 4;
-           *v++ = 0.0; *v++ = 0.0;
-
-           *v++ = x1; *v++ = y0;
-            vec4_copy(v, style->rect_color);
-            v += 4;
-           *v++ = 0.0; *v++ = 0.0;
-
-           *v++ = x1; *v++ = y1;
-            vec4_copy(v, style->rect_color);
-            v += 4;
-           *v++ = 0.0; *v++ = 0.0;
-
-           *v++ = x0; *v++ = y1;
-            vec4_copy(v, style->rect_color);
-            v += 4;
-           *v++ = 0.0; *v++ = 0.0;
-
-            qglVertexPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), backgroundArray);
-            qglColorPointer(4, GL_FLOAT, 8 * sizeof(GLfloat), backgroundArray + 2);
-            qglTexCoordPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), backgroundArray + 6);
-            qglDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-        }
-
-
-        for(int line = n_lines - 1; line >= 0; --line)
-        {
-            int n_sym = -1;
-            if(n_lines > 1)
-            {
-                end = glf_get_string_for_width(gl_font, begin, w_pt, &n_sym);
-            }
-            if(style->shadowed)
-            {
-                vec4_copy(gl_font->gl_font_color, shadow_color);
-                glf_render_str(gl_font,
-                               (real_x + GUI_FONT_SHADOW_HORIZONTAL_SHIFT),
-                               (real_y + line * dy + GUI_FONT_SHADOW_VERTICAL_SHIFT),
-                               begin, n_sym);
-            }
-            vec4_copy(gl_font->gl_font_color, style->font_color);
-            glf_render_str(gl_font, real_x, real_y + line * dy, begin, n_sym);
-            begin = end;
+            font_data.items_size += 64;
+            font_data.items = (gl_text_draw_item_p)realloc(font_data.items, font_data.items_size * sizeof(gl_text_draw_item_t));
         }
+        item = font_data.items + font_data.items_count++;
+        item->layout = layout;
+        item->style = style;
+        item->x = real_x;
+        item->y = real_y;
+
+        font_data.vertex_count += (style->rect) ? (6) : (0);
+        font_data.vertex_count += layout->quads_count * ((style->shadowed) ? (12) : (6));
     }
 }
 
@@ -268,9 +479,21 @@ void GLText_RenderStringLine(gl_text_line_p l)
 void GLText_RenderStrings()
 {
     gl_text_line_p l = font_data.gl_base_lines;
-
-    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-    qglBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    uint32_t vertex_count;
+    GLfloat *buffer, *p;
+    uint32_t stream_offset;
+    size_t offset;
+    const GLfloat zero_tex_coord[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    font_data.frame++;
+    font_data.items_count = 0;
+    font_data.vertex_count = 0;
+    font_data.runs_count = 0;
+    for(uint32_t i = 0; i < font_data.immediate_count; i++)
+    {
+        GLText_ClearLayout(font_data.immediate[i]);                             // previous frame items are drawn
+    }
+    font_data.immediate_count = 0;
 
     while(l)
     {
@@ -287,8 +510,97 @@ void GLText_RenderStrings()
             l->show = 0;
         }
     }
-
     font_data.temp_lines_used = 0;
+
+    vertex_count = font_data.vertex_count;
+    if(vertex_count == 0)
+    {
+        return;
+    }
+
+    buffer = (GLfloat*)GLStream_Map(vertex_count * 8 * sizeof(GLfloat), &stream_offset);
+    offset = stream_offset;
+    if(buffer == NULL)
+    {
+        // does not fit to the stream buffer; draw from client memory
+        if(vertex_count > font_data.vertex_buffer_size)
+        {
+            font_data.vertex_buffer_size = vertex_count + 1024;
+            font_data.vertex_buffer = (GLfloat*)realloc(font_data.vertex_buffer, font_data.vertex_buffer_size * 8 * sizeof(GLfloat));
+        }
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        buffer = font_data.vertex_buffer;
+        offset = (size_t)buffer;
+    }
+    // same order as lines drawn one by one: background, then for every
+    // wrapped line all its shadows and then all its glyphs
+    p = buffer;
+    for(uint32_t i = 0; i < font_data.items_count; i++)
+    {
+        gl_text_draw_item_p item = font_data.items + i;
+        gl_text_layout_p layout = item->layout;
+        gl_fontstyle_p style = item->style;
+
+        if(style->rect)
+        {
+            GLfloat rect[4];
+            rect[0] = layout->rect[0] - style->rect_border * screen_width;
+            rect[1] = layout->rect[1] - style->rect_border * screen_height;
+            rect[2] = layout->rect[2] + style->rect_border * screen_width;
+            rect[3] = layout->rect[3] + style->rect_border * screen_height;
+            p = GLText_WriteQuad(p, item->x, item->y, rect, zero_tex_coord, style->rect_color);
+            GLText_AddRun(0, 6);
+        }
+
+        gl_glyph_quad_p q = layout->quads;
+        for(uint16_t k = 0; k < layout->lines_count; k++)
+        {
+            uint32_t n = layout->line_quads[k];
+            if(style->shadowed)
+            {
+                GLfloat shadow_color[4];
+                shadow_color[0] = 0.0f;
+                shadow_color[1] = 0.0f;
+                shadow_color[2] = 0.0f;
+                shadow_color[3] = (float)style->font_color[3] * GUI_FONT_SHADOW_TRANSPARENCY;
+                for(uint32_t j = 0; j < n; j++)
+                {
+                    p = GLText_WriteQuad(p, item->x + GUI_FONT_SHADOW_HORIZONTAL_SHIFT, item->y + GUI_FONT_SHADOW_VERTICAL_SHIFT, q[j].rect, q[j].tex_coord, shadow_color);
+                    GLText_AddRun(q[j].tex_index, 6);
+                }
+            }
+            for(uint32_t j = 0; j < n; j++)
+            {
+                p = GLText_WriteQuad(p, item->x, item->y, q[j].rect, q[j].tex_coord, style->font_color);
+                GLText_AddRun(q[j].tex_index, 6);
+            }
+            q += n;
+        }
+    }
+
+    if(buffer != font_data.vertex_buffer)
+    {
+        GLStream_Unmap();
+    }
+
+    qglBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    qglVertexPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (const GLvoid*)offset);
+    qglTexCoordPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (const GLvoid*)(offset + 2 * sizeof(GLfloat)));
+    qglColorPointer(4, GL_FLOAT, 8 * sizeof(GLfloat), (const GLvoid*)(offset + 4 * sizeof(GLfloat)));
+    for(uint32_t i = 0; i < font_data.runs_count; i++)
+    {
+        gl_text_run_p run = font_data.runs + i;
+        if(run->tex_index == 0)
+        {
+            BindWhiteTexture();
+        }
+        else
+        {
+            qglBindTexture(GL_TEXTURE_2D, run->tex_index);
+        }
+        qglDrawArrays(GL_TRIANGLES, run->first_vertex, run->vertex_count);
+    }
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 }
 
 
@@ -386,6 +698,7 @@ int GLText_AddFont(uint16_t index, uint16_t size, const char* path)
         {
             if(font_data.fonts[index].gl_font)
             {
+                GLText_ClearLayoutCache();
                 glf_free_font(font_data.fonts[index].gl_font);
             }
             font_data.fonts[index].font_size = size;
@@ -402,6 +715,7 @@ int GLText_RemoveFont(uint16_t index)
 {
     if((index < font_data.max_fonts) && (font_data.fonts[index].gl_font))
     {
+        GLText_ClearLayoutCache();
         glf_free_font(font_data.fonts[index].gl_font);
         font_data.fonts[index].gl_font = NULL;
         return 1;
@@ -216,6 +216,7 @@ PFNGLGETATTRIBLOCATIONARBPROC           qglGetAttribLocationARB = NULL;
 PFNGLENABLEVERTEXATTRIBARRAYARBPROC     qglEnableVertexAttribArrayARB = NULL;
 PFNGLENABLEVERTEXATTRIBARRAYARBPROC     qglDisableVertexAttribArrayARB = NULL;
 PFNGLVERTEXATTRIBPOINTERARBPROC         qglVertexAttribPointerARB = NULL;
+PFNGLVERTEXATTRIB1FARBPROC              qglVertexAttrib1fARB = NULL;
 
 PFNGLACTIVETEXTUREARBPROC               qglActiveTextureARB = NULL;
 PFNGLCLIENTACTIVETEXTUREARBPROC         qglClientActiveTextureARB = NULL;
@@ -271,6 +272,36 @@ PFNGLISVERTEXARRAYPROC                  qglIsVertexArray = NULL;
 
 PFNGLGENERATEMIPMAPEXTPROC              qglGenerateMipmap = NULL;
 
+PFNGLCOMPRESSEDTEXIMAGE2DARBPROC        qglCompressedTexImage2DARB = NULL;
+
+PFNGLMAPBUFFERRANGEPROC                 qglMapBufferRange = NULL;
+PFNGLFENCESYNCPROC                      qglFenceSync = NULL;
+PFNGLCLIENTWAITSYNCPROC                 qglClientWaitSync = NULL;
+PFNGLDELETESYNCPROC                     qglDeleteSync = NULL;
+PFNGLBUFFERSTORAGEPROC                  qglBufferStorage = NULL;
+
+PFNGLGETPROGRAMBINARYPROC               qglGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC                  qglProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC              qglProgramParameteri = NULL;
+PFNGLGETPROGRAMIVPROC                   qglGetProgramiv = NULL;
+
+PFNGLGENQUERIESPROC                     qglGenQueries = NULL;
+PFNGLDELETEQUERIESPROC                  qglDeleteQueries = NULL;
+PFNGLBEGINQUERYPROC                     qglBeginQuery = NULL;
+PFNGLENDQUERYPROC                       qglEndQuery = NULL;
+PFNGLGETQUERYOBJECTUIVPROC              qglGetQueryObjectuiv = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC            qglGetQueryObjectui64v = NULL;
+
+PFNGLGENFRAMEBUFFERSPROC                qglGenFramebuffers = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC             qglDeleteFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC                qglBindFramebuffer = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC         qglCheckFramebufferStatus = NULL;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC        qglFramebufferRenderbuffer = NULL;
+PFNGLGENRENDERBUFFERSPROC               qglGenRenderbuffers = NULL;
+PFNGLDELETERENDERBUFFERSPROC            qglDeleteRenderbuffers = NULL;
+PFNGLBINDRENDERBUFFERPROC               qglBindRenderbuffer = NULL;
+PFNGLRENDERBUFFERSTORAGEPROC            qglRenderbufferStorage = NULL;
+
 static char *engine_gl_ext_str = NULL;
 static GLuint whiteTexture = 0;
 
@@ -526,6 +557,56 @@ void InitGLExtFuncs()
         fprintf(stderr, "VBOs not supported");
         abort();
     }
+    if(IsGLExtensionSupported("GL_ARB_texture_compression"))
+    {
+        qglCompressedTexImage2DARB = (PFNGLCOMPRESSEDTEXIMAGE2DARBPROC)SDL_GL_GetProcAddress("glCompressedTexImage2DARB");
+    }
+    if(IsGLExtensionSupported("GL_ARB_map_buffer_range"))
+    {
+        qglMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)SDL_GL_GetProcAddress("glMapBufferRange");
+    }
+    if(IsGLExtensionSupported("GL_ARB_sync"))
+    {
+        qglFenceSync = (PFNGLFENCESYNCPROC)SDL_GL_GetProcAddress("glFenceSync");
+        qglClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)SDL_GL_GetProcAddress("glClientWaitSync");
+        qglDeleteSync = (PFNGLDELETESYNCPROC)SDL_GL_GetProcAddress("glDeleteSync");
+    }
+    if(IsGLExtensionSupported("GL_ARB_buffer_storage"))
+    {
+        qglBufferStorage = (PFNGLBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glBufferStorage");
+    }
+    if(IsGLExtensionSupported("GL_ARB_get_program_binary"))
+    {
+        qglGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+        qglProgramBinary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+        qglProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+        qglGetProgramiv = (PFNGLGETPROGRAMIVPROC)SDL_GL_GetProcAddress("glGetProgramiv");
+    }
+    if(IsGLExtensionSupported("GL_ARB_timer_query") || IsGLExtensionSupported("GL_EXT_timer_query"))
+    {
+        qglGenQueries = (PFNGLGENQUERIESPROC)SDL_GL_GetProcAddress("glGenQueries");
+        qglDeleteQueries = (PFNGLDELETEQUERIESPROC)SDL_GL_GetProcAddress("glDeleteQueries");
+        qglBeginQuery = (PFNGLBEGINQUERYPROC)SDL_GL_GetProcAddress("glBeginQuery");
+        qglEndQuery = (PFNGLENDQUERYPROC)SDL_GL_GetProcAddress("glEndQuery");
+        qglGetQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVPROC)SDL_GL_GetProcAddress("glGetQueryObjectuiv");
+        qglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)SDL_GL_GetProcAddress("glGetQueryObjectui64v");
+        if(qglGetQueryObjectui64v == NULL)
+        {
+            qglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
+        }
+    }
+    if(IsGLExtensionSupported("GL_ARB_framebuffer_object"))
+    {
+        qglGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)SDL_GL_GetProcAddress("glGenFramebuffers");
+        qglDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteFramebuffers");
+        qglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)SDL_GL_GetProcAddress("glBindFramebuffer");
+        qglCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)SDL_GL_GetProcAddress("glCheckFramebufferStatus");
+        qglFramebufferRenderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)SDL_GL_GetProcAddress("glFramebufferRenderbuffer");
+        qglGenRenderbuffers = (PFNGLGENRENDERBUFFERSPROC)SDL_GL_GetProcAddress("glGenRenderbuffers");
+        qglDeleteRenderbuffers = (PFNGLDELETERENDERBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteRenderbuffers");
+        qglBindRenderbuffer = (PFNGLBINDRENDERBUFFERPROC)SDL_GL_GetProcAddress("glBindRenderbuffer");
+        qglRenderbufferStorage = (PFNGLRENDERBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glRenderbufferStorage");
+    }
     if(IsGLExtensionSupported("GL_ARB_shading_language_100"))
     {
         qglDeleteObjectARB = (PFNGLDELETEOBJECTARBPROC)SDL_GL_GetProcAddress("glDeleteObjectARB");
@@ -575,6 +656,7 @@ void InitGLExtFuncs()
         qglDisableVertexAttribArrayARB = (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC)SDL_GL_GetProcAddress("glDisableVertexAttribArrayARB");
 
         qglVertexAttribPointerARB = (PFNGLVERTEXATTRIBPOINTERARBPROC)SDL_GL_GetProcAddress("glVertexAttribPointerARB");
+        qglVertexAttrib1fARB = (PFNGLVERTEXATTRIB1FARBPROC)SDL_GL_GetProcAddress("glVertexAttrib1fARB");
     }
     else
     {
@@ -711,18 +793,20 @@ int loadShaderFromBuff(GLhandleARB ShaderObj, const char *source, const char *ad
 }
 
 
-int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines)
+/**
+ * Reads whole shader file; returns zero terminated text (free it) or NULL.
+ */
+char *readShaderFile(const char *fileName)
 {
     FILE *file;
     GLint size = 0;
-    int ret = 0;
 
     //Sys_DebugLog(GL_LOG_FILENAME, "GL_Loading %s", fileName);
     file = fopen (fileName, "rb");
     if (file == NULL)
     {
         Sys_DebugLog(GL_LOG_FILENAME, "Error opening %s", fileName);
-        return ret;
+        return NULL;
     }
 
     fseek(file, 0, SEEK_END);
@@ -732,7 +816,7 @@ int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *
     {
         fclose(file);
         Sys_DebugLog(GL_LOG_FILENAME, "Error loading file %s: size < 1", fileName);
-        return ret;
+        return NULL;
     }
 
     char *buf = (char*)malloc(size + 1);
@@ -744,8 +828,20 @@ int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *
     buf[size] = 0;
     fclose(file);
 
-    ret = loadShaderFromBuff(ShaderObj, buf, additionalDefines);
-    free(buf);
+    return buf;
+}
+
+
+int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines)
+{
+    int ret = 0;
+    char *buf = readShaderFile(fileName);
+
+    if(buf)
+    {
+        ret = loadShaderFromBuff(ShaderObj, buf, additionalDefines);
+        free(buf);
+    }
     return ret;
 }
 
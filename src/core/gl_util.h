@@ -371,6 +371,7 @@ extern PFNGLGETATTRIBLOCATIONARBPROC qglGetAttribLocationARB;
 extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC qglEnableVertexAttribArrayARB;
 extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC qglDisableVertexAttribArrayARB;
 extern PFNGLVERTEXATTRIBPOINTERARBPROC qglVertexAttribPointerARB;
+extern PFNGLVERTEXATTRIB1FARBPROC qglVertexAttrib1fARB;
 
 /*multitexture EXT*/
 extern PFNGLACTIVETEXTUREARBPROC qglActiveTextureARB;
@@ -428,6 +429,40 @@ extern PFNGLISVERTEXARRAYPROC qglIsVertexArray;
 
 extern PFNGLGENERATEMIPMAPPROC qglGenerateMipmap;
 
+extern PFNGLCOMPRESSEDTEXIMAGE2DARBPROC qglCompressedTexImage2DARB;
+
+/* streaming buffers: map range, sync objects, immutable storage */
+extern PFNGLMAPBUFFERRANGEPROC qglMapBufferRange;
+extern PFNGLFENCESYNCPROC qglFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC qglClientWaitSync;
+extern PFNGLDELETESYNCPROC qglDeleteSync;
+extern PFNGLBUFFERSTORAGEPROC qglBufferStorage;
+
+/* program binaries */
+extern PFNGLGETPROGRAMBINARYPROC qglGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC qglProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC qglProgramParameteri;
+extern PFNGLGETPROGRAMIVPROC qglGetProgramiv;
+
+/* GPU timer queries */
+extern PFNGLGENQUERIESPROC qglGenQueries;
+extern PFNGLDELETEQUERIESPROC qglDeleteQueries;
+extern PFNGLBEGINQUERYPROC qglBeginQuery;
+extern PFNGLENDQUERYPROC qglEndQuery;
+extern PFNGLGETQUERYOBJECTUIVPROC qglGetQueryObjectuiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC qglGetQueryObjectui64v;
+
+/* framebuffer objects */
+extern PFNGLGENFRAMEBUFFERSPROC qglGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC qglDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC qglBindFramebuffer;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC qglCheckFramebufferStatus;
+extern PFNGLFRAMEBUFFERRENDERBUFFERPROC qglFramebufferRenderbuffer;
+extern PFNGLGENRENDERBUFFERSPROC qglGenRenderbuffers;
+extern PFNGLDELETERENDERBUFFERSPROC qglDeleteRenderbuffers;
+extern PFNGLBINDRENDERBUFFERPROC qglBindRenderbuffer;
+extern PFNGLRENDERBUFFERSTORAGEPROC qglRenderbufferStorage;
+
 void InitGLExtFuncs();
 int IsGLExtensionSupported(const char *ext);
 
@@ -435,6 +470,7 @@ int checkOpenGLError();
 void printInfoLog (GLhandleARB object);
 int loadShaderFromBuff(GLhandleARB ShaderObj, const char *source, const char *additionalDefines);
 int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines);
+char *readShaderFile(const char *fileName);
 
 void BindWhiteTexture();
 
@@ -21,6 +21,8 @@ extern "C" {
 #include "core/vmath.h"
 #include "core/polygon.h"
 #include "core/gl_text.h"
+#include "core/gl_stats.h"
+#include "core/gl_stream.h"
 #include "render/camera.h"
 #include "render/render.h"
 #include "script/script.h"
@@ -44,8 +46,10 @@ extern "C" {
 #include "trigger.h"
 #include "character_controller.h"
 #include "render/bsp_tree.h"
+#include "render/occlusion.h"
 #include "render/shader_manager.h"
 #include "image.h"
+#include "bench.h"
 
 
 static SDL_Window             *sdl_window     = NULL;
@@ -59,6 +63,8 @@ static stream_codec_t           engine_video;
 static char                     base_path[1024] = {0};
 static volatile int             engine_done   = 0;
 static int                      engine_set_zero_time = 0;
+static int                      engine_headless = 0;
+static int                      engine_gl_stats_saved = -1;                    // r_gl_stats state while GL stats view is shown
 float time_scale = 1.0f;
 
 engine_container_p      last_cont = NULL;
@@ -83,6 +89,7 @@ enum debug_view_state_e
     room_objects,
     ai_boxes,
     bsp_info,
+    gl_stats,
     model_view,
     debug_states_count
 };
@@ -134,6 +141,10 @@ void Engine_Start(int argc, char **argv)
 {
     char *config_name = NULL;
     char *autoexec_name = NULL;
+    bench_render_params_t bench_params = {NULL, NULL, NULL, 0};
+    bench_physics_params_t bench_physics = {NULL, NULL, 0, BENCH_PHYSICS_BALLS, BENCH_PHYSICS_GHOSTS, BENCH_PHYSICS_RAGDOLLS, BENCH_PHYSICS_HAIRS, BENCH_PHYSICS_RAYS};
+    const char *check_portals[BENCH_PORTALS_LEVELS_MAX];
+    uint32_t check_portals_count = 0;
 
     Engine_InitDefaultGlobals();
 
@@ -180,16 +191,83 @@ void Engine_Start(int argc, char **argv)
             }
             ++i;
         }
+        else if((0 == strcmp(argv[i], "-bench_render")) && (i + 1 < argc))
+        {
+            bench_params.level = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "-bench_path")) && (i + 1 < argc))
+        {
+            bench_params.path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "-bench_out")) && (i + 1 < argc))
+        {
+            bench_params.out = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "-bench_frames")) && (i + 1 < argc))
+        {
+            bench_params.frames = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-bench_physics")) && (i + 1 < argc))
+        {
+            bench_physics.level = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "-bench_balls")) && (i + 1 < argc))
+        {
+            bench_physics.balls = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-bench_ghosts")) && (i + 1 < argc))
+        {
+            bench_physics.ghosts = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-bench_ragdolls")) && (i + 1 < argc))
+        {
+            bench_physics.ragdolls = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-bench_hairs")) && (i + 1 < argc))
+        {
+            bench_physics.hairs = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-bench_rays")) && (i + 1 < argc))
+        {
+            bench_physics.rays = atoi(argv[++i]);
+        }
+        else if((0 == strcmp(argv[i], "-check_portals")) && (i + 1 < argc))
+        {
+            ++i;
+            if(check_portals_count < BENCH_PORTALS_LEVELS_MAX)
+            {
+                check_portals[check_portals_count++] = argv[i];
+            }
+        }
         else
         {
             puts("usage:");
             puts("-config \"path_to_config_file\"");
             puts("-autoexec \"path_to_autoexec_file\"");
             puts("-base_path \"path_to_base_folder_location (contains data, resource, save and script folders)\"");
+            puts("-bench_render \"level_path\" - headless render benchmark, then exit");
+            puts("-bench_path \"camera_path_file\" - points recorded with r_bench_path_add (default: level flybys or rooms walk)");
+            puts("-bench_frames N - frames per camera path, or physics benchmark ticks");
+            puts("-bench_out \"file\" - per frame results (CSV), or physics benchmark results (JSON)");
+            puts("-bench_physics \"level_path\" - headless physics benchmark, then exit");
+            puts("-bench_balls N, -bench_ghosts N, -bench_ragdolls N, -bench_hairs N - physics benchmark scene");
+            puts("-bench_rays N - physics benchmark ray tests per tick");
+            puts("-check_portals \"level_path\" - compare serial and parallel portal traversal, may be repeated; exit code 1 on mismatch");
             exit(0);
         }
     }
 
+    bench_physics.out = bench_params.out;
+    bench_physics.ticks = bench_params.frames;
+    if(bench_params.level || bench_physics.level || check_portals_count)
+    {
+        engine_headless = 1;
+        if(!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+        {
+            setenv("SDL_VIDEODRIVER", "offscreen", 0);                          // no display server, render to pbuffer
+        }
+    }
+
     // Primary initialization.
     Engine_Init_Pre();
 
@@ -216,6 +294,15 @@ void Engine_Start(int argc, char **argv)
     // Clearing up memory for initial level loading.
     World_Prepare();
 
+    if(engine_headless)
+    {
+        if(check_portals_count > 0)
+        {
+            Engine_Shutdown(Bench_CheckPortals(check_portals, check_portals_count));
+        }
+        Engine_Shutdown((bench_physics.level) ? (Bench_Physics(&bench_physics)) : (Bench_Render(&bench_params)));
+    }
+
     // Setting up mouse.
     SDL_SetRelativeMouseMode(SDL_TRUE);
     SDL_WarpMouseInWindow(sdl_window, screen_info.w / 2, screen_info.h / 2);
@@ -239,10 +326,13 @@ void Engine_Shutdown(int val)
         engine_lua = NULL;
     }
 
+    Cam_ClearCollisionCache();
     Physics_Destroy();
     Gui_Destroy();
     Con_Destroy();
     GLText_Destroy();
+    GLStats_Destroy();
+    GLStream_Destroy();
     glf_destroy();
     Sys_Destroy();
 
@@ -343,6 +433,8 @@ void Engine_Init_Post()
 void Engine_InitGL()
 {
     InitGLExtFuncs();
+    GLStream_Init(GL_STREAM_BUFFER_SIZE);
+    GLStats_Init();
     qglClearColor(0.0, 0.0, 0.0, 1.0);
 
     qglEnable(GL_DEPTH_TEST);
@@ -374,7 +466,11 @@ void Engine_InitSDLVideo()
     Uint32 video_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_MOUSE_FOCUS | SDL_WINDOW_INPUT_FOCUS;
     PFNGLGETSTRINGPROC lglGetString = NULL;
 
-    if(screen_info.fullscreen)
+    if(engine_headless)
+    {
+        video_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN;
+    }
+    else if(screen_info.fullscreen)
     {
         video_flags |= SDL_WINDOW_FULLSCREEN;
     }
@@ -568,6 +664,16 @@ void Engine_Display(float time)
         // GL_VERTEX_ARRAY | GL_COLOR_ARRAY
 
         screen_info.debug_view_state %= debug_states_count;
+        if((screen_info.debug_view_state == debug_view_state_e::gl_stats) && (engine_gl_stats_saved < 0))
+        {
+            engine_gl_stats_saved = GLStats_IsEnabled();
+            GLStats_SetEnabled(1);
+        }
+        else if((screen_info.debug_view_state != debug_view_state_e::gl_stats) && (engine_gl_stats_saved >= 0))
+        {
+            GLStats_SetEnabled(engine_gl_stats_saved);
+            engine_gl_stats_saved = -1;
+        }
         if(screen_info.debug_view_state)
         {
             ShowDebugInfo();
@@ -596,19 +702,23 @@ void Engine_Display(float time)
         qglEnable(GL_ALPHA_TEST);
 
         qglPopClientAttrib();        ///@POP -> GL_VERTEX_ARRAY | GL_COLOR_ARRAY
+        GLStats_BeginPass(GL_STATS_PASS_GUI);
         Gui_Render();
+        GLStats_EndPass();
         Gui_SwitchGLMode(0);
 
         renderer.DrawListDebugLines();
 
-        SDL_GL_SwapWindow(sdl_window);
+        Engine_GLSwapWindow();
     }
 }
 
 
 void Engine_GLSwapWindow()
 {
+    GLStats_EndFrame();
     SDL_GL_SwapWindow(sdl_window);
+    GLStream_EndFrame();
 }
 
 
@@ -1347,6 +1457,33 @@ void ShowDebugInfo()
                 GLText_OutTextXY(30.0f, y += dy, "input polygons = %07d", renderer.dynamicBSP->GetInputPolygonsCount());
                 GLText_OutTextXY(30.0f, y += dy, "added polygons = %07d", renderer.dynamicBSP->GetAddedPolygonsCount());
             }
+            if(renderer.occlusionCuller && (renderer.r_flags & R_OCCLUSION_CULLING))
+            {
+                GLText_OutTextXY(30.0f, y += dy, "occluders = %07d / %07d", renderer.occlusionCuller->GetRasterizedCount(), renderer.occlusionCuller->GetOccludersCount());
+                GLText_OutTextXY(30.0f, y += dy, "occluded objects = %07d", renderer.occlusionCuller->GetCulledCount());
+            }
+            break;
+
+        case debug_view_state_e::gl_stats:
+            {
+                const gl_stats_t *st = GLStats_GetLastFrame();
+                GLText_OutTextXY(30.0f, y += dy, "VIEW: GL stats (r_gl_stats_dump to print)");
+                GLText_OutTextXY(30.0f, y += dy, "draws = %d, vertices = %d", st->draw_calls, st->vertices);
+                GLText_OutTextXY(30.0f, y += dy, "binds: tex = %d, prog = %d, buf = %d", st->texture_binds, st->program_binds, st->buffer_binds);
+                GLText_OutTextXY(30.0f, y += dy, "states = %d, uniforms = %d", st->state_changes, st->uniform_uploads);
+                GLText_OutTextXY(30.0f, y += dy, "uploads: buf = %d, tex = %d, bytes = %d, stream = %d", st->buffer_uploads, st->texture_uploads, (int)st->upload_bytes, (int)st->stream_bytes);
+                for(int i = 0; i < GL_STATS_PASS_COUNT; i++)
+                {
+                    if(st->pass_time[i] >= 0.0f)
+                    {
+                        GLText_OutTextXY(30.0f, y += dy, "gpu %s = %.3f ms", GLStats_GetPassName(i), st->pass_time[i]);
+                    }
+                    else
+                    {
+                        GLText_OutTextXY(30.0f, y += dy, "gpu %s = n/a", GLStats_GetPassName(i));
+                    }
+                }
+            }
             break;
 
         case debug_view_state_e::model_view:
@@ -1612,7 +1749,14 @@ extern "C" int Engine_ExecCmd(char *ch)
             Con_AddLine("free_look - switch camera mode\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("r_crosshair - switch crosshair visibility\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("cam_distance - camera distance to actor\0", FONTSTYLE_CONSOLE_NOTIFY);
-            Con_AddLine("r_wireframe, r_portals, r_frustums, r_room_boxes, r_boxes, r_normals, r_skip_room, r_flyby, r_cinematics, r_triggers, r_ai_boxes, r_cameras - render modes\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_wireframe, r_portals, r_frustums, r_room_boxes, r_boxes, r_normals, r_skip_room, r_flyby, r_cinematics, r_triggers, r_ai_boxes, r_cameras, r_cpu_skin, r_occlusion, r_portals_mt - render modes\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_bench_bones [iterations] - compare per bone and palette bones upload cost\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_gl_stats - switch GL calls accounting, r_gl_stats_dump - print last frame GL stats\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_portals_check - compare serial and parallel portal traversal from every room centre and direction\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_bench_path_add [file] - append camera point to render benchmark path (default bench_path.txt)\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("phys_hops [N] - keep physics awake N near rooms around player and camera, -1 - everywhere\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("phys_contacts - contacts pool size, last frame contacts and physics heap allocations\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("phys_sector_heights - switch floor and ceiling tests from sectors data, phys_heights_check - compare them with rays in all sectors\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("playsound(id) - play specified sound\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("stopsound(id) - stop specified sound\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("Watch out for case sensitive commands!\0", FONTSTYLE_CONSOLE_WARNING);
@@ -1763,6 +1907,170 @@ extern "C" int Engine_ExecCmd(char *ch)
             renderer.r_flags ^= R_DRAW_AI_BOXES;
             return 1;
         }
+        else if(!strcmp(token, "r_cpu_skin"))
+        {
+            renderer.r_flags ^= R_CPU_SKINNING;
+            return 1;
+        }
+        else if(!strcmp(token, "r_occlusion"))
+        {
+            renderer.r_flags ^= R_OCCLUSION_CULLING;
+            return 1;
+        }
+        else if(!strcmp(token, "r_portals_mt"))
+        {
+            renderer.r_flags ^= R_PARALLEL_PORTALS;
+            Con_Printf("parallel portals traversal %s", (renderer.r_flags & R_PARALLEL_PORTALS) ? ("on") : ("off"));
+            return 1;
+        }
+        else if(!strcmp(token, "r_portals_check"))
+        {
+            bench_portals_result_t result;
+            Bench_CheckPortalsRooms(&engine_camera, &result, Con_Printf);
+            Con_Printf("portals check: identical = %d, different = %d, skipped = %d", result.identical, result.different, result.skipped);
+            return 1;
+        }
+        else if(!strcmp(token, "r_bench_path_add"))
+        {
+            ch = SC_ParseToken(ch, token, sizeof(token));
+            const char *file_name = (ch && token[0]) ? (token) : ("bench_path.txt");
+            if(!Bench_AddPathPoint(file_name, &engine_camera))
+            {
+                Con_Warning("can not write \"%s\"", file_name);
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "r_bench_bones"))
+        {
+            entity_p player = World_GetPlayer();
+            int iterations = SC_ParseInt(&ch);
+            if(player && player->bf)
+            {
+                renderer.BenchmarkBonesUpload(player->bf, (iterations > 0) ? (iterations) : (10000));
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "r_gl_stats"))
+        {
+            if(engine_gl_stats_saved >= 0)
+            {
+                engine_gl_stats_saved = !engine_gl_stats_saved;                 // applied when GL stats view is closed
+                Con_Printf("GL stats %s after GL stats view", (engine_gl_stats_saved) ? ("on") : ("off"));
+            }
+            else
+            {
+                GLStats_SetEnabled(!GLStats_IsEnabled());
+                Con_Printf("GL stats %s", (GLStats_IsEnabled()) ? ("on") : ("off"));
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "r_gl_stats_dump"))
+        {
+            const gl_stats_t *st = GLStats_GetLastFrame();
+            if(!GLStats_IsEnabled())
+            {
+                Con_Printf("GL stats are off, use r_gl_stats");
+                return 1;
+            }
+            Con_Printf("draws = %d, vertices = %d", st->draw_calls, st->vertices);
+            Con_Printf("binds: texture = %d, program = %d, buffer = %d", st->texture_binds, st->program_binds, st->buffer_binds);
+            Con_Printf("state changes = %d, uniforms = %d", st->state_changes, st->uniform_uploads);
+            Con_Printf("uploads: buffer = %d, texture = %d, bytes = %d, stream bytes = %d", st->buffer_uploads, st->texture_uploads, (int)st->upload_bytes, (int)st->stream_bytes);
+            for(int i = 0; i < GL_STATS_PASS_COUNT; i++)
+            {
+                Con_Printf("gpu %s = %.3f ms", GLStats_GetPassName(i), st->pass_time[i]);
+            }
+            if(!GLStats_HasTimers())
+            {
+                Con_Printf("timer queries are not supported");
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "phys_hops"))
+        {
+            char *next = SC_ParseToken(ch, token, sizeof(token));
+            if(next)
+            {
+                World_SetPhysicsHops(atoi(token));
+            }
+            Con_Printf("physics hops = %d, active rooms = %d", World_GetPhysicsHops(), World_GetPhysicsActiveRoomsCount());
+            return 1;
+        }
+        else if(!strcmp(token, "phys_contacts"))
+        {
+            uint32_t pool_size, contacts, allocations;
+            Physics_GetCollisionPoolInfo(&pool_size, &contacts, &allocations);
+            Con_Printf("contacts pool = %d, last frame: contacts = %d, heap allocations = %d", pool_size, contacts, allocations);
+            return 1;
+        }
+        else if(!strcmp(token, "phys_sector_heights"))
+        {
+            Character_SetSectorHeights(!Character_GetSectorHeights());
+            Con_Printf("sector heights = %d", Character_GetSectorHeights());
+            return 1;
+        }
+        else if(!strcmp(token, "phys_heights_check"))
+        {
+            room_p rooms = NULL;
+            uint32_t rooms_count = 0;
+            int checked = 0, failed = 0, skipped = 0;
+            int old_hops = World_GetPhysicsHops();
+            const float probes[2][2] = {{0.25f, 0.6f}, {0.7f, 0.35f}};          // one probe per split triangle
+            engine_container_t cont;
+
+            World_SetPhysicsHops(-1);                                           // rays must see every room
+            World_UpdatePhysicsActivity(NULL, 0);
+            memset(&cont, 0, sizeof(cont));
+            World_GetRoomInfo(&rooms, &rooms_count);
+            for(uint32_t i = 0; i < rooms_count; i++)
+            {
+                room_p r = rooms + i;
+                if(r->real_room != r)
+                {
+                    continue;
+                }
+                cont.room = r;
+                for(uint32_t j = 0; j < r->sectors_count; j++)
+                {
+                    room_sector_p rs = r->content->sectors + j;
+                    if((rs->floor_penetration_config == TR_PENETRATION_CONFIG_WALL) || (rs->ceiling <= rs->floor))
+                    {
+                        continue;
+                    }
+                    for(int k = 0; k < 4; k++)
+                    {
+                        collision_result_t fast, ray;
+                        float pos[3], to[3];
+                        int ceiling = k & 1;
+                        pos[0] = r->transform[12 + 0] + (rs->index_x + probes[k / 2][0]) * TR_METERING_SECTORSIZE;
+                        pos[1] = r->transform[12 + 1] + (rs->index_y + probes[k / 2][1]) * TR_METERING_SECTORSIZE;
+                        pos[2] = 0.5f * (rs->floor + rs->ceiling);
+                        vec3_copy(to, pos);
+                        to[2] += (ceiling) ? (4096.0f) : (-8192.0f);
+                        if(!((ceiling) ? (Sector_CeilingTest(rs, &cont, pos, 4096.0f, &fast)) : (Sector_FloorTest(rs, &cont, pos, 8192.0f, &fast))))
+                        {
+                            skipped++;
+                            continue;
+                        }
+                        Physics_RayTestFiltered(&ray, pos, to, &cont, COLLISION_FILTER_HEIGHT_TEST);
+                        if((fast.hit == ray.hit) && (!ray.hit || ((fast.obj == ray.obj) && (fabs(fast.point[2] - ray.point[2]) < 1.0f) &&
+                           (vec3_dot(fast.normale, ray.normale) > 0.999f))))
+                        {
+                            checked++;
+                        }
+                        else
+                        {
+                            failed++;
+                            Con_Printf("room %d sector (%d, %d) %s: %.1f, ray: %.1f", r->id, rs->index_x, rs->index_y,
+                                       (ceiling) ? ("ceiling") : ("floor"), (fast.hit) ? (fast.point[2]) : (0.0f), (ray.hit) ? (ray.point[2]) : (0.0f));
+                        }
+                    }
+                }
+            }
+            World_SetPhysicsHops(old_hops);                                     // frozen again on the next frame
+            Con_Printf("heights check: identical = %d, different = %d, left to rays = %d", checked, failed, skipped);
+            return 1;
+        }
         else if(!strcmp(token, "r_crosshair"))
         {
             screen_info.crosshair = !screen_info.crosshair;
@@ -450,6 +450,7 @@ int Entity_GetPenetrationFixVector(struct entity_s *ent, collision_callback_t ca
 {
     int ret = 0;
     collision_node_p cn = NULL;
+    uint32_t cn_count;
 
     vec3_set_zero(reaction);
     if(Physics_IsGhostsInited(ent->physics) && (Physics_GetBodiesCount(ent->physics) == ent->bf->bone_tag_count))
@@ -471,8 +472,8 @@ int Entity_GetPenetrationFixVector(struct entity_s *ent, collision_callback_t ca
                 {
                     Mat4_Mat4_mul(tr, ent->transform, btag->full_transform);
                     Physics_SetGhostWorldTransform(ent->physics, tr, m);
-                    cn = Physics_GetGhostCurrentCollision(ent->physics, m, filter);
-                    callback(ent, cn);
+                    cn_count = Physics_GetGhostCurrentCollision(ent->physics, m, filter, &cn);
+                    callback(ent, cn, cn_count);
                 }
                 continue;
             }
@@ -522,12 +523,12 @@ int Entity_GetPenetrationFixVector(struct entity_s *ent, collision_callback_t ca
             {
                 vec3_copy(tr + 12, curr);
                 Physics_SetGhostWorldTransform(ent->physics, tr, m);
-                cn = Physics_GetGhostCurrentCollision(ent->physics, m, filter);
+                cn_count = Physics_GetGhostCurrentCollision(ent->physics, m, filter, &cn);
                 if(callback)
                 {
-                    callback(ent, cn);
+                    callback(ent, cn, cn_count);
                 }
-                for(; cn && cn->obj; cn = cn->next)
+                for(uint32_t k = 0; k < cn_count; k++, cn++)
                 {
                     vec3_mul_scalar(tmp, cn->penetration, cn->penetration[3]);
                     vec3_add_to(ent->transform + 12, tmp);
@@ -573,8 +574,8 @@ int Entity_GetPenetrationFixVector(struct entity_s *ent, collision_callback_t ca
             {
                 vec3_copy(tr + 12, curr);
                 Physics_SetGhostWorldTransform(ent->physics, tr, 0);
-                cn = Physics_GetGhostCurrentCollision(ent->physics, 0, filter);
-                for(; cn && cn->obj; cn = cn->next)
+                cn_count = Physics_GetGhostCurrentCollision(ent->physics, 0, filter, &cn);
+                for(uint32_t k = 0; k < cn_count; k++, cn++)
                 {
                     vec3_mul_scalar(tmp, cn->penetration, cn->penetration[3]);
                     vec3_add_to(ent->transform + 12, tmp);
@@ -740,8 +741,9 @@ void Entity_CheckCollisionCallbacks(entity_p ent)
 {
     for(int i = Physics_GetBodiesCount(ent->physics) - 1; i >= 0; --i)
     {
-        collision_node_p cn = Physics_GetGhostCurrentCollision(ent->physics, i, COLLISION_GROUP_TRIGGERS);
-        for(; cn && cn->obj; cn = cn->next)
+        collision_node_p cn = NULL;
+        uint32_t cn_count = Physics_GetGhostCurrentCollision(ent->physics, i, COLLISION_GROUP_TRIGGERS, &cn);
+        for(uint32_t k = 0; k < cn_count; k++, cn++)
         {
             // do callbacks here:
             if(cn->obj->object_type == OBJECT_ENTITY)
@@ -1216,10 +1218,100 @@ void Entity_Frame(entity_p entity, float time)
             ss_anim = ss_anim->next;
         }
 
-        SSBoneFrame_Update(entity->bf, time);
+        // animation time and commands are already advanced, only pose building may be delayed
+        entity->bf->pose_time += time;
+        switch(Entity_GetAnimLOD(entity))
+        {
+            case ENTITY_ANIM_LOD_REDUCED:
+                if(entity->bf->pose_time < ENTITY_ANIM_LOD_PERIOD)
+                {
+                    SSBoneFrame_UpdateBounds(entity->bf);
+                    break;
+                }
+                // pass through
+            case ENTITY_ANIM_LOD_FULL:
+                SSBoneFrame_Update(entity->bf, entity->bf->pose_time);
+                entity->bf->pose_time = 0.0f;
+                break;
+
+            default:
+                // pose is rebuilt when the entity is back, not with the time of the whole absence
+                entity->bf->pose_time = (entity->bf->pose_time > ENTITY_ANIM_LOD_PERIOD) ? (ENTITY_ANIM_LOD_PERIOD) : (entity->bf->pose_time);
+                SSBoneFrame_UpdateBounds(entity->bf);
+                break;
+        };
     }
 }
 
+/**
+ * Rebuilds bones pose delayed by animation LOD; for code that reads bones
+ * of any entity out of its frame update (scripts creating bodies or ragdolls).
+ */
+void Entity_UpdatePose(entity_p entity)
+{
+    if(entity && entity->bf->animations.model && (entity->bf->pose_time > 0.0f) && !(entity->type_flags & ENTITY_TYPE_DYNAMIC))
+    {
+        SSBoneFrame_Update(entity->bf, entity->bf->pose_time);
+        entity->bf->pose_time = 0.0f;
+    }
+}
+
+
+/**
+ * Chooses bones update rate: full for everything player, camera or physics interacts with
+ * and for entities whose bones drive other objects (hair, ragdoll), reduced for distant
+ * visible entities and for hidden ones with per bone collisions, bounds only for the rest
+ * (the room was not rendered in last frame).
+ */
+int  Entity_GetAnimLOD(entity_p entity)
+{
+    entity_p player = World_GetPlayer();
+    room_p room = entity->self->room;
+    float dist[3];
+
+    if((entity == player) || (room == NULL) || (engine_camera_state.target_id == entity->id) ||
+       (player && player->character && (player->character->target_id == entity->id)))
+    {
+        return ENTITY_ANIM_LOD_FULL;
+    }
+
+    if((entity->type_flags & ENTITY_TYPE_DYNAMIC) || (entity->character && (entity->character->hair_count > 0)))
+    {
+        return ENTITY_ANIM_LOD_FULL;
+    }
+
+    for(ss_animation_p ss_anim = &entity->bf->animations; ss_anim; ss_anim = ss_anim->next)
+    {
+        if(ss_anim->anim_ext_flags & ANIM_EXT_TARGET_TO)
+        {
+            return ENTITY_ANIM_LOD_FULL;
+        }
+    }
+
+    if(player)
+    {
+        vec3_sub(dist, entity->transform + 12, player->transform + 12);
+        if(vec3_sqabs(dist) < ENTITY_ANIM_LOD_INTERACT_DIST * ENTITY_ANIM_LOD_INTERACT_DIST)
+        {
+            return ENTITY_ANIM_LOD_FULL;
+        }
+    }
+
+    if(room->is_in_r_list)
+    {
+        vec3_sub(dist, entity->transform + 12, engine_camera.gl_transform + 12);
+        return (vec3_sqabs(dist) < ENTITY_ANIM_LOD_NEAR_DIST * ENTITY_ANIM_LOD_NEAR_DIST) ? (ENTITY_ANIM_LOD_FULL) : (ENTITY_ANIM_LOD_REDUCED);
+    }
+
+    if((entity->self->collision_group != COLLISION_NONE) && Physics_IsBodyesInited(entity->physics) &&
+       (entity->self->collision_shape != COLLISION_SHAPE_SINGLE_BOX) && (entity->self->collision_shape != COLLISION_SHAPE_SINGLE_SPHERE))
+    {
+        return ENTITY_ANIM_LOD_REDUCED;
+    }
+
+    return ENTITY_ANIM_LOD_BOUNDS;
+}
+
 /**
  * The function rebuild / renew entity's BV
  */
@@ -34,6 +34,17 @@ struct inventory_node_s;
 
 #define ENTITY_TYPE_SPAWNED                         (0x8000)    // Was spawned.
 
+/*
+ * ANIMATION LOD: how often bones pose is rebuilt
+ */
+#define ENTITY_ANIM_LOD_FULL                        (0)         // Every frame.
+#define ENTITY_ANIM_LOD_REDUCED                     (1)         // Once per ENTITY_ANIM_LOD_PERIOD.
+#define ENTITY_ANIM_LOD_BOUNDS                      (2)         // Root and bounding box only.
+
+#define ENTITY_ANIM_LOD_PERIOD                      (1.0f / 15.0f)
+#define ENTITY_ANIM_LOD_NEAR_DIST                   (8192.0f)   // Visible entities closer to camera are fully updated.
+#define ENTITY_ANIM_LOD_INTERACT_DIST               (2048.0f)   // Entities closer to player are fully updated.
+
 /*
  * SURFACE MOVEMENT DIRECTIONS
  */
@@ -129,7 +140,7 @@ struct inventory_node_s;
 #define WEAPON_STATE_FIRE_TO_IDLE               (0x05)
 #define WEAPON_STATE_IDLE_TO_HIDE               (0x06)
 
-typedef void (*collision_callback_t)(struct entity_s *ent, struct collision_node_s *cn);
+typedef void (*collision_callback_t)(struct entity_s *ent, struct collision_node_s *cn, uint32_t count);
 
 // Specific in-game entity structure.
 
@@ -188,6 +199,8 @@ void Entity_UpdateRoomPos(entity_p ent);
 void Entity_MoveToRoom(entity_p entity, struct room_s *new_room);
 
 void Entity_Frame(entity_p entity, float time);  // process frame + trying to change state
+int  Entity_GetAnimLOD(entity_p entity);
+void Entity_UpdatePose(entity_p entity);
 
 void Entity_RebuildBV(entity_p ent);
 void Entity_UpdateTransform(entity_p entity);
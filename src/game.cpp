@@ -608,6 +608,7 @@ void Game_Frame(float time)
 
     // In game mode
     Script_DoTasks(engine_lua, time);
+    World_UpdateSectorsOccupancy();
 
     // This must be called EVERY frame to max out smoothness.
     // Includes animations, camera movement, and so on.
@@ -732,6 +733,11 @@ void Game_Frame(float time)
 
     World_IterateAllEntities(Game_UpdateEntity, NULL);
 
+    {
+        room_p physics_seeds[2] = {(player) ? (player->self->room) : (NULL), engine_camera.current_room};
+        World_UpdatePhysicsActivity(physics_seeds, 2);
+    }
+    Ragdoll_SetLodOrigin(engine_camera.gl_transform + 12);
     Physics_StepSimulation(time);
 
     Controls_RefreshStates();
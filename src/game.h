@@ -31,6 +31,7 @@ void Game_StopFlyBy();
 
 void Cam_PlayFlyBy(struct camera_state_s *cam_state, float time);
 void Cam_FollowEntity(struct camera_s *cam, struct camera_state_s *cam_state, struct entity_s *ent);
+void Cam_ClearCollisionCache();
 
 #endif
 
@@ -16,6 +16,143 @@
 #include "character_controller.h"
 
 
+/*
+ * Camera collision keeps the last collision free distance and contact normal:
+ * camera comes in at once, but goes back out smoothly. Usually it is one
+ * sweep from the target straight to the desired position against the cached
+ * static geometry around; the full per offset sweeps are used only when the
+ * cache can not answer (moving objects near, static geometry changed).
+ */
+#define CAM_CACHE_MARGIN            (1024.0f)
+#define CAM_RECOVER_SPEED           (2048.0f)                                   // units per second
+#define CAM_PUSH_FADE_SPEED         (256.0f)
+
+static struct
+{
+    physics_sweep_cache_t       cache;
+    float                       safe_dist;                                      // collision free part of the sweep
+    float                       normal[3];                                      // last contact normal
+    float                       push;                                           // offset along normal, fades after contact
+}cam_collision;
+
+
+static void Cam_MoveBack(struct camera_s *cam, struct camera_state_s *cam_state, float cam_pos[3])
+{
+    if(cam_state->state == CAMERA_STATE_LOOK_AT)
+    {
+        entity_p target = World_GetEntityByID(cam_state->target_id);
+        if(target && target != World_GetPlayer())
+        {
+            float dir2d[2], dist;
+            dir2d[0] = target->transform[12 + 0] - cam->gl_transform[12 + 0];
+            dir2d[1] = target->transform[12 + 1] - cam->gl_transform[12 + 1];
+            dist = control_states.cam_distance / sqrtf(dir2d[0] * dir2d[0] + dir2d[1] * dir2d[1]);
+            cam_pos[0] -= dir2d[0] * dist;
+            cam_pos[1] -= dir2d[1] * dist;
+        }
+    }
+    else
+    {
+        cam_pos[0] += sinf(control_states.cam_angles[0]) * control_states.cam_distance;
+        cam_pos[1] -= cosf(control_states.cam_angles[0]) * control_states.cam_distance;
+    }
+}
+
+
+static void Cam_FullCollision(struct camera_s *cam, struct camera_state_s *cam_state, struct entity_s *ent, float cam_pos[3], int16_t filter, float test_r)
+{
+    float cameraFrom[3], cameraTo[3];
+    collision_result_t cb;
+
+    vec3_copy(cameraFrom, cam_pos);
+    cam_pos[2] += 2.0f * cam_state->entity_offset_z;
+    vec3_copy(cameraTo, cam_pos);
+    if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
+    {
+        vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
+    }
+
+    if(cam_state->entity_offset_x != 0.0f)
+    {
+        vec3_copy(cameraFrom, cam_pos);
+        cam_pos[0] += cam_state->entity_offset_x * cam->gl_transform[0 + 0];
+        cam_pos[1] += cam_state->entity_offset_x * cam->gl_transform[0 + 1];
+        cam_pos[2] += cam_state->entity_offset_x * cam->gl_transform[0 + 2];
+        vec3_copy(cameraTo, cam_pos);
+        if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
+        {
+            vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
+        }
+    }
+
+    vec3_copy(cameraFrom, cam_pos);
+    Cam_MoveBack(cam, cam_state, cam_pos);
+    vec3_copy(cameraTo, cam_pos);
+    if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
+    {
+        vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
+    }
+}
+
+
+static int Cam_CachedCollision(struct camera_s *cam, struct camera_state_s *cam_state, struct entity_s *ent, float cam_pos[3], int16_t filter, float test_r)
+{
+    float from[3], to[3], dir[3], len, dist;
+    collision_result_t cb;
+
+    vec3_copy(from, cam_pos);
+    vec3_copy(to, cam_pos);
+    to[2] += 2.0f * cam_state->entity_offset_z;
+    vec3_add_mul(to, to, cam->gl_transform + 0, cam_state->entity_offset_x);
+    Cam_MoveBack(cam, cam_state, to);
+
+    if(!Physics_SweepCacheCovers(&cam_collision.cache, from, to, test_r, ent->self, filter))
+    {
+        float bb_min[3], bb_max[3];
+        for(int i = 0; i < 3; i++)
+        {
+            bb_min[i] = ((from[i] < to[i]) ? (from[i]) : (to[i])) - CAM_CACHE_MARGIN;
+            bb_max[i] = ((from[i] > to[i]) ? (from[i]) : (to[i])) + CAM_CACHE_MARGIN;
+        }
+        Physics_SweepCacheBuild(&cam_collision.cache, bb_min, bb_max, ent->self, filter);
+    }
+    if(!Physics_SphereTestCached(&cam_collision.cache, &cb, from, to, test_r, ent->self, filter))
+    {
+        return 0;                                                               // moving objects near or cache failed here
+    }
+
+    vec3_sub(dir, to, from);
+    len = vec3_abs(dir);
+    dist = (cb.hit) ? (cb.fraction * len) : (len);
+    cam_collision.safe_dist += CAM_RECOVER_SPEED * engine_frame_time;
+    cam_collision.safe_dist = (cam_collision.safe_dist < dist) ? (cam_collision.safe_dist) : (dist);
+    if(cb.hit)
+    {
+        vec3_copy(cam_collision.normal, cb.normale);
+        cam_collision.push = 1.5f * test_r;                                     // sphere centre is already test_r off the surface
+    }
+    else
+    {
+        cam_collision.push -= CAM_PUSH_FADE_SPEED * engine_frame_time;
+        cam_collision.push = (cam_collision.push > 0.0f) ? (cam_collision.push) : (0.0f);
+    }
+
+    if(len > 0.0f)
+    {
+        vec3_add_mul(cam_pos, from, dir, cam_collision.safe_dist / len);
+    }
+    vec3_add_mul(cam_pos, cam_pos, cam_collision.normal, cam_collision.push);
+
+    return 1;
+}
+
+
+void Cam_ClearCollisionCache()
+{
+    Physics_SweepCacheClear(&cam_collision.cache);
+}
+
+
 void Cam_PlayFlyBy(struct camera_state_s *cam_state, float time)
 {
     const float max_time = cam_state->flyby->pos_x->base_points_count - 1;
@@ -38,7 +175,6 @@ void Cam_PlayFlyBy(struct camera_state_s *cam_state, float time)
 void Cam_FollowEntity(struct camera_s *cam, struct camera_state_s *cam_state, struct entity_s *ent)
 {
     float cam_pos[3], cameraFrom[3], cameraTo[3];
-    collision_result_t cb;
     const int16_t filter = COLLISION_GROUP_STATIC_ROOM | COLLISION_GROUP_STATIC_OBLECT | COLLISION_GROUP_KINEMATIC;
     const float test_r = 16.0f;
 
@@ -149,49 +285,11 @@ void Cam_FollowEntity(struct camera_s *cam, struct camera_state_s *cam_state, st
     }*/
 
     vec3_copy(cameraFrom, cam_pos);
-    cam_pos[2] += 2.0f * cam_state->entity_offset_z;
-    vec3_copy(cameraTo, cam_pos);
-    if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
-    {
-        vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
-    }
-
-    if(cam_state->entity_offset_x != 0.0f)
-    {
-        vec3_copy(cameraFrom, cam_pos);
-        cam_pos[0] += cam_state->entity_offset_x * cam->gl_transform[0 + 0];
-        cam_pos[1] += cam_state->entity_offset_x * cam->gl_transform[0 + 1];
-        cam_pos[2] += cam_state->entity_offset_x * cam->gl_transform[0 + 2];
-        vec3_copy(cameraTo, cam_pos);
-        if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
-        {
-            vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
-        }
-    }
-
-    vec3_copy(cameraFrom, cam_pos);
-    if(cam_state->state == CAMERA_STATE_LOOK_AT)
-    {
-        entity_p target = World_GetEntityByID(cam_state->target_id);
-        if(target && target != World_GetPlayer())
-        {
-            float dir2d[2], dist;
-            dir2d[0] = target->transform[12 + 0] - cam->gl_transform[12 + 0];
-            dir2d[1] = target->transform[12 + 1] - cam->gl_transform[12 + 1];
-            dist = control_states.cam_distance / sqrtf(dir2d[0] * dir2d[0] + dir2d[1] * dir2d[1]);
-            cam_pos[0] -= dir2d[0] * dist;
-            cam_pos[1] -= dir2d[1] * dist;
-        }
-    }
-    else
-    {
-        cam_pos[0] += sinf(control_states.cam_angles[0]) * control_states.cam_distance;
-        cam_pos[1] -= cosf(control_states.cam_angles[0]) * control_states.cam_distance;
-    }
-    vec3_copy(cameraTo, cam_pos);
-    if(Physics_SphereTest(&cb, cameraFrom, cameraTo, test_r, ent->self, filter))
+    if(!Cam_CachedCollision(cam, cam_state, ent, cam_pos, filter, test_r))
     {
-        vec3_add_mul(cam_pos, cb.point, cb.normale, 2.5f * test_r);
+        Cam_FullCollision(cam, cam_state, ent, cam_pos, filter, test_r);
+        cam_collision.safe_dist = vec3_dist(cameraFrom, cam_pos);
+        cam_collision.push = 0.0f;
     }
 
     //Update cam pos
@@ -6,6 +6,7 @@
 #include "../core/gl_util.h"
 #include "../core/gl_font.h"
 #include "../core/gl_text.h"
+#include "../core/gl_stream.h"
 #include "../core/system.h"
 #include "../core/console.h"
 #include "../core/vmath.h"
@@ -29,7 +30,6 @@
 
 gui_ProgressBar     Bar[BAR_LASTINDEX];
 static GLuint       crosshairBuffer = 0;
-static GLuint       rectBuffer = 0;
 static GLuint       load_screen_tex = 0;
 GLuint      backgroundBuffer = 0;
 GLfloat     guiProjectionMatrix[16];
@@ -46,7 +46,6 @@ void Gui_Init()
 
     qglGenBuffersARB(1, &crosshairBuffer);
     qglGenBuffersARB(1, &backgroundBuffer);
-    qglGenBuffersARB(1, &rectBuffer);
     qglGenTextures(1, &load_screen_tex);
     Gui_FillCrosshairBuffer();
     Gui_FillBackgroundBuffer();
@@ -185,7 +184,6 @@ void Gui_Destroy()
     qglDeleteTextures(1, &load_screen_tex);
     qglDeleteBuffersARB(1, &crosshairBuffer);
     qglDeleteBuffersARB(1, &backgroundBuffer);
-    qglDeleteBuffersARB(1, &rectBuffer);
 }
 
 
@@ -516,9 +514,13 @@ void Gui_DrawRect(const GLfloat &x, const GLfloat &y,
     GLfloat y0 = y + height;
     GLfloat x1 = x + width;
     GLfloat y1 = y;
-    GLfloat *v, rectArray[32];
+    uint32_t offset;
+    GLfloat *v = (GLfloat*)GLStream_Map(sizeof(GLfloat[32]), &offset);
 
-    v = rectArray;
+    if(v == NULL)
+    {
+        return;
+    }
    *v++ = x0; *v++ = y0;
    *v++ = 0.0f; *v++ = 0.0f;
     vec4_copy(v, colorUpperLeft);
@@ -537,6 +539,7 @@ void Gui_DrawRect(const GLfloat &x, const GLfloat &y,
    *v++ = x0; *v++ = y1;
    *v++ = 0.0f; *v++ = 1.0f;
     vec4_copy(v, colorLowerLeft);
+    GLStream_Unmap();
 
     if(qglIsTexture(texture))
     {
@@ -546,11 +549,9 @@ void Gui_DrawRect(const GLfloat &x, const GLfloat &y,
     {
         BindWhiteTexture();
     }
-    qglBindBufferARB(GL_ARRAY_BUFFER, rectBuffer);
-    qglBufferDataARB(GL_ARRAY_BUFFER, sizeof(GLfloat[32]), rectArray, GL_DYNAMIC_DRAW);
-    qglVertexPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)0);
-    qglTexCoordPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)sizeof(GLfloat[2]));
-    qglColorPointer(4, GL_FLOAT, 8 * sizeof(GLfloat), (void *)sizeof(GLfloat[4]));
+    qglVertexPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)((size_t)offset));
+    qglTexCoordPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)(offset + sizeof(GLfloat[2])));
+    qglColorPointer(4, GL_FLOAT, 8 * sizeof(GLfloat), (void *)(offset + sizeof(GLfloat[4])));
     qglDrawArrays(GL_TRIANGLE_FAN, 0, 4);
 }
 
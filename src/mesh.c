@@ -25,10 +25,10 @@ void BaseMesh_Clear(base_mesh_p mesh)
         mesh->vbo_animated_vertex_array = 0;
     }
     
-    if(qglIsBufferARB(mesh->vbo_animated_texcoord_array))
+    if(qglIsBufferARB(mesh->vbo_animated_frame_array))
     {
-        qglDeleteBuffersARB(1, &mesh->vbo_animated_texcoord_array);
-        mesh->vbo_animated_texcoord_array = 0;
+        qglDeleteBuffersARB(1, &mesh->vbo_animated_frame_array);
+        mesh->vbo_animated_frame_array = 0;
     }
 
     mesh->transparency_polygons = NULL;
@@ -148,7 +148,7 @@ void BaseMesh_GenVBO(struct base_mesh_s *mesh)
 {
     mesh->vbo_vertex_array = 0;
     mesh->vbo_animated_vertex_array = 0;
-    mesh->vbo_animated_texcoord_array = 0;
+    mesh->vbo_animated_frame_array = 0;
     
     /// now, begin VBO filling!
     qglGenBuffersARB(1, &mesh->vbo_vertex_array);
@@ -169,10 +169,21 @@ void BaseMesh_GenVBO(struct base_mesh_s *mesh)
         qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(vertex_t), mesh->animated_vertices, GL_STATIC_DRAW);
         free(mesh->animated_vertices);
         mesh->animated_vertices = NULL;
-        // Prepare empty buffer for tex coords
-        qglGenBuffersARB(1, &mesh->vbo_animated_texcoord_array);
-        qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
-        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), 0, GL_STREAM_DRAW);
+        // Static animation frame info; actual tex coords are calculated by vertex shader
+        GLfloat *frames = (GLfloat*)malloc(mesh->animated_vertex_count * sizeof(GLfloat [2]));
+        GLfloat *data = frames;
+        for(polygon_p p = mesh->animated_polygons; p; p = p->next)
+        {
+            for(uint16_t i = 0; i < p->vertex_count; i++, data += 2)
+            {
+                data[0] = p->anim_id;
+                data[1] = p->frame_offset;
+            }
+        }
+        qglGenBuffersARB(1, &mesh->vbo_animated_frame_array);
+        qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_frame_array);
+        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), frames, GL_STATIC_DRAW);
+        free(frames);
     }
     qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
     qglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
@@ -53,7 +53,7 @@ typedef struct base_mesh_s
 
     GLuint                  vbo_vertex_array;
     GLuint                  vbo_animated_vertex_array;
-    GLuint                  vbo_animated_texcoord_array;
+    GLuint                  vbo_animated_frame_array;                           // (anim_id, frame_offset) per animated vertex
 }base_mesh_t, *base_mesh_p;
 
 
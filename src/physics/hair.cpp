@@ -1,13 +1,652 @@
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 extern "C" {
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
 }
 
+#include "../core/gl_util.h"
+#include "../core/vmath.h"
+#include "../world.h"
+#include "../room.h"
+#include "../mesh.h"
+#include "../skeletal_model.h"
+#include "physics.h"
 #include "hair.h"
 
+/*
+ * Hair strand is a verlet particles chain: the root is pinned to the head,
+ * every element lies between two particles. Constraints are solved in red /
+ * black order (even segments, then odd ones), so each pass has no shared
+ * particles and goes 4 segments at a time over SoA arrays. Collisions: owner
+ * bones spheres and nearest room planes (floor, ceiling, walls). All strands
+ * are solved on a worker thread while Bullet steps the world.
+ */
+#define HAIR_PARTICLES_MAX          (16)                                        // root included
+#define HAIR_PARTICLES_PADDED       (HAIR_PARTICLES_MAX + 8)                    // SIMD loads past the tail
+#define HAIR_SPHERES_MAX            (32)
+#define HAIR_PLANES_MAX             (6)
+#define HAIR_ITERATIONS             (4)
+#define HAIR_SUBSTEP                (1.0f / 60.0f)
+#define HAIR_SUBSTEPS_MAX           (4)
+#define HAIR_PLANE_MARGIN           (8.0f)
+
+typedef struct hair_s
+{
+    struct physics_data_s      *physics;                                        // owner, valid in the frame it is updated
+    struct room_s              *room;
+    uint32_t                    owner_body;
+    uint16_t                    element_count;
+    uint16_t                    particles_count;
+    uint16_t                    active : 1;                                     // updated this frame
+    uint16_t                    inited : 1;
+    uint16_t                    : 14;
+    struct base_mesh_s        **meshes;
+    float                      (*transforms)[16];                               // elements in world space
+
+    float                       x[HAIR_PARTICLES_PADDED]            __attribute__((aligned(16)));
+    float                       y[HAIR_PARTICLES_PADDED]            __attribute__((aligned(16)));
+    float                       z[HAIR_PARTICLES_PADDED]            __attribute__((aligned(16)));
+    float                       px[HAIR_PARTICLES_PADDED]           __attribute__((aligned(16)));
+    float                       py[HAIR_PARTICLES_PADDED]           __attribute__((aligned(16)));
+    float                       pz[HAIR_PARTICLES_PADDED]           __attribute__((aligned(16)));
+    float                       inv_mass[HAIR_PARTICLES_PADDED]     __attribute__((aligned(16)));
+    float                       rest_length[HAIR_PARTICLES_PADDED]  __attribute__((aligned(16)));   // segment i: particles i, i + 1
+    float                       stiffness[HAIR_PARTICLES_PADDED]    __attribute__((aligned(16)));   // 0 for padding segments
+
+    float                       head_offset[3];
+    float                       damping;
+    float                       friction;
+    float                       last_dt;
+
+    uint16_t                    bones_count;
+    float                      (*bone_spheres)[4];                              // centre and radius in bone space
+
+    // frame input, gathered on main thread
+    float                       head_tr[16];
+    float                       gravity[3];
+    float                       time;
+    uint16_t                    spheres_count;
+    uint16_t                    planes_count;
+    float                       spheres[HAIR_SPHERES_MAX][4];
+    float                       planes[HAIR_PLANES_MAX][4];                     // n * p + d >= 0 is free space
+}hair_t, *hair_p;
+
+static struct
+{
+    hair_p                     *hairs;
+    uint32_t                    hairs_count;
+    uint32_t                    hairs_size;
+    uint32_t                    active_count;
+    SDL_Thread                 *thread;
+    SDL_sem                    *start;
+    SDL_sem                    *done;
+    bool                        started;
+    bool                        exit;
+}hair_solver;
+
+
+static void Hair_Register(hair_p hair)
+{
+    if(hair_solver.hairs_count >= hair_solver.hairs_size)
+    {
+        uint32_t new_size = (hair_solver.hairs_size > 0) ? (hair_solver.hairs_size * 2) : (8);
+        hair_p *new_hairs = (hair_p*)realloc(hair_solver.hairs, new_size * sizeof(hair_p));
+        if(new_hairs == NULL)
+        {
+            return;
+        }
+        hair_solver.hairs = new_hairs;
+        hair_solver.hairs_size = new_size;
+    }
+    hair_solver.hairs[hair_solver.hairs_count++] = hair;
+}
+
+
+static void Hair_Unregister(hair_p hair)
+{
+    for(uint32_t i = 0; i < hair_solver.hairs_count; i++)
+    {
+        if(hair_solver.hairs[i] == hair)
+        {
+            hair_solver.hairs[i] = hair_solver.hairs[--hair_solver.hairs_count];
+            break;
+        }
+    }
+}
+
+
+struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics, struct ss_bone_frame_s *bf)
+{
+    // No setup or parent to link to - bypass function.
+    if(!physics || !setup || !bf || (setup->link_body >= (uint32_t)Physics_GetBodiesCount(physics)))
+    {
+        return NULL;
+    }
+
+    skeletal_model_p model = World_GetModelByID(setup->model_id);
+    if((!model) || (model->mesh_count == 0))
+    {
+        return NULL;
+    }
+
+    hair_p hair = (hair_p)calloc(1, sizeof(hair_t));
+    hair->physics = physics;
+    hair->owner_body = setup->link_body;
+    hair->element_count = (model->mesh_count < HAIR_PARTICLES_MAX) ? (model->mesh_count) : (HAIR_PARTICLES_MAX - 1);
+    hair->particles_count = hair->element_count + 1;
+    hair->meshes = (struct base_mesh_s**)malloc(hair->element_count * sizeof(struct base_mesh_s*));
+    hair->transforms = (float(*)[16])malloc(hair->element_count * 16 * sizeof(float));
+    vec3_copy(hair->head_offset, setup->head_offset);
+    hair->damping = (setup->hair_damping[0] < 0.0f) ? (0.0f) : ((setup->hair_damping[0] > 1.0f) ? (1.0f) : (setup->hair_damping[0]));
+    hair->friction = (setup->hair_friction < 0.0f) ? (0.0f) : ((setup->hair_friction > 1.0f) ? (1.0f) : (setup->hair_friction));
+
+    // Root is pinned; weights go from root to tail weight, heavier particles move less.
+    float weight_step = (setup->root_weight - setup->tail_weight) / hair->element_count;
+    float current_weight = setup->root_weight;
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        struct base_mesh_s *mesh = model->mesh_tree[i].mesh_base;
+        hair->meshes[i] = mesh;
+        hair->rest_length[i] = fabs(mesh->bb_max[1] - mesh->bb_min[1]) * setup->joint_overlap;
+        hair->stiffness[i] = 1.0f;
+        current_weight -= weight_step;
+        hair->inv_mass[i + 1] = (current_weight > 0.0f) ? (1.0f / current_weight) : (1.0f);
+        Mat4_E_macro(hair->transforms[i]);
+    }
+    hair->inv_mass[0] = 0.0f;
+
+    // Owner bones collision spheres: meshes centres and inner radii.
+    hair->bones_count = (bf->bone_tag_count < HAIR_SPHERES_MAX) ? (bf->bone_tag_count) : (HAIR_SPHERES_MAX);
+    hair->bone_spheres = (float(*)[4])calloc(hair->bones_count, 4 * sizeof(float));
+    for(uint16_t i = 0; i < hair->bones_count; i++)
+    {
+        struct base_mesh_s *mesh = bf->bone_tags[i].mesh_base;
+        if(mesh && (mesh->vertex_count > 0))
+        {
+            float r = 0.5f * (mesh->bb_max[0] - mesh->bb_min[0]);
+            float t = 0.5f * (mesh->bb_max[1] - mesh->bb_min[1]);
+            r = (t < r) ? (t) : (r);
+            t = 0.5f * (mesh->bb_max[2] - mesh->bb_min[2]);
+            r = (t < r) ? (t) : (r);
+            vec3_copy(hair->bone_spheres[i], mesh->centre);
+            hair->bone_spheres[i][3] = r;
+        }
+    }
+
+    Hair_Register(hair);
+    return hair;
+}
+
+
+void Hair_Delete(struct hair_s *hair)
+{
+    if(hair)
+    {
+        Hair_Unregister(hair);
+        free(hair->bone_spheres);
+        free(hair->transforms);
+        free(hair->meshes);
+        free(hair);
+    }
+}
+
+
+void Hair_Update(struct hair_s *hair, struct physics_data_s *physics)
+{
+    if(hair && (hair->element_count > 0))
+    {
+        hair->physics = physics;
+        hair->active = 1;
+    }
+}
+
+
+int Hair_GetElementsCount(struct hair_s *hair)
+{
+    return (hair) ? (hair->element_count) : (0);
+}
+
+
+void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16])
+{
+    Mat4_Copy(tr, hair->transforms[element]);
+    *mesh = hair->meshes[element];
+}
+
+
+static void Hair_AddPlane(hair_p hair, const float n[3], const float point[3])
+{
+    if(hair->planes_count < HAIR_PLANES_MAX)
+    {
+        float *plane = hair->planes[hair->planes_count++];
+        vec3_copy(plane, n);
+        plane[3] = -vec3_dot(n, point);
+    }
+}
+
+
+static void Hair_AddSectorSurface(hair_p hair, float corners[4][3], float up)
+{
+    // quad normal from diagonals cross product, through the corners centre
+    float d0[3], d1[3], n[3], centre[3], t;
+    vec3_sub(d0, corners[2], corners[0]);
+    vec3_sub(d1, corners[1], corners[3]);
+    vec3_cross(n, d0, d1);
+    t = vec3_abs(n);
+    if(t > 0.001f)
+    {
+        t = ((n[2] * up) > 0.0f) ? (1.0f / t) : (-1.0f / t);
+        vec3_mul_scalar(n, n, t);
+        vec3_add(centre, corners[0], corners[1]);
+        vec3_add(centre, centre, corners[2]);
+        vec3_add(centre, centre, corners[3]);
+        vec3_mul_scalar(centre, centre, 0.25f);
+        Hair_AddPlane(hair, n, centre);
+    }
+}
+
+/*
+ * Floor and ceiling of the head's sector column and the walls of its sides:
+ * sides without a passable neighbour at the head height.
+ */
+static void Hair_GatherPlanes(hair_p hair, float pos[3])
+{
+    room_sector_p rs;
+
+    hair->planes_count = 0;
+    hair->room = World_FindRoomByPosCogerrence(pos, hair->room);
+    rs = (hair->room) ? (Room_GetSectorXYZ(hair->room, pos)) : (NULL);
+    if(rs)
+    {
+        room_sector_p floor_rs = Sector_GetLowest(rs);
+        room_sector_p ceiling_rs = Sector_GetHighest(rs);
+        const float dirs[4][3] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}};
+
+        Hair_AddSectorSurface(hair, floor_rs->floor_corners, 1.0f);
+        Hair_AddSectorSurface(hair, ceiling_rs->ceiling_corners, -1.0f);
+        for(int i = 0; i < 4; i++)
+        {
+            room_sector_p next = Sector_GetNextSector(rs, (float*)dirs[i]);
+            next = (next != rs) ? (Sector_GetPortalSectorTargetRaw(next)) : (NULL);
+            if(!next || (next->floor_penetration_config == TR_PENETRATION_CONFIG_WALL) ||
+               (next->floor > pos[2]) || (next->ceiling < pos[2]))
+            {
+                float n[3], point[3];
+                vec3_mul_scalar(n, dirs[i], -1.0f);
+                vec3_add_mul(point, rs->pos, dirs[i], 0.5f * TR_METERING_SECTORSIZE);
+                Hair_AddPlane(hair, n, point);
+            }
+        }
+    }
+}
+
+
+static void Hair_PlaceParticles(hair_p hair, float root[3])
+{
+    float z = root[2];
+    for(uint16_t i = 0; i < hair->particles_count; i++)
+    {
+        hair->x[i] = hair->px[i] = root[0];
+        hair->y[i] = hair->py[i] = root[1];
+        hair->z[i] = hair->pz[i] = z;
+        z -= hair->rest_length[i];
+    }
+    hair->inited = 1;
+}
+
+/*
+ * Main thread part: owner bodies are taken from physics, so the frame input
+ * is consistent with the entity already animated in this frame.
+ */
+static void Hair_GatherInput(hair_p hair, float time)
+{
+    float tr[16], root[3], total_length = 0.0f;
+    int bodies_count = Physics_GetBodiesCount(hair->physics);
+
+    Physics_GetBodyWorldTransform(hair->physics, hair->head_tr, hair->owner_body);
+    Mat4_vec3_mul(root, hair->head_tr, hair->head_offset);
+    Physics_GetGravity(hair->gravity);
+    hair->time = time;
+
+    hair->spheres_count = 0;
+    for(uint16_t i = 0; (i < hair->bones_count) && (i < bodies_count); i++)
+    {
+        if(hair->bone_spheres[i][3] > 1.0f)
+        {
+            float *sphere = hair->spheres[hair->spheres_count++];
+            Physics_GetBodyWorldTransform(hair->physics, tr, i);
+            Mat4_vec3_mul(sphere, tr, hair->bone_spheres[i]);
+            sphere[3] = hair->bone_spheres[i][3];
+        }
+    }
+    Hair_GatherPlanes(hair, root);
+
+    // first frame or teleport: start from hanging down chain
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        total_length += hair->rest_length[i];
+    }
+    if(!hair->inited || (fabs(hair->x[0] - root[0]) + fabs(hair->y[0] - root[1]) + fabs(hair->z[0] - root[2]) > 2.0f * total_length + TR_METERING_STEP))
+    {
+        Hair_PlaceParticles(hair, root);
+    }
+    hair->x[0] = hair->px[0] = root[0];
+    hair->y[0] = hair->py[0] = root[1];
+    hair->z[0] = hair->pz[0] = root[2];
+}
+
+
+static void Hair_Integrate(hair_p hair, float dt)
+{
+    float damp = powf(1.0f - hair->damping, dt);
+    float ratio = (hair->last_dt > 0.0f) ? (dt / hair->last_dt) : (1.0f);
+    float gx = hair->gravity[0] * dt * dt;
+    float gy = hair->gravity[1] * dt * dt;
+    float gz = hair->gravity[2] * dt * dt;
+
+    damp *= ratio;
+    for(uint16_t i = 1; i < hair->particles_count; i++)
+    {
+        float x = hair->x[i], y = hair->y[i], z = hair->z[i];
+        hair->x[i] += (x - hair->px[i]) * damp + gx;
+        hair->y[i] += (y - hair->py[i]) * damp + gy;
+        hair->z[i] += (z - hair->pz[i]) * damp + gz;
+        hair->px[i] = x;
+        hair->py[i] = y;
+        hair->pz[i] = z;
+    }
+    hair->last_dt = dt;
+}
+
+/*
+ * Distance constraints of segments first, first + 2, ...; 4 segments per
+ * step: 8 particles are split into even (a) and odd (b) lanes.
+ */
+static void Hair_SolveSegments(hair_p hair, int first)
+{
+    int segments_count = hair->particles_count - 1;
+#ifdef __SSE__
+    const __m128 eps = _mm_set1_ps(0.0001f);
+    for(int i = first; i < segments_count; i += 8)
+    {
+        __m128 x0 = _mm_loadu_ps(hair->x + i), x1 = _mm_loadu_ps(hair->x + i + 4);
+        __m128 y0 = _mm_loadu_ps(hair->y + i), y1 = _mm_loadu_ps(hair->y + i + 4);
+        __m128 z0 = _mm_loadu_ps(hair->z + i), z1 = _mm_loadu_ps(hair->z + i + 4);
+        __m128 w0 = _mm_loadu_ps(hair->inv_mass + i), w1 = _mm_loadu_ps(hair->inv_mass + i + 4);
+        __m128 r0 = _mm_loadu_ps(hair->rest_length + i), r1 = _mm_loadu_ps(hair->rest_length + i + 4);
+        __m128 k0 = _mm_loadu_ps(hair->stiffness + i), k1 = _mm_loadu_ps(hair->stiffness + i + 4);
+
+        __m128 ax = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(2, 0, 2, 0)), bx = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 ay = _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(2, 0, 2, 0)), by = _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 az = _mm_shuffle_ps(z0, z1, _MM_SHUFFLE(2, 0, 2, 0)), bz = _mm_shuffle_ps(z0, z1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 wa = _mm_shuffle_ps(w0, w1, _MM_SHUFFLE(2, 0, 2, 0)), wb = _mm_shuffle_ps(w0, w1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 rest = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 k = _mm_shuffle_ps(k0, k1, _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128 dx = _mm_sub_ps(bx, ax), dy = _mm_sub_ps(by, ay), dz = _mm_sub_ps(bz, az);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 denom = _mm_max_ps(_mm_mul_ps(len, _mm_add_ps(wa, wb)), eps);
+        __m128 s = _mm_div_ps(_mm_mul_ps(k, _mm_sub_ps(len, rest)), denom);
+        __m128 sa = _mm_mul_ps(s, wa), sb = _mm_mul_ps(s, wb);
+
+        ax = _mm_add_ps(ax, _mm_mul_ps(sa, dx));
+        ay = _mm_add_ps(ay, _mm_mul_ps(sa, dy));
+        az = _mm_add_ps(az, _mm_mul_ps(sa, dz));
+        bx = _mm_sub_ps(bx, _mm_mul_ps(sb, dx));
+        by = _mm_sub_ps(by, _mm_mul_ps(sb, dy));
+        bz = _mm_sub_ps(bz, _mm_mul_ps(sb, dz));
+
+        _mm_storeu_ps(hair->x + i, _mm_unpacklo_ps(ax, bx));
+        _mm_storeu_ps(hair->x + i + 4, _mm_unpackhi_ps(ax, bx));
+        _mm_storeu_ps(hair->y + i, _mm_unpacklo_ps(ay, by));
+        _mm_storeu_ps(hair->y + i + 4, _mm_unpackhi_ps(ay, by));
+        _mm_storeu_ps(hair->z + i, _mm_unpacklo_ps(az, bz));
+        _mm_storeu_ps(hair->z + i + 4, _mm_unpackhi_ps(az, bz));
+    }
+#else
+    for(int i = first; i < segments_count; i += 2)
+    {
+        float dx = hair->x[i + 1] - hair->x[i];
+        float dy = hair->y[i + 1] - hair->y[i];
+        float dz = hair->z[i + 1] - hair->z[i];
+        float len = sqrtf(dx * dx + dy * dy + dz * dz);
+        float denom = len * (hair->inv_mass[i] + hair->inv_mass[i + 1]);
+        float s = (denom > 0.0001f) ? (hair->stiffness[i] * (len - hair->rest_length[i]) / denom) : (0.0f);
+        float sa = s * hair->inv_mass[i], sb = s * hair->inv_mass[i + 1];
+        hair->x[i] += sa * dx;
+        hair->y[i] += sa * dy;
+        hair->z[i] += sa * dz;
+        hair->x[i + 1] -= sb * dx;
+        hair->y[i + 1] -= sb * dy;
+        hair->z[i + 1] -= sb * dz;
+    }
+#endif
+}
+
+
+static void Hair_Collide(hair_p hair)
+{
+    for(uint16_t j = 0; j < hair->spheres_count; j++)
+    {
+        const float *sphere = hair->spheres[j];
+        for(uint16_t i = 1; i < hair->particles_count; i++)
+        {
+            float dx = hair->x[i] - sphere[0];
+            float dy = hair->y[i] - sphere[1];
+            float dz = hair->z[i] - sphere[2];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            if((d2 < sphere[3] * sphere[3]) && (d2 > 0.0001f))
+            {
+                float t = sphere[3] / sqrtf(d2) - 1.0f;
+                hair->x[i] += dx * t;
+                hair->y[i] += dy * t;
+                hair->z[i] += dz * t;
+                hair->px[i] += (hair->x[i] - hair->px[i]) * hair->friction;
+                hair->py[i] += (hair->y[i] - hair->py[i]) * hair->friction;
+                hair->pz[i] += (hair->z[i] - hair->pz[i]) * hair->friction;
+            }
+        }
+    }
+
+    for(uint16_t j = 0; j < hair->planes_count; j++)
+    {
+        const float *plane = hair->planes[j];
+        for(uint16_t i = 1; i < hair->particles_count; i++)
+        {
+            float dist = plane[0] * hair->x[i] + plane[1] * hair->y[i] + plane[2] * hair->z[i] + plane[3];
+            if(dist < HAIR_PLANE_MARGIN)
+            {
+                float t = HAIR_PLANE_MARGIN - dist;
+                hair->x[i] += plane[0] * t;
+                hair->y[i] += plane[1] * t;
+                hair->z[i] += plane[2] * t;
+                hair->px[i] += (hair->x[i] - hair->px[i]) * hair->friction;
+                hair->py[i] += (hair->y[i] - hair->py[i]) * hair->friction;
+                hair->pz[i] += (hair->z[i] - hair->pz[i]) * hair->friction;
+            }
+        }
+    }
+}
+
+/*
+ * Element i: origin in particle i, Y axis to particle i + 1 (as the meshes
+ * are modelled), X is the head X axis made orthogonal.
+ */
+static void Hair_UpdateTransforms(hair_p hair)
+{
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        float *tr = hair->transforms[i];
+        float *ax = tr + 0, *ay = tr + 4, *az = tr + 8, t;
+
+        ay[0] = hair->x[i + 1] - hair->x[i];
+        ay[1] = hair->y[i + 1] - hair->y[i];
+        ay[2] = hair->z[i + 1] - hair->z[i];
+        t = vec3_abs(ay);
+        if(t < 0.001f)
+        {
+            vec3_copy(ay, hair->head_tr + 4);
+            t = vec3_abs(ay);
+        }
+        vec3_mul_scalar(ay, ay, 1.0f / t);
+
+        vec3_copy(ax, hair->head_tr + 0);
+        t = vec3_dot(ax, ay);
+        if(fabs(t) > 0.99f)
+        {
+            vec3_copy(ax, hair->head_tr + 8);
+            t = vec3_dot(ax, ay);
+        }
+        vec3_add_mul(ax, ax, ay, -t);
+        vec3_norm(ax, t);
+        vec3_cross(az, ax, ay);
+
+        tr[3] = tr[7] = tr[11] = 0.0f;
+        tr[12] = hair->x[i];
+        tr[13] = hair->y[i];
+        tr[14] = hair->z[i];
+        tr[15] = 1.0f;
+    }
+}
+
+
+static void Hair_Solve(hair_p hair)
+{
+    int steps = (int)ceilf(hair->time / HAIR_SUBSTEP);
+    steps = (steps < 1) ? (1) : ((steps > HAIR_SUBSTEPS_MAX) ? (HAIR_SUBSTEPS_MAX) : (steps));
+
+    if(hair->time > 0.0f)
+    {
+        float dt = hair->time / steps;
+        for(int s = 0; s < steps; s++)
+        {
+            Hair_Integrate(hair, dt);
+            for(int it = 0; it < HAIR_ITERATIONS; it++)
+            {
+                Hair_SolveSegments(hair, 0);
+                Hair_SolveSegments(hair, 1);
+                Hair_Collide(hair);
+            }
+        }
+    }
+    Hair_UpdateTransforms(hair);
+}
+
+
+static void Hair_SolveAll()
+{
+    for(uint32_t i = 0; i < hair_solver.hairs_count; i++)
+    {
+        if(hair_solver.hairs[i]->active)
+        {
+            Hair_Solve(hair_solver.hairs[i]);
+            hair_solver.hairs[i]->active = 0;
+        }
+    }
+}
+
+
+static int Hair_ThreadFunc(void *data)
+{
+    while(true)
+    {
+        SDL_SemWait(hair_solver.start);
+        if(hair_solver.exit)
+        {
+            break;
+        }
+        Hair_SolveAll();
+        SDL_SemPost(hair_solver.done);
+    }
+
+    return 0;
+}
+
+
+void Hair_StartSimulation(float time)
+{
+    hair_solver.active_count = 0;
+    for(uint32_t i = 0; i < hair_solver.hairs_count; i++)
+    {
+        hair_p hair = hair_solver.hairs[i];
+        if(hair->active && hair->physics)
+        {
+            Hair_GatherInput(hair, time);
+            hair_solver.active_count++;
+        }
+        else
+        {
+            hair->active = 0;
+        }
+    }
+
+    if(hair_solver.active_count > 0)
+    {
+        if(!hair_solver.started)
+        {
+            hair_solver.started = true;
+            hair_solver.exit = false;
+            hair_solver.start = SDL_CreateSemaphore(0);
+            hair_solver.done = SDL_CreateSemaphore(0);
+            hair_solver.thread = (SDL_GetCPUCount() > 1) ? (SDL_CreateThread(Hair_ThreadFunc, "hair_solver", NULL)) : (NULL);
+        }
+        if(hair_solver.thread)
+        {
+            SDL_SemPost(hair_solver.start);
+        }
+    }
+}
+
+
+void Hair_FinishSimulation()
+{
+    if(hair_solver.active_count > 0)
+    {
+        if(hair_solver.thread)
+        {
+            SDL_SemWait(hair_solver.done);
+        }
+        else
+        {
+            Hair_SolveAll();
+        }
+        hair_solver.active_count = 0;
+    }
+}
+
+
+void Hair_StopSimulation()
+{
+    if(hair_solver.started)
+    {
+        if(hair_solver.thread)
+        {
+            hair_solver.exit = true;
+            SDL_SemPost(hair_solver.start);
+            SDL_WaitThread(hair_solver.thread, NULL);
+            hair_solver.thread = NULL;
+        }
+        SDL_DestroySemaphore(hair_solver.start);
+        SDL_DestroySemaphore(hair_solver.done);
+        hair_solver.start = NULL;
+        hair_solver.done = NULL;
+        hair_solver.started = false;
+    }
+    free(hair_solver.hairs);
+    hair_solver.hairs = NULL;
+    hair_solver.hairs_count = 0;
+    hair_solver.hairs_size = 0;
+}
+
 struct hair_setup_s *Hair_GetSetup(struct lua_State *lua, int stack_pos)
 {
     struct hair_setup_s *hair_setup = NULL;
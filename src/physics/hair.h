@@ -56,6 +56,12 @@ typedef struct hair_setup_s
 }hair_setup_t, *hair_setup_p;
 
 
+// Physics step: gathers updated hairs input and solves them on worker thread
+// until Finish; Stop ends the worker.
+void Hair_StartSimulation(float time);
+void Hair_FinishSimulation();
+void Hair_StopSimulation();
+
 // Gets scripted hair set-up to specified hair set-up structure.
 hair_setup_p Hair_GetSetup(struct lua_State *lua, int stack_pos);
 void Hair_DeleteSetup(hair_setup_p setup);
@@ -22,7 +22,6 @@ typedef struct collision_node_s
     uint16_t                    part_from;
     uint16_t                    part_self;
     struct engine_container_s  *obj;
-    struct collision_node_s    *next;
     float                       penetration[4];  // x, y, z, dist
     float                       point[3];
 }collision_node_t, *collision_node_p;
@@ -49,13 +48,68 @@ typedef struct ghost_shape_s
 }ghost_shape_t, *ghost_shape_p;
 
 
+#define PHYSICS_QUERY_RAY                  (0)
+#define PHYSICS_QUERY_RAY_FILTERED         (1)  // back faces skipped, as Physics_RayTestFiltered
+#define PHYSICS_QUERY_SPHERE               (2)
+
+typedef struct physics_step_info_s
+{
+    float                       step_ms;        // last Physics_StepSimulation wall time
+    uint32_t                    pairs;          // broadphase overlapping pairs
+    uint32_t                    manifolds;      // narrowphase contact manifolds
+    uint32_t                    contacts;       // contact points in manifolds
+    uint32_t                    bodies;         // rigid bodies in world
+    uint32_t                    active_bodies;
+}physics_step_info_t, *physics_step_info_p;
+
+
+typedef struct physics_query_s
+{
+    uint16_t                    type;
+    int16_t                     filter;
+    float                       from[3];
+    float                       to[3];
+    float                       R;              // sphere radius
+    struct engine_container_s  *cont;           // self, and source room for the rooms filter
+    struct collision_result_s   result;
+}physics_query_t, *physics_query_p;
+
+
+/*
+ * Room partitions objects around the bounds, for coherent sweeps repeated each
+ * frame (camera). Static geometry changes (flips, freezing, level reload) and
+ * the room change make cache invalid; objects array grows as needed.
+ */
+typedef struct physics_sweep_cache_s
+{
+    struct physics_object_s   **objects;
+    uint32_t                    objects_count;
+    uint32_t                    objects_size;
+    int16_t                     valid;
+    int16_t                     filter;
+    uint32_t                    revision;
+    struct room_s              *room;
+    float                       bb_min[3];
+    float                       bb_max[3];
+}physics_sweep_cache_t, *physics_sweep_cache_p;
+
+
 struct physics_data_s;
 struct physics_object_s;
 
 /* Common physics functions */
 void Physics_Init();
 void Physics_Destroy();
-void Physics_StepSimulation(float time);
+void Physics_StepSimulation(float time);                                        // also ends the contacts pool frame
+uint32_t Physics_GetHeapAllocations();                                          // Bullet and contacts pool, since start
+void Physics_GetCollisionPoolInfo(uint32_t *size, uint32_t *last_frame_count, uint32_t *last_frame_allocations);
+void Physics_GetStepInfo(struct physics_step_info_s *info);                   // last step state, for benchmarks and debug
+/*
+ * Static collision shapes BVH cache; open while level collision is generated,
+ * End writes the file if something was built or dropped.
+ */
+void Physics_BvhCacheBegin(const char *file_name, const char *level_path);
+void Physics_BvhCacheEnd();
 void Physics_DebugDrawWorld();
 void Physics_CleanUpObjects();
 
@@ -68,6 +122,24 @@ void Physics_SetGravity(float g[3]);
 int  Physics_RayTest(struct collision_result_s *result, float from[3], float to[3], struct engine_container_s *cont, int16_t filter);
 int  Physics_RayTestFiltered(struct collision_result_s *result, float from[3], float to[3], struct engine_container_s *cont, int16_t filter);
 int  Physics_SphereTest(struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter);
+/*
+ * Runs independent ray / sphere queries with one broadphase pass over the
+ * whole batch bounds; results are the same as of the single tests above.
+ * Big batches are spread between worker threads. Returns hits count.
+ */
+int  Physics_QueryBatch(struct physics_query_s *queries, uint32_t count);
+int  Physics_SweepCacheBuild(struct physics_sweep_cache_s *cache, float bb_min[3], float bb_max[3], struct engine_container_s *cont, int16_t filter);
+void Physics_SweepCacheClear(struct physics_sweep_cache_s *cache);
+/*
+ * Cache was built (maybe unsuccessfully) for the current room, static geometry
+ * and filter, and its bounds contain the sweep; if so, rebuilding is useless.
+ */
+int  Physics_SweepCacheCovers(struct physics_sweep_cache_s *cache, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter);
+/*
+ * Sphere test against the cache; returns 0 if cache can not answer (invalid,
+ * sweep out of bounds, non static objects near), so Physics_SphereTest is needed.
+ */
+int  Physics_SphereTestCached(struct physics_sweep_cache_s *cache, struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter);
 
 /* Physics object manipulation functions */
 int  Physics_IsBodyesInited(struct physics_data_s *physics);
@@ -78,7 +150,8 @@ void Physics_SetBodyWorldTransform(struct physics_data_s *physics, float tr[16],
 void Physics_GetGhostWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 void Physics_SetGhostWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 ghost_shape_p Physics_GetGhostShapeInfo(struct physics_data_s *physics, uint16_t index);
-collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics, uint16_t index, int16_t filter);
+// contacts array is valid until the end of the frame; returns contacts count
+uint32_t Physics_GetGhostCurrentCollision(struct physics_data_s *physics, uint16_t index, int16_t filter, struct collision_node_s **nodes);
 
 // Bullet entity rigid body generating.
 void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s *bf);
@@ -90,9 +163,16 @@ void Physics_SetOwnerObject(struct physics_object_s *obj, struct engine_containe
 void Physics_DeleteObject(struct physics_object_s *obj);
 void Physics_EnableObject(struct physics_object_s *obj);
 void Physics_DisableObject(struct physics_object_s *obj);
+/*
+ * Frozen objects are out of the dynamics world (no broadphase, solver, ray
+ * tests), but keep all state; enable / disable calls on frozen object only
+ * change what will be restored on unfreeze.
+ */
+void Physics_SetObjectFrozen(struct physics_object_s *obj, int frozen);
 
 void Physics_EnableCollision(struct physics_data_s *physics);
 void Physics_DisableCollision(struct physics_data_s *physics);
+void Physics_SetCollisionFrozen(struct physics_data_s *physics, int frozen);
 void Physics_SetBoneCollision(struct physics_data_s *physics, int bone_index, int collision);
 void Physics_SetCollisionGroupAndMask(struct physics_data_s *physics, int16_t group, int16_t mask);
 void Physics_SetCollisionScale(struct physics_data_s *physics, float scaling[3]);
@@ -112,6 +192,8 @@ struct rd_setup_s;
 
 bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct rd_setup_s *setup);
 bool Ragdoll_Delete(struct physics_data_s *physics);
+// Distant ragdolls are solved with less iterations; usually camera position.
+void Ragdoll_SetLodOrigin(float pos[3]);
 
 
 /* Hair interface */
@@ -141,13 +223,14 @@ bool Ragdoll_Delete(struct physics_data_s *physics);
 struct hair_s;
 struct hair_setup_s;
 
-// Creates hair into allocated hair structure, using previously defined setup and
-// entity index.
-struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics);
+// Creates hair into allocated hair structure, using previously defined setup,
+// owner physics and bones (collision spheres).
+struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics, struct ss_bone_frame_s *bf);
 
 // Removes specified hair from entity and clears it from memory.
 void Hair_Delete(struct hair_s *hair);
 
+// Marks hair to be simulated in this frame physics step.
 void Hair_Update(struct hair_s *hair, struct physics_data_s *physics);
 
 int Hair_GetElementsCount(struct hair_s *hair);
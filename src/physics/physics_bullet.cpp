@@ -1,7 +1,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <SDL2/SDL.h>
 
 #include <btBulletCollisionCommon.h>
 #include <btBulletDynamicsCommon.h>
@@ -16,6 +18,7 @@
 #include "../core/gl_font.h"
 #include "../core/gl_text.h"
 #include "../core/console.h"
+#include "../core/system.h"
 #include "../core/vmath.h"
 #include "../core/obb.h"
 #include "../render/render.h"
@@ -36,6 +39,33 @@
 /*
  * INTERNAL BHYSICS CLASSES
  */
+
+/*
+ * Rooms prefilter of queries, the same rejections as in addSingleResult that
+ * do not depend on the hit point; done before the narrowphase, so far and
+ * overlapped rooms trimeshes are not traced at all. Room partitions objects
+ * may be skipped, when they are tested by the sweep cache.
+ */
+static bool Physics_QueryNeedsCollision(engine_container_p cont, int16_t filter, bool skip_partitions, btBroadphaseProxy *proxy)
+{
+    btCollisionObject *obj = (btCollisionObject*)proxy->m_clientObject;
+    engine_container_p c1 = (engine_container_p)obj->getUserPointer();
+    room_p r0 = (cont) ? (cont->room) : (NULL);
+    room_p r1 = (c1) ? (c1->room) : (NULL);
+
+    if(c1 && (((c1->collision_group & filter) == 0x0000) || (c1 == cont)))
+    {
+        return false;
+    }
+
+    if(skip_partitions && r1 && ((c1->object_type == OBJECT_ROOM_BASE) || (c1->object_type == OBJECT_STATIC_MESH)))
+    {
+        return false;
+    }
+
+    return !r0 || !r1 || (Room_IsInNearRoomsList(r0, r1) && !Room_IsInOverlappedRoomsList(r0, r1));
+}
+
 class bt_engine_ClosestRayResultCallback : public btCollisionWorld::ClosestRayResultCallback
 {
 public:
@@ -51,6 +81,12 @@ public:
         m_collisionFilterMask |= (filter & COLLISION_GROUP_DYNAMICS) ? (btBroadphaseProxy::DefaultFilter) : 0x0000;
     }
 
+    virtual bool needsCollision(btBroadphaseProxy* proxy0) const override
+    {
+        return ClosestRayResultCallback::needsCollision(proxy0) &&
+               Physics_QueryNeedsCollision(m_cont, m_filter, false, proxy0);
+    }
+
     virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace) override
     {
         room_p r0 = NULL, r1 = NULL;
@@ -117,6 +153,12 @@ public:
         m_collisionFilterMask |= (filter & COLLISION_GROUP_DYNAMICS) ? (btBroadphaseProxy::DefaultFilter) : 0x0000;
     }
 
+    virtual bool needsCollision(btBroadphaseProxy* proxy0) const override
+    {
+        return ClosestConvexResultCallback::needsCollision(proxy0) &&
+               Physics_QueryNeedsCollision(m_cont, m_filter, m_skip_partitions, proxy0);
+    }
+
     virtual btScalar addSingleResult(btCollisionWorld::LocalConvexResult &convexResult, bool normalInWorldSpace)
     {
         room_p r0 = NULL, r1 = NULL;
@@ -162,6 +204,8 @@ public:
         return 1.0f;
     }
 
+    bool               m_skip_partitions = false;
+
 private:
     engine_container_p m_cont;
     int16_t            m_filter;
@@ -238,11 +282,17 @@ struct bt_engine_OverlapFilterCallback : public btOverlapFilterCallback
 struct physics_object_s
 {
     btRigidBody    *bt_body;
+    bool            frozen;
+    bool            restore;                // is in world after unfreeze
 };
 
 struct kinematic_info_s
 {
     bool        has_collisions;
+    bool        body_restore;               // frozen state: is in world after unfreeze
+    bool        ghost_restore;
+    int16_t     group;                      // frozen body broadphase filter
+    int16_t     mask;
 };
 
 typedef struct physics_data_s
@@ -255,13 +305,16 @@ typedef struct physics_data_s
     struct ghost_shape_s               *ghosts_info;
     btPairCachingGhostObject          **ghost_objects;          // like Bullet character controller for penetration resolving.
     btManifoldArray                    *manifoldArray;          // keep track of the contact manifolds
-    struct collision_node_s            *collision_track;
     uint16_t                            objects_count;          // Ragdoll joints
     uint16_t                            bt_joint_count;         // Ragdoll joints
+    uint16_t                            bt_joints_size;         // joints array capacity, kept for the next ragdoll
     btTypedConstraint                 **bt_joints;              // Ragdoll joints
+    bool                                rd_baked;               // settled ragdoll: static bodies in the last pose
+    float                               rd_settle_time;
 
     int16_t                             collision_group;
     int16_t                             collision_mask;
+    bool                                frozen;
     struct engine_container_s          *cont;
 }physics_data_t, *physics_data_p;
 
@@ -324,15 +377,118 @@ btDiscreteDynamicsWorld                 *bt_engine_dynamicsWorld = NULL;
 
 CBulletDebugDrawer                       bt_debug_drawer;
 
+/*
+ * Contacts of all ghost queries of the frame go to one array; results of a
+ * query are contiguous. An outgrown array stays alive until the frame end,
+ * because earlier results still point to it, so the pool reaches the peak
+ * contacts count of the level and then never allocates.
+ */
+#define COLLISION_POOL_MAX_RETIRED  (16)
+
+static struct
+{
+    collision_node_p            nodes;
+    uint32_t                    size;
+    uint32_t                    count;
+    uint32_t                    last_frame_count;
+    uint32_t                    frame_allocations;                              // heap allocations counter on frame start
+    uint32_t                    last_frame_allocations;
+    collision_node_p            retired[COLLISION_POOL_MAX_RETIRED];
+    uint16_t                    retired_count;
+}bt_engine_collision_pool;
+
+static SDL_atomic_t             bt_engine_allocations;                          // Bullet and contacts pool heap allocations
+static float                    bt_engine_step_ms = 0.0f;
+static uint32_t                 bt_engine_static_revision = 0;                  // changed with room partitions objects world state
+
+static void *Physics_CountedAlloc(size_t size)
+{
+    SDL_AtomicAdd(&bt_engine_allocations, 1);
+    return malloc(size);
+}
+
+
+static void Physics_CountedFree(void *ptr)
+{
+    free(ptr);
+}
+
+/*
+ * Static trimesh BVH cache: optimized BVHs of room heightmaps, tweens and
+ * static meshes are stored serialized in the level's cache file and restored
+ * in place on the next load. Trimeshes themselves are still generated (that
+ * is cheap); entry is used only if the trimesh hash matches.
+ */
+#define BVH_CACHE_MAGIC             (0x48564254)                                // "TBVH"
+#define BVH_CACHE_VERSION           (1)
+#define BVH_CACHE_PLATFORM          ((uint32_t)(sizeof(void*) | (sizeof(btScalar) << 8) | (sizeof(btOptimizedBvh) << 16)))
+#define BVH_CACHE_HASH_INIT         (14695981039346656037ULL)
+
+#define BVH_CACHE_KEY_ROOM          (1 << 24)
+#define BVH_CACHE_KEY_ROOM_TWEENS   (2 << 24)
+#define BVH_CACHE_KEY_STATIC_MESH   (3 << 24)
+
+typedef struct bvh_cache_entry_s
+{
+    uint32_t                    key;
+    uint32_t                    size;
+    uint64_t                    mesh_hash;
+    uint8_t                    *data;                                           // 16 bytes aligned serialized btOptimizedBvh
+    int                         used;
+}bvh_cache_entry_t, *bvh_cache_entry_p;
+
+static struct
+{
+    int                         active;
+    int                         dirty;
+    char                        file_name[1024];
+    uint64_t                    level_hash;
+    bvh_cache_entry_p           entries;
+    uint32_t                    entries_count;
+    uint32_t                    entries_size;
+    uint32_t                    hits;
+    uint32_t                    misses;
+}bt_engine_bvh_cache;
+
+/*
+ * Shape that owns BVH deserialized in place into btAlignedAlloc'ed buffer.
+ */
+class btCachedBvhTriangleMeshShape : public btBvhTriangleMeshShape
+{
+public:
+    btCachedBvhTriangleMeshShape(btStridingMeshInterface *meshInterface, bool useQuantizedAabbCompression, btOptimizedBvh *bvh) :
+        btBvhTriangleMeshShape(meshInterface, useQuantizedAabbCompression, false),
+        m_cachedBvh(bvh)
+    {
+        setOptimizedBvh(bvh);
+    }
+
+    virtual ~btCachedBvhTriangleMeshShape()
+    {
+        m_cachedBvh->~btOptimizedBvh();
+        btAlignedFree(m_cachedBvh);
+    }
+
+private:
+    btOptimizedBvh *m_cachedBvh;
+};
+
 /* bullet collision model calculation */
 btCollisionShape* BT_CSfromBBox(btScalar *bb_min, btScalar *bb_max);
-btCollisionShape* BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, bool buildBvh, bool is_static = true);
-btCollisionShape* BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, uint32_t tweens_count, bool useCompression, bool buildBvh);
+btCollisionShape* BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, bool buildBvh, bool is_static = true, uint32_t cache_key = 0);
+btCollisionShape* BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, uint32_t tweens_count, bool useCompression, bool buildBvh, uint32_t cache_key = 0);
+btCollisionShape* BT_CSfromTrimesh(btTriangleMesh *trimesh, bool useCompression, bool buildBvh, uint32_t cache_key);
 
 uint32_t BT_AddFloorAndCeilingToTrimesh(btTriangleMesh *trimesh, struct room_sector_s *sector);
 uint32_t BT_AddSectorTweenToTrimesh(btTriangleMesh *trimesh, struct sector_tween_s *tween);
 
 void Physics_DeleteRigidBody(struct physics_data_s *physics);                   // only for internal usage
+static void Physics_StopBatchThreads();
+static void Physics_ResetCollisionPool();
+static void Ragdoll_UpdateActivity(float time);
+static void Ragdoll_ReleaseJoints(struct physics_data_s *physics);
+static void Ragdoll_RemoveActive(struct physics_data_s *physics);
+static void Ragdoll_ClearPool();
 
 btScalar getInnerBBRadius(btScalar bb_min[3], btScalar bb_max[3])
 {
@@ -346,6 +502,12 @@ btScalar getInnerBBRadius(btScalar bb_min[3], btScalar bb_max[3])
 // Bullet Physics initialization.
 void Physics_Init()
 {
+    btAlignedAllocSetCustom(Physics_CountedAlloc, Physics_CountedFree);
+    bt_engine_collision_pool.size = DEFAULT_COLLSION_NODE_POOL_SIZE;
+    bt_engine_collision_pool.nodes = (collision_node_p)Physics_CountedAlloc(bt_engine_collision_pool.size * sizeof(collision_node_t));
+    bt_engine_collision_pool.count = 0;
+    bt_engine_collision_pool.retired_count = 0;
+
     ///collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
     bt_engine_collisionConfiguration = new btDefaultCollisionConfiguration();
 
@@ -371,6 +533,10 @@ void Physics_Init()
 
 void Physics_Destroy()
 {
+    Physics_StopBatchThreads();
+    Hair_StopSimulation();
+    Ragdoll_ClearPool();
+
     //delete dynamics world
     delete bt_engine_dynamicsWorld;
 
@@ -386,15 +552,113 @@ void Physics_Destroy()
     delete bt_engine_collisionConfiguration;
 
     delete bt_engine_ghostPairCallback;
+
+    Physics_ResetCollisionPool();
+    free(bt_engine_collision_pool.nodes);
+    bt_engine_collision_pool.nodes = NULL;
+    bt_engine_collision_pool.size = 0;
 }
 
 
 void Physics_StepSimulation(float time)
 {
+    Uint64 t0 = SDL_GetPerformanceCounter();
     time = (time < 0.1f) ? (time) : (0.0f);
+    Hair_StartSimulation(time);                                                 // strands are solved on worker meanwhile
     bt_engine_dynamicsWorld->stepSimulation(time, 0);
+    Hair_FinishSimulation();
+    Ragdoll_UpdateActivity(time);
+    Physics_ResetCollisionPool();
+    bt_engine_step_ms = 1000.0f * (SDL_GetPerformanceCounter() - t0) / SDL_GetPerformanceFrequency();
+}
+
+
+static void Physics_ResetCollisionPool()
+{
+    for(uint16_t i = 0; i < bt_engine_collision_pool.retired_count; i++)
+    {
+        free(bt_engine_collision_pool.retired[i]);
+        bt_engine_collision_pool.retired[i] = NULL;
+    }
+    bt_engine_collision_pool.retired_count = 0;
+    bt_engine_collision_pool.last_frame_count = bt_engine_collision_pool.count;
+    bt_engine_collision_pool.count = 0;
+    bt_engine_collision_pool.last_frame_allocations = Physics_GetHeapAllocations() - bt_engine_collision_pool.frame_allocations;
+    bt_engine_collision_pool.frame_allocations = Physics_GetHeapAllocations();
 }
 
+/**
+ * Returns free node for the query started at *first; on grow the query's
+ * nodes are moved to the new array and *first is reset.
+ */
+static collision_node_p Physics_NewCollisionNode(uint32_t *first)
+{
+    if(bt_engine_collision_pool.count >= bt_engine_collision_pool.size)
+    {
+        uint32_t query_count = bt_engine_collision_pool.count - *first;
+        uint32_t new_size = bt_engine_collision_pool.size * 2;
+        collision_node_p new_nodes;
+
+        if(bt_engine_collision_pool.retired_count >= COLLISION_POOL_MAX_RETIRED)
+        {
+            return NULL;
+        }
+        new_nodes = (collision_node_p)Physics_CountedAlloc(new_size * sizeof(collision_node_t));
+        if(new_nodes == NULL)
+        {
+            return NULL;
+        }
+        memcpy(new_nodes, bt_engine_collision_pool.nodes + *first, query_count * sizeof(collision_node_t));
+        bt_engine_collision_pool.retired[bt_engine_collision_pool.retired_count++] = bt_engine_collision_pool.nodes;
+        bt_engine_collision_pool.nodes = new_nodes;
+        bt_engine_collision_pool.size = new_size;
+        bt_engine_collision_pool.count = query_count;
+        *first = 0;
+    }
+
+    return bt_engine_collision_pool.nodes + bt_engine_collision_pool.count++;
+}
+
+
+uint32_t Physics_GetHeapAllocations()
+{
+    return SDL_AtomicGet(&bt_engine_allocations);
+}
+
+
+void Physics_GetCollisionPoolInfo(uint32_t *size, uint32_t *last_frame_count, uint32_t *last_frame_allocations)
+{
+    *size = bt_engine_collision_pool.size;
+    *last_frame_count = bt_engine_collision_pool.last_frame_count;
+    *last_frame_allocations = bt_engine_collision_pool.last_frame_allocations;
+}
+
+void Physics_GetStepInfo(struct physics_step_info_s *info)
+{
+    int manifolds = bt_engine_dispatcher->getNumManifolds();
+    btCollisionObjectArray &objects = bt_engine_dynamicsWorld->getCollisionObjectArray();
+
+    info->step_ms = bt_engine_step_ms;
+    info->pairs = bt_engine_overlappingPairCache->getOverlappingPairCache()->getNumOverlappingPairs();
+    info->manifolds = manifolds;
+    info->contacts = 0;
+    for(int i = 0; i < manifolds; i++)
+    {
+        info->contacts += bt_engine_dispatcher->getManifoldByIndexInternal(i)->getNumContacts();
+    }
+    info->bodies = 0;
+    info->active_bodies = 0;
+    for(int i = 0; i < objects.size(); i++)
+    {
+        if(btRigidBody::upcast(objects[i]))
+        {
+            info->bodies++;
+            info->active_bodies += (objects[i]->isActive()) ? (1) : (0);
+        }
+    }
+}
+
+
 void Physics_DebugDrawWorld()
 {
     bt_engine_dynamicsWorld->debugDrawWorld();
@@ -447,12 +711,15 @@ struct physics_data_s *Physics_CreatePhysicsData(struct engine_container_s *cont
     ret->bt_joints = NULL;
     ret->objects_count = 0;
     ret->bt_joint_count = 0;
+    ret->bt_joints_size = 0;
+    ret->rd_baked = false;
+    ret->rd_settle_time = 0.0f;
     ret->manifoldArray = NULL;
     ret->ghosts_info = NULL;
     ret->ghost_objects = NULL;
-    ret->collision_track = NULL;
     ret->collision_group = btBroadphaseProxy::KinematicFilter;
     ret->collision_mask = btBroadphaseProxy::AllFilter;
+    ret->frozen = false;
     ret->cont = cont;
 
     return ret;
@@ -463,35 +730,19 @@ void Physics_DeletePhysicsData(struct physics_data_s *physics)
 {
     if(physics)
     {
-        for(collision_node_p cn = physics->collision_track; cn;)
-        {
-            collision_node_p next = cn->next;
-            free(cn);
-            cn = next;
-        }
-        physics->collision_track = NULL;
-
         if(physics->bt_info)
         {
             free(physics->bt_info);
             physics->bt_info = NULL;
         }
 
+        Ragdoll_RemoveActive(physics);                                          // nothing may point to the freed data
         if(physics->bt_joints)
         {
-            for(uint32_t i = 0; i < physics->bt_joint_count; i++)
-            {
-                if(physics->bt_joints[i])
-                {
-                    bt_engine_dynamicsWorld->removeConstraint(physics->bt_joints[i]);
-                    delete physics->bt_joints[i];
-                    physics->bt_joints[i] = NULL;
-                }
-            }
-
+            Ragdoll_ReleaseJoints(physics);
             free(physics->bt_joints);
             physics->bt_joints = NULL;
-            physics->bt_joint_count = 0;
+            physics->bt_joints_size = 0;
         }
 
         if(physics->ghost_objects)
@@ -656,6 +907,469 @@ int  Physics_SphereTest(struct collision_result_s *result, float from[3], float
 }
 
 
+/*
+ * Room partitions: room trimeshes, tweens and static meshes never leave their
+ * room, so the static geometry a query from a room may hit is the partitions
+ * of the rooms reachable through its portals (near rooms list). The sweep
+ * cache collects them once and reuses them for repeated queries.
+ */
+#define PHYSICS_PARTITIONS_MAX      (64)
+
+static uint16_t Physics_GetQueryPartitions(engine_container_p cont, room_p *rooms)
+{
+    room_p r0 = (cont && cont->room) ? (cont->room->real_room) : (NULL);
+    uint16_t rooms_count = 0;
+
+    if(r0 && (r0->content->near_room_list_size < PHYSICS_PARTITIONS_MAX))
+    {
+        rooms[rooms_count++] = r0;
+        for(uint16_t i = 0; i < r0->content->near_room_list_size; i++)
+        {
+            room_p r = r0->content->near_room_list[i]->real_room;
+            uint16_t j = 0;
+            for(; (j < rooms_count) && (rooms[j] != r); j++);
+            if(j == rooms_count)
+            {
+                rooms[rooms_count++] = r;
+            }
+        }
+    }
+
+    return rooms_count;
+}
+
+
+static void Physics_PartitionObjectSweepTest(struct physics_object_s *obj, const btConvexShape *shape, const btTransform &tFrom, const btTransform &tTo,
+                                             const btVector3 &qMin, const btVector3 &qMax, btCollisionWorld::ConvexResultCallback &cb)
+{
+    btBroadphaseProxy *proxy = (obj) ? (obj->bt_body->getBroadphaseHandle()) : (NULL);
+    if(proxy && cb.needsCollision(proxy) && TestAabbAgainstAabb2(qMin, qMax, proxy->m_aabbMin, proxy->m_aabbMax))
+    {
+        btCollisionWorld::objectQuerySingle(shape, tFrom, tTo, obj->bt_body, obj->bt_body->getCollisionShape(), obj->bt_body->getWorldTransform(),
+                                            cb, bt_engine_dynamicsWorld->getDispatchInfo().m_allowedCcdPenetration);
+    }
+}
+
+
+/*
+ * Sweep cache: static partition objects around the query bounds are collected
+ * once, then repeated sweeps inside the bounds test only them. Other objects
+ * (kinematic, characters...) are not cached; if any of them is near the sweep,
+ * the cache can not answer and the full test is needed.
+ */
+class bt_engine_SweepCacheAabbCallback : public btBroadphaseAabbCallback
+{
+public:
+    bt_engine_SweepCacheAabbCallback(btCollisionWorld::ConvexResultCallback &cb) :
+        m_cb(cb),
+        m_blocked(false)
+    {
+    }
+
+    virtual bool process(const btBroadphaseProxy *proxy) override
+    {
+        m_blocked = m_blocked || m_cb.needsCollision((btBroadphaseProxy*)proxy);
+        return !m_blocked;
+    }
+
+    btCollisionWorld::ConvexResultCallback &m_cb;
+    bool                                    m_blocked;
+};
+
+
+static void Physics_SweepCacheAdd(struct physics_sweep_cache_s *cache, struct physics_object_s *obj, btCollisionWorld::ConvexResultCallback &cb,
+                                  const btVector3 &qMin, const btVector3 &qMax)
+{
+    btBroadphaseProxy *proxy = (obj) ? (obj->bt_body->getBroadphaseHandle()) : (NULL);
+    if(cache->valid && proxy && cb.needsCollision(proxy) && TestAabbAgainstAabb2(qMin, qMax, proxy->m_aabbMin, proxy->m_aabbMax))
+    {
+        if(cache->objects_count >= cache->objects_size)
+        {
+            uint32_t new_size = (cache->objects_size > 0) ? (cache->objects_size * 2) : (32);
+            struct physics_object_s **new_objects = (struct physics_object_s**)realloc(cache->objects, new_size * sizeof(struct physics_object_s*));
+            if(new_objects == NULL)
+            {
+                cache->valid = 0;
+                return;
+            }
+            cache->objects = new_objects;
+            cache->objects_size = new_size;
+        }
+        cache->objects[cache->objects_count++] = obj;
+    }
+}
+
+
+int  Physics_SweepCacheBuild(struct physics_sweep_cache_s *cache, float bb_min[3], float bb_max[3], struct engine_container_s *cont, int16_t filter)
+{
+    bt_engine_ClosestConvexResultCallback cb(cont, bb_min, bb_max, filter);
+    btVector3 qMin(bb_min[0], bb_min[1], bb_min[2]), qMax(bb_max[0], bb_max[1], bb_max[2]);
+    room_p rooms[PHYSICS_PARTITIONS_MAX];
+    uint16_t rooms_count = Physics_GetQueryPartitions(cont, rooms);
+
+    cache->objects_count = 0;
+    cache->revision = bt_engine_static_revision;
+    cache->room = (cont && cont->room) ? (cont->room->real_room) : (NULL);       // kept on failure, to not retry in the same place
+    cache->valid = (rooms_count > 0);
+    cache->filter = filter;
+    vec3_copy(cache->bb_min, bb_min);
+    vec3_copy(cache->bb_max, bb_max);
+    for(uint16_t i = 0; i < rooms_count; i++)
+    {
+        room_content_p content = rooms[i]->content;
+        Physics_SweepCacheAdd(cache, content->physics_body, cb, qMin, qMax);
+        Physics_SweepCacheAdd(cache, content->physics_alt_tween, cb, qMin, qMax);
+        for(uint32_t j = 0; j < content->static_mesh_count; j++)
+        {
+            Physics_SweepCacheAdd(cache, content->static_mesh[j].physics_body, cb, qMin, qMax);
+        }
+    }
+
+    return cache->valid;
+}
+
+
+void Physics_SweepCacheClear(struct physics_sweep_cache_s *cache)
+{
+    free(cache->objects);
+    cache->objects = NULL;
+    cache->objects_count = 0;
+    cache->objects_size = 0;
+    cache->valid = 0;
+    cache->room = NULL;
+}
+
+
+int  Physics_SweepCacheCovers(struct physics_sweep_cache_s *cache, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter)
+{
+    room_p room = (cont && cont->room) ? (cont->room->real_room) : (NULL);
+
+    if(!room || (cache->room != room) || (cache->revision != bt_engine_static_revision) || (cache->filter != filter))
+    {
+        return 0;
+    }
+    for(int i = 0; i < 3; i++)
+    {
+        float t_min = ((from[i] < to[i]) ? (from[i]) : (to[i])) - R;
+        float t_max = ((from[i] > to[i]) ? (from[i]) : (to[i])) + R;
+        if((t_min < cache->bb_min[i]) || (t_max > cache->bb_max[i]))
+        {
+            return 0;                                                           // sweep left cached bounds
+        }
+    }
+
+    return 1;
+}
+
+
+int  Physics_SphereTestCached(struct physics_sweep_cache_s *cache, struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter)
+{
+    bt_engine_ClosestConvexResultCallback cb(cont, from, to, filter);
+    btVector3 vFrom(from[0], from[1], from[2]), vTo(to[0], to[1], to[2]);
+    btVector3 qMin(vFrom), qMax(vFrom), r(R, R, R);
+    btTransform tFrom, tTo;
+    btSphereShape sphere(R);
+
+    qMin.setMin(vTo);
+    qMax.setMax(vTo);
+    qMin -= r;
+    qMax += r;
+    if(!cache->valid || !Physics_SweepCacheCovers(cache, from, to, R, cont, filter))
+    {
+        return 0;
+    }
+
+    {
+        bt_engine_SweepCacheAabbCallback moving(cb);
+        cb.m_skip_partitions = true;
+        bt_engine_dynamicsWorld->getBroadphase()->aabbTest(qMin, qMax, moving);
+        cb.m_skip_partitions = false;
+        if(moving.m_blocked)
+        {
+            return 0;
+        }
+    }
+
+    tFrom.setIdentity();
+    tFrom.setOrigin(vFrom);
+    tTo.setIdentity();
+    tTo.setOrigin(vTo);
+    for(uint32_t i = 0; i < cache->objects_count; i++)
+    {
+        Physics_PartitionObjectSweepTest(cache->objects[i], &sphere, tFrom, tTo, qMin, qMax, cb);
+    }
+
+    result->obj = NULL;
+    result->hit = 0x00;
+    result->fraction = 1.0f;
+    if(cb.hasHit())
+    {
+        result->obj      = (struct engine_container_s *)cb.m_hitCollisionObject->getUserPointer();
+        result->hit      = 0x01;
+        result->bone_num = cb.m_hitCollisionObject->getUserIndex();
+        vec3_copy(result->normale, cb.m_hitNormalWorld.m_floats);
+        vec3_copy(result->point, cb.m_hitPointWorld.m_floats);
+        result->fraction = cb.m_closestHitFraction;
+    }
+
+    return 1;
+}
+
+
+/*
+ * Batched queries: candidates come from one broadphase AABB test over the
+ * whole batch, then every query checks only the candidates its own sweep
+ * bounds touch, with the same callbacks as the world tests.
+ */
+#define PHYSICS_BATCH_MAX_WORKERS   (4)                                         // main thread included
+#define PHYSICS_BATCH_THREADS_MIN   (64)                                        // smaller batches are not worth waking threads
+
+class bt_engine_CandidatesCallback : public btBroadphaseAabbCallback
+{
+public:
+    virtual bool process(const btBroadphaseProxy *proxy) override
+    {
+        m_objects.push_back((btCollisionObject*)proxy->m_clientObject);
+        return true;
+    }
+
+    btAlignedObjectArray<btCollisionObject*> m_objects;
+};
+
+static struct
+{
+    SDL_Thread                 *threads[PHYSICS_BATCH_MAX_WORKERS];
+    SDL_sem                    *start;
+    SDL_sem                    *done;
+    SDL_atomic_t                next_query;
+    uint16_t                    workers_count;
+    bool                        started;
+    bool                        exit;
+    struct physics_query_s     *queries;
+    uint32_t                    queries_count;
+    bt_engine_CandidatesCallback candidates;
+}bt_engine_batch;
+
+
+static void Physics_QueryCandidates(struct physics_query_s *q, btAlignedObjectArray<btCollisionObject*> &candidates)
+{
+    btVector3 vFrom(q->from[0], q->from[1], q->from[2]), vTo(q->to[0], q->to[1], q->to[2]);
+    btVector3 qMin(vFrom), qMax(vFrom);
+    btTransform tFrom, tTo;
+    struct collision_result_s *result = &q->result;
+
+    qMin.setMin(vTo);
+    qMax.setMax(vTo);
+    tFrom.setIdentity();
+    tFrom.setOrigin(vFrom);
+    tTo.setIdentity();
+    tTo.setOrigin(vTo);
+    result->obj = NULL;
+    result->hit = 0x00;
+    result->fraction = 1.0f;
+
+    if(q->type == PHYSICS_QUERY_SPHERE)
+    {
+        bt_engine_ClosestConvexResultCallback cb(q->cont, q->from, q->to, q->filter);
+        btSphereShape sphere(q->R);
+        btScalar allowed_penetration = bt_engine_dynamicsWorld->getDispatchInfo().m_allowedCcdPenetration;
+        btVector3 r(q->R, q->R, q->R);
+
+        qMin -= r;
+        qMax += r;
+        for(int i = 0; i < candidates.size(); i++)
+        {
+            btCollisionObject *obj = candidates[i];
+            btBroadphaseProxy *proxy = obj->getBroadphaseHandle();
+            if(cb.needsCollision(proxy) && TestAabbAgainstAabb2(qMin, qMax, proxy->m_aabbMin, proxy->m_aabbMax))
+            {
+                btCollisionWorld::objectQuerySingle(&sphere, tFrom, tTo, obj, obj->getCollisionShape(), obj->getWorldTransform(), cb, allowed_penetration);
+            }
+        }
+
+        if(cb.hasHit())
+        {
+            result->obj      = (struct engine_container_s *)cb.m_hitCollisionObject->getUserPointer();
+            result->hit      = 0x01;
+            result->bone_num = cb.m_hitCollisionObject->getUserIndex();
+            vec3_copy(result->normale, cb.m_hitNormalWorld.m_floats);
+            vec3_copy(result->point, cb.m_hitPointWorld.m_floats);
+            result->fraction = cb.m_closestHitFraction;
+        }
+    }
+    else
+    {
+        bt_engine_ClosestRayResultCallback cb(q->cont, q->from, q->to, q->filter);
+        if(q->type == PHYSICS_QUERY_RAY_FILTERED)
+        {
+            cb.m_flags |= btTriangleRaycastCallback::kF_FilterBackfaces;
+            cb.m_flags |= btTriangleRaycastCallback::kF_KeepUnflippedNormal;
+        }
+
+        for(int i = 0; i < candidates.size(); i++)
+        {
+            btCollisionObject *obj = candidates[i];
+            btBroadphaseProxy *proxy = obj->getBroadphaseHandle();
+            if(cb.needsCollision(proxy) && TestAabbAgainstAabb2(qMin, qMax, proxy->m_aabbMin, proxy->m_aabbMax))
+            {
+                btCollisionWorld::rayTestSingle(tFrom, tTo, obj, obj->getCollisionShape(), obj->getWorldTransform(), cb);
+            }
+        }
+
+        if(cb.hasHit())
+        {
+            result->obj      = (struct engine_container_s *)cb.m_collisionObject->getUserPointer();
+            result->hit      = 0x01;
+            result->bone_num = cb.m_collisionObject->getUserIndex();
+            vec3_copy(result->normale, cb.m_hitNormalWorld.m_floats);
+            vFrom.setInterpolate3(vFrom, vTo, cb.m_closestHitFraction);
+            vec3_copy(result->point, vFrom.m_floats);
+            result->fraction = cb.m_closestHitFraction;
+        }
+    }
+}
+
+
+static void Physics_DoBatchQueries()
+{
+    while(true)
+    {
+        int i = SDL_AtomicAdd(&bt_engine_batch.next_query, 1);
+        if(i >= (int)bt_engine_batch.queries_count)
+        {
+            break;
+        }
+        Physics_QueryCandidates(bt_engine_batch.queries + i, bt_engine_batch.candidates.m_objects);
+    }
+}
+
+
+static int Physics_BatchThreadFunc(void *data)
+{
+    while(true)
+    {
+        SDL_SemWait(bt_engine_batch.start);
+        if(bt_engine_batch.exit)
+        {
+            break;
+        }
+        Physics_DoBatchQueries();
+        SDL_SemPost(bt_engine_batch.done);
+    }
+
+    return 0;
+}
+
+
+static void Physics_StartBatchThreads()
+{
+    int cpu_count = SDL_GetCPUCount();
+
+    bt_engine_batch.started = true;
+    bt_engine_batch.workers_count = (cpu_count < 1) ? (1) : ((cpu_count > PHYSICS_BATCH_MAX_WORKERS) ? (PHYSICS_BATCH_MAX_WORKERS) : (cpu_count));
+    if(bt_engine_batch.workers_count > 1)
+    {
+        bt_engine_batch.start = SDL_CreateSemaphore(0);
+        bt_engine_batch.done = SDL_CreateSemaphore(0);
+        bt_engine_batch.exit = false;
+        for(uint16_t i = 1; i < bt_engine_batch.workers_count; i++)
+        {
+            bt_engine_batch.threads[i] = SDL_CreateThread(Physics_BatchThreadFunc, "physics_queries", NULL);
+            if(bt_engine_batch.threads[i] == NULL)
+            {
+                bt_engine_batch.workers_count = i;                              // work with what we have
+                break;
+            }
+        }
+    }
+}
+
+
+static void Physics_StopBatchThreads()
+{
+    if(bt_engine_batch.started && (bt_engine_batch.start != NULL))
+    {
+        bt_engine_batch.exit = true;
+        for(uint16_t i = 1; i < bt_engine_batch.workers_count; i++)
+        {
+            SDL_SemPost(bt_engine_batch.start);
+        }
+        for(uint16_t i = 1; i < bt_engine_batch.workers_count; i++)
+        {
+            SDL_WaitThread(bt_engine_batch.threads[i], NULL);
+            bt_engine_batch.threads[i] = NULL;
+        }
+        SDL_DestroySemaphore(bt_engine_batch.start);
+        SDL_DestroySemaphore(bt_engine_batch.done);
+        bt_engine_batch.start = NULL;
+        bt_engine_batch.done = NULL;
+    }
+    bt_engine_batch.started = false;
+    bt_engine_batch.candidates.m_objects.clear();
+}
+
+
+int Physics_QueryBatch(struct physics_query_s *queries, uint32_t count)
+{
+    btVector3 bMin, bMax;
+    uint16_t started = 0;
+    int ret = 0;
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    bMin.setValue(queries[0].from[0], queries[0].from[1], queries[0].from[2]);
+    bMax = bMin;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        btScalar R = (queries[i].type == PHYSICS_QUERY_SPHERE) ? (queries[i].R) : (0.0f);
+        btVector3 r(R, R, R);
+        btVector3 vFrom(queries[i].from[0], queries[i].from[1], queries[i].from[2]);
+        btVector3 vTo(queries[i].to[0], queries[i].to[1], queries[i].to[2]);
+        bMin.setMin(vFrom - r);
+        bMin.setMin(vTo - r);
+        bMax.setMax(vFrom + r);
+        bMax.setMax(vTo + r);
+    }
+
+    bt_engine_batch.candidates.m_objects.resize(0);
+    bt_engine_dynamicsWorld->getBroadphase()->aabbTest(bMin, bMax, bt_engine_batch.candidates);
+    bt_engine_batch.queries = queries;
+    bt_engine_batch.queries_count = count;
+    SDL_AtomicSet(&bt_engine_batch.next_query, 0);
+
+    if(count >= PHYSICS_BATCH_THREADS_MIN)
+    {
+        if(!bt_engine_batch.started)
+        {
+            Physics_StartBatchThreads();
+        }
+        started = bt_engine_batch.workers_count - 1;
+        for(uint16_t i = 0; i < started; i++)
+        {
+            SDL_SemPost(bt_engine_batch.start);
+        }
+    }
+
+    Physics_DoBatchQueries();
+    for(uint16_t i = 0; i < started; i++)
+    {
+        SDL_SemWait(bt_engine_batch.done);
+    }
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        ret += queries[i].result.hit;
+    }
+    bt_engine_batch.queries = NULL;
+    bt_engine_batch.queries_count = 0;
+
+    return ret;
+}
+
+
 int Physics_IsBodyesInited(struct physics_data_s *physics)
 {
     return physics && physics->bt_body;
@@ -725,8 +1439,10 @@ ghost_shape_p Physics_GetGhostShapeInfo(struct physics_data_s *physics, uint16_t
 
 /**
  * It is from bullet_character_controller
+ * Contacts go to the frame pool; ghost pair cache and its manifolds persist
+ * between frames, manifolds array keeps its capacity.
  */
-collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics, uint16_t index, int16_t filter)
+uint32_t Physics_GetGhostCurrentCollision(struct physics_data_s *physics, uint16_t index, int16_t filter, collision_node_p *nodes)
 {
     // Here we must refresh the overlapping paircache as the penetrating movement itself or the
     // previous recovery iteration might have used setWorldTransform and pushed us into an object
@@ -736,7 +1452,7 @@ collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics
     // Do this by calling the broadphase's setAabb with the moved AABB, this will update the broadphase
     // paircache and the ghostobject's internal paircache at the same time.    /BW
 
-    collision_node_p *cn = &(physics->collision_track);
+    uint32_t first = bt_engine_collision_pool.count;
     btPairCachingGhostObject *ghost = physics->ghost_objects[index];
     if(ghost && ghost->getBroadphaseHandle())
     {
@@ -748,72 +1464,314 @@ collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics
         bt_engine_dynamicsWorld->getBroadphase()->setAabb(ghost->getBroadphaseHandle(), aabb_min, aabb_max, bt_engine_dynamicsWorld->getDispatcher());
         bt_engine_dynamicsWorld->getDispatcher()->dispatchAllCollisionPairs(ghost->getOverlappingPairCache(), bt_engine_dynamicsWorld->getDispatchInfo(), bt_engine_dynamicsWorld->getDispatcher());
 
-        num_pairs = pairArray.size();
-        for(int i = 0; i < num_pairs; i++)
-        {
-            // do not use commented code: it prevents to collision skips.
-            //btBroadphasePair &pair = pairArray[i];
-            //btBroadphasePair* collisionPair = bt_engine_dynamicsWorld->getPairCache()->findPair(pair.m_pProxy0,pair.m_pProxy1);
-            btBroadphasePair *collisionPair = &pairArray[i];
-            if(collisionPair && collisionPair->m_algorithm)
-            {
-                physics->manifoldArray->clear();
-                collisionPair->m_algorithm->getAllContactManifolds(*(physics->manifoldArray));
-                manifolds_size = physics->manifoldArray->size();
-                for(int j = 0; j < manifolds_size; j++)
-                {
-                    btPersistentManifold* manifold = (*(physics->manifoldArray))[j];
-                    btCollisionObject *obj = (btCollisionObject*)manifold->getBody0();
-                    btScalar directionSign = btScalar(1.0);
-                    if(obj == ghost)
-                    {
-                        obj = (btCollisionObject*)manifold->getBody1();
-                        directionSign = btScalar(-1.0);
-                    }
+        num_pairs = pairArray.size();
+        for(int i = 0; i < num_pairs; i++)
+        {
+            // do not use commented code: it prevents to collision skips.
+            //btBroadphasePair &pair = pairArray[i];
+            //btBroadphasePair* collisionPair = bt_engine_dynamicsWorld->getPairCache()->findPair(pair.m_pProxy0,pair.m_pProxy1);
+            btBroadphasePair *collisionPair = &pairArray[i];
+            if(collisionPair && collisionPair->m_algorithm)
+            {
+                physics->manifoldArray->resize(0);
+                collisionPair->m_algorithm->getAllContactManifolds(*(physics->manifoldArray));
+                manifolds_size = physics->manifoldArray->size();
+                for(int j = 0; j < manifolds_size; j++)
+                {
+                    btPersistentManifold* manifold = (*(physics->manifoldArray))[j];
+                    btCollisionObject *obj = (btCollisionObject*)manifold->getBody0();
+                    btScalar directionSign = btScalar(1.0);
+                    if(obj == ghost)
+                    {
+                        obj = (btCollisionObject*)manifold->getBody1();
+                        directionSign = btScalar(-1.0);
+                    }
+
+                    engine_container_p cont = (engine_container_p)obj->getUserPointer();
+                    if(cont && (cont->collision_group & filter))
+                    {
+                        for(int k = 0; k < manifold->getNumContacts(); k++)
+                        {
+                            const btManifoldPoint&pt = manifold->getContactPoint(k);
+                            btScalar dist = pt.getDistance();
+
+                            collision_node_p cn;
+                            if((dist < 0.0) && (cn = Physics_NewCollisionNode(&first)))
+                            {
+                                cn->obj = cont;
+                                cn->part_from = obj->getUserIndex();
+                                cn->part_self = i;
+                                cn->penetration[0] = pt.m_normalWorldOnB[0];
+                                cn->penetration[1] = pt.m_normalWorldOnB[1];
+                                cn->penetration[2] = pt.m_normalWorldOnB[2];
+                                cn->penetration[3] = dist * directionSign;
+                                cn->point[0] = pt.m_positionWorldOnA[0];
+                                cn->point[1] = pt.m_positionWorldOnA[1];
+                                cn->point[2] = pt.m_positionWorldOnA[2];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        physics->manifoldArray->resize(0);
+    }
+
+    *nodes = bt_engine_collision_pool.nodes + first;
+    return bt_engine_collision_pool.count - first;
+}
+
+
+/*
+ * BVH CACHE
+ */
+static uint64_t BT_Hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *ch = (const uint8_t*)data;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ ch[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t BT_TrimeshHash(btTriangleMesh *trimesh)
+{
+    const unsigned char *vertices, *indices;
+    int vertices_count, vertex_stride, faces_count, index_stride;
+    PHY_ScalarType vertex_type, index_type;
+    uint64_t hash = BVH_CACHE_HASH_INIT;
+
+    trimesh->getLockedReadOnlyVertexIndexBase(&vertices, vertices_count, vertex_type, vertex_stride,
+                                              &indices, index_stride, faces_count, index_type, 0);
+    for(int i = 0; i < vertices_count; i++)
+    {
+        hash = BT_Hash(hash, vertices + i * vertex_stride, 3 * sizeof(btScalar));  // w is not initialized
+    }
+    hash = BT_Hash(hash, indices, faces_count * index_stride);
+    trimesh->unLockReadOnlyVertexBase(0);
+
+    return hash;
+}
+
+
+static bvh_cache_entry_p BT_BvhCacheFindEntry(uint32_t key)
+{
+    for(uint32_t i = 0; i < bt_engine_bvh_cache.entries_count; i++)
+    {
+        if(bt_engine_bvh_cache.entries[i].key == key)
+        {
+            return bt_engine_bvh_cache.entries + i;
+        }
+    }
+    return NULL;
+}
+
+
+static bvh_cache_entry_p BT_BvhCacheAddEntry(uint32_t key)
+{
+    if(bt_engine_bvh_cache.entries_count >= bt_engine_bvh_cache.entries_size)
+    {
+        uint32_t new_size = (bt_engine_bvh_cache.entries_size > 0) ? (bt_engine_bvh_cache.entries_size * 2) : (256);
+        bvh_cache_entry_p new_entries = (bvh_cache_entry_p)realloc(bt_engine_bvh_cache.entries, new_size * sizeof(bvh_cache_entry_t));
+        if(new_entries == NULL)
+        {
+            return NULL;
+        }
+        bt_engine_bvh_cache.entries = new_entries;
+        bt_engine_bvh_cache.entries_size = new_size;
+    }
+
+    bvh_cache_entry_p entry = bt_engine_bvh_cache.entries + bt_engine_bvh_cache.entries_count++;
+    entry->key = key;
+    entry->size = 0;
+    entry->mesh_hash = 0;
+    entry->data = NULL;
+    entry->used = 0;
+    return entry;
+}
+
+
+static void BT_BvhCacheReadFile()
+{
+    FILE *f = fopen(bt_engine_bvh_cache.file_name, "rb");
+    uint32_t header[4];
+    uint64_t level_hash;
+
+    if(f == NULL)
+    {
+        return;
+    }
+
+    if((fread(header, sizeof(uint32_t), 3, f) != 3) || (fread(&level_hash, sizeof(uint64_t), 1, f) != 1) ||
+       (fread(header + 3, sizeof(uint32_t), 1, f) != 1) || (header[0] != BVH_CACHE_MAGIC) ||
+       (header[1] != BVH_CACHE_VERSION) || (header[2] != BVH_CACHE_PLATFORM) || (level_hash != bt_engine_bvh_cache.level_hash))
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "BVH cache \"%s\" is outdated", bt_engine_bvh_cache.file_name);
+        fclose(f);
+        return;
+    }
+
+    for(uint32_t i = 0; i < header[3]; i++)
+    {
+        uint32_t key_size[2];
+        uint64_t mesh_hash;
+        bvh_cache_entry_p entry;
+        if((fread(key_size, sizeof(uint32_t), 2, f) != 2) || (fread(&mesh_hash, sizeof(uint64_t), 1, f) != 1) ||
+           ((entry = BT_BvhCacheAddEntry(key_size[0])) == NULL))
+        {
+            break;
+        }
+        entry->mesh_hash = mesh_hash;
+        entry->data = (uint8_t*)btAlignedAlloc(key_size[1], 16);
+        if((entry->data == NULL) || (fread(entry->data, 1, key_size[1], f) != key_size[1]))
+        {
+            btAlignedFree(entry->data);
+            bt_engine_bvh_cache.entries_count--;
+            break;
+        }
+        entry->size = key_size[1];
+    }
+    fclose(f);
+}
+
+
+static void BT_BvhCacheWriteFile()
+{
+    FILE *f = fopen(bt_engine_bvh_cache.file_name, "wb");
+    uint32_t header[4] = {BVH_CACHE_MAGIC, BVH_CACHE_VERSION, BVH_CACHE_PLATFORM, 0};
+
+    if(f == NULL)
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "can not write BVH cache \"%s\"", bt_engine_bvh_cache.file_name);
+        return;
+    }
+
+    for(uint32_t i = 0; i < bt_engine_bvh_cache.entries_count; i++)
+    {
+        header[3] += (bt_engine_bvh_cache.entries[i].used) ? (1) : (0);
+    }
+
+    fwrite(header, sizeof(uint32_t), 3, f);
+    fwrite(&bt_engine_bvh_cache.level_hash, sizeof(uint64_t), 1, f);
+    fwrite(header + 3, sizeof(uint32_t), 1, f);
+    for(uint32_t i = 0; i < bt_engine_bvh_cache.entries_count; i++)
+    {
+        bvh_cache_entry_p entry = bt_engine_bvh_cache.entries + i;
+        if(entry->used)
+        {
+            uint32_t key_size[2] = {entry->key, entry->size};
+            fwrite(key_size, sizeof(uint32_t), 2, f);
+            fwrite(&entry->mesh_hash, sizeof(uint64_t), 1, f);
+            fwrite(entry->data, 1, entry->size, f);
+        }
+    }
+    fclose(f);
+}
+
+
+void Physics_BvhCacheBegin(const char *file_name, const char *level_path)
+{
+    FILE *f = fopen(level_path, "rb");
+    long level_size = 0;
+
+    Physics_BvhCacheEnd();
+    if(f)
+    {
+        fseek(f, 0, SEEK_END);
+        level_size = ftell(f);
+        fclose(f);
+    }
+
+    strncpy(bt_engine_bvh_cache.file_name, file_name, sizeof(bt_engine_bvh_cache.file_name) - 1);
+    bt_engine_bvh_cache.file_name[sizeof(bt_engine_bvh_cache.file_name) - 1] = 0;
+    bt_engine_bvh_cache.level_hash = BT_Hash(BVH_CACHE_HASH_INIT, level_path, strlen(level_path));
+    bt_engine_bvh_cache.level_hash = BT_Hash(bt_engine_bvh_cache.level_hash, &level_size, sizeof(level_size));
+    bt_engine_bvh_cache.hits = 0;
+    bt_engine_bvh_cache.misses = 0;
+    bt_engine_bvh_cache.dirty = 0;
+    bt_engine_bvh_cache.active = 1;
+    BT_BvhCacheReadFile();
+}
+
+
+void Physics_BvhCacheEnd()
+{
+    if(bt_engine_bvh_cache.active)
+    {
+        for(uint32_t i = 0; i < bt_engine_bvh_cache.entries_count; i++)
+        {
+            bt_engine_bvh_cache.dirty |= !bt_engine_bvh_cache.entries[i].used;  // removed meshes are dropped
+        }
+        if(bt_engine_bvh_cache.dirty)
+        {
+            BT_BvhCacheWriteFile();
+        }
+        Sys_DebugLog(SYS_LOG_FILENAME, "BVH cache: %d loaded, %d built", bt_engine_bvh_cache.hits, bt_engine_bvh_cache.misses);
+    }
+
+    for(uint32_t i = 0; i < bt_engine_bvh_cache.entries_count; i++)
+    {
+        btAlignedFree(bt_engine_bvh_cache.entries[i].data);
+    }
+    free(bt_engine_bvh_cache.entries);
+    bt_engine_bvh_cache.entries = NULL;
+    bt_engine_bvh_cache.entries_count = 0;
+    bt_engine_bvh_cache.entries_size = 0;
+    bt_engine_bvh_cache.active = 0;
+}
+
+
+btCollisionShape *BT_CSfromTrimesh(btTriangleMesh *trimesh, bool useCompression, bool buildBvh, uint32_t cache_key)
+{
+    btBvhTriangleMeshShape *ret;
+    bvh_cache_entry_p entry;
+    uint64_t mesh_hash;
 
-                    engine_container_p cont = (engine_container_p)obj->getUserPointer();
-                    if(cont && (cont->collision_group & filter))
-                    {
-                        for(int k = 0; k < manifold->getNumContacts(); k++)
-                        {
-                            const btManifoldPoint&pt = manifold->getContactPoint(k);
-                            btScalar dist = pt.getDistance();
+    if(!bt_engine_bvh_cache.active || !cache_key || !useCompression || !buildBvh)
+    {
+        return new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+    }
 
-                            if(dist < 0.0)
-                            {
-                                if(*cn == NULL)
-                                {
-                                    *cn = (collision_node_p)malloc(sizeof(collision_node_t));
-                                    (*cn)->next = NULL;
-                                }
-
-                                (*cn)->obj = cont;
-                                (*cn)->part_from = obj->getUserIndex();
-                                (*cn)->part_self = i;
-                                (*cn)->penetration[0] = pt.m_normalWorldOnB[0];
-                                (*cn)->penetration[1] = pt.m_normalWorldOnB[1];
-                                (*cn)->penetration[2] = pt.m_normalWorldOnB[2];
-                                (*cn)->penetration[3] = dist * directionSign;
-                                (*cn)->point[0] = pt.m_positionWorldOnA[0];
-                                (*cn)->point[1] = pt.m_positionWorldOnA[1];
-                                (*cn)->point[2] = pt.m_positionWorldOnA[2];
-
-                                cn = &((*cn)->next);
-                            }
-                        }
-                    }
-                }
-            }
+    mesh_hash = BT_TrimeshHash(trimesh);
+    entry = BT_BvhCacheFindEntry(cache_key);
+    if(entry && entry->data && (entry->mesh_hash == mesh_hash))
+    {
+        void *buff = btAlignedAlloc(entry->size, 16);
+        btOptimizedBvh *bvh;
+        memcpy(buff, entry->data, entry->size);
+        bvh = btOptimizedBvh::deSerializeInPlace(buff, entry->size, false);
+        if(bvh)
+        {
+            entry->used = 1;
+            bt_engine_bvh_cache.hits++;
+            return new btCachedBvhTriangleMeshShape(trimesh, useCompression, bvh);
         }
-        physics->manifoldArray->clear();
+        btAlignedFree(buff);
     }
 
-    if(*cn)
+    ret = new btBvhTriangleMeshShape(trimesh, useCompression, true);
+    bt_engine_bvh_cache.misses++;
+    entry = (entry) ? (entry) : (BT_BvhCacheAddEntry(cache_key));
+    if(entry && ret->getOptimizedBvh())
     {
-        (*cn)->obj = NULL;
+        btOptimizedBvh *bvh = ret->getOptimizedBvh();
+        uint32_t size = bvh->calculateSerializeBufferSize();
+        btAlignedFree(entry->data);
+        entry->data = (uint8_t*)btAlignedAlloc(size, 16);
+        entry->size = 0;
+        entry->used = 0;
+        if(entry->data && bvh->serializeInPlace(entry->data, size, false))
+        {
+            entry->size = size;
+            entry->mesh_hash = mesh_hash;
+            entry->used = 1;
+            bt_engine_bvh_cache.dirty = 1;
+        }
     }
 
-    return physics->collision_track;
+    return ret;
 }
 
 
@@ -856,7 +1814,7 @@ btCollisionShape *BT_CSfromBBox(btScalar *bb_min, btScalar *bb_max)
 }
 
 
-btCollisionShape *BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, bool buildBvh, bool is_static)
+btCollisionShape *BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, bool buildBvh, bool is_static, uint32_t cache_key)
 {
     uint32_t cnt = 0;
     polygon_p p;
@@ -888,7 +1846,7 @@ btCollisionShape *BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, b
 
     if(is_static)
     {
-        ret = new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+        ret = BT_CSfromTrimesh(trimesh, useCompression, buildBvh, cache_key);
     }
     else
     {
@@ -1161,7 +2119,7 @@ uint32_t BT_AddSectorTweenToTrimesh(btTriangleMesh *trimesh, struct sector_tween
 }
 
 
-btCollisionShape *BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, uint32_t tweens_count, bool useCompression, bool buildBvh)
+btCollisionShape *BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, uint32_t tweens_count, bool useCompression, bool buildBvh, uint32_t cache_key)
 {
     uint32_t cnt = 0;
     btTriangleMesh *trimesh = new btTriangleMesh;
@@ -1183,7 +2141,7 @@ btCollisionShape *BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t s
         return NULL;
     }
 
-    ret = new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+    ret = BT_CSfromTrimesh(trimesh, useCompression, buildBvh, cache_key);
     return ret;
 }
 
@@ -1197,6 +2155,7 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
     btTransform startTransform;
     btCollisionShape *cshape = NULL;
 
+    Physics_SetCollisionFrozen(physics, 0);
     Physics_DeleteRigidBody(physics);
     if(physics->bt_info)
     {
@@ -1212,6 +2171,8 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
                 physics->bt_body = (btRigidBody**)malloc(physics->objects_count * sizeof(btRigidBody*));
                 physics->bt_info = (struct kinematic_info_s*)malloc(physics->objects_count * sizeof(struct kinematic_info_s));
                 physics->bt_info->has_collisions = true;
+                physics->bt_info->body_restore = false;
+                physics->bt_info->ghost_restore = false;
 
                 float hx = (bf->bb_max[0] - bf->bb_min[0]) * 0.5f;
                 float hy = (bf->bb_max[1] - bf->bb_min[1]) * 0.5f;
@@ -1236,6 +2197,8 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
                 physics->bt_body = (btRigidBody**)malloc(physics->objects_count * sizeof(btRigidBody*));
                 physics->bt_info = (struct kinematic_info_s*)malloc(physics->objects_count * sizeof(struct kinematic_info_s));
                 physics->bt_info->has_collisions = true;
+                physics->bt_info->body_restore = false;
+                physics->bt_info->ghost_restore = false;
 
                 cshape = new btSphereShape(getInnerBBRadius(bf->bb_min, bf->bb_max));
                 cshape->calculateLocalInertia(0.0, localInertia);
@@ -1262,6 +2225,8 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
                     base_mesh_p mesh = bf->bone_tags[i].mesh_base;
                     cshape = NULL;
                     physics->bt_info[i].has_collisions = false;
+                    physics->bt_info[i].body_restore = false;
+                    physics->bt_info[i].ghost_restore = false;
                     switch(physics->cont->collision_shape)
                     {
                         case COLLISION_SHAPE_TRIMESH_CONVEX:
@@ -1343,6 +2308,7 @@ void Physics_DeleteRigidBody(struct physics_data_s *physics)
  */
 void Physics_CreateGhosts(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct ghost_shape_s *shape_info)
 {
+    Physics_SetCollisionFrozen(physics, 0);
     if(physics->objects_count > 0)
     {
         btTransform tr;
@@ -1486,6 +2452,7 @@ void Physics_SetGhostCollisionShape(struct physics_data_s *physics, struct ss_bo
 
             case COLLISION_NONE:
                 bt_engine_dynamicsWorld->removeCollisionObject(physics->ghost_objects[index]);
+                physics->bt_info[index].ghost_restore = false;
                 break;
         };
 
@@ -1495,7 +2462,11 @@ void Physics_SetGhostCollisionShape(struct physics_data_s *physics, struct ss_bo
             physics->ghosts_info[index] = *shape_info;
             physics->ghost_objects[index]->setCollisionShape(new_shape);
             physics->ghost_objects[index]->getCollisionShape()->setMargin(COLLISION_MARGIN_DEFAULT);
-            if(!physics->ghost_objects[index]->getBroadphaseHandle())
+            if(physics->frozen)
+            {
+                physics->bt_info[index].ghost_restore = true;
+            }
+            else if(!physics->ghost_objects[index]->getBroadphaseHandle())
             {
                 bt_engine_dynamicsWorld->addCollisionObject(physics->ghost_objects[index], btBroadphaseProxy::SensorTrigger, btBroadphaseProxy::AllFilter & ~btBroadphaseProxy::SensorTrigger);
             }
@@ -1529,7 +2500,7 @@ void Physics_GenStaticMeshRigidBody(struct static_mesh_s *smesh)
             break;
 
         case COLLISION_SHAPE_TRIMESH:
-            cshape = BT_CSfromMesh(smesh->mesh, true, true, true);
+            cshape = BT_CSfromMesh(smesh->mesh, true, true, true, BVH_CACHE_KEY_STATIC_MESH | smesh->mesh->id);
             break;
 
         case COLLISION_SHAPE_TRIMESH_CONVEX:
@@ -1547,6 +2518,8 @@ void Physics_GenStaticMeshRigidBody(struct static_mesh_s *smesh)
         btTransform startTransform;
         startTransform.setFromOpenGLMatrix(smesh->transform);
         smesh->physics_body = (struct physics_object_s*)malloc(sizeof(struct physics_object_s));
+        smesh->physics_body->frozen = false;
+        smesh->physics_body->restore = false;
         btDefaultMotionState* motionState = new btDefaultMotionState(startTransform);
         smesh->physics_body->bt_body = new btRigidBody(0.0, motionState, cshape, localInertia);
         cshape->setMargin(COLLISION_MARGIN_DEFAULT);
@@ -1560,7 +2533,8 @@ void Physics_GenStaticMeshRigidBody(struct static_mesh_s *smesh)
 
 struct physics_object_s* Physics_GenRoomRigidBody(struct room_s *room, struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, int num_tweens)
 {
-    btCollisionShape *cshape = BT_CSfromHeightmap(heightmap, sectors_count, tweens, num_tweens, true, true);
+    uint32_t cache_key = ((heightmap) ? (BVH_CACHE_KEY_ROOM) : (BVH_CACHE_KEY_ROOM_TWEENS)) | room->id;
+    btCollisionShape *cshape = BT_CSfromHeightmap(heightmap, sectors_count, tweens, num_tweens, true, true, cache_key);
     struct physics_object_s *ret = NULL;
 
     if(cshape)
@@ -1569,6 +2543,8 @@ struct physics_object_s* Physics_GenRoomRigidBody(struct room_s *room, struct ro
         btTransform tr;
         tr.setFromOpenGLMatrix(room->transform);
         ret = (struct physics_object_s*)malloc(sizeof(struct physics_object_s));
+        ret->frozen = false;
+        ret->restore = false;
         btDefaultMotionState* motionState = new btDefaultMotionState(tr);
         cshape->setMargin(COLLISION_MARGIN_DEFAULT);
         ret->bt_body = new btRigidBody(0.0, motionState, cshape, localInertia);
@@ -1611,24 +2587,60 @@ void Physics_DeleteObject(struct physics_object_s *obj)
         bt_engine_dynamicsWorld->removeRigidBody(obj->bt_body);
         delete obj->bt_body;
         free(obj);
+        bt_engine_static_revision++;
     }
 }
 
 
 void Physics_EnableObject(struct physics_object_s *obj)
 {
-    if(obj->bt_body && !obj->bt_body->isInWorld())
+    if(obj->frozen)
+    {
+        obj->restore = true;
+    }
+    else if(obj->bt_body && !obj->bt_body->isInWorld())
     {
         bt_engine_dynamicsWorld->addRigidBody(obj->bt_body, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter);
+        bt_engine_static_revision++;
     }
 }
 
 
 void Physics_DisableObject(struct physics_object_s *obj)
 {
-    if(obj->bt_body && obj->bt_body->isInWorld())
+    if(obj->frozen)
+    {
+        obj->restore = false;
+    }
+    else if(obj->bt_body && obj->bt_body->isInWorld())
     {
         bt_engine_dynamicsWorld->removeRigidBody(obj->bt_body);
+        bt_engine_static_revision++;
+    }
+}
+
+
+void Physics_SetObjectFrozen(struct physics_object_s *obj, int frozen)
+{
+    if(frozen && !obj->frozen)
+    {
+        obj->restore = obj->bt_body && obj->bt_body->isInWorld();
+        if(obj->restore)
+        {
+            bt_engine_dynamicsWorld->removeRigidBody(obj->bt_body);
+            bt_engine_static_revision++;
+        }
+        obj->frozen = true;
+    }
+    else if(!frozen && obj->frozen)
+    {
+        obj->frozen = false;
+        if(obj->restore && !obj->bt_body->isInWorld())
+        {
+            bt_engine_dynamicsWorld->addRigidBody(obj->bt_body, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter);
+            bt_engine_static_revision++;
+        }
+        obj->restore = false;
     }
 }
 
@@ -1640,7 +2652,21 @@ void Physics_DisableObject(struct physics_object_s *obj)
  */
 void Physics_EnableCollision(struct physics_data_s *physics)
 {
-    if(physics->bt_body)
+    if(physics->bt_body && physics->frozen)
+    {
+        for(uint32_t i = 0; i < physics->objects_count; i++)
+        {
+            if(physics->bt_body[i] && physics->bt_info[i].has_collisions && !physics->bt_info[i].body_restore)
+            {
+                physics->bt_info[i].body_restore = true;
+                physics->bt_info[i].group = physics->collision_group;
+                physics->bt_info[i].mask = physics->collision_mask;
+            }
+            physics->bt_info[i].ghost_restore |= (physics->ghost_objects && physics->ghost_objects[i] &&
+                                                  (physics->ghosts_info[i].shape_id != COLLISION_NONE));
+        }
+    }
+    else if(physics->bt_body)
     {
         for(uint32_t i = 0; i < physics->objects_count; i++)
         {
@@ -1662,7 +2688,15 @@ void Physics_EnableCollision(struct physics_data_s *physics)
 
 void Physics_DisableCollision(struct physics_data_s *physics)
 {
-    if(physics->bt_body != NULL)
+    if((physics->bt_body != NULL) && physics->frozen)
+    {
+        for(uint32_t i = 0; i < physics->objects_count; i++)
+        {
+            physics->bt_info[i].body_restore = false;
+            physics->bt_info[i].ghost_restore = false;
+        }
+    }
+    else if(physics->bt_body != NULL)
     {
         for(uint32_t i = 0; i < physics->objects_count; i++)
         {
@@ -1682,12 +2716,84 @@ void Physics_DisableCollision(struct physics_data_s *physics)
 }
 
 
+/**
+ * Frozen entity bodies, ghosts and ragdoll joints are out of the world; each
+ * body keeps its broadphase filter to be restored exactly as it was.
+ */
+void Physics_SetCollisionFrozen(struct physics_data_s *physics, int frozen)
+{
+    if((physics->bt_body == NULL) || ((frozen != 0) == physics->frozen))
+    {
+        return;
+    }
+
+    if(frozen)
+    {
+        for(uint32_t i = 0; i < physics->bt_joint_count; i++)
+        {
+            if(physics->bt_joints[i])
+            {
+                bt_engine_dynamicsWorld->removeConstraint(physics->bt_joints[i]);
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < physics->objects_count; i++)
+    {
+        btRigidBody *b = physics->bt_body[i];
+        btPairCachingGhostObject *g = (physics->ghost_objects) ? (physics->ghost_objects[i]) : (NULL);
+        struct kinematic_info_s *info = physics->bt_info + i;
+        if(frozen)
+        {
+            info->body_restore = b && b->isInWorld();
+            if(info->body_restore)
+            {
+                info->group = b->getBroadphaseHandle()->m_collisionFilterGroup;
+                info->mask = b->getBroadphaseHandle()->m_collisionFilterMask;
+                bt_engine_dynamicsWorld->removeRigidBody(b);
+            }
+            info->ghost_restore = g && g->getBroadphaseHandle();
+            if(info->ghost_restore)
+            {
+                bt_engine_dynamicsWorld->removeCollisionObject(g);
+            }
+        }
+        else
+        {
+            if(info->body_restore && !b->isInWorld())
+            {
+                bt_engine_dynamicsWorld->addRigidBody(b, info->group, info->mask);
+            }
+            if(info->ghost_restore && !g->getBroadphaseHandle())
+            {
+                bt_engine_dynamicsWorld->addCollisionObject(g, btBroadphaseProxy::SensorTrigger, btBroadphaseProxy::AllFilter & ~btBroadphaseProxy::SensorTrigger);
+            }
+            info->body_restore = false;
+            info->ghost_restore = false;
+        }
+    }
+
+    if(!frozen)
+    {
+        for(uint32_t i = 0; i < physics->bt_joint_count; i++)
+        {
+            if(physics->bt_joints[i])
+            {
+                bt_engine_dynamicsWorld->addConstraint(physics->bt_joints[i], true);
+            }
+        }
+    }
+    physics->frozen = (frozen != 0);
+}
+
+
 void Physics_SetBoneCollision(struct physics_data_s *physics, int bone_index, int collision)
 {
     if(physics->bt_body && (bone_index >= 0) && (bone_index < physics->objects_count))
     {
         btRigidBody *b = physics->bt_body[bone_index];
         physics->bt_info[bone_index].has_collisions = collision;
+        physics->bt_info[bone_index].body_restore &= (collision != 0);
 
         if(b && !collision && b->isInWorld())
         {
@@ -1721,6 +2827,8 @@ void Physics_SetCollisionGroupAndMask(struct physics_data_s *physics, int16_t gr
                 b->getBroadphaseHandle()->m_collisionFilterGroup = physics->collision_group;
                 b->getBroadphaseHandle()->m_collisionFilterMask = physics->collision_mask;
             }
+            physics->bt_info[i].group = physics->collision_group;
+            physics->bt_info[i].mask = physics->collision_mask;
         }
     }
 }
@@ -1728,6 +2836,7 @@ void Physics_SetCollisionGroupAndMask(struct physics_data_s *physics, int16_t gr
 
 void Physics_SetCollisionScale(struct physics_data_s *physics, float scaling[3])
 {
+    Physics_SetCollisionFrozen(physics, 0);
     for(int i = 0; i < physics->objects_count; i++)
     {
         bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
@@ -1742,6 +2851,7 @@ void Physics_SetCollisionScale(struct physics_data_s *physics, float scaling[3])
 void Physics_SetBodyMass(struct physics_data_s *physics, float mass, uint16_t index)
 {
     btVector3 inertia (0.0, 0.0, 0.0);
+    Physics_SetCollisionFrozen(physics, 0);
     bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[index]);
 
         physics->bt_body[index]->getCollisionShape()->calculateLocalInertia(mass, inertia);
@@ -1774,291 +2884,207 @@ void Physics_SetLinearFactor(struct physics_data_s *physics, float factor[3], ui
 
 
 /* *****************************************************************************
- * ************************  HAIR DATA  ****************************************
+ * ************************  RAGDOLL DATA  *************************************
  * ****************************************************************************/
 
-typedef struct hair_element_s
-{
-    struct base_mesh_s         *mesh;              // Pointer to rendered mesh.
-    btCollisionShape           *shape;             // Pointer to collision shape.
-    btRigidBody                *body;              // Pointer to dynamic body.
-    btGeneric6DofConstraint    *joint;             // Array of joints.
-}hair_element_t, *hair_element_p;
-
-
-typedef struct hair_s
+/*
+ * Ragdoll constraints are built in place in equal blocks (size of the biggest
+ * joint type) from the free list, released blocks go back to it, so after the
+ * first deaths in a level ragdolls do not allocate. Bodies and shapes are the
+ * entity's own ones, ragdoll only changes their mass and filters.
+ * Ragdoll that stays below sleeping threshold for RD_SETTLE_TIME is baked:
+ * joints are released and bodies become static in the last pose. Distant
+ * ragdolls get less solver iterations.
+ */
+#define RD_SIZE_MAX(a, b)           (((a) > (b)) ? (a) : (b))
+#define RD_JOINT_BLOCK_SIZE         RD_SIZE_MAX(sizeof(btPoint2PointConstraint), RD_SIZE_MAX(sizeof(btHingeConstraint), sizeof(btConeTwistConstraint)))
+#define RD_SETTLE_TIME              (0.5f)
+#define RD_LOD_NEAR_DIST            (4096.0f)                                   // default solver iterations
+#define RD_LOD_FAR_DIST             (12288.0f)
+#define RD_LOD_MID_ITERATIONS       (4)
+#define RD_LOD_FAR_ITERATIONS       (2)
+
+static struct
 {
-    engine_container_p        container;
-    uint32_t                  owner_body;         // Owner entity's body ID.
-
-    uint8_t                   root_index;         // Index of "root" element.
-    uint8_t                   tail_index;         // Index of "tail" element.
-
-    uint8_t                   element_count;      // Overall amount of elements.
-    hair_element_s           *elements;           // Array of elements.
-
-    uint8_t                   vertex_map_count;
-    uint32_t                 *hair_vertex_map;    // Hair vertex indices to link
-    uint32_t                 *head_vertex_map;    // Head vertex indices to link
+    void                      **free_blocks;
+    uint32_t                    free_count;
+    uint32_t                    blocks_count;                                   // free_blocks capacity
+    struct physics_data_s     **active;                                         // simulated, not baked ragdolls
+    uint32_t                    active_count;
+    uint32_t                    active_size;
+    float                       lod_origin[3];
+}bt_engine_ragdolls;
 
-}hair_t, *hair_p;
 
-
-struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics)
+static void *Ragdoll_NewJointBlock()
 {
-    // No setup or parent to link to - bypass function.
-
-    if(!physics || !setup || (setup->link_body >= physics->objects_count) ||
-       !physics->bt_body[setup->link_body])
+    if(bt_engine_ragdolls.free_count > 0)
     {
-        return NULL;
+        return bt_engine_ragdolls.free_blocks[--bt_engine_ragdolls.free_count];
     }
 
-    skeletal_model_p model = World_GetModelByID(setup->model_id);
-    if((!model) || (model->mesh_count == 0))
+    // free list can hold every block, so releasing never fails
+    void **new_blocks = (void**)realloc(bt_engine_ragdolls.free_blocks, (bt_engine_ragdolls.blocks_count + 1) * sizeof(void*));
+    if(new_blocks == NULL)
     {
         return NULL;
     }
+    bt_engine_ragdolls.free_blocks = new_blocks;
+    bt_engine_ragdolls.blocks_count++;
+    return btAlignedAlloc(RD_JOINT_BLOCK_SIZE, 16);
+}
 
-    // Setup engine container. FIXME: DOESN'T WORK PROPERLY ATM.
-    struct hair_s *hair = (struct hair_s*)calloc(1, sizeof(struct hair_s));
-    hair->container = Container_Create();
-    hair->container->collision_group = COLLISION_GROUP_DYNAMICS_NI;
-    hair->container->collision_mask = COLLISION_GROUP_STATIC_ROOM | COLLISION_GROUP_STATIC_OBLECT | COLLISION_GROUP_KINEMATIC | COLLISION_GROUP_CHARACTERS;
-    hair->container->collision_shape = COLLISION_SHAPE_TRIMESH;
-    hair->container->object_type = OBJECT_HAIR;
-    hair->container->object = hair;
-    hair->container->room = physics->cont->room;
-
-    // Setup initial hair parameters.
-    hair->owner_body = setup->link_body;    // Entity body to refer to.
-
-    // Setup initial position / angles.
-    btTransform startTransform = physics->bt_body[hair->owner_body]->getWorldTransform();
-    // Number of elements (bodies) is equal to number of hair meshes.
-
-    hair->element_count = model->mesh_count;
-    hair->elements      = (hair_element_p)calloc(hair->element_count, sizeof(hair_element_t));
-
-    // Root index should be always zero, as it is how engine determines that it is
-    // connected to head and renders it properly. Tail index should be always the
-    // last element of the hair, as it indicates absence of "child" constraint.
-
-    hair->root_index = 0;
-    hair->tail_index = hair->element_count - 1;
-
-    // Weight step is needed to determine the weight of each hair body.
-    // It is derived from root body weight and tail body weight.
-
-    btScalar weight_step = ((setup->root_weight - setup->tail_weight) / hair->element_count);
-    btScalar current_weight = setup->root_weight;
 
-    for(uint32_t i = 0; i < hair->element_count; i++)
+static void Ragdoll_FreeJointBlock(void *block)
+{
+    if(block)
     {
-        // Point to corresponding mesh.
-
-        hair->elements[i].mesh = model->mesh_tree[i].mesh_base;
-
-        // Begin creating ACTUAL physical hair mesh.
-        btVector3   localInertia(0, 0, 0);
-
-        // Make collision shape out of mesh.
-        hair->elements[i].shape = BT_CSfromMesh(hair->elements[i].mesh, true, true, false);
-        hair->elements[i].shape->calculateLocalInertia((current_weight * setup->hair_inertia), localInertia);
-        hair->elements[i].joint = NULL;
-
-        // Decrease next body weight to weight_step parameter.
-        current_weight -= weight_step;
-
-        // Initialize motion state for body.
-        btDefaultMotionState* motionState = new btDefaultMotionState(startTransform);
-
-        // Make rigid body.
-        hair->elements[i].body = new btRigidBody(current_weight, motionState, hair->elements[i].shape, localInertia);
-
-        // Damping makes body stop in space by itself, to prevent it from continous movement.
-        hair->elements[i].body->setDamping(setup->hair_damping[0], setup->hair_damping[1]);
-
-        // Restitution and friction parameters define "bounciness" and "dullness" of hair.
-        hair->elements[i].body->setRestitution(setup->hair_restitution);
-        hair->elements[i].body->setFriction(setup->hair_friction);
-
-        // Since hair is always moving with Lara, even if she's in still state (like, hanging
-        // on a ledge), hair bodies shouldn't deactivate over time.
-        hair->elements[i].body->forceActivationState(DISABLE_DEACTIVATION);
-
-        // Hair bodies must not collide with each other, and also collide ONLY with kinematic
-        // bodies (e. g. animated meshes), or else Lara's ghost object or anything else will be able to
-        // collide with hair!
-        hair->elements[i].body->setUserPointer(hair->container);
-        bt_engine_dynamicsWorld->addRigidBody(hair->elements[i].body, btBroadphaseProxy::DebrisFilter, btBroadphaseProxy::DefaultFilter | btBroadphaseProxy::StaticFilter | btBroadphaseProxy::KinematicFilter | btBroadphaseProxy::CharacterFilter);
-
-        hair->elements[i].body->activate();
+        bt_engine_ragdolls.free_blocks[bt_engine_ragdolls.free_count++] = block;
     }
+}
 
-    // GENERATE CONSTRAINTS.
-    // All constraints are generic 6-DOF type, as they seem perfect fit for hair.
-
-    // If multiple joints per body is specified, joints are placed in circular manner,
-    // with obvious step of (SIMD_2_PI) / joint count. It means that all joints will form
-    // circle-like figure.
-
-    for(uint32_t i = 0; i < hair->element_count; i++)
-    {
-        btRigidBody* prev_body;
-        btScalar     body_length;
-
-        // Each body width and height are used to calculate position of each joint.
-
-        //btScalar body_width = fabs(hair->elements[i].mesh->bb_max[0] - hair->elements[i].mesh->bb_min[0]);
-        //btScalar body_depth = fabs(hair->elements[i].mesh->bb_max[3] - hair->elements[i].mesh->bb_min[3]);
 
-        btTransform localA; localA.setIdentity();
-        btTransform localB; localB.setIdentity();
+static void Ragdoll_ClearPool()
+{
+    for(uint32_t i = 0; i < bt_engine_ragdolls.free_count; i++)
+    {
+        btAlignedFree(bt_engine_ragdolls.free_blocks[i]);
+    }
+    free(bt_engine_ragdolls.free_blocks);
+    free(bt_engine_ragdolls.active);
+    bt_engine_ragdolls.free_blocks = NULL;
+    bt_engine_ragdolls.free_count = 0;
+    bt_engine_ragdolls.blocks_count = 0;
+    bt_engine_ragdolls.active = NULL;
+    bt_engine_ragdolls.active_count = 0;
+    bt_engine_ragdolls.active_size = 0;
+}
 
-        btScalar joint_x = 0.0;
-        btScalar joint_y = 0.0;
 
-        if(i == 0)  // First joint group
+static void Ragdoll_AddActive(struct physics_data_s *physics)
+{
+    if(bt_engine_ragdolls.active_count >= bt_engine_ragdolls.active_size)
+    {
+        uint32_t new_size = (bt_engine_ragdolls.active_size > 0) ? (bt_engine_ragdolls.active_size * 2) : (16);
+        struct physics_data_s **new_active = (struct physics_data_s**)realloc(bt_engine_ragdolls.active, new_size * sizeof(struct physics_data_s*));
+        if(new_active == NULL)
         {
-            // Adjust pivot point A to parent body.
-            localA.setOrigin(btVector3(setup->head_offset[0] + joint_x, setup->head_offset[1], setup->head_offset[2] + joint_y));
-            localA.getBasis().setEulerZYX(setup->root_angle[0], setup->root_angle[1], setup->root_angle[2]);
-
-            localB.setOrigin(btVector3(joint_x, 0.0, joint_y));
-            localB.getBasis().setEulerZYX(0,-SIMD_HALF_PI,0);
-
-            prev_body = physics->bt_body[hair->owner_body];                     // Previous body is parent body.
+            return;                                                             // simulated as usual, just never baked
         }
-        else
-        {
-            // Adjust pivot point A to previous mesh's length, considering mesh overlap multiplier.
-
-            body_length = fabs(hair->elements[i-1].mesh->bb_max[1] - hair->elements[i-1].mesh->bb_min[1]) * setup->joint_overlap;
-
-            localA.setOrigin(btVector3(joint_x, body_length, joint_y));
-            localA.getBasis().setEulerZYX(0,SIMD_HALF_PI,0);
-
-            // Pivot point B is automatically adjusted by Bullet.
+        bt_engine_ragdolls.active = new_active;
+        bt_engine_ragdolls.active_size = new_size;
+    }
+    bt_engine_ragdolls.active[bt_engine_ragdolls.active_count++] = physics;
+}
 
-            localB.setOrigin(btVector3(joint_x, 0.0, joint_y));
-            localB.getBasis().setEulerZYX(0,SIMD_HALF_PI,0);
 
-            prev_body = hair->elements[i-1].body;   // Previous body is preceiding hair mesh.
+static void Ragdoll_RemoveActive(struct physics_data_s *physics)
+{
+    for(uint32_t i = 0; i < bt_engine_ragdolls.active_count; i++)
+    {
+        if(bt_engine_ragdolls.active[i] == physics)
+        {
+            bt_engine_ragdolls.active[i] = bt_engine_ragdolls.active[--bt_engine_ragdolls.active_count];
+            break;
         }
+    }
+}
 
-        // Create 6DOF constraint.
-        hair->elements[i].joint = new btGeneric6DofConstraint(*prev_body, *(hair->elements[i].body), localA, localB, true);
 
-        // CFM and ERP parameters are critical for making joint "hard" and link
-        // to Lara's head. With wrong values, constraints may become "elastic".
-        for(int axis = 0; axis <= 5; axis++)
+static void Ragdoll_ReleaseJoints(struct physics_data_s *physics)
+{
+    for(uint32_t i = 0; i < physics->bt_joint_count; i++)
+    {
+        btTypedConstraint *joint = physics->bt_joints[i];
+        if(joint)
         {
-            hair->elements[i].joint->setParam(BT_CONSTRAINT_STOP_CFM, setup->joint_cfm, axis);
-            hair->elements[i].joint->setParam(BT_CONSTRAINT_STOP_ERP, setup->joint_erp, axis);
+            if(!physics->frozen)
+            {
+                bt_engine_dynamicsWorld->removeConstraint(joint);
+            }
+            joint->~btTypedConstraint();
+            Ragdoll_FreeJointBlock(joint);
+            physics->bt_joints[i] = NULL;
         }
+    }
+    physics->bt_joint_count = 0;
+    Ragdoll_RemoveActive(physics);
+}
 
-        if(i == 0)
-        {
-            // First joint group should be more limited in motion, as it is connected
-            // right to the head. NB: Should we make it scriptable as well?
-            hair->elements[i].joint->setLinearLowerLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setLinearUpperLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setAngularLowerLimit(btVector3(-SIMD_HALF_PI,     0., -SIMD_HALF_PI*0.4));
-            hair->elements[i].joint->setAngularUpperLimit(btVector3(-SIMD_HALF_PI*0.3, 0.,  SIMD_HALF_PI*0.4));
 
-            // Increased solver iterations make constraint even more stable.
-            hair->elements[i].joint->setOverrideNumSolverIterations(100);
-        }
-        else
+static void Ragdoll_MakeBodiesStatic(struct physics_data_s *physics)
+{
+    for(uint32_t i = 0; i < physics->objects_count; i++)
+    {
+        if(physics->bt_body[i]->isInWorld())
         {
-            // Normal joint with more movement freedom.
-            hair->elements[i].joint->setLinearLowerLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setLinearUpperLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setAngularLowerLimit(btVector3(-SIMD_HALF_PI*0.5, 0., -SIMD_HALF_PI*0.5));
-            hair->elements[i].joint->setAngularUpperLimit(btVector3( SIMD_HALF_PI*0.5, 0.,  SIMD_HALF_PI*0.5));
+            bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
         }
-        hair->elements[i].joint->setDbgDrawSize(btScalar(5.f));    // Draw constraint axes.
-
-        // Add constraint to the world.
-        bt_engine_dynamicsWorld->addConstraint(hair->elements[i].joint, true);
+        physics->bt_body[i]->setMassProps(0, btVector3(0.0, 0.0, 0.0));
+        physics->bt_body[i]->setLinearVelocity(btVector3(0.0, 0.0, 0.0));
+        physics->bt_body[i]->setAngularVelocity(btVector3(0.0, 0.0, 0.0));
+        bt_engine_dynamicsWorld->addRigidBody(physics->bt_body[i], btBroadphaseProxy::KinematicFilter, btBroadphaseProxy::AllFilter);
     }
-
-    return hair;
 }
 
 
-void Hair_Delete(struct hair_s *hair)
+static void Ragdoll_UpdateActivity(float time)
 {
-    if(hair)
+    const btScalar threshold2 = RD_DEFAULT_SLEEPING_THRESHOLD * RD_DEFAULT_SLEEPING_THRESHOLD;
+    btVector3 lod_origin(bt_engine_ragdolls.lod_origin[0], bt_engine_ragdolls.lod_origin[1], bt_engine_ragdolls.lod_origin[2]);
+
+    for(uint32_t i = 0; i < bt_engine_ragdolls.active_count;)
     {
-        for(int i = 0; i < hair->element_count; i++)
+        struct physics_data_s *physics = bt_engine_ragdolls.active[i];
+        bool settled = true;
+
+        if(physics->frozen)
         {
-            if(hair->elements[i].joint)
-            {
-                bt_engine_dynamicsWorld->removeConstraint(hair->elements[i].joint);
-                delete hair->elements[i].joint;
-                hair->elements[i].joint = NULL;
-            }
+            i++;
+            continue;
         }
 
-        for(int i = 0; i < hair->element_count; i++)
+        for(uint16_t j = 0; settled && (j < physics->objects_count); j++)
         {
-            if(hair->elements[i].body)
-            {
-                hair->elements[i].body->setUserPointer(NULL);
-                bt_engine_dynamicsWorld->removeRigidBody(hair->elements[i].body);
-                delete hair->elements[i].body;
-                hair->elements[i].body = NULL;
-            }
-            if(hair->elements[i].shape)
-            {
-                delete hair->elements[i].shape;
-                hair->elements[i].shape = NULL;
-            }
+            btRigidBody *b = physics->bt_body[j];
+            settled = !b->isActive() ||
+                      ((b->getLinearVelocity().length2() < threshold2) && (b->getAngularVelocity().length2() < threshold2));
         }
-        free(hair->elements);
-        hair->elements = NULL;
-        hair->element_count = 0;
-
-        hair->container = NULL;
-        hair->owner_body = 0;
-
-        hair->root_index = 0;
-        hair->tail_index = 0;
-
-        free(hair->container);
-        hair->container = NULL;
-
-        free(hair);
-    }
-}
 
+        physics->rd_settle_time = (settled) ? (physics->rd_settle_time + time) : (0.0f);
+        if(physics->rd_settle_time >= RD_SETTLE_TIME)
+        {
+            Ragdoll_ReleaseJoints(physics);                                     // last active ragdoll is moved to i
+            Ragdoll_MakeBodiesStatic(physics);
+            physics->rd_baked = true;
+            continue;
+        }
 
-void Hair_Update(struct hair_s *hair, struct physics_data_s *physics)
-{
-    if(hair && (hair->element_count > 0))
-    {
-        hair->container->room = physics->cont->room;
+        btScalar dist2 = (physics->bt_body[0]->getWorldTransform().getOrigin() - lod_origin).length2();
+        int iterations = -1;
+        if(dist2 > RD_LOD_FAR_DIST * RD_LOD_FAR_DIST)
+        {
+            iterations = RD_LOD_FAR_ITERATIONS;
+        }
+        else if(dist2 > RD_LOD_NEAR_DIST * RD_LOD_NEAR_DIST)
+        {
+            iterations = RD_LOD_MID_ITERATIONS;
+        }
+        for(uint16_t j = 0; j < physics->bt_joint_count; j++)
+        {
+            physics->bt_joints[j]->setOverrideNumSolverIterations(iterations);
+        }
+        i++;
     }
 }
 
-int Hair_GetElementsCount(struct hair_s *hair)
-{
-    return (hair)?(hair->element_count):(0);
-}
 
-void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16])
+void Ragdoll_SetLodOrigin(float pos[3])
 {
-    hair->elements[element].body->getWorldTransform().getOpenGLMatrix(tr);
-    *mesh = hair->elements[element].mesh;
+    vec3_copy(bt_engine_ragdolls.lod_origin, pos);
 }
 
 
-/* *****************************************************************************
- * ************************  RAGDOLL DATA  *************************************
- * ****************************************************************************/
-
 bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct rd_setup_s *setup)
 {
     // No entity, setup or body count overflow - bypass function.
@@ -2070,15 +3096,18 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
 
     bool result = true;
 
+    Physics_SetCollisionFrozen(physics, 0);                                     // ragdoll sets its own filters
+
     // If ragdoll already exists, overwrite it with new one.
 
-    if(physics->bt_joint_count > 0)
+    if((physics->bt_joint_count > 0) || physics->rd_baked)
     {
         result = Ragdoll_Delete(physics);
     }
 
     // Setup bodies.
     physics->bt_joint_count = 0;
+    physics->rd_settle_time = 0.0f;
     // update current character animation and full fix body to avoid starting ragdoll partially inside the wall or floor...
     for(uint32_t i = 0; i < setup->body_count; i++)
     {
@@ -2125,8 +3154,18 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
     }
 
     // Setup constraints.
-    physics->bt_joint_count = setup->joint_count;
-    physics->bt_joints = (btTypedConstraint**)calloc(physics->bt_joint_count, sizeof(btTypedConstraint*));
+    if(physics->bt_joints_size < setup->joint_count)
+    {
+        free(physics->bt_joints);
+        physics->bt_joints = (btTypedConstraint**)malloc(setup->joint_count * sizeof(btTypedConstraint*));
+        physics->bt_joints_size = (physics->bt_joints) ? (setup->joint_count) : (0);
+    }
+    for(uint16_t i = 0; i < physics->bt_joints_size; i++)
+    {
+        physics->bt_joints[i] = NULL;
+    }
+    physics->bt_joint_count = (physics->bt_joints_size >= setup->joint_count) ? (setup->joint_count) : (0);
+    result = result && (physics->bt_joint_count == setup->joint_count);
 
     for(int i = 0; i < physics->bt_joint_count; i++)
     {
@@ -2140,7 +3179,8 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
         btTransform localA, localB;
         ss_bone_tag_p btB = bf->bone_tags + setup->joint_setup[i].body_index;
         ss_bone_tag_p btA = btB->parent;
-        if(btA == NULL)
+        void *block;
+        if((btA == NULL) || ((block = Ragdoll_NewJointBlock()) == NULL))
         {
             result = false;
             break;
@@ -2162,14 +3202,14 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
         {
             case RD_CONSTRAINT_POINT:
                 {
-                    btPoint2PointConstraint* pointC = new btPoint2PointConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA.getOrigin(), localB.getOrigin());
+                    btPoint2PointConstraint* pointC = new(block) btPoint2PointConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA.getOrigin(), localB.getOrigin());
                     physics->bt_joints[i] = pointC;
                 }
                 break;
 
             case RD_CONSTRAINT_HINGE:
                 {
-                    btHingeConstraint* hingeC = new btHingeConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
+                    btHingeConstraint* hingeC = new(block) btHingeConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
                     hingeC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], 0.9, 0.3, 0.3);
                     physics->bt_joints[i] = hingeC;
                 }
@@ -2177,11 +3217,21 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
 
             case RD_CONSTRAINT_CONE:
                 {
-                    btConeTwistConstraint* coneC = new btConeTwistConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
+                    btConeTwistConstraint* coneC = new(block) btConeTwistConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
                     coneC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], setup->joint_setup[i].joint_limit[2], 0.9, 0.3, 0.7);
                     physics->bt_joints[i] = coneC;
                 }
                 break;
+
+            default:
+                Ragdoll_FreeJointBlock(block);
+                result = false;
+                break;
+        }
+
+        if(physics->bt_joints[i] == NULL)
+        {
+            break;
         }
 
         physics->bt_joints[i]->setParam(BT_CONSTRAINT_STOP_CFM, setup->joint_cfm, -1);
@@ -2195,6 +3245,10 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
     {
         Ragdoll_Delete(physics);  // PARANOID: Clean up the mess, if something went wrong.
     }
+    else if(physics->bt_joint_count > 0)
+    {
+        Ragdoll_AddActive(physics);                                             // no joints - nothing to bake
+    }
 
     physics->cont->collision_group = COLLISION_GROUP_DYNAMICS_NI;
 
@@ -2204,34 +3258,17 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
 
 bool Ragdoll_Delete(struct physics_data_s *physics)
 {
-    if(physics->bt_joint_count == 0)
+    if((physics->bt_joint_count == 0) && !physics->rd_baked)
     {
         return false;
     }
 
-    for(uint32_t i = 0; i < physics->bt_joint_count; i++)
-    {
-        if(physics->bt_joints[i])
-        {
-            bt_engine_dynamicsWorld->removeConstraint(physics->bt_joints[i]);
-            delete physics->bt_joints[i];
-            physics->bt_joints[i] = NULL;
-        }
-    }
-
-    for(uint32_t i = 0; i < physics->objects_count; i++)
-    {
-        if(physics->bt_body[i]->isInWorld())
-        {
-            bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
-        }
-        physics->bt_body[i]->setMassProps(0, btVector3(0.0, 0.0, 0.0));
-        bt_engine_dynamicsWorld->addRigidBody(physics->bt_body[i], btBroadphaseProxy::KinematicFilter, btBroadphaseProxy::AllFilter);
-    }
+    Physics_SetCollisionFrozen(physics, 0);
+    Ragdoll_ReleaseJoints(physics);
+    Ragdoll_MakeBodiesStatic(physics);
 
-    free(physics->bt_joints);
-    physics->bt_joints = NULL;
-    physics->bt_joint_count = 0;
+    physics->rd_baked = false;
+    physics->rd_settle_time = 0.0f;
     physics->cont->collision_group = COLLISION_GROUP_CHARACTERS;
 
     return true;
@@ -50,6 +50,305 @@ static __inline GLuint NextPowerOf2(GLuint in)
 #define ARRAY_CAPACITY_INCREASE_STEP (32)
 #define WHITE_TEXTURE_INDEX          (0x8000)
 
+#define PAGE_ALPHA_OPAQUE            (0)
+#define PAGE_ALPHA_COLOUR_KEY        (1)                                        // only 0 and 255 alpha values
+#define PAGE_ALPHA_BLENDED           (2)
+
+/*!
+ * Classifies alpha channel of the RGBA page to select its storage format.
+ */
+static int PageAlphaType(const GLubyte *data, unsigned long pixels)
+{
+    int ret = PAGE_ALPHA_OPAQUE;
+    for (unsigned long i = 0; i < pixels; i++)
+    {
+        GLubyte a = data[i * 4 + 3];
+        if (a == 0x00)
+            ret = PAGE_ALPHA_COLOUR_KEY;
+        else if (a != 0xFF)
+            return PAGE_ALPHA_BLENDED;
+    }
+    return ret;
+}
+
+/*!
+ * Builds the next mip level with a 2x2 box filter. Colours are weighted by alpha, so colour keyed (black transparent) texels do not darken their opaque neighbours. Tiles are never mixed as long as 2^level does not exceed the border width.
+ */
+static void DownsampleMipLevel(GLubyte *dst, const GLubyte *src, unsigned w, unsigned h)
+{
+    unsigned dw = (w > 1) ? (w / 2) : 1;
+    unsigned dh = (h > 1) ? (h / 2) : 1;
+    unsigned step_x = (w > 1) ? 4 : 0;
+    unsigned step_y = (h > 1) ? (w * 4) : 0;
+
+    for (unsigned y = 0; y < dh; y++)
+    {
+        for (unsigned x = 0; x < dw; x++)
+        {
+            const GLubyte *t0 = src + ((y * 2) * w + x * 2) * 4;
+            if (h == 1)
+                t0 = src + (x * 2) * 4;
+            const GLubyte *t1 = t0 + step_x;
+            const GLubyte *t2 = t0 + step_y;
+            const GLubyte *t3 = t2 + step_x;
+            GLubyte *d = dst + (y * dw + x) * 4;
+            unsigned a = t0[3] + t1[3] + t2[3] + t3[3];
+
+            for (int c = 0; c < 3; c++)
+            {
+                if (a > 0)
+                    d[c] = (t0[c] * t0[3] + t1[c] * t1[3] + t2[c] * t2[3] + t3[c] * t3[3] + a / 2) / a;
+                else
+                    d[c] = (t0[c] + t1[c] + t2[c] + t3[c] + 2) / 4;
+            }
+            d[3] = (a + 2) / 4;
+        }
+    }
+}
+
+static uint16_t PackColour565(const int c[3])
+{
+    return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void UnpackColour565(uint16_t v, int c[3])
+{
+    c[0] = (v >> 11) & 0x1F;
+    c[1] = (v >> 5) & 0x3F;
+    c[2] = v & 0x1F;
+    c[0] = (c[0] << 3) | (c[0] >> 2);
+    c[1] = (c[1] << 2) | (c[1] >> 4);
+    c[2] = (c[2] << 3) | (c[2] >> 2);
+}
+
+/*!
+ * Encodes S3TC colour block of 16 RGBA texels: the bounding box diagonal is used as endpoints and every texel gets the nearest palette entry. With punch through alpha, texels with alpha < 128 use the transparent entry (DXT1 three colour mode).
+ */
+static void EncodeColourBlock(GLubyte *out, const GLubyte *texels, bool punch_through)
+{
+    int mn[3] = {255, 255, 255};
+    int mx[3] = {0, 0, 0};
+    bool transparent = false;
+    bool opaque = false;
+
+    for (int i = 0; i < 16; i++)
+    {
+        const GLubyte *t = texels + i * 4;
+        if (punch_through && (t[3] < 128))
+        {
+            transparent = true;
+            continue;
+        }
+        opaque = true;
+        for (int c = 0; c < 3; c++)
+        {
+            mn[c] = (t[c] < mn[c]) ? t[c] : mn[c];
+            mx[c] = (t[c] > mx[c]) ? t[c] : mx[c];
+        }
+    }
+
+    if (!opaque)
+    {
+        mn[0] = mn[1] = mn[2] = 0;
+        mx[0] = mx[1] = mx[2] = 0;
+    }
+    else
+    {
+        // Pick the box diagonal along the colours: flip channels that anticorrelate with the widest one
+        int ref = 0;
+        for (int c = 1; c < 3; c++)
+            ref = (mx[c] - mn[c] > mx[ref] - mn[ref]) ? c : ref;
+        for (int c = 0; c < 3; c++)
+        {
+            int cov = 0;
+            for (int i = 0; (c != ref) && (i < 16); i++)
+            {
+                const GLubyte *t = texels + i * 4;
+                if (!punch_through || (t[3] >= 128))
+                    cov += (2 * t[ref] - mn[ref] - mx[ref]) * (2 * t[c] - mn[c] - mx[c]);
+            }
+            if (cov < 0)
+            {
+                int t = mn[c];
+                mn[c] = mx[c];
+                mx[c] = t;
+            }
+        }
+    }
+
+    uint16_t c0 = PackColour565(mx);
+    uint16_t c1 = PackColour565(mn);
+    if ((transparent && (c0 > c1)) || (!transparent && (c0 < c1)))
+    {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    int palette[4][3];
+    int palette_size = transparent ? 3 : 4;
+    UnpackColour565(c0, palette[0]);
+    UnpackColour565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        if (transparent)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+        }
+        else
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+    }
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        const GLubyte *t = texels + i * 4;
+        uint32_t index = 3;
+        if (!punch_through || (t[3] >= 128))
+        {
+            int best = 0x7FFFFFFF;
+            for (int p = 0; p < palette_size; p++)
+            {
+                int dr = t[0] - palette[p][0];
+                int dg = t[1] - palette[p][1];
+                int db = t[2] - palette[p][2];
+                int d = dr * dr + dg * dg + db * db;
+                if (d < best)
+                {
+                    best = d;
+                    index = p;
+                }
+            }
+        }
+        indices |= index << (2 * i);
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = (indices >> 24) & 0xFF;
+}
+
+/*!
+ * Encodes DXT5 alpha block of 16 RGBA texels with the eight values interpolation mode.
+ */
+static void EncodeAlphaBlock(GLubyte *out, const GLubyte *texels)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        int a = texels[i * 4 + 3];
+        a0 = (a > a0) ? a : a0;
+        a1 = (a < a1) ? a : a1;
+    }
+
+    uint64_t indices = 0;
+    if (a0 > a1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            // s: steps from a1 to a0; palette is a0, a1, then interpolated from a0 to a1
+            int s = ((texels[i * 4 + 3] - a1) * 7 + (a0 - a1) / 2) / (a0 - a1);
+            uint64_t index = (s == 7) ? 0 : ((s == 0) ? 1 : (8 - s));
+            indices |= index << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+/*!
+ * Compresses one RGBA image to S3TC; returns size of the compressed data.
+ */
+static unsigned long CompressImageS3TC(GLubyte *out, const GLubyte *data, unsigned w, unsigned h, GLenum format)
+{
+    GLubyte texels[16 * 4];
+    GLubyte *block = out;
+
+    for (unsigned by = 0; by < h; by += 4)
+    {
+        for (unsigned bx = 0; bx < w; bx += 4)
+        {
+            for (unsigned i = 0; i < 16; i++)
+            {
+                unsigned x = bx + (i & 3);
+                unsigned y = by + (i >> 2);
+                x = (x < w) ? x : (w - 1);
+                y = (y < h) ? y : (h - 1);
+                memcpy(texels + i * 4, data + (y * w + x) * 4, 4);
+            }
+
+            if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            {
+                EncodeAlphaBlock(block, texels);
+                EncodeColourBlock(block + 8, texels, false);
+                block += 16;
+            }
+            else
+            {
+                EncodeColourBlock(block, texels, format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+                block += 8;
+            }
+        }
+    }
+
+    return block - out;
+}
+
+/*!
+ * Uploads one mip level of the bound texture in the selected internal format; buffer is used for converted data. Returns uploaded size in bytes.
+ */
+static unsigned long UploadMipLevel(GLint level, GLenum internal_format, const GLubyte *data, unsigned w, unsigned h, GLubyte *buffer)
+{
+    uint16_t *packed = (uint16_t *) buffer;
+    unsigned long pixels = w * h;
+    unsigned long size;
+
+    switch (internal_format)
+    {
+        case GL_RGB5:
+            for (unsigned long i = 0; i < pixels; i++)
+            {
+                const GLubyte *t = data + i * 4;
+                packed[i] = ((t[0] >> 3) << 11) | ((t[1] >> 2) << 5) | (t[2] >> 3);
+            }
+            qglTexImage2D(GL_TEXTURE_2D, level, GL_RGB5, (GLsizei) w, (GLsizei) h, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, buffer);
+            return pixels * 2;
+
+        case GL_RGB5_A1:
+            for (unsigned long i = 0; i < pixels; i++)
+            {
+                const GLubyte *t = data + i * 4;
+                packed[i] = ((t[0] >> 3) << 11) | ((t[1] >> 3) << 6) | ((t[2] >> 3) << 1) | (t[3] >> 7);
+            }
+            qglTexImage2D(GL_TEXTURE_2D, level, GL_RGB5_A1, (GLsizei) w, (GLsizei) h, 0, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, buffer);
+            return pixels * 2;
+
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            size = CompressImageS3TC(buffer, data, w, h, internal_format);
+            qglCompressedTexImage2DARB(GL_TEXTURE_2D, level, internal_format, (GLsizei) w, (GLsizei) h, 0, (GLsizei) size, buffer);
+            return size;
+
+        default:
+            qglTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, (GLsizei) w, (GLsizei) h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            return pixels * 4;
+    }
+}
+
 /*!
  * The bordered texture atlas used by the borderedTextureAtlas_CompareCanonicalTextureSizes function. Sadly, qsort does not allow passing this context through as a parameter, and the nonstandard extensions qsort_r/qsort_s which do are not supported on MinGW, so this has to be done as a global variable.
  */
@@ -173,6 +472,7 @@ bordered_texture_atlas::bordered_texture_atlas(int border,
 number_result_pages(0),
 result_page_width(0),
 result_page_height(NULL),
+uploaded_size(0),
 number_original_pages(page_count),
 original_pages(pages),
 number_file_object_textures(0),
@@ -493,9 +793,37 @@ unsigned long bordered_texture_atlas::getNumAtlasPages() const
     return number_result_pages;
 }
 
-void bordered_texture_atlas::createTextures(GLuint *textureNames)
+unsigned long bordered_texture_atlas::getUploadedSize() const
+{
+    return uploaded_size;
+}
+
+int bordered_texture_atlas::createTextures(GLuint *textureNames, int format, int mipLevels)
 {
     GLubyte *data = (GLubyte *) malloc(4 * result_page_width * result_page_width);
+    GLubyte *buffer = (GLubyte *) malloc(2 * result_page_width * result_page_width + 16);
+    GLubyte *mip_data[2];
+    bool s3tc = (format == TEXTURE_FORMAT_COMPRESSED) && (qglCompressedTexImage2DARB != NULL) &&
+                IsGLExtensionSupported("GL_EXT_texture_compression_s3tc");
+    int mip_levels = (mipLevels > 0) ? mipLevels : 0;
+
+    if (format == TEXTURE_FORMAT_COMPRESSED && !s3tc)
+        format = TEXTURE_FORMAT_16BIT;
+
+    // Deeper levels would mix neighbour tiles
+    if (border_width > 0)
+    {
+        int max_levels = 0;
+        while ((2 << max_levels) <= border_width)
+            max_levels++;
+        mip_levels = (mip_levels > max_levels) ? max_levels : mip_levels;
+    }
+    while ((mip_levels > 0) && ((result_page_width >> mip_levels) == 0))
+        mip_levels--;
+
+    mip_data[0] = (GLubyte *) malloc(result_page_width * result_page_width);
+    mip_data[1] = (GLubyte *) malloc(result_page_width * result_page_width / 4 + 16);
+    uploaded_size = 0;
 
     qglGenTextures((GLsizei) number_result_pages, textureNames);
 
@@ -634,61 +962,45 @@ void bordered_texture_atlas::createTextures(GLuint *textureNames)
             }
         }
 
-        qglBindTexture(GL_TEXTURE_2D, textureNames[page]);
-        qglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)result_page_width, (GLsizei) result_page_height[page], 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        if(qglGenerateMipmap != NULL)
+        // Choose storage of the page and upload it with CPU built mip chain
+        GLenum internal_format = GL_RGBA;
+        unsigned w = result_page_width;
+        unsigned h = result_page_height[page];
+        switch (PageAlphaType(data, w * h))
         {
-            qglGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else
-        {
-            int mip_level = 1;
-            int w = result_page_width / 2;
-            int h = result_page_height[page] / 2;
-            GLubyte *mip_data = (GLubyte *) malloc(4 * w * h);
+            case PAGE_ALPHA_OPAQUE:
+                internal_format = s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : ((format == TEXTURE_FORMAT_16BIT) ? GL_RGB5 : GL_RGBA);
+                break;
 
-            assert(w > 0 && h > 0);
-            for(int i = 0; i < h; i++)
-            {
-                for(int j = 0; j < w; j++)
-                {
-                    mip_data[i * w * 4 + j * 4 + 0] = 0.25 * ((int)data[i * w * 16 + j * 8 + 0] + (int)data[i * w * 16 + j * 8 + 4 + 0] + (int)data[i * w * 16 + w * 8 + j * 8 + 0] + (int)data[i * w * 16 + w * 8 + j * 8 + 4 + 0]);
-                    mip_data[i * w * 4 + j * 4 + 1] = 0.25 * ((int)data[i * w * 16 + j * 8 + 1] + (int)data[i * w * 16 + j * 8 + 4 + 1] + (int)data[i * w * 16 + w * 8 + j * 8 + 1] + (int)data[i * w * 16 + w * 8 + j * 8 + 4 + 1]);
-                    mip_data[i * w * 4 + j * 4 + 2] = 0.25 * ((int)data[i * w * 16 + j * 8 + 2] + (int)data[i * w * 16 + j * 8 + 4 + 2] + (int)data[i * w * 16 + w * 8 + j * 8 + 2] + (int)data[i * w * 16 + w * 8 + j * 8 + 4 + 2]);
-                    mip_data[i * w * 4 + j * 4 + 3] = 0.25 * ((int)data[i * w * 16 + j * 8 + 3] + (int)data[i * w * 16 + j * 8 + 4 + 3] + (int)data[i * w * 16 + w * 8 + j * 8 + 3] + (int)data[i * w * 16 + w * 8 + j * 8 + 4 + 3]);
-                }
-            }
+            case PAGE_ALPHA_COLOUR_KEY:
+                internal_format = s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : ((format == TEXTURE_FORMAT_16BIT) ? GL_RGB5_A1 : GL_RGBA);
+                break;
 
-            //char tgan[128];
-            //WriteTGAfile("mip_00.tga", data, result_page_width, result_page_height[page], 0);
-            //sprintf(tgan, "mip_%0.2d.tga", mip_level);
-            //WriteTGAfile(tgan, mip_data, w, h, 0);
-            qglTexImage2D(GL_TEXTURE_2D, mip_level, GL_RGBA, (GLsizei)w, (GLsizei)h, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip_data);
+            default:
+                internal_format = s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_RGBA;
+                break;
+        };
 
-            while((w > 1) && (h > 1) /*&& (mip_level < 4)*/)
-            {
-                mip_level++;
-                w /= 2; w = (w==0)?1:w;
-                h /= 2; h = (h==0)?1:h;
-                for(int i = 0; i < h; i++)
-                {
-                    for(int j = 0; j < w; j++)
-                    {
-                        mip_data[i * w * 4 + j * 4 + 0] = 0.25 * ((int)mip_data[i * w * 16 + j * 8 + 0] + (int)mip_data[i * w * 16 + j * 8 + 4 + 0] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 0] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 4 + 0]);
-                        mip_data[i * w * 4 + j * 4 + 1] = 0.25 * ((int)mip_data[i * w * 16 + j * 8 + 1] + (int)mip_data[i * w * 16 + j * 8 + 4 + 1] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 1] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 4 + 1]);
-                        mip_data[i * w * 4 + j * 4 + 2] = 0.25 * ((int)mip_data[i * w * 16 + j * 8 + 2] + (int)mip_data[i * w * 16 + j * 8 + 4 + 2] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 2] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 4 + 2]);
-                        mip_data[i * w * 4 + j * 4 + 3] = 0.25 * ((int)mip_data[i * w * 16 + j * 8 + 3] + (int)mip_data[i * w * 16 + j * 8 + 4 + 3] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 3] + (int)mip_data[i * w * 16 + w * 8 + j * 8 + 4 + 3]);
-                    }
-                }
-                //sprintf(tgan, "mip_%0.2d.tga", mip_level);
-                //WriteTGAfile(tgan, mip_data, w, h, 0);
-                qglTexImage2D(GL_TEXTURE_2D, mip_level, GL_RGBA, (GLsizei)w, (GLsizei)h, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip_data);
-            }
-            free(mip_data);
+        qglBindTexture(GL_TEXTURE_2D, textureNames[page]);
+        uploaded_size += UploadMipLevel(0, internal_format, data, w, h, buffer);
+        const GLubyte *mip_src = data;
+        for (int level = 1; level <= mip_levels; level++)
+        {
+            GLubyte *mip_dst = (level & 1) ? mip_data[0] : mip_data[1];
+            DownsampleMipLevel(mip_dst, mip_src, w, h);
+            w = (w > 1) ? (w / 2) : 1;
+            h = (h > 1) ? (h / 2) : 1;
+            uploaded_size += UploadMipLevel(level, internal_format, mip_dst, w, h, buffer);
+            mip_src = mip_dst;
         }
         qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
+    free(mip_data[1]);
+    free(mip_data[0]);
+    free(buffer);
     free(data);
+
+    return mip_levels;
 }
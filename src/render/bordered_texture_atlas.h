@@ -32,6 +32,16 @@
 #include "../core/polygon.h"
 #include "../vt/tr_types.h"
 
+/*!
+ * Storage formats of the atlas pages (render_settings_s::texture_format).
+ * 16 bit stores opaque pages as RGB565 and colour keyed pages as RGB5_A1;
+ * compressed uses S3TC DXT1 / DXT5 and falls back to 16 bit if not supported.
+ * Pages with semi transparent pixels that do not fit are kept as RGBA8.
+ */
+#define TEXTURE_FORMAT_RGBA8            (0)
+#define TEXTURE_FORMAT_16BIT            (1)
+#define TEXTURE_FORMAT_COMPRESSED       (2)
+
 class bordered_texture_atlas
 {
     /*!
@@ -83,6 +93,7 @@ class bordered_texture_atlas
     unsigned long number_result_pages;
     unsigned result_page_width;
     unsigned *result_page_height;
+    unsigned long uploaded_size;                // Bytes of all pages and mip levels sent to GL by createTextures.
     
     // Original data
     unsigned long number_original_pages;
@@ -166,6 +177,11 @@ public:
      * layout if none has happened so far.
      */
     unsigned long getNumAtlasPages() const;
+
+    /*!
+     * Returns size of the texture data uploaded by the last createTextures call.
+     */
+    unsigned long getUploadedSize() const;
     
     /*!
      * Returns height of specified file object texture.
@@ -179,8 +195,11 @@ public:
      * @param atlas The atlas.
      * @param textureNames The names of the textures.
      * @param additionalTextureNames How many texture names to create in addition to the needed ones.
+     * @param format Pages storage format, one of TEXTURE_FORMAT_*.
+     * @param mipLevels Wanted count of mip levels; they are built on CPU and limited by the border width.
+     * @return Count of mip levels that were uploaded (for GL_TEXTURE_MAX_LEVEL).
      */
-    void createTextures(GLuint *textureNames);
+    int createTextures(GLuint *textureNames, int format, int mipLevels);
 
 };
 
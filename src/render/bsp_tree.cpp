@@ -15,6 +15,12 @@
 #define NEED_REALLOC_VERTEX_BUFF      (2)
 #define NEED_REALLOC_TEMP_BUFF        (3)
 
+typedef struct bsp_node_backup_s
+{
+    struct bsp_node_s      *node;
+    struct bsp_node_s       data;
+} bsp_node_backup_t, *bsp_node_backup_p;
+
 struct bsp_node_s *CDynamicBSP::CreateBSPNode()
 {
     bsp_node_p ret = (bsp_node_p)(m_tree_buffer + m_tree_allocated);
@@ -27,6 +33,32 @@ struct bsp_node_s *CDynamicBSP::CreateBSPNode()
 }
 
 
+void CDynamicBSP::BackupNode(struct bsp_node_s *node)
+{
+    if((uint8_t*)node >= m_tree_buffer + m_static_tree_allocated)
+    {
+        return;                                                                 // not a static node
+    }
+
+    if(m_node_backups_count >= m_node_backups_size)
+    {
+        uint32_t new_size = (m_node_backups_size > 0) ? (m_node_backups_size * 2) : (256);
+        bsp_node_backup_p new_backups = (bsp_node_backup_p)realloc(m_node_backups, new_size * sizeof(bsp_node_backup_t));
+        if(new_backups == NULL)
+        {
+            m_realloc_state = NEED_REALLOC_TREE_BUFF;                           // forces full rebuild
+            return;
+        }
+        m_node_backups = new_backups;
+        m_node_backups_size = new_size;
+    }
+
+    m_node_backups[m_node_backups_count].node = node;
+    m_node_backups[m_node_backups_count].data = *node;
+    m_node_backups_count++;
+}
+
+
 struct polygon_s *CDynamicBSP::CreatePolygon(uint16_t vertex_count)
 {
     polygon_p ret = (polygon_p)(m_temp_buffer + m_temp_allocated);
@@ -58,6 +90,7 @@ void CDynamicBSP::AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p)
 
     //vertex_p v = m_vertex_buffer + m_vertex_allocated;
     //vertex_p pv = p->vertices;
+    this->BackupNode(leaf);
     memcpy(m_vertex_buffer + m_vertex_allocated, p->vertices, p->vertex_count * sizeof(vertex_t));
     for(uint16_t i = 0; i < p->vertex_count; i++/*, v++, pv++*/)
     {
@@ -101,6 +134,7 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
     if(root->polygons_front == NULL)
     {
         // we though root->front == NULL and root->back == NULL
+        this->BackupNode(root);
         vec4_copy(root->plane, p->plane);
         p->next = NULL;
         this->AddBSPPolygon(root, p);
@@ -133,6 +167,7 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
     {
         if (root->front == NULL)
         {
+            this->BackupNode(root);
             root->front = this->CreateBSPNode();
         }
         this->AddPolygon(root->front, p);
@@ -141,6 +176,7 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
     {
         if (root->back == NULL)
         {
+            this->BackupNode(root);
             root->back = this->CreateBSPNode();
         }
         this->AddPolygon(root->back, p);
@@ -160,11 +196,13 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
 
         if(root->front == NULL)
         {
+            this->BackupNode(root);
             root->front = this->CreateBSPNode();
         }
         this->AddPolygon(root->front, front);
         if(root->back == NULL)
         {
+            this->BackupNode(root);
             root->back = this->CreateBSPNode();
         }
         this->AddPolygon(root->back, back);
@@ -192,6 +230,14 @@ CDynamicBSP::CDynamicBSP(uint32_t size)
     m_input_polygons = 0;
     m_added_polygons = 0;
 
+    m_static_tree_allocated = 0;
+    m_static_vertex_allocated = 0;
+    m_static_input_polygons = 0;
+    m_static_added_polygons = 0;
+    m_node_backups = NULL;
+    m_node_backups_size = 0;
+    m_node_backups_count = 0;
+
     m_vbo = 0;
     m_anim_seq = NULL;
     m_realloc_state = 0;
@@ -228,16 +274,30 @@ CDynamicBSP::~CDynamicBSP()
     }
     m_vertex_buffer_size = 0;
 
+    if(m_node_backups)
+    {
+        free(m_node_backups);
+        m_node_backups = NULL;
+    }
+    m_node_backups_size = 0;
+    m_node_backups_count = 0;
+
     m_realloc_state = 0;
     m_anim_seq = NULL;
     m_root = NULL;
 }
 
 
-void CDynamicBSP::AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f)
+void CDynamicBSP::AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f, int filter)
 {
     for( ; p && (!m_realloc_state); p = p->next)
     {
+        if(((filter == BSP_ADD_STATIC_POLYGONS) && (p->anim_id > 0)) ||
+           ((filter == BSP_ADD_ANIMATED_POLYGONS) && (p->anim_id == 0)))
+        {
+            continue;
+        }
+
         m_temp_allocated = 0;
         polygon_p np = this->CreatePolygon(p->vertex_count);
         bool visible = (f == NULL);
@@ -361,5 +421,40 @@ void CDynamicBSP::Reset(struct anim_seq_s *seq)
     m_realloc_state = 0;
     m_input_polygons = 0;
     m_added_polygons = 0;
+    m_static_tree_allocated = 0;
+    m_static_vertex_allocated = 0;
+    m_static_input_polygons = 0;
+    m_static_added_polygons = 0;
+    m_node_backups_count = 0;
     m_root = this->CreateBSPNode();
 }
+
+/**
+ * Everything added till now becomes the static part of the tree.
+ */
+void CDynamicBSP::SetStaticMark()
+{
+    m_static_tree_allocated = m_tree_allocated;
+    m_static_vertex_allocated = m_vertex_allocated;
+    m_static_input_polygons = m_input_polygons;
+    m_static_added_polygons = m_added_polygons;
+    m_node_backups_count = 0;
+}
+
+/**
+ * Drops everything added after SetStaticMark(), static part of the tree stays as is.
+ */
+void CDynamicBSP::ResetToStatic()
+{
+    while(m_node_backups_count > 0)
+    {
+        m_node_backups_count--;
+        *m_node_backups[m_node_backups_count].node = m_node_backups[m_node_backups_count].data;
+    }
+
+    m_temp_allocated = 0;
+    m_tree_allocated = m_static_tree_allocated;
+    m_vertex_allocated = m_static_vertex_allocated;
+    m_input_polygons = m_static_input_polygons;
+    m_added_polygons = m_static_added_polygons;
+}
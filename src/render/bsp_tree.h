@@ -10,6 +10,11 @@ struct polygon_s;
 struct frustum_s;
 struct anim_seq_s;
 
+// polygons filter for CDynamicBSP::AddNewPolygonList
+#define BSP_ADD_ALL_POLYGONS            (0)
+#define BSP_ADD_STATIC_POLYGONS         (1)                                     // polygons with constant texture only
+#define BSP_ADD_ANIMATED_POLYGONS       (2)                                     // polygons with animated texture only
+
 typedef struct bsp_polygon_s 
 {
     uint16_t                vertex_count;                                       // number of vertices
@@ -52,8 +57,22 @@ class CDynamicBSP
     
     uint32_t             m_input_polygons;
     uint32_t             m_added_polygons;
-    
+
+    /*
+     * Static part of the tree is kept between frames: everything allocated
+     * before the mark stays, and static nodes changed by later insertions are
+     * backed up to be restored by ResetToStatic().
+     */
+    uint32_t             m_static_tree_allocated;
+    uint32_t             m_static_vertex_allocated;
+    uint32_t             m_static_input_polygons;
+    uint32_t             m_static_added_polygons;
+    struct bsp_node_backup_s *m_node_backups;
+    uint32_t             m_node_backups_size;
+    uint32_t             m_node_backups_count;
+
     struct bsp_node_s     *CreateBSPNode();
+    void BackupNode(struct bsp_node_s *node);
     struct polygon_s      *CreatePolygon(uint16_t vertex_count);
     void AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p);
     void AddPolygon(struct bsp_node_s *root, struct polygon_s *p);
@@ -65,8 +84,15 @@ public:
     CDynamicBSP(uint32_t size);
    ~CDynamicBSP();
    
-    void AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f);
+    void AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f, int filter = BSP_ADD_ALL_POLYGONS);
     void Reset(struct anim_seq_s *seq);
+    void SetStaticMark();
+    void ResetToStatic();
+
+    bool NeedRealloc()
+    {
+        return m_realloc_state != 0;
+    }
     
     struct vertex_s *GetVertexArray()
     {
@@ -77,6 +103,16 @@ public:
     {
         return m_vertex_allocated;
     }
+
+    uint32_t GetStaticVertexCount()
+    {
+        return m_static_vertex_allocated;
+    }
+
+    uint32_t GetVertexBufferSize()
+    {
+        return m_vertex_buffer_size;
+    }
     
     uint32_t GetInputPolygonsCount()
     {
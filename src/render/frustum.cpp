@@ -23,6 +23,8 @@ CFrustumManager::CFrustumManager(uint32_t buffer_size)
     m_buffer = (uint8_t*)malloc(buffer_size * sizeof(uint8_t));
     memset(m_buffer, 0, (buffer_size * sizeof(uint8_t)));
     m_need_realloc = false;
+    m_split_buffer = NULL;
+    m_split_buffer_size = 0;
 }
 
 CFrustumManager::~CFrustumManager()
@@ -32,6 +34,9 @@ CFrustumManager::~CFrustumManager()
         free(m_buffer);
         m_buffer = NULL;
     }
+    free(m_split_buffer);
+    m_split_buffer = NULL;
+    m_split_buffer_size = 0;
 }
 
 void CFrustumManager::Reset()
@@ -72,6 +77,26 @@ frustum_p CFrustumManager::CreateFrustum()
     return NULL;
 }
 
+/**
+ * Scratch vertices buffer for the splitting, owned by the manager (Sys_GetTempMem
+ * is not thread safe).
+ */
+float *CFrustumManager::GetSplitBuffer(uint32_t vertex_count)
+{
+    if(vertex_count * 3 > m_split_buffer_size)
+    {
+        float *new_buffer = (float*)realloc(m_split_buffer, vertex_count * 3 * sizeof(float));
+        if(new_buffer == NULL)
+        {
+            m_need_realloc = true;
+            return NULL;
+        }
+        m_split_buffer = new_buffer;
+        m_split_buffer_size = vertex_count * 3;
+    }
+    return m_split_buffer;
+}
+
 float *CFrustumManager::Alloc(uint32_t size)
 {
     size *= sizeof(float);
@@ -232,7 +257,12 @@ void CFrustumManager::GenClipPlanes(frustum_p p, struct camera_s *cam)
     }
 }
 
-frustum_p CFrustumManager::PortalFrustumIntersect(struct portal_s *portal, frustum_p emitter, struct camera_s *cam)
+/**
+ * Generates the frustum of the portal seen through the emitter frustum; it is
+ * not added to the destination room's list, so it may be called on any thread
+ * with its own manager.
+ */
+frustum_p CFrustumManager::PortalFrustumGen(struct portal_s *portal, frustum_p emitter, struct camera_s *cam)
 {
     if(!m_need_realloc)
     {
@@ -263,25 +293,8 @@ frustum_p CFrustumManager::PortalFrustumIntersect(struct portal_s *portal, frust
             return NULL;
         }
 
-        /*
-         * Search for the first free room's frustum
-         */
         uint32_t original_allocated = m_allocated;
-        frustum_p prev = NULL, current_gen = NULL;
-        if(dest_room->frustum == NULL)
-        {
-            current_gen = dest_room->frustum = this->CreateFrustum();
-        }
-        else
-        {
-            prev = dest_room->frustum;
-            while(prev->next)
-            {
-                prev = prev->next;
-            }
-            current_gen = prev->next = this->CreateFrustum();                   // generate new frustum.
-        }
-
+        frustum_p current_gen = this->CreateFrustum();                          // generate new frustum.
         if(m_need_realloc)
         {
             return NULL;
@@ -290,35 +303,17 @@ frustum_p CFrustumManager::PortalFrustumIntersect(struct portal_s *portal, frust
         this->SplitPrepare(current_gen, portal, emitter);                       // prepare to the clipping
         if(m_need_realloc)
         {
-            if(prev)
-            {
-                prev->next = NULL;
-            }
-            else
-            {
-                dest_room->frustum = NULL;
-            }
             return NULL;
         }
 
-        int buf_size = (current_gen->vertex_count + emitter->vertex_count + 4) * 3 * sizeof(float);
-        float *tmp = (float*)Sys_GetTempMem(buf_size);
-        if(this->SplitByPlane(current_gen, emitter->norm, tmp))                 // splitting by main frustum clip plane
+        float *tmp = this->GetSplitBuffer(current_gen->vertex_count + emitter->vertex_count + 4);
+        if((tmp != NULL) && this->SplitByPlane(current_gen, emitter->norm, tmp))  // splitting by main frustum clip plane
         {
             n = emitter->planes;
             for(uint16_t i = 0; i < emitter->vertex_count; i++, n += 4)
             {
                 if(!this->SplitByPlane(current_gen, n, tmp))
                 {
-                    if(prev)
-                    {
-                        prev->next = NULL;
-                    }
-                    else
-                    {
-                        dest_room->frustum = NULL;
-                    }
-                    Sys_ReturnTempMem(buf_size);
                     m_allocated = original_allocated;
                     return NULL;
                 }
@@ -327,44 +322,44 @@ frustum_p CFrustumManager::PortalFrustumIntersect(struct portal_s *portal, frust
             this->GenClipPlanes(current_gen, cam);                              // all is OK, let us generate clipplanes
             if(m_need_realloc)
             {
-                if(prev)
-                {
-                    prev->next = NULL;
-                }
-                else
-                {
-                    dest_room->frustum = NULL;
-                }
-                Sys_ReturnTempMem(buf_size);
                 m_allocated = original_allocated;
                 return NULL;
             }
 
             current_gen->parent = emitter;                                      // add parent pointer
             current_gen->parents_count = emitter->parents_count + 1;
-            Sys_ReturnTempMem(buf_size);
             return current_gen;
         }
 
-        if(prev)
-        {
-            prev->next = NULL;
-        }
-        else
-        {
-            dest_room->frustum = NULL;
-        }
         m_allocated = original_allocated;
-        Sys_ReturnTempMem(buf_size);
     }
 
     return NULL;
 }
 
+frustum_p CFrustumManager::PortalFrustumIntersect(struct portal_s *portal, frustum_p emitter, struct camera_s *cam)
+{
+    frustum_p gen = this->PortalFrustumGen(portal, emitter, cam);
+    if(gen)
+    {
+        Frustum_AddToList(&portal->dest_room->real_room->frustum, gen);
+    }
+    return gen;
+}
+
 /*
  ************************* END FRUSTUM MANAGER IMPLEMENTATION*******************
  */
 
+void Frustum_AddToList(struct frustum_s **list, frustum_p frustum)
+{
+    while(*list)
+    {
+        list = &(*list)->next;
+    }
+    *list = frustum;
+}
+
 /**
  * we need that checking to avoid infinite recursions
  */
@@ -42,10 +42,27 @@ public:
    ~CFrustumManager();
     
     void Reset();
-    frustum_p PortalFrustumIntersect(struct portal_s *portal, frustum_p emitter, struct camera_s *cam);
+    frustum_p PortalFrustumGen(struct portal_s *portal, frustum_p emitter, struct camera_s *cam);
+    frustum_p PortalFrustumIntersect(struct portal_s *portal, frustum_p emitter, struct camera_s *cam);   // generates and adds to dest room list
+
+    bool IsOverflowed()
+    {
+        return m_need_realloc;
+    }
+
+    uint32_t GetAllocated()
+    {
+        return m_allocated;
+    }
+
+    uint32_t GetBufferSize()
+    {
+        return m_buffer_size;
+    }
 
 private:
     float *Alloc(uint32_t size);
+    float *GetSplitBuffer(uint32_t vertex_count);
     frustum_p CreateFrustum();
     void SplitPrepare(frustum_p frustum, struct portal_s *p, frustum_p emitter);
     void GenClipPlanes(frustum_p p, struct camera_s *cam);
@@ -55,8 +72,11 @@ private:
     uint32_t m_buffer_size;
     uint32_t m_allocated;
     uint8_t *m_buffer;
+    float   *m_split_buffer;
+    uint32_t m_split_buffer_size;
 };
 
+void Frustum_AddToList(struct frustum_s **list, frustum_p frustum);
 bool Frustum_HaveParent(frustum_p parent, frustum_p frustum);
 bool Frustum_IsPolyVisible(struct polygon_s *p, struct frustum_s *frustum, bool check_backface);
 bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *frustum);
@@ -0,0 +1,540 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+
+#include "../core/vmath.h"
+#include "../core/polygon.h"
+#include "../core/obb.h"
+#include "../mesh.h"
+#include "../room.h"
+#include "render.h"
+#include "frustum.h"
+#include "occlusion.h"
+
+
+COcclusionCuller::COcclusionCuller()
+{
+    m_depth = (float*)malloc(OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT * sizeof(float));
+    m_triangles = NULL;
+    m_triangles_count = 0;
+    m_ranges = NULL;
+    m_ranges_count = 0;
+
+    m_rooms = NULL;
+    m_rooms_count = 0;
+    m_rooms_size = 0;
+    m_clips = NULL;
+    m_clips_count = 0;
+    m_clips_size = 0;
+
+    m_rasterized_count = 0;
+    m_culled_count = 0;
+
+    m_thread = NULL;
+    m_start = NULL;
+    m_done = NULL;
+    m_exit = false;
+    m_busy = false;
+}
+
+
+COcclusionCuller::~COcclusionCuller()
+{
+    if(m_thread)
+    {
+        this->Wait();
+        m_exit = true;
+        SDL_SemPost(m_start);
+        SDL_WaitThread(m_thread, NULL);
+        m_thread = NULL;
+        SDL_DestroySemaphore(m_start);
+        SDL_DestroySemaphore(m_done);
+        m_start = NULL;
+        m_done = NULL;
+    }
+
+    free(m_depth);
+    m_depth = NULL;
+    free(m_triangles);
+    m_triangles = NULL;
+    m_triangles_count = 0;
+    free(m_ranges);
+    m_ranges = NULL;
+    m_ranges_count = 0;
+    free(m_rooms);
+    m_rooms = NULL;
+    m_rooms_count = 0;
+    m_rooms_size = 0;
+    free(m_clips);
+    m_clips = NULL;
+    m_clips_count = 0;
+    m_clips_size = 0;
+}
+
+
+int COcclusionCuller::ThreadFunc(void *data)
+{
+    COcclusionCuller *culler = (COcclusionCuller*)data;
+
+    while(true)
+    {
+        SDL_SemWait(culler->m_start);
+        if(culler->m_exit)
+        {
+            break;
+        }
+        culler->RasterizeOccluders();
+        SDL_SemPost(culler->m_done);
+    }
+
+    return 0;
+}
+
+
+void COcclusionCuller::Wait()
+{
+    if(m_busy)
+    {
+        SDL_SemWait(m_done);
+        m_busy = false;
+    }
+}
+
+/**
+ * Extracts occluders from every room content: large opaque polygons, triangulated, in room space.
+ */
+void COcclusionCuller::ResetWorld(struct room_s *rooms, uint32_t rooms_count)
+{
+    this->Wait();
+
+    free(m_triangles);
+    m_triangles = NULL;
+    m_triangles_count = 0;
+    free(m_ranges);
+    m_ranges = NULL;
+    m_ranges_count = 0;
+    m_rooms_count = 0;
+
+    if((rooms == NULL) || (rooms_count == 0))
+    {
+        return;
+    }
+
+    uint32_t triangles_size = 0;
+    m_ranges = (occluder_range_p)malloc(rooms_count * sizeof(occluder_range_t));
+    for(uint32_t i = 0; i < rooms_count; i++)
+    {
+        occluder_range_p range = m_ranges + m_ranges_count++;
+        range->content = rooms[i].original_content;
+        range->first_triangle = m_triangles_count;
+        range->triangles_count = 0;
+
+        base_mesh_p mesh = (range->content) ? (range->content->mesh) : (NULL);
+        if(mesh == NULL)
+        {
+            continue;
+        }
+
+        polygon_p p = mesh->polygons;
+        for(uint32_t j = 0; j < mesh->polygons_count; j++, p++)
+        {
+            if((p->transparency != BM_OPAQUE) || (p->vertex_count < 3))
+            {
+                continue;
+            }
+
+            float area = 0.0f, t[3], e1[3], e2[3];
+            for(uint16_t k = 2; k < p->vertex_count; k++)
+            {
+                vec3_sub(e1, p->vertices[k - 1].position, p->vertices[0].position);
+                vec3_sub(e2, p->vertices[k].position, p->vertices[0].position);
+                vec3_cross(t, e1, e2);
+                area += 0.5f * vec3_abs(t);
+            }
+            if(area < OCCLUDER_MIN_AREA)
+            {
+                continue;
+            }
+
+            if(m_triangles_count + p->vertex_count - 2 > triangles_size)
+            {
+                triangles_size = (triangles_size > 0) ? (triangles_size * 2) : (1024);
+                m_triangles = (float*)realloc(m_triangles, triangles_size * 9 * sizeof(float));
+            }
+            for(uint16_t k = 2; k < p->vertex_count; k++)
+            {
+                float *tr = m_triangles + 9 * m_triangles_count++;
+                vec3_copy(tr + 0, p->vertices[0].position);
+                vec3_copy(tr + 3, p->vertices[k - 1].position);
+                vec3_copy(tr + 6, p->vertices[k].position);
+                range->triangles_count++;
+            }
+        }
+    }
+
+    if(m_rooms_size < rooms_count)
+    {
+        m_rooms_size = rooms_count;
+        m_rooms = (occlusion_room_p)realloc(m_rooms, m_rooms_size * sizeof(occlusion_room_t));
+    }
+}
+
+
+occluder_range_p COcclusionCuller::FindRange(struct room_content_s *content)
+{
+    for(uint32_t i = 0; i < m_ranges_count; i++)
+    {
+        if(m_ranges[i].content == content)
+        {
+            return m_ranges + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Starts occluders rasterization for the current frame on the worker thread.
+ */
+void COcclusionCuller::BeginFrame(const float view_proj[16], struct room_s **rooms, uint32_t rooms_count)
+{
+    this->Wait();
+
+    if(m_thread == NULL)
+    {
+        m_start = SDL_CreateSemaphore(0);
+        m_done = SDL_CreateSemaphore(0);
+        m_exit = false;
+        m_thread = SDL_CreateThread(COcclusionCuller::ThreadFunc, "occlusion", this);
+    }
+
+    Mat4_Copy(m_view_proj, view_proj);
+    m_rooms_count = (rooms_count < m_rooms_size) ? (rooms_count) : (m_rooms_size);
+    m_clips_count = 0;
+    for(uint32_t i = 0; i < m_rooms_count; i++)
+    {
+        m_rooms[i].room = rooms[i];
+        this->AddRoomClips(m_rooms + i, rooms[i]->frustum);                     // frustums are reused by next frame, so project them here
+    }
+    m_culled_count = 0;
+
+    if(m_thread)
+    {
+        m_busy = true;
+        SDL_SemPost(m_start);
+    }
+    else
+    {
+        this->RasterizeOccluders();                                              // no threads - do it here
+    }
+}
+
+
+void COcclusionCuller::EndFrame()
+{
+    this->Wait();
+}
+
+
+static inline void Occlusion_Project(float ret[4], const float mvp[16], const float v[3])
+{
+    Mat4_vec3_mul_macro(ret, mvp, v);
+    ret[3] = mvp[3] * v[0] + mvp[7] * v[1] + mvp[11] * v[2] + mvp[15];
+}
+
+
+occlusion_clip_p COcclusionCuller::NewClip()
+{
+    if(m_clips_count >= m_clips_size)
+    {
+        m_clips_size = (m_clips_size > 0) ? (m_clips_size * 2) : (64);
+        m_clips = (occlusion_clip_p)realloc(m_clips, m_clips_size * sizeof(occlusion_clip_t));
+    }
+    return m_clips + m_clips_count++;
+}
+
+/**
+ * Projects room frustums (portal windows) to the buffer. A window that crosses the
+ * near plane or has too many edges gets no clip, so the room gives no occluders there.
+ */
+void COcclusionCuller::AddRoomClips(occlusion_room_p r, struct frustum_s *frustum)
+{
+    r->first_clip = m_clips_count;
+    r->clips_count = 0;
+
+    if(frustum == NULL)
+    {
+        occlusion_clip_p clip = this->NewClip();
+        clip->edges_count = 0;
+        clip->rect[0] = 0;
+        clip->rect[1] = 0;
+        clip->rect[2] = OCCLUSION_BUFFER_WIDTH - 1;
+        clip->rect[3] = OCCLUSION_BUFFER_HEIGHT - 1;
+        r->clips_count = 1;
+        return;
+    }
+
+    for(frustum_p f = frustum; f; f = f->next)
+    {
+        float x[OCCLUSION_CLIP_EDGES_MAX], y[OCCLUSION_CLIP_EDGES_MAX], area = 0.0f;
+        float min_x = OCCLUSION_BUFFER_WIDTH, max_x = 0.0f;
+        float min_y = OCCLUSION_BUFFER_HEIGHT, max_y = 0.0f;
+        uint16_t n = f->vertex_count;
+        bool valid = (n >= 3) && (n <= OCCLUSION_CLIP_EDGES_MAX);
+
+        for(uint16_t i = 0; valid && (i < n); i++)
+        {
+            float v[4];
+            Occlusion_Project(v, m_view_proj, f->vertex + 3 * i);
+            valid = (v[3] >= OCCLUSION_NEAR_W);
+            if(valid)
+            {
+                x[i] = (0.5f + 0.5f * v[0] / v[3]) * OCCLUSION_BUFFER_WIDTH;
+                y[i] = (0.5f + 0.5f * v[1] / v[3]) * OCCLUSION_BUFFER_HEIGHT;
+                min_x = (x[i] < min_x) ? (x[i]) : (min_x);
+                max_x = (x[i] > max_x) ? (x[i]) : (max_x);
+                min_y = (y[i] < min_y) ? (y[i]) : (min_y);
+                max_y = (y[i] > max_y) ? (y[i]) : (max_y);
+            }
+        }
+        if(!valid)
+        {
+            continue;
+        }
+
+        for(uint16_t i = 0; i < n; i++)
+        {
+            uint16_t i1 = (i + 1) % n;
+            area += x[i] * y[i1] - x[i1] * y[i];
+        }
+        if((area > -1.0e-4f) && (area < 1.0e-4f))
+        {
+            continue;
+        }
+
+        occlusion_clip_p clip = this->NewClip();
+        float sign = (area > 0.0f) ? (1.0f) : (-1.0f);
+        for(uint16_t i = 0; i < n; i++)
+        {
+            uint16_t i1 = (i + 1) % n;
+            clip->edges[i][0] = sign * (y[i] - y[i1]);
+            clip->edges[i][1] = sign * (x[i1] - x[i]);
+            clip->edges[i][2] = sign * (x[i] * y[i1] - x[i1] * y[i]);
+        }
+        clip->edges_count = n;
+        min_x = (min_x < 0.0f) ? (0.0f) : (min_x);
+        min_y = (min_y < 0.0f) ? (0.0f) : (min_y);
+        max_x = (max_x > OCCLUSION_BUFFER_WIDTH - 1) ? (OCCLUSION_BUFFER_WIDTH - 1) : (max_x);
+        max_y = (max_y > OCCLUSION_BUFFER_HEIGHT - 1) ? (OCCLUSION_BUFFER_HEIGHT - 1) : (max_y);
+        clip->rect[0] = (int16_t)min_x;
+        clip->rect[1] = (int16_t)min_y;
+        clip->rect[2] = (int16_t)max_x;
+        clip->rect[3] = (int16_t)max_y;
+        r->clips_count++;
+    }
+}
+
+
+void COcclusionCuller::RasterizeOccluders()
+{
+    float *depth = m_depth;
+    for(uint32_t i = 0; i < OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT; i++)
+    {
+        *depth++ = 1.0f;
+    }
+    m_rasterized_count = 0;
+
+    for(uint32_t i = 0; i < m_rooms_count; i++)
+    {
+        occlusion_room_p r = m_rooms + i;
+        occluder_range_p range = this->FindRange(r->room->content);
+        if((range == NULL) || (range->triangles_count == 0) || (r->clips_count == 0))
+        {
+            continue;
+        }
+
+        float mvp[16], v[3][4];
+        Mat4_Mat4_mul(mvp, m_view_proj, r->room->transform);
+        float *tr = m_triangles + 9 * range->first_triangle;
+        for(uint32_t j = 0; j < range->triangles_count; j++, tr += 9)
+        {
+            Occlusion_Project(v[0], mvp, tr + 0);
+            Occlusion_Project(v[1], mvp, tr + 3);
+            Occlusion_Project(v[2], mvp, tr + 6);
+            // no near plane clipping: such occluders are just skipped
+            if((v[0][3] < OCCLUSION_NEAR_W) || (v[1][3] < OCCLUSION_NEAR_W) || (v[2][3] < OCCLUSION_NEAR_W))
+            {
+                continue;
+            }
+            this->RasterizeTriangle(v[0], v[1], v[2], m_clips + r->first_clip, r->clips_count);
+        }
+    }
+}
+
+/**
+ * Half space rasterization, clipped by room windows. Conservative: a pixel is written
+ * only if it is entirely inside the triangle and inside one of the windows, and gets
+ * the farthest depth of the triangle over the pixel.
+ */
+void COcclusionCuller::RasterizeTriangle(const float v0[4], const float v1[4], const float v2[4], occlusion_clip_p clips, uint32_t clips_count)
+{
+    float x[3], y[3], z[3];
+    const float *v[3] = {v0, v1, v2};
+
+    for(int i = 0; i < 3; i++)
+    {
+        float inv_w = 1.0f / v[i][3];
+        x[i] = (0.5f + 0.5f * v[i][0] * inv_w) * OCCLUSION_BUFFER_WIDTH;
+        y[i] = (0.5f + 0.5f * v[i][1] * inv_w) * OCCLUSION_BUFFER_HEIGHT;
+        z[i] = v[i][2] * inv_w;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if((area > -1.0e-4f) && (area < 1.0e-4f))
+    {
+        return;
+    }
+    if(area < 0.0f)                                                             // occluders are double sided
+    {
+        float t;
+        SWAPT(x[1], x[2], t);
+        SWAPT(y[1], y[2], t);
+        SWAPT(z[1], z[2], t);
+        area = -area;
+    }
+
+    int tmin_x = (int)((x[0] < x[1]) ? ((x[0] < x[2]) ? x[0] : x[2]) : ((x[1] < x[2]) ? x[1] : x[2]));
+    int tmax_x = (int)((x[0] > x[1]) ? ((x[0] > x[2]) ? x[0] : x[2]) : ((x[1] > x[2]) ? x[1] : x[2]));
+    int tmin_y = (int)((y[0] < y[1]) ? ((y[0] < y[2]) ? y[0] : y[2]) : ((y[1] < y[2]) ? y[1] : y[2]));
+    int tmax_y = (int)((y[0] > y[1]) ? ((y[0] > y[2]) ? y[0] : y[2]) : ((y[1] > y[2]) ? y[1] : y[2]));
+
+    // edge functions: e_i(px, py) = a_i * px + b_i * py + c_i, positive inside;
+    // at pixel centre e_i >= h_i means the whole pixel is on the inner side
+    float a[3], b[3], c[3], h[3];
+    for(int i = 0; i < 3; i++)
+    {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        a[i] = y[i1] - y[i2];
+        b[i] = x[i2] - x[i1];
+        c[i] = x[i1] * y[i2] - x[i2] * y[i1];
+        h[i] = 0.5f * (fabsf(a[i]) + fabsf(b[i]));
+    }
+
+    float inv_area = 1.0f / area;
+    float dz = 0.5f * (fabsf(a[0] * z[0] + a[1] * z[1] + a[2] * z[2]) + fabsf(b[0] * z[0] + b[1] * z[1] + b[2] * z[2])) * inv_area;
+    bool rasterized = false;
+
+    for(uint32_t ci = 0; ci < clips_count; ci++)
+    {
+        occlusion_clip_p clip = clips + ci;
+        int min_x = (tmin_x > clip->rect[0]) ? (tmin_x) : (clip->rect[0]);
+        int min_y = (tmin_y > clip->rect[1]) ? (tmin_y) : (clip->rect[1]);
+        int max_x = (tmax_x < clip->rect[2]) ? (tmax_x) : (clip->rect[2]);
+        int max_y = (tmax_y < clip->rect[3]) ? (tmax_y) : (clip->rect[3]);
+        if((min_x > max_x) || (min_y > max_y))
+        {
+            continue;
+        }
+
+        float ch[OCCLUSION_CLIP_EDGES_MAX];
+        for(uint16_t k = 0; k < clip->edges_count; k++)
+        {
+            ch[k] = 0.5f * (fabsf(clip->edges[k][0]) + fabsf(clip->edges[k][1]));
+        }
+
+        float px0 = (float)min_x + 0.5f;
+        float py = (float)min_y + 0.5f;
+        for(int py_i = min_y; py_i <= max_y; py_i++, py += 1.0f)
+        {
+            float e0 = a[0] * px0 + b[0] * py + c[0];
+            float e1 = a[1] * px0 + b[1] * py + c[1];
+            float e2 = a[2] * px0 + b[2] * py + c[2];
+            float px = px0;
+            float *row = m_depth + py_i * OCCLUSION_BUFFER_WIDTH;
+            for(int px_i = min_x; px_i <= max_x; px_i++, px += 1.0f, e0 += a[0], e1 += a[1], e2 += a[2])
+            {
+                if((e0 < h[0]) || (e1 < h[1]) || (e2 < h[2]))
+                {
+                    continue;
+                }
+                bool inside = true;
+                for(uint16_t k = 0; inside && (k < clip->edges_count); k++)
+                {
+                    const float *ce = clip->edges[k];
+                    inside = (ce[0] * px + ce[1] * py + ce[2] >= ch[k]);
+                }
+                if(inside)
+                {
+                    float d = (e0 * z[0] + e1 * z[1] + e2 * z[2]) * inv_area + dz;
+                    row[px_i] = (d < row[px_i]) ? (d) : (row[px_i]);
+                    rasterized = true;
+                }
+            }
+        }
+    }
+
+    m_rasterized_count += (rasterized) ? (1) : (0);
+}
+
+/**
+ * Conservative test: bounds are visible if their nearest depth is not behind occluders
+ * at any pixel of the screen rectangle (grown by one pixel).
+ */
+bool COcclusionCuller::IsOBBVisible(struct obb_s *obb)
+{
+    float min_x = OCCLUSION_BUFFER_WIDTH, max_x = 0.0f;
+    float min_y = OCCLUSION_BUFFER_HEIGHT, max_y = 0.0f;
+    float min_z = 1.0f;
+
+    this->Wait();
+
+    for(int i = 0; i < 6; i++)
+    {
+        polygon_p p = obb->polygons + i;
+        for(uint16_t j = 0; j < p->vertex_count; j++)
+        {
+            float v[4];
+            Occlusion_Project(v, m_view_proj, p->vertices[j].position);
+            if(v[3] < OCCLUSION_NEAR_W)
+            {
+                return true;
+            }
+            float inv_w = 1.0f / v[3];
+            float sx = (0.5f + 0.5f * v[0] * inv_w) * OCCLUSION_BUFFER_WIDTH;
+            float sy = (0.5f + 0.5f * v[1] * inv_w) * OCCLUSION_BUFFER_HEIGHT;
+            float sz = v[2] * inv_w;
+            min_x = (sx < min_x) ? (sx) : (min_x);
+            max_x = (sx > max_x) ? (sx) : (max_x);
+            min_y = (sy < min_y) ? (sy) : (min_y);
+            max_y = (sy > max_y) ? (sy) : (max_y);
+            min_z = (sz < min_z) ? (sz) : (min_z);
+        }
+    }
+
+    int x0 = (int)min_x - 1, x1 = (int)max_x + 1;
+    int y0 = (int)min_y - 1, y1 = (int)max_y + 1;
+    x0 = (x0 < 0) ? (0) : (x0);
+    y0 = (y0 < 0) ? (0) : (y0);
+    x1 = (x1 >= OCCLUSION_BUFFER_WIDTH) ? (OCCLUSION_BUFFER_WIDTH - 1) : (x1);
+    y1 = (y1 >= OCCLUSION_BUFFER_HEIGHT) ? (OCCLUSION_BUFFER_HEIGHT - 1) : (y1);
+    if((x0 > x1) || (y0 > y1))
+    {
+        return true;
+    }
+
+    for(int y = y0; y <= y1; y++)
+    {
+        const float *row = m_depth + y * OCCLUSION_BUFFER_WIDTH;
+        for(int x = x0; x <= x1; x++)
+        {
+            if(row[x] >= min_z)
+            {
+                return true;
+            }
+        }
+    }
+
+    m_culled_count++;
+    return false;
+}
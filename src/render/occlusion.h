@@ -0,0 +1,110 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdint.h>
+
+struct room_s;
+struct room_content_s;
+struct obb_s;
+struct frustum_s;
+struct SDL_Thread;
+struct SDL_semaphore;
+
+#define OCCLUSION_BUFFER_WIDTH          (256)
+#define OCCLUSION_BUFFER_HEIGHT         (128)
+#define OCCLUSION_NEAR_W                (16.0f)                                 // occluders and bounds closer to camera are not used
+#define OCCLUDER_MIN_AREA               (1024.0f * 1024.0f)                     // one sector wall; smaller polygons are not occluders
+#define OCCLUSION_CLIP_EDGES_MAX        (16)                                    // portal windows with more edges give no occluders
+
+typedef struct occluder_range_s
+{
+    struct room_content_s      *content;
+    uint32_t                    first_triangle;
+    uint32_t                    triangles_count;
+}occluder_range_t, *occluder_range_p;
+
+/*
+ * Screen space window of one room frustum (portal), in buffer pixels;
+ * edges_count == 0 is the whole screen (room with camera inside).
+ */
+typedef struct occlusion_clip_s
+{
+    float                       edges[OCCLUSION_CLIP_EDGES_MAX][3];             // a * x + b * y + c, positive inside
+    uint16_t                    edges_count;
+    int16_t                     rect[4];                                        // min x, min y, max x, max y
+}occlusion_clip_t, *occlusion_clip_p;
+
+typedef struct occlusion_room_s
+{
+    struct room_s              *room;
+    uint32_t                    first_clip;
+    uint32_t                    clips_count;
+}occlusion_room_t, *occlusion_room_p;
+
+/*
+ * Software occlusion culling: large opaque room polygons (extracted at world load)
+ * of visible rooms are rasterized by a worker thread into a low resolution depth
+ * buffer; static meshes and entities bounds are tested against it before drawing.
+ * Occluders of a room are written only inside the portal windows the room is seen
+ * through, and only to pixels they cover entirely, with their farthest depth.
+ */
+class COcclusionCuller
+{
+public:
+    COcclusionCuller();
+   ~COcclusionCuller();
+
+    void ResetWorld(struct room_s *rooms, uint32_t rooms_count);
+    void BeginFrame(const float view_proj[16], struct room_s **rooms, uint32_t rooms_count);
+    void EndFrame();
+    bool IsOBBVisible(struct obb_s *obb);
+
+    uint32_t GetOccludersCount()
+    {
+        return m_triangles_count;
+    }
+
+    uint32_t GetRasterizedCount()
+    {
+        return m_rasterized_count;
+    }
+
+    uint32_t GetCulledCount()
+    {
+        return m_culled_count;
+    }
+
+private:
+    static int ThreadFunc(void *data);
+    void Wait();
+    void RasterizeOccluders();
+    void RasterizeTriangle(const float v0[4], const float v1[4], const float v2[4], occlusion_clip_p clips, uint32_t clips_count);
+    void AddRoomClips(occlusion_room_p r, struct frustum_s *frustum);
+    occlusion_clip_p NewClip();
+    occluder_range_p FindRange(struct room_content_s *content);
+
+    float                      *m_depth;                                        // NDC z of the nearest occluder per pixel
+    float                      *m_triangles;                                    // room space occluders, 9 floats per triangle
+    uint32_t                    m_triangles_count;
+    occluder_range_p            m_ranges;
+    uint32_t                    m_ranges_count;
+
+    float                       m_view_proj[16];
+    occlusion_room_p            m_rooms;                                        // rooms to rasterize in current frame
+    uint32_t                    m_rooms_count;
+    uint32_t                    m_rooms_size;
+    occlusion_clip_p            m_clips;
+    uint32_t                    m_clips_count;
+    uint32_t                    m_clips_size;
+
+    uint32_t                    m_rasterized_count;
+    uint32_t                    m_culled_count;
+
+    struct SDL_Thread          *m_thread;
+    struct SDL_semaphore       *m_start;
+    struct SDL_semaphore       *m_done;
+    volatile bool               m_exit;
+    bool                        m_busy;
+};
+
+#endif
@@ -0,0 +1,268 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
+#include "../core/vmath.h"
+#include "../room.h"
+#include "frustum.h"
+#include "camera.h"
+#include "portal_traversal.h"
+
+
+CPortalTraversal::CPortalTraversal()
+{
+    int cpu_count = SDL_GetCPUCount();
+
+    m_camera = NULL;
+    m_tasks = NULL;
+    m_tasks_count = 0;
+    m_tasks_size = 0;
+    SDL_AtomicSet(&m_next_task, 0);
+
+    m_workers_count = (cpu_count < 1) ? (1) : ((cpu_count > PORTAL_TRAVERSAL_MAX_WORKERS) ? (PORTAL_TRAVERSAL_MAX_WORKERS) : (cpu_count));
+    for(uint16_t i = 0; i < PORTAL_TRAVERSAL_MAX_WORKERS; i++)
+    {
+        struct worker_s *w = m_workers + i;
+        w->owner = this;
+        w->frustumManager = (i < m_workers_count) ? (new CFrustumManager(PORTAL_TRAVERSAL_ARENA_SIZE)) : (NULL);
+        w->events = NULL;
+        w->events_count = 0;
+        w->events_size = 0;
+        w->failed = false;
+        w->thread = NULL;
+    }
+
+    m_threads_started = false;
+    m_start = NULL;
+    m_done = NULL;
+    m_exit = false;
+}
+
+
+CPortalTraversal::~CPortalTraversal()
+{
+    if(m_threads_started)
+    {
+        m_exit = true;
+        for(uint16_t i = 1; i < m_workers_count; i++)
+        {
+            SDL_SemPost(m_start);
+        }
+        for(uint16_t i = 1; i < PORTAL_TRAVERSAL_MAX_WORKERS; i++)
+        {
+            if(m_workers[i].thread)
+            {
+                SDL_WaitThread(m_workers[i].thread, NULL);
+                m_workers[i].thread = NULL;
+            }
+        }
+        SDL_DestroySemaphore(m_start);
+        SDL_DestroySemaphore(m_done);
+        m_start = NULL;
+        m_done = NULL;
+        m_threads_started = false;
+    }
+
+    for(uint16_t i = 0; i < PORTAL_TRAVERSAL_MAX_WORKERS; i++)
+    {
+        delete m_workers[i].frustumManager;
+        m_workers[i].frustumManager = NULL;
+        free(m_workers[i].events);
+        m_workers[i].events = NULL;
+        m_workers[i].events_count = 0;
+        m_workers[i].events_size = 0;
+    }
+
+    free(m_tasks);
+    m_tasks = NULL;
+    m_tasks_count = 0;
+    m_tasks_size = 0;
+}
+
+
+int CPortalTraversal::ThreadFunc(void *data)
+{
+    struct worker_s *w = (struct worker_s*)data;
+    CPortalTraversal *traversal = w->owner;
+
+    while(true)
+    {
+        SDL_SemWait(traversal->m_start);
+        if(traversal->m_exit)
+        {
+            break;
+        }
+        traversal->DoTasks(w);
+        SDL_SemPost(traversal->m_done);
+    }
+
+    return 0;
+}
+
+
+void CPortalTraversal::StartThreads()
+{
+    if(!m_threads_started && (m_workers_count > 1))
+    {
+        m_start = SDL_CreateSemaphore(0);
+        m_done = SDL_CreateSemaphore(0);
+        m_exit = false;
+        for(uint16_t i = 1; i < m_workers_count; i++)
+        {
+            m_workers[i].thread = SDL_CreateThread(CPortalTraversal::ThreadFunc, "portals", m_workers + i);
+            if(m_workers[i].thread == NULL)
+            {
+                m_workers_count = i;                                            // work with what we have
+                break;
+            }
+        }
+        m_threads_started = true;
+    }
+}
+
+/**
+ * Frees all frustums and events of the previous frame.
+ */
+void CPortalTraversal::Begin(struct camera_s *cam)
+{
+    m_camera = cam;
+    m_tasks_count = 0;
+    for(uint16_t i = 0; i < m_workers_count; i++)
+    {
+        m_workers[i].frustumManager->Reset();
+        m_workers[i].events_count = 0;
+        m_workers[i].failed = false;
+    }
+}
+
+
+void CPortalTraversal::AddStart(struct portal_s *portal)
+{
+    if(m_tasks_count >= m_tasks_size)
+    {
+        uint32_t new_size = (m_tasks_size > 0) ? (m_tasks_size * 2) : (32);
+        portal_traversal_task_p new_tasks = (portal_traversal_task_p)realloc(m_tasks, new_size * sizeof(portal_traversal_task_t));
+        if(new_tasks == NULL)
+        {
+            m_workers[0].failed = true;
+            return;
+        }
+        m_tasks = new_tasks;
+        m_tasks_size = new_size;
+    }
+
+    portal_traversal_task_p task = m_tasks + m_tasks_count++;
+    task->portal = portal;
+    task->frustum = NULL;
+    task->first_event = 0;
+    task->events_count = 0;
+    task->worker = 0;
+}
+
+/**
+ * Runs all start portals; the main thread takes tasks too. The caller merges
+ * the result only if the serial traversal (one arena of serial_arena_size)
+ * would not overflow either, otherwise it must use the serial path.
+ */
+bool CPortalTraversal::Run(uint32_t serial_arena_size)
+{
+    uint16_t started = 0;
+    uint32_t used = 0;
+
+    SDL_AtomicSet(&m_next_task, 0);
+    if(m_tasks_count > 1)
+    {
+        this->StartThreads();
+        if(m_threads_started)
+        {
+            started = m_workers_count - 1;
+            for(uint16_t i = 0; i < started; i++)
+            {
+                SDL_SemPost(m_start);
+            }
+        }
+    }
+
+    this->DoTasks(m_workers);
+    for(uint16_t i = 0; i < started; i++)
+    {
+        SDL_SemWait(m_done);
+    }
+
+    for(uint16_t i = 0; i < m_workers_count; i++)
+    {
+        if(m_workers[i].failed || m_workers[i].frustumManager->IsOverflowed())
+        {
+            return false;
+        }
+        used += m_workers[i].frustumManager->GetAllocated();
+    }
+
+    return used + PORTAL_TRAVERSAL_ARENA_RESERVE < serial_arena_size;
+}
+
+
+portal_traversal_event_p CPortalTraversal::GetEvents(portal_traversal_task_p task)
+{
+    return m_workers[task->worker].events + task->first_event;
+}
+
+
+void CPortalTraversal::DoTasks(struct worker_s *w)
+{
+    while(true)
+    {
+        int i = SDL_AtomicAdd(&m_next_task, 1);
+        if(i >= (int)m_tasks_count)
+        {
+            break;
+        }
+
+        portal_traversal_task_p task = m_tasks + i;
+        task->worker = w - m_workers;
+        task->first_event = w->events_count;
+        task->frustum = w->frustumManager->PortalFrustumGen(task->portal, m_camera->frustum, m_camera);
+        if(task->frustum)
+        {
+            task->frustum->parents_count = 1;                                   // created by camera
+            this->Traverse(w, task->portal, task->frustum);
+        }
+        task->events_count = w->events_count - task->first_event;
+    }
+}
+
+/**
+ * Same recursion as CRender::ProcessRoom. Its early exit never triggers here:
+ * the room was entered through the portal, so it has just got a frustum.
+ */
+void CPortalTraversal::Traverse(struct worker_s *w, struct portal_s *portal, struct frustum_s *frus)
+{
+    room_p room = portal->dest_room->real_room;
+
+    for(uint16_t i = 0; i < room->content->portals_count; i++)
+    {
+        portal_p p = room->content->portals + i;
+        frustum_p gen_frus = w->frustumManager->PortalFrustumGen(p, frus, m_camera);
+        if(gen_frus)
+        {
+            if(w->events_count >= w->events_size)
+            {
+                uint32_t new_size = (w->events_size > 0) ? (w->events_size * 2) : (256);
+                portal_traversal_event_p new_events = (portal_traversal_event_p)realloc(w->events, new_size * sizeof(portal_traversal_event_t));
+                if(new_events == NULL)
+                {
+                    w->failed = true;
+                    return;
+                }
+                w->events = new_events;
+                w->events_size = new_size;
+            }
+            w->events[w->events_count].room = p->dest_room->real_room;
+            w->events[w->events_count].frustum = gen_frus;
+            w->events_count++;
+            this->Traverse(w, p, gen_frus);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+
+#ifndef PORTAL_TRAVERSAL_H
+#define PORTAL_TRAVERSAL_H
+
+#include <stdint.h>
+#include <SDL2/SDL_atomic.h>
+
+struct room_s;
+struct portal_s;
+struct frustum_s;
+struct camera_s;
+struct SDL_Thread;
+struct SDL_semaphore;
+
+#define PORTAL_TRAVERSAL_MAX_WORKERS    (8)                                     // main thread included
+#define PORTAL_TRAVERSAL_ARENA_SIZE     (32768)
+#define PORTAL_TRAVERSAL_ARENA_RESERVE  (4096)                                  // serial arena headroom for one frustum generation
+
+typedef struct portal_traversal_event_s
+{
+    struct room_s              *room;                                           // real room, frustum goes to its list
+    struct frustum_s           *frustum;
+}portal_traversal_event_t, *portal_traversal_event_p;
+
+typedef struct portal_traversal_task_s
+{
+    struct portal_s            *portal;                                         // start portal, tested with camera frustum
+    struct frustum_s           *frustum;                                        // start portal frustum, NULL if not visible
+    uint32_t                    first_event;
+    uint32_t                    events_count;
+    uint16_t                    worker;
+}portal_traversal_task_t, *portal_traversal_task_p;
+
+/*
+ * Portal traversal of GenWorldList split by start portals between worker
+ * threads. Each worker has its own frustum arena and records generated
+ * frustums in depth first order, so the renderer can add them to the rooms
+ * lists and to the render list in exactly the serial order.
+ */
+class CPortalTraversal
+{
+public:
+    CPortalTraversal();
+   ~CPortalTraversal();
+
+    void Begin(struct camera_s *cam);
+    void AddStart(struct portal_s *portal);
+    bool Run(uint32_t serial_arena_size);                                       // false if result is incomplete (arena overflow)
+
+    uint32_t GetTasksCount()
+    {
+        return m_tasks_count;
+    }
+
+    portal_traversal_task_p GetTask(uint32_t i)
+    {
+        return m_tasks + i;
+    }
+
+    portal_traversal_event_p GetEvents(portal_traversal_task_p task);
+
+    uint16_t GetWorkersCount()
+    {
+        return m_workers_count;
+    }
+
+private:
+    struct worker_s
+    {
+        CPortalTraversal           *owner;
+        class CFrustumManager      *frustumManager;
+        portal_traversal_event_p    events;
+        uint32_t                    events_count;
+        uint32_t                    events_size;
+        bool                        failed;
+        struct SDL_Thread          *thread;
+    };
+
+    static int ThreadFunc(void *data);
+    void StartThreads();
+    void DoTasks(struct worker_s *w);
+    void Traverse(struct worker_s *w, struct portal_s *portal, struct frustum_s *frus);
+
+    struct camera_s            *m_camera;
+    portal_traversal_task_p     m_tasks;
+    uint32_t                    m_tasks_count;
+    uint32_t                    m_tasks_size;
+    SDL_atomic_t                m_next_task;
+
+    struct worker_s             m_workers[PORTAL_TRAVERSAL_MAX_WORKERS];
+    uint16_t                    m_workers_count;
+    bool                        m_threads_started;
+    struct SDL_semaphore       *m_start;
+    struct SDL_semaphore       *m_done;
+    volatile bool               m_exit;
+};
+
+#endif
@@ -1,11 +1,14 @@
 
 #include <cmath>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL_platform.h>
 #include <SDL2/SDL_opengl.h>
 
 #include "../core/gl_util.h"
 #include "../core/gl_text.h"
+#include "../core/gl_stats.h"
+#include "../core/gl_stream.h"
 #include "../core/system.h"
 #include "../core/console.h"
 #include "../core/vmath.h"
@@ -18,6 +21,8 @@
 #include "render.h"
 #include "bsp_tree.h"
 #include "frustum.h"
+#include "occlusion.h"
+#include "portal_traversal.h"
 #include "shader_description.h"
 #include "shader_manager.h"
 #include "../room.h"
@@ -34,31 +39,52 @@ void CalculateWaterTint(GLfloat *tint, uint8_t fixed_colour);
 
 #define DEBUG_DRAWER_DEFAULT_BUFFER_SIZE        (128 * 1024)
 
+#define ROOM_CLIP_NONE          (0)
+#define ROOM_CLIP_SCISSOR       (1)     // frustums screen rect does not touch overlapped rooms
+#define ROOM_CLIP_STENCIL       (2)     // scissor + frustums polygons in stencil
+
 /*
  * =============================================================================
  */
 
 CRender::CRender():
 m_camera(NULL),
+m_fixed_tick(-1),
 m_rooms(NULL),
 m_rooms_count(0),
 m_anim_sequences(NULL),
 m_anim_sequences_count(0),
+m_anim_sequences_in_shader(false),
 m_active_transparency(0),
 m_active_texture(0),
 r_list_size(0),
 r_list_active_count(0),
 r_list(NULL),
+m_bsp_rooms(NULL),
+m_bsp_rooms_count(0),
+m_bsp_static_valid(false),
+m_bsp_vertex_source(-1),
+m_bsp_stream_buffer(0),
+m_bsp_stream_base(NULL),
+m_room_lights(NULL),
+m_room_clip(NULL),
+m_stencil_offset(0),
+m_stencil_fallback(false),
 frustumManager(NULL),
+portalTraversal(NULL),
+m_list_parallel(false),
 shaderManager(NULL),
 debugDrawer(NULL),
+occlusionCuller(NULL),
 dynamicBSP(NULL),
 r_flags(0x00)
 {
     this->InitSettings();
     frustumManager = new CFrustumManager(32768);
+    portalTraversal = new CPortalTraversal();
     debugDrawer    = new CRenderDebugDrawer();
     dynamicBSP     = new CDynamicBSP(512 * 1024);
+    occlusionCuller = new COcclusionCuller();
 }
 
 CRender::~CRender()
@@ -73,12 +99,29 @@ CRender::~CRender()
         r_list = NULL;
     }
 
+    if(m_bsp_rooms)
+    {
+        m_bsp_rooms_count = 0;
+        free(m_bsp_rooms);
+        m_bsp_rooms = NULL;
+    }
+
+    this->ClearRoomLights();
+    free(m_room_clip);
+    m_room_clip = NULL;
+
     if(frustumManager)
     {
         delete frustumManager;
         frustumManager = NULL;
     }
 
+    if(portalTraversal)
+    {
+        delete portalTraversal;
+        portalTraversal = NULL;
+    }
+
     if(debugDrawer)
     {
         delete debugDrawer;
@@ -91,6 +134,12 @@ CRender::~CRender()
         dynamicBSP = NULL;
     }
 
+    if(occlusionCuller)
+    {
+        delete occlusionCuller;
+        occlusionCuller = NULL;
+    }
+
     if(shaderManager)
     {
         delete shaderManager;
@@ -107,6 +156,7 @@ void CRender::InitSettings()
     settings.mipmaps = 3;
     settings.mipmap_mode = 3;
     settings.texture_border = 8;
+    settings.texture_format = 0;
     settings.z_depth = 16;
     settings.fog_enabled = 1;
     settings.fog_color[0] = 0.0f;
@@ -127,12 +177,22 @@ void CRender::DoShaders()
 void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim_seq_s *anim_sequences, uint32_t anim_sequences_count)
 {
     this->CleanList();
+    this->ClearRoomLights();
     r_flags = 0x00;
 
     m_rooms = rooms;
     m_rooms_count = rooms_count;
+    occlusionCuller->ResetWorld(rooms, rooms_count);
     m_anim_sequences = anim_sequences;
     m_anim_sequences_count = anim_sequences_count;
+    m_bsp_rooms_count = 0;
+    m_bsp_static_valid = false;
+    m_anim_sequences_in_shader = shaderManager && (anim_sequences_count <= (uint32_t)shaderManager->getAnimSequencesSize());
+    for(uint32_t i = 0, frames_count = 0; m_anim_sequences_in_shader && (i < anim_sequences_count); i++)
+    {
+        frames_count += anim_sequences[i].frames_count;
+        m_anim_sequences_in_shader = (frames_count <= (uint32_t)shaderManager->getAnimFramesSize());
+    }
 
     if(m_rooms)
     {
@@ -142,6 +202,8 @@ void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim
             free(r_list);
         }
         r_list = (struct render_list_s*)malloc(list_size * sizeof(struct render_list_s));
+        m_bsp_rooms = (struct room_s**)realloc(m_bsp_rooms, list_size * sizeof(struct room_s*));
+        m_room_clip = (struct room_clip_s*)realloc(m_room_clip, rooms_count * sizeof(struct room_clip_s));
         for(uint32_t i = 0; i < list_size; i++)
         {
             r_list[i].active = 0;
@@ -156,6 +218,12 @@ void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim
         {
             m_rooms[i].is_in_r_list = 0;
         }
+
+        m_room_lights = (struct room_lights_s*)calloc(m_rooms_count, sizeof(struct room_lights_s));
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            this->GenRoomLights(m_room_lights + i, m_rooms[i].original_content);
+        }
     }
 }
 
@@ -222,7 +290,61 @@ void CRender::UpdateAnimTextures()
                 };
             }
         }
+
+        this->UploadAnimTextures();
+    }
+}
+
+/**
+ * Sends current state of all animated sequences to the shaders table (see anim_texture.vsh),
+ * so meshes with animated polygons are drawn from static buffers.
+ */
+void CRender::UploadAnimTextures()
+{
+    if(!m_anim_sequences_in_shader || (shaderManager == NULL))
+    {
+        return;
+    }
+
+    GLfloat sequences[4 * MAX_ANIM_SEQUENCES];
+    GLfloat frames[8 * MAX_ANIM_FRAMES];
+    GLfloat *seq_data = sequences;
+    GLfloat *frame_data = frames;
+    int frames_count = 0;
+    anim_seq_p seq = m_anim_sequences;
+    for(uint32_t i = 0; i < m_anim_sequences_count; i++, seq++, seq_data += 4)
+    {
+        seq_data[0] = frames_count;
+        seq_data[1] = seq->frames_count;
+        seq_data[2] = seq->current_frame;
+        seq_data[3] = 0.0f;
+
+        tex_frame_p tf = seq->frames;
+        for(uint16_t j = 0; j < seq->frames_count; j++, tf++, frame_data += 8)
+        {
+            vec4_copy(frame_data, tf->mat);
+            frame_data[4] = tf->move[0];
+            frame_data[5] = tf->move[1] - tf->current_uvrotate;
+            frame_data[6] = 0.0f;
+            frame_data[7] = 0.0f;
+        }
+        frames_count += seq->frames_count;
     }
+
+    shaderManager->setAnimTextures(sequences, m_anim_sequences_count, frames, frames_count);
+}
+
+/**
+ * Camera is inside the bounds of the neighbour room (near the portal plane), so
+ * the room is drawn and its portals are started from the camera as well.
+ */
+static inline bool Render_IsCameraNearRoom(const float cam_pos[3], struct room_s *curr_room, struct room_s *dest_room)
+{
+    const float eps = 10.0f;
+    return (cam_pos[0] <= dest_room->bb_max[0] + eps) && (cam_pos[0] >= dest_room->bb_min[0] - eps) &&
+           (cam_pos[1] <= dest_room->bb_max[1] + eps) && (cam_pos[1] >= dest_room->bb_min[1] - eps) &&
+           (cam_pos[2] <= dest_room->bb_max[2] + eps) && (cam_pos[2] >= dest_room->bb_min[2] - eps) &&
+           !Room_IsInOverlappedRoomsList(curr_room, dest_room);
 }
 
 /**
@@ -230,8 +352,8 @@ void CRender::UpdateAnimTextures()
  */
 void CRender::GenWorldList(struct camera_s *cam)
 {
+    m_list_parallel = false;
     this->CleanList();
-    this->dynamicBSP->Reset(m_anim_sequences);
     this->frustumManager->Reset();
     cam->frustum->next = NULL;
     m_camera = cam;
@@ -246,10 +368,14 @@ void CRender::GenWorldList(struct camera_s *cam)
     cam->current_room = curr_room;                                              // set camera's cuttent room pointer
     if(curr_room != NULL)                                                       // camera located in some room
     {
-        const float eps = 10.0f;
         portal_p p = curr_room->content->portals;
         curr_room->frustum = NULL;                                              // room with camera inside has no frustums!
         this->AddRoom(curr_room);                                               // room with camera inside adds to the render list immediately
+        if((r_flags & R_PARALLEL_PORTALS) && this->GenWorldListParallel(curr_room))
+        {
+            return;
+        }
+
         for(uint16_t i = 0; i < curr_room->content->portals_count; i++, p++)    // go through all start room portals
         {
             room_p dest_room = p->dest_room->real_room;
@@ -260,10 +386,7 @@ void CRender::GenWorldList(struct camera_s *cam)
                 last_frus->parents_count = 1;                                   // created by camera
                 this->ProcessRoom(p, last_frus);                                // next start reccursion algorithm
             }
-            else if((cam_pos[0] <= dest_room->bb_max[0] + eps) && (cam_pos[0] >= dest_room->bb_min[0] - eps) &&
-                    (cam_pos[1] <= dest_room->bb_max[1] + eps) && (cam_pos[1] >= dest_room->bb_min[1] - eps) &&
-                    (cam_pos[2] <= dest_room->bb_max[2] + eps) && (cam_pos[2] >= dest_room->bb_min[2] - eps) &&
-                    !Room_IsInOverlappedRoomsList(curr_room, dest_room))
+            else if(Render_IsCameraNearRoom(cam_pos, curr_room, dest_room))
             {
                 portal_p np = dest_room->content->portals;
                 dest_room->frustum = NULL;                                      // room with camera inside has no frustums!
@@ -323,17 +446,38 @@ void CRender::DrawList()
         qglDisable(GL_BLEND);
         qglEnable(GL_ALPHA_TEST);
 
+        if(r_flags & R_OCCLUSION_CULLING)
+        {
+            // occluders are rasterized while sky box and room meshes are drawn
+            size_t buf_size = r_list_active_count * sizeof(room_p);
+            room_p *rooms = (room_p*)Sys_GetTempMem(buf_size);
+            for(uint32_t i = 0; i < r_list_active_count; i++)
+            {
+                rooms[i] = r_list[i].room;
+            }
+            occlusionCuller->BeginFrame(m_camera->gl_view_proj_mat, rooms, r_list_active_count);
+            Sys_ReturnTempMem(buf_size);
+        }
+
         m_active_texture = 0;
+        GLStats_BeginPass(GL_STATS_PASS_SKY);
         this->DrawSkyBox(m_camera->gl_view_proj_mat);
 
         /*
          * room rendering
          */
+        GLStats_BeginPass(GL_STATS_PASS_ROOMS);
+        this->PrepareRoomsClip();
+        for(uint32_t i = 0; i < r_list_active_count; i++)
+        {
+            this->DrawRoom(r_list[i].room, m_camera->gl_view_proj_mat);
+        }
         for(uint32_t i = 0; i < r_list_active_count; i++)
         {
-            this->DrawRoom(r_list[i].room, m_camera->gl_view_mat, m_camera->gl_view_proj_mat);
+            this->DrawRoomObjects(r_list[i].room, m_camera->gl_view_mat, m_camera->gl_view_proj_mat);
         }
 
+        GLStats_BeginPass(GL_STATS_PASS_SPRITES);
         qglDisable(GL_CULL_FACE);
         for(uint32_t i = 0; i < r_list_active_count; i++)
         {
@@ -343,28 +487,11 @@ void CRender::DrawList()
         /*
          * NOW render transparency polygons
          */
-        /*First generate BSP from base room mesh - it has good for start splitter polygons*/
-        for(uint32_t i = 0; i < r_list_active_count; i++)
-        {
-            room_p r = r_list[i].room;
-            if((r->content->mesh != NULL) && (r->content->mesh->transparency_polygons != NULL))
-            {
-                dynamicBSP->AddNewPolygonList(r->content->mesh->transparency_polygons, r->transform, m_camera->frustum);
-            }
-        }
-
+        GLStats_BeginPass(GL_STATS_PASS_TRANSPARENCY);
+        this->FillTransparencyBSP();
         for(uint32_t i = 0; i < r_list_active_count; i++)
         {
             room_p r = r_list[i].room;
-            // Add transparency polygons from static meshes (if they exists)
-            for(uint16_t j = 0; j < r->content->static_mesh_count; j++)
-            {
-                if((r->content->static_mesh[j].mesh->transparency_polygons != NULL) && Frustum_IsOBBVisibleInFrustumList(r->content->static_mesh[j].obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
-                {
-                    dynamicBSP->AddNewPolygonList(r->content->static_mesh[j].mesh->transparency_polygons, r->content->static_mesh[j].transform, m_camera->frustum);
-                }
-            }
-
             // Add transparency polygons from all entities (if they exists) // yes, entities may be animated and intersects with each others;
             for(engine_container_p cont = r->containers; cont; cont = cont->next)
             {
@@ -397,24 +524,115 @@ void CRender::DrawList()
             qglDisable(GL_ALPHA_TEST);
             qglEnable(GL_BLEND);
             m_active_transparency = 0;
-            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->m_vbo);
             qglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-            qglBufferDataARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->GetActiveVertexCount() * sizeof(vertex_t), dynamicBSP->GetVertexArray(), GL_DYNAMIC_DRAW);
-            qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
-            qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
-            qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
-            qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+            // static vertices are already in dynamicBSP->m_vbo (see FillTransparencyBSP),
+            // vertices of the animated polygons of this frame go to the stream buffer
+            uint32_t dynamic_count = dynamicBSP->GetActiveVertexCount() - dynamicBSP->GetStaticVertexCount();
+            m_bsp_stream_buffer = 0;
+            m_bsp_stream_base = (GLubyte*)(dynamicBSP->GetVertexArray() + dynamicBSP->GetStaticVertexCount());
+            if(dynamic_count > 0)
+            {
+                uint32_t offset;
+                void *v = GLStream_Map(dynamic_count * sizeof(vertex_t), &offset);
+                if(v != NULL)
+                {
+                    memcpy(v, m_bsp_stream_base, dynamic_count * sizeof(vertex_t));
+                    GLStream_Unmap();
+                    m_bsp_stream_buffer = GLStream_GetBuffer();
+                    m_bsp_stream_base = (GLubyte*)((size_t)offset);
+                }
+            }
+            m_bsp_vertex_source = -1;
             this->DrawBSPBackToFront(dynamicBSP->m_root);
             qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
             qglDepthMask(GL_TRUE);
             qglDisable(GL_BLEND);
         }
+        GLStats_EndPass();
         //Reset polygon draw mode
         qglPolygonMode(GL_FRONT, GL_FILL);
         m_active_texture = 0;
+        occlusionCuller->EndFrame();
+    }
+}
+
+/**
+ * Room and static meshes transparency never moves, so that part of the BSP is built
+ * only when the set of visible rooms changes; animated polygons are re-added every frame.
+ */
+void CRender::FillTransparencyBSP()
+{
+    bool rooms_changed = !m_bsp_static_valid || dynamicBSP->NeedRealloc() || (m_bsp_rooms_count != r_list_active_count);
+    for(uint32_t i = 0; !rooms_changed && (i < r_list_active_count); i++)
+    {
+        rooms_changed = (m_bsp_rooms[i] != r_list[i].room);
+    }
+
+    if(rooms_changed)
+    {
+        dynamicBSP->Reset(m_anim_sequences);
+        /*First generate BSP from base room mesh - it has good for start splitter polygons*/
+        for(uint32_t i = 0; i < r_list_active_count; i++)
+        {
+            room_p r = r_list[i].room;
+            if((r->content->mesh != NULL) && (r->content->mesh->transparency_polygons != NULL))
+            {
+                dynamicBSP->AddNewPolygonList(r->content->mesh->transparency_polygons, r->transform, NULL, BSP_ADD_STATIC_POLYGONS);
+            }
+            m_bsp_rooms[i] = r;
+        }
+
+        // Add transparency polygons from static meshes (if they exists)
+        for(uint32_t i = 0; i < r_list_active_count; i++)
+        {
+            room_p r = r_list[i].room;
+            for(uint16_t j = 0; j < r->content->static_mesh_count; j++)
+            {
+                if(r->content->static_mesh[j].mesh->transparency_polygons != NULL)
+                {
+                    dynamicBSP->AddNewPolygonList(r->content->static_mesh[j].mesh->transparency_polygons, r->content->static_mesh[j].transform, NULL, BSP_ADD_STATIC_POLYGONS);
+                }
+            }
+        }
+
+        dynamicBSP->SetStaticMark();
+        m_bsp_rooms_count = r_list_active_count;
+        m_bsp_static_valid = !dynamicBSP->NeedRealloc();
+
+        if(dynamicBSP->m_vbo != 0)
+        {
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->m_vbo);
+            qglBufferDataARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->GetStaticVertexCount() * sizeof(vertex_t), dynamicBSP->GetVertexArray(), GL_STATIC_DRAW_ARB);
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        }
+    }
+    else
+    {
+        dynamicBSP->ResetToStatic();
+    }
+
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        room_p r = r_list[i].room;
+        if((r->content->mesh != NULL) && (r->content->mesh->transparency_polygons != NULL))
+        {
+            dynamicBSP->AddNewPolygonList(r->content->mesh->transparency_polygons, r->transform, m_camera->frustum, BSP_ADD_ANIMATED_POLYGONS);
+        }
+        for(uint16_t j = 0; j < r->content->static_mesh_count; j++)
+        {
+            if((r->content->static_mesh[j].mesh->transparency_polygons != NULL) && Frustum_IsOBBVisibleInFrustumList(r->content->static_mesh[j].obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
+            {
+                dynamicBSP->AddNewPolygonList(r->content->static_mesh[j].mesh->transparency_polygons, r->content->static_mesh[j].transform, m_camera->frustum, BSP_ADD_ANIMATED_POLYGONS);
+            }
+        }
     }
 }
 
+bool CRender::IsOBBNotOccluded(struct obb_s *obb)
+{
+    return !(r_flags & R_OCCLUSION_CULLING) || occlusionCuller->IsOBBVisible(obb);
+}
+
 void CRender::DrawListDebugLines()
 {
     if(r_flags && m_camera)
@@ -600,7 +818,33 @@ void CRender::DrawBSPPolygon(struct bsp_polygon_s *p)
         m_active_texture = p->texture_index;
         qglBindTexture(GL_TEXTURE_2D, m_active_texture);
     }
-    qglDrawElements(GL_TRIANGLE_FAN, p->vertex_count, GL_UNSIGNED_INT, p->indexes);
+
+    // BSP polygon vertices are allocated sequentially, so indexes[0] is the first vertex
+    GLint first = p->indexes[0];
+    int8_t source = (first >= (GLint)dynamicBSP->GetStaticVertexCount()) ? (1) : (0);
+    if(m_bsp_vertex_source != source)
+    {
+        size_t base = 0;
+        m_bsp_vertex_source = source;
+        if(source)
+        {
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_bsp_stream_buffer);
+            base = (size_t)m_bsp_stream_base;
+        }
+        else
+        {
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->m_vbo);
+        }
+        qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, position)));
+        qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, color)));
+        qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, normal)));
+        qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, tex_coord)));
+    }
+    if(source)
+    {
+        first -= dynamicBSP->GetStaticVertexCount();
+    }
+    qglDrawArrays(GL_TRIANGLE_FAN, first, p->vertex_count);
 }
 
 void CRender::DrawBSPFrontToBack(struct bsp_node_s *root)
@@ -703,33 +947,40 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
 {
     if(mesh->animated_vertex_count)
     {
-        // Respecify the tex coord buffer
-        qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
-        // Tell OpenGL to discard the old values
-        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), 0, GL_STREAM_DRAW);
-        // Get writable data (to avoid copy)
-        GLfloat *data = (GLfloat *) qglMapBufferARB(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-        for(polygon_p p = mesh->animated_polygons; p; p = p->next)
-        {
-            anim_seq_p seq = m_anim_sequences + p->anim_id - 1;
-            uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
-            tex_frame_p tf = seq->frames + frame;
-            for(uint16_t i = 0; i < p->vertex_count; i++, data += 2)
-            {
-                ApplyAnimTextureTransformation(data, p->vertices[i].tex_coord, tf);
-            }
-        }
-        qglUnmapBufferARB(GL_ARRAY_BUFFER);
-
-        // Setup altered buffer
-        qglTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat [2]), 0);
         // Setup static data
         qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_vertex_array);
         qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
         qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
         qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
 
+        GLfloat *data = NULL;
+        size_t buf_size = mesh->animated_vertex_count * sizeof(GLfloat [2]);
+        if(m_anim_sequences_in_shader)
+        {
+            // Frame is selected by vertex shader
+            qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+            qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_frame_array);
+            qglEnableVertexAttribArrayARB(SHADER_ATTRIB_ANIM_FRAME);
+            qglVertexAttribPointerARB(SHADER_ATTRIB_ANIM_FRAME, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat [2]), 0);
+        }
+        else
+        {
+            // Too many sequences for shader's table; tex coords are calculated here
+            GLfloat *tc = data = (GLfloat*)Sys_GetTempMem(buf_size);
+            for(polygon_p p = mesh->animated_polygons; p; p = p->next)
+            {
+                anim_seq_p seq = m_anim_sequences + p->anim_id - 1;
+                uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
+                tex_frame_p tf = seq->frames + frame;
+                for(uint16_t i = 0; i < p->vertex_count; i++, tc += 2)
+                {
+                    ApplyAnimTextureTransformation(tc, p->vertices[i].tex_coord, tf);
+                }
+            }
+            qglBindBufferARB(GL_ARRAY_BUFFER, 0);
+            qglTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat [2]), data);
+        }
+
         mesh_face_p face = mesh->animated_faces;
         for(uint32_t face_index = 0; face_index < mesh->animated_faces_count; face_index++, face++)
         {
@@ -740,6 +991,16 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
             }
             qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
         }
+
+        if(data)
+        {
+            Sys_ReturnTempMem(buf_size);
+        }
+        else
+        {
+            qglDisableVertexAttribArrayARB(SHADER_ATTRIB_ANIM_FRAME);
+            qglVertexAttrib1fARB(SHADER_ATTRIB_ANIM_FRAME, 0.0f);               // not animated for all other meshes
+        }
     }
 
     if(mesh->vertex_count == 0)
@@ -815,6 +1076,34 @@ void CRender::DrawSkinMesh(struct base_mesh_s *mesh, struct base_mesh_s *parent_
     Sys_ReturnTempMem(2 * buf_size);
 }
 
+/**
+ * Draws skin mesh from bone's skin buffer (see SSBoneFrame_GenSkinVBO), deformation is done by
+ * entity vertex shader; bones palette must be set up by the caller.
+ */
+void CRender::DrawSkinMeshVBO(struct base_mesh_s *mesh, GLuint vbo_skin_array)
+{
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo_skin_array);
+    qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
+    qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+    qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+    qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+    qglEnableVertexAttribArrayARB(SHADER_ATTRIB_BONE_INDEX);
+    qglVertexAttribPointerARB(SHADER_ATTRIB_BONE_INDEX, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)(mesh->vertex_count * sizeof(vertex_t)));
+
+    mesh_face_p face = mesh->faces;
+    for(uint32_t face_index = 0; face_index < mesh->faces_count; face_index++, face++)
+    {
+        if(m_active_texture != face->texture_index)
+        {
+            m_active_texture = face->texture_index;
+            qglBindTexture(GL_TEXTURE_2D, m_active_texture);
+        }
+        qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
+    }
+
+    qglDisableVertexAttribArrayARB(SHADER_ATTRIB_BONE_INDEX);
+}
+
 void CRender::DrawSkyBox(const float modelViewProjectionMatrix[16])
 {
     skeletal_model_p skybox;
@@ -849,21 +1138,64 @@ void CRender::DrawSkyBox(const float modelViewProjectionMatrix[16])
 void CRender::DrawSkeletalModel(const lit_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float mvpMatrix[16])
 {
     ss_bone_tag_p btag = bframe->bone_tags;
-    float mvTransform[16];
-    float mvpTransform[16];
     //mvMatrix = modelViewMatrix x entity->transform
     //mvpMatrix = modelViewProjectionMatrix x entity->transform
+    qglUniformMatrix4fvARB(shader->model_view, 1, false, mvMatrix);
+    qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, mvpMatrix);
+
+    if(bframe->bone_tag_count > shaderManager->getBonePaletteSize())
+    {
+        this->DrawSkeletalModelPerBone(shader, bframe);
+        return;
+    }
+
+    // whole bones palette goes to the shader by one call; meshes select it's bone by constant attribute
+    GLfloat palette[16 * SS_BONE_PALETTE_SIZE];
+    for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
+    {
+        Mat4_Copy(palette + 16 * i, btag->full_transform);
+    }
+    qglUniformMatrix4fvARB(shader->bone_transform, bframe->bone_tag_count, false, palette);
 
+    btag = bframe->bone_tags;
     for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
     {
         if(!btag->is_hidden)
         {
-            Mat4_Mat4_mul(mvTransform, mvMatrix, btag->full_transform);
-            qglUniformMatrix4fvARB(shader->model_view, 1, false, mvTransform);
+            qglVertexAttrib1fARB(SHADER_ATTRIB_BONE_INDEX, (GLfloat)i);
+            this->DrawMesh((btag->mesh_replace) ? (btag->mesh_replace) : (btag->mesh_base), NULL, NULL);
+            if(btag->mesh_slot)
+            {
+                this->DrawMesh(btag->mesh_slot, NULL, NULL);
+            }
+            if(btag->mesh_skin && btag->parent)
+            {
+                if(btag->vbo_skin_array && !(r_flags & R_CPU_SKINNING))
+                {
+                    this->DrawSkinMeshVBO(btag->mesh_skin, btag->vbo_skin_array);
+                }
+                else
+                {
+                    this->DrawSkinMesh(btag->mesh_skin, btag->parent->mesh_base, btag->skin_map, btag->transform);
+                }
+            }
+        }
+    }
+    qglVertexAttrib1fARB(SHADER_ATTRIB_BONE_INDEX, 0.0f);
+}
 
-            Mat4_Mat4_mul(mvpTransform, mvpMatrix, btag->full_transform);
-            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, mvpTransform);
+/**
+ * Fallback for models with more bones than palette size: palette slot 0 is reloaded for every bone.
+ */
+void CRender::DrawSkeletalModelPerBone(const lit_shader_description *shader, struct ss_bone_frame_s *bframe)
+{
+    ss_bone_tag_p btag = bframe->bone_tags;
 
+    for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
+    {
+        if(!btag->is_hidden)
+        {
+            qglUniformMatrix4fvARB(shader->bone_transform, 1, false, btag->full_transform);
             this->DrawMesh((btag->mesh_replace) ? (btag->mesh_replace) : (btag->mesh_base), NULL, NULL);
             if(btag->mesh_slot)
             {
@@ -877,6 +1209,64 @@ void CRender::DrawSkeletalModel(const lit_shader_description *shader, struct ss_
     }
 }
 
+/**
+ * Compares CPU cost of per bone matrices upload with one bones palette upload;
+ * only uniforms are sent, meshes are not drawn.
+ */
+void CRender::BenchmarkBonesUpload(struct ss_bone_frame_s *bframe, int iterations)
+{
+    const lit_shader_description *shader = shaderManager->getEntityShader(0);
+    const float *mvMatrix, *mvpMatrix;
+    uint16_t bones_count = (bframe->bone_tag_count < shaderManager->getBonePaletteSize()) ? (bframe->bone_tag_count) : (shaderManager->getBonePaletteSize());
+    GLfloat palette[16 * SS_BONE_PALETTE_SIZE];
+    float mvTransform[16];
+    float mvpTransform[16];
+    float per_bone_time, palette_time, t;
+
+    if((m_camera == NULL) || (bframe->bone_tag_count == 0))
+    {
+        return;
+    }
+
+    mvMatrix = m_camera->gl_view_mat;
+    mvpMatrix = m_camera->gl_view_proj_mat;
+    qglUseProgramObjectARB(shader->program);
+    qglFinish();
+    t = Sys_FloatTime();
+    for(int n = 0; n < iterations; n++)
+    {
+        ss_bone_tag_p btag = bframe->bone_tags;
+        for(uint16_t i = 0; i < bones_count; i++, btag++)
+        {
+            Mat4_Mat4_mul(mvTransform, mvMatrix, btag->full_transform);
+            qglUniformMatrix4fvARB(shader->model_view, 1, false, mvTransform);
+            Mat4_Mat4_mul(mvpTransform, mvpMatrix, btag->full_transform);
+            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, mvpTransform);
+        }
+    }
+    qglFinish();
+    per_bone_time = Sys_FloatTime() - t;
+
+    t = Sys_FloatTime();
+    for(int n = 0; n < iterations; n++)
+    {
+        ss_bone_tag_p btag = bframe->bone_tags;
+        qglUniformMatrix4fvARB(shader->model_view, 1, false, mvMatrix);
+        qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, mvpMatrix);
+        for(uint16_t i = 0; i < bones_count; i++, btag++)
+        {
+            Mat4_Copy(palette + 16 * i, btag->full_transform);
+        }
+        qglUniformMatrix4fvARB(shader->bone_transform, bones_count, false, palette);
+    }
+    qglFinish();
+    palette_time = Sys_FloatTime() - t;
+    qglUseProgramObjectARB(0);
+
+    Con_Printf("bones = %d, iterations = %d", bones_count, iterations);
+    Con_Printf("per bone: %.3f ms, palette: %.3f ms", 1000.0f * per_bone_time, 1000.0f * palette_time);
+}
+
 void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
 {
     if(!(entity->state_flags & ENTITY_STATE_VISIBLE) || (entity->bf->animations.model->hide && !(r_flags & R_DRAW_NULLMESHES)))
@@ -911,17 +1301,16 @@ void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16
         {
             base_mesh_p mesh;
             float transform[16];
+            // hair elements are given in world space
+            qglUniformMatrix4fvARB(shader->model_view, 1, GL_FALSE, modelViewMatrix);
+            qglUniformMatrix4fvARB(shader->model_view_projection, 1, GL_FALSE, modelViewProjectionMatrix);
             for(int h = 0; h < entity->character->hair_count; h++)
             {
                 int num_elements = Hair_GetElementsCount(entity->character->hairs[h]);
                 for(uint16_t i = 0; i < num_elements; i++)
                 {
                     Hair_GetElementInfo(entity->character->hairs[h], i, &mesh, transform);
-                    Mat4_Mat4_mul(subModelView, modelViewMatrix, transform);
-                    Mat4_Mat4_mul(subModelViewProjection, modelViewProjectionMatrix, transform);
-
-                    qglUniformMatrix4fvARB(shader->model_view, 1, GL_FALSE, subModelView);
-                    qglUniformMatrix4fvARB(shader->model_view_projection, 1, GL_FALSE, subModelViewProjection);
+                    qglUniformMatrix4fvARB(shader->bone_transform, 1, GL_FALSE, transform);
                     this->DrawMesh(mesh, NULL, NULL);
                 }
             }
@@ -929,65 +1318,199 @@ void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16
     }
 }
 
-void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
+/**
+ * Screen bounds of the room frustums (portal windows); whole viewport if the
+ * room has no frustums (camera inside) or a frustum crosses the camera plane.
+ */
+static void Render_FrustumsRect(struct frustum_s *frustum, const float view_proj[16], const GLint viewport[4], GLint rect[4])
 {
-    float transform[16];
-    engine_container_p cont;
-    entity_p ent;
+    float bmin[2] = {1.0f, 1.0f}, bmax[2] = {-1.0f, -1.0f};
 
-    const shader_description *lastShader = 0;
+    if(frustum == NULL)
+    {
+        bmin[0] = bmin[1] = -1.0f;
+        bmax[0] = bmax[1] = 1.0f;
+    }
 
-#if STENCIL_FRUSTUM
-    ////start test stencil test code
-    bool need_stencil = false;
-    if(room->frustum != NULL)
+    for(frustum_p f = frustum; f; f = f->next)
     {
-        for(uint16_t i = 0; i < room->content->overlapped_room_list_size; i++)
+        float *v = f->vertex;
+        for(uint16_t i = 0; i < f->vertex_count; i++, v += 3)
         {
-            if(room->content->overlapped_room_list[i]->real_room->is_in_r_list)
+            float p[3], w = view_proj[3] * v[0] + view_proj[7] * v[1] + view_proj[11] * v[2] + view_proj[15];
+            if(w < 1.0f)
             {
-                need_stencil = true;
+                bmin[0] = bmin[1] = -1.0f;
+                bmax[0] = bmax[1] = 1.0f;
+                f = NULL;
                 break;
             }
+            Mat4_vec3_mul_macro(p, view_proj, v);
+            p[0] /= w;
+            p[1] /= w;
+            bmin[0] = (p[0] < bmin[0]) ? (p[0]) : (bmin[0]);
+            bmin[1] = (p[1] < bmin[1]) ? (p[1]) : (bmin[1]);
+            bmax[0] = (p[0] > bmax[0]) ? (p[0]) : (bmax[0]);
+            bmax[1] = (p[1] > bmax[1]) ? (p[1]) : (bmax[1]);
         }
-
-        if(need_stencil)
+        if(f == NULL)
         {
-            const int elem_size = (3 + 3 + 4 + 2) * sizeof(GLfloat);
-            const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
-            size_t buf_size;
+            break;
+        }
+    }
 
-            qglUseProgramObjectARB(shader->program);
-            qglUniform1iARB(shader->sampler, 0);
-            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, engine_camera.gl_view_proj_mat);
-            qglEnable(GL_STENCIL_TEST);
-            qglClear(GL_STENCIL_BUFFER_BIT);
-            qglStencilFunc(GL_NEVER, 1, 0x00);
-            qglStencilOp(GL_REPLACE, GL_KEEP, GL_KEEP);
+    bmin[0] = (bmin[0] < -1.0f) ? (-1.0f) : (bmin[0]);
+    bmin[1] = (bmin[1] < -1.0f) ? (-1.0f) : (bmin[1]);
+    bmax[0] = (bmax[0] > 1.0f) ? (1.0f) : (bmax[0]);
+    bmax[1] = (bmax[1] > 1.0f) ? (1.0f) : (bmax[1]);
+    if((bmin[0] >= bmax[0]) || (bmin[1] >= bmax[1]))
+    {
+        rect[0] = viewport[0];
+        rect[1] = viewport[1];
+        rect[2] = rect[3] = 0;
+        return;
+    }
+
+    rect[0] = viewport[0] + (GLint)floorf(0.5f * (bmin[0] + 1.0f) * viewport[2]);
+    rect[1] = viewport[1] + (GLint)floorf(0.5f * (bmin[1] + 1.0f) * viewport[3]);
+    rect[2] = viewport[0] + (GLint)ceilf(0.5f * (bmax[0] + 1.0f) * viewport[2]) - rect[0];
+    rect[3] = viewport[1] + (GLint)ceilf(0.5f * (bmax[1] + 1.0f) * viewport[3]) - rect[1];
+}
+
+
+static inline bool Render_RectsIntersect(const GLint a[4], const GLint b[4])
+{
+    return (a[0] < b[0] + b[2]) && (b[0] < a[0] + a[2]) && (a[1] < b[1] + b[3]) && (b[1] < a[1] + a[3]);
+}
+
+/**
+ * Rooms that overlap another visible room are clipped by their portals: by
+ * scissor rect of the frustums if that rect does not touch the overlapped
+ * rooms, else by frustums polygons in stencil (all fans in one stream range).
+ */
+void CRender::PrepareRoomsClip()
+{
+    GLint viewport[4];
+    uint32_t stencil_vertices = 0;
+
+    if(m_room_clip == NULL)
+    {
+        return;
+    }
+
+    qglGetIntegerv(GL_VIEWPORT, viewport);
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        struct room_clip_s *clip = m_room_clip + (r_list[i].room - m_rooms);
+        clip->mode = ROOM_CLIP_NONE;
+        clip->stencil_first = 0;
+        Render_FrustumsRect(r_list[i].room->frustum, m_camera->gl_view_proj_mat, viewport, clip->rect);
+    }
+
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        room_p room = r_list[i].room;
+        struct room_clip_s *clip = m_room_clip + (room - m_rooms);
+        if(room->frustum == NULL)
+        {
+            continue;
+        }
+
+        for(uint16_t j = 0; j < room->content->overlapped_room_list_size; j++)
+        {
+            room_p over = room->content->overlapped_room_list[j]->real_room;
+            if(over->is_in_r_list)
+            {
+                clip->mode = (clip->mode == ROOM_CLIP_NONE) ? (ROOM_CLIP_SCISSOR) : (clip->mode);
+                if(Render_RectsIntersect(clip->rect, m_room_clip[over - m_rooms].rect))
+                {
+                    clip->mode = ROOM_CLIP_STENCIL;
+                    break;
+                }
+            }
+        }
+
+        if(clip->mode == ROOM_CLIP_STENCIL)
+        {
+            clip->stencil_first = stencil_vertices;
             for(frustum_p f = room->frustum; f; f = f->next)
             {
-                buf_size = f->vertex_count * elem_size;
-                GLfloat *v, *buf = (GLfloat*)Sys_GetTempMem(buf_size);
-                v=buf;
-                for(int16_t i = f->vertex_count - 1; i >= 0; i--)
+                stencil_vertices += f->vertex_count;
+            }
+        }
+    }
+
+    if(stencil_vertices > 0)
+    {
+        GLfloat *v = (GLfloat*)GLStream_Map(stencil_vertices * 3 * sizeof(GLfloat), &m_stencil_offset);
+        if((v == NULL) != m_stencil_fallback)
+        {
+            m_stencil_fallback = (v == NULL);
+            Sys_DebugLog(SYS_LOG_FILENAME, (m_stencil_fallback) ? ("can not map %d stencil clip vertices, overlapped rooms are scissor clipped") :
+                                                                  ("%d stencil clip vertices are mapped, overlapped rooms are stencil clipped again"), stencil_vertices);
+        }
+        for(uint32_t i = 0; i < r_list_active_count; i++)
+        {
+            struct room_clip_s *clip = m_room_clip + (r_list[i].room - m_rooms);
+            if((clip->mode == ROOM_CLIP_STENCIL) && (v == NULL))
+            {
+                clip->mode = ROOM_CLIP_SCISSOR;
+            }
+            else if(clip->mode == ROOM_CLIP_STENCIL)
+            {
+                for(frustum_p f = r_list[i].room->frustum; f; f = f->next)
                 {
-                    vec3_copy(v, f->vertex + 3 * i);                    v+=3;
-                    vec3_copy_inv(v, engine_camera.gl_transform + 8);   v+=3;
-                    vec4_set_one(v);                                    v+=4;
-                    v[0] = v[1] = 0.0;                                  v+=2;
+                    for(int16_t k = f->vertex_count - 1; k >= 0; k--, v += 3)
+                    {
+                        vec3_copy(v, f->vertex + 3 * k);
+                    }
                 }
+            }
+        }
+        GLStream_Unmap();
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+    }
+}
 
-                m_active_texture = 0;
-                BindWhiteTexture();
-                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-                qglVertexPointer(3, GL_FLOAT, elem_size, buf+0);
-                qglNormalPointer(GL_FLOAT, elem_size, buf+3);
-                qglColorPointer(4, GL_FLOAT, elem_size, buf+3+3);
-                qglTexCoordPointer(2, GL_FLOAT, elem_size, buf+3+3+4);
-                qglDrawArrays(GL_TRIANGLE_FAN, 0, f->vertex_count);
+void CRender::DrawRoom(struct room_s *room, const float modelViewProjectionMatrix[16])
+{
+    const shader_description *lastShader = 0;
 
-                Sys_ReturnTempMem(buf_size);
+#if STENCIL_FRUSTUM
+    int8_t clip_mode = (m_room_clip) ? (m_room_clip[room - m_rooms].mode) : (ROOM_CLIP_NONE);
+    if(clip_mode != ROOM_CLIP_NONE)
+    {
+        struct room_clip_s *clip = m_room_clip + (room - m_rooms);
+        qglEnable(GL_SCISSOR_TEST);
+        qglScissor(clip->rect[0], clip->rect[1], clip->rect[2], clip->rect[3]);
+        if(clip_mode == ROOM_CLIP_STENCIL)
+        {
+            const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
+            const GLsizei stride = 3 * sizeof(GLfloat);
+            GLint first = clip->stencil_first;
+
+            qglUseProgramObjectARB(shader->program);
+            qglUniform1iARB(shader->sampler, 0);
+            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, engine_camera.gl_view_proj_mat);
+            qglEnable(GL_STENCIL_TEST);
+            qglClear(GL_STENCIL_BUFFER_BIT);                                    // scissor limits the clear
+            qglStencilFunc(GL_NEVER, 1, 0x00);
+            qglStencilOp(GL_REPLACE, GL_KEEP, GL_KEEP);
+            m_active_texture = 0;
+            BindWhiteTexture();
+
+            // fragments never pass, so other attributes just alias the positions
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, GLStream_GetBuffer());
+            qglVertexPointer(3, GL_FLOAT, stride, (void*)((size_t)m_stencil_offset));
+            qglNormalPointer(GL_FLOAT, stride, (void*)((size_t)m_stencil_offset));
+            qglColorPointer(3, GL_FLOAT, stride, (void*)((size_t)m_stencil_offset));
+            qglTexCoordPointer(2, GL_FLOAT, stride, (void*)((size_t)m_stencil_offset));
+            for(frustum_p f = room->frustum; f; f = f->next)
+            {
+                qglDrawArrays(GL_TRIANGLE_FAN, first, f->vertex_count);
+                first += f->vertex_count;
             }
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
             qglStencilFunc(GL_EQUAL, 1, 0xFF);
         }
     }
@@ -1009,18 +1532,33 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
 
         lastShader = shader;
         qglUniform4fvARB(shader->tint_mult, 1, tint);
-        qglUniform1fARB(shader->current_tick, (GLfloat) SDL_GetTicks());
+        qglUniform1fARB(shader->current_tick, (GLfloat)((m_fixed_tick >= 0) ? (m_fixed_tick) : (SDL_GetTicks())));
         qglUniform1iARB(shader->sampler, 0);
         qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, modelViewProjectionTransform);
         this->DrawMesh(room->content->mesh, NULL, NULL);
     }
 
 #if STENCIL_FRUSTUM
-    if(need_stencil)
+    if(clip_mode == ROOM_CLIP_STENCIL)
     {
         qglDisable(GL_STENCIL_TEST);
     }
+    if(clip_mode != ROOM_CLIP_NONE)
+    {
+        qglDisable(GL_SCISSOR_TEST);
+    }
 #endif
+}
+
+/**
+ * Static meshes and entities of the room (and of near rooms that are not in the
+ * render list); drawn after all room meshes, so occluders have been rasterized meanwhile.
+ */
+void CRender::DrawRoomObjects(struct room_s *room, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
+{
+    float transform[16];
+    engine_container_p cont;
+    entity_p ent;
 
     if (room->content->static_mesh_count > 0)
     {
@@ -1028,7 +1566,8 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
         for(uint32_t i = 0; i < room->content->static_mesh_count; i++)
         {
             if(Frustum_IsOBBVisibleInFrustumList(room->content->static_mesh[i].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
-               (!room->content->static_mesh[i].hide || (r_flags & R_DRAW_DUMMY_STATICS)))
+               (!room->content->static_mesh[i].hide || (r_flags & R_DRAW_DUMMY_STATICS)) &&
+               this->IsOBBNotOccluded(room->content->static_mesh[i].obb))
             {
                 Mat4_Mat4_mul(transform, modelViewProjectionMatrix, room->content->static_mesh[i].transform);
                 qglUniformMatrix4fvARB(shaderManager->getStaticMeshShader()->model_view_projection, 1, false, transform);
@@ -1054,7 +1593,8 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
         {
         case OBJECT_ENTITY:
             ent = (entity_p)cont->object;
-            if(Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
+            if(Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
+               this->IsOBBNotOccluded(ent->obb))
             {
                 this->DrawEntity(ent, modelViewMatrix, modelViewProjectionMatrix);
             }
@@ -1073,7 +1613,8 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
                 {
                     if(OBB_OBB_Test(near_room->content->static_mesh[si].obb, room->obb, 0.0f) &&
                        Frustum_IsOBBVisibleInFrustumList(near_room->content->static_mesh[si].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
-                       (!near_room->content->static_mesh[si].hide || (r_flags & R_DRAW_DUMMY_STATICS)))
+                       (!near_room->content->static_mesh[si].hide || (r_flags & R_DRAW_DUMMY_STATICS)) &&
+                       this->IsOBBNotOccluded(near_room->content->static_mesh[si].obb))
                     {
                         qglUseProgramObjectARB(shaderManager->getStaticMeshShader()->program);
                         Mat4_Mat4_mul(transform, modelViewProjectionMatrix, near_room->content->static_mesh[si].transform);
@@ -1101,7 +1642,8 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
                 case OBJECT_ENTITY:
                     ent = (entity_p)cont->object;
                     if(OBB_OBB_Test(ent->obb, room->obb, 0.0f) &&
-                       Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
+                       Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
+                       this->IsOBBNotOccluded(ent->obb))
                     {
                         this->DrawEntity(ent, modelViewMatrix, modelViewProjectionMatrix);
                     }
@@ -1121,8 +1663,21 @@ void CRender::DrawRoomSprites(struct room_s *room)
         GLfloat *view = m_camera->gl_transform + 8;
         GLfloat *up = m_camera->gl_transform + 4;
         GLfloat *right = m_camera->gl_transform + 0;
+        uint32_t offset;
+        size_t base;
+        vertex_p buf = (vertex_p)GLStream_Map(4 * room->content->sprites_count * sizeof(vertex_t), &offset);
+
+        if(buf != NULL)
+        {
+            base = offset;
+        }
+        else
+        {
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            buf = room->content->sprites_vertices;
+            base = (size_t)buf;
+        }
 
-        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
         qglUseProgramObjectARB(shader->program);
         qglUniform1iARB(shader->sampler, 0);
         qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, m_camera->gl_view_proj_mat);
@@ -1130,7 +1685,11 @@ void CRender::DrawRoomSprites(struct room_s *room)
         for(uint32_t i = 0; i < room->content->sprites_count; i++)
         {
             room_sprite_p s = room->content->sprites + i;
-            vertex_p v = room->content->sprites_vertices + i * 4;
+            vertex_p v = buf + i * 4;
+            if(buf != room->content->sprites_vertices)
+            {
+                memcpy(v, room->content->sprites_vertices + i * 4, 4 * sizeof(vertex_t));  // colours and texture coordinates
+            }
             vec3_copy_inv(v[0].normal, view);
             vec3_copy_inv(v[1].normal, view);
             vec3_copy_inv(v[2].normal, view);
@@ -1153,12 +1712,18 @@ void CRender::DrawRoomSprites(struct room_s *room)
             v[3].position[2] = s->pos[2] + s->sprite->right * right[2] + s->sprite->bottom * up[2];
         }
 
+        if(buf != room->content->sprites_vertices)
+        {
+            GLStream_Unmap();
+        }
+
         qglBindTexture(GL_TEXTURE_2D, room->content->sprites->sprite->texture_index);
-        qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->position);
-        qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->color);
-        qglNormalPointer(GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->normal);
-        qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->tex_coord);
+        qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, position)));
+        qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, color)));
+        qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, normal)));
+        qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)(base + offsetof(vertex_t, tex_coord)));
         qglDrawArrays(GL_QUADS, 0, 4 * room->content->sprites_count);
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
     }
 }
 
@@ -1253,121 +1818,405 @@ int CRender::ProcessRoom(struct portal_s *portal, struct frustum_s *frus)
 }
 
 /**
- * Sets up the light calculations for the given entity based on its current
- * room. Returns the used shader, which will have been made current already.
+ * Start portals go to the worker threads, the result is merged here in the
+ * serial order: the same frustums in the same rooms lists, the same r_list.
+ * Returns false if nothing was changed and the serial path has to be used.
  */
-const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16])
+bool CRender::GenWorldListParallel(struct room_s *curr_room)
 {
-    // Calculate lighting
-    const lit_shader_description *shader;
+    GLfloat *cam_pos = m_camera->gl_transform + 12;
+    portal_p p = curr_room->content->portals;
+    uint32_t task = 0;
 
-    room_s *room = entity->self->room;
-    if(room != NULL)
+    portalTraversal->Begin(m_camera);
+    for(uint16_t i = 0; i < curr_room->content->portals_count; i++, p++)
     {
-        GLfloat ambient_component[4];
+        room_p dest_room = p->dest_room->real_room;
+        portalTraversal->AddStart(p);
+        if(Render_IsCameraNearRoom(cam_pos, curr_room, dest_room))
+        {
+            for(uint16_t ii = 0; ii < dest_room->content->portals_count; ii++)  // used only if the portal is not visible
+            {
+                portalTraversal->AddStart(dest_room->content->portals + ii);
+            }
+        }
+    }
 
-        ambient_component[0] = room->content->ambient_lighting[0];
-        ambient_component[1] = room->content->ambient_lighting[1];
-        ambient_component[2] = room->content->ambient_lighting[2];
-        ambient_component[3] = 1.0f;
+    if(!portalTraversal->Run(frustumManager->GetBufferSize()))
+    {
+        return false;
+    }
 
-        if(room->content->room_flags & TR_ROOM_FLAG_WATER)
+    p = curr_room->content->portals;
+    for(uint16_t i = 0; i < curr_room->content->portals_count; i++, p++)
+    {
+        room_p dest_room = p->dest_room->real_room;
+        bool near_room = Render_IsCameraNearRoom(cam_pos, curr_room, dest_room);
+        if(this->MergeTraversal(task++))
         {
-            CalculateWaterTint(ambient_component, 0);
+            task += (near_room) ? (dest_room->content->portals_count) : (0);
         }
+        else if(near_room)
+        {
+            dest_room->frustum = NULL;                                          // room with camera inside has no frustums!
+            if(this->AddRoom(dest_room))
+            {
+                for(uint16_t ii = 0; ii < dest_room->content->portals_count; ii++)
+                {
+                    this->MergeTraversal(task++);
+                }
+            }
+            else
+            {
+                task += dest_room->content->portals_count;
+            }
+        }
+    }
 
-        GLenum current_light_number = 0;
-        light_s *current_light = NULL;
-
-        GLfloat positions[3*MAX_NUM_LIGHTS];
-        GLfloat colors[4*MAX_NUM_LIGHTS];
-        GLfloat innerRadiuses[1*MAX_NUM_LIGHTS];
-        GLfloat outerRadiuses[1*MAX_NUM_LIGHTS];
-        memset(positions, 0, sizeof(positions));
-        memset(colors, 0, sizeof(colors));
-        memset(innerRadiuses, 0, sizeof(innerRadiuses));
-        memset(outerRadiuses, 0, sizeof(outerRadiuses));
+    m_list_parallel = true;
+    return true;
+}
 
-        float *entity_pos = entity->transform + 12;
+/**
+ * Adds start portal frustum and all frustums generated from it, in the order
+ * of ProcessRoom recursion.
+ */
+struct frustum_s *CRender::MergeTraversal(uint32_t task_index)
+{
+    portal_traversal_task_p task = portalTraversal->GetTask(task_index);
 
-        for(uint32_t i = 0; (i < room->content->lights_count) && (current_light_number < MAX_NUM_LIGHTS); i++)
+    if(task->frustum)
+    {
+        room_p dest_room = task->portal->dest_room->real_room;
+        portal_traversal_event_p ev = portalTraversal->GetEvents(task);
+        Frustum_AddToList(&dest_room->frustum, task->frustum);
+        this->AddRoom(dest_room);
+        for(uint32_t i = 0; i < task->events_count; i++, ev++)
         {
-            current_light = &room->content->lights[i];
+            Frustum_AddToList(&ev->room->frustum, ev->frustum);
+            this->AddRoom(ev->room);
+        }
+    }
 
-            float x = entity_pos[0] - current_light->pos[0];
-            float y = entity_pos[1] - current_light->pos[1];
-            float z = entity_pos[2] - current_light->pos[2];
+    return task->frustum;
+}
 
-            float distance = sqrtf(x * x + y * y + z * z);
 
-            // Find color
-            colors[current_light_number*4 + 0] = std::fmin(std::fmax(current_light->colour[0], 0.0), 1.0);
-            colors[current_light_number*4 + 1] = std::fmin(std::fmax(current_light->colour[1], 0.0), 1.0);
-            colors[current_light_number*4 + 2] = std::fmin(std::fmax(current_light->colour[2], 0.0), 1.0);
-            colors[current_light_number*4 + 3] = std::fmin(std::fmax(current_light->colour[3], 0.0), 1.0);
+static inline void Render_DumpWord(uint32_t *buf, uint32_t size, uint32_t *n, uint32_t word)
+{
+    if(*n < size)
+    {
+        buf[*n] = word;
+    }
+    (*n)++;
+}
 
-            if(room->content->room_flags & TR_ROOM_FLAG_WATER)
-            {
-                CalculateWaterTint(colors + current_light_number * 4, 0);
-            }
 
-            // Find position
-            Mat4_vec3_mul(&positions[3*current_light_number], modelViewMatrix, current_light->pos);
+static inline void Render_DumpFloats(uint32_t *buf, uint32_t size, uint32_t *n, const float *v, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t word;
+        memcpy(&word, v + i, sizeof(uint32_t));
+        Render_DumpWord(buf, size, n, word);
+    }
+}
+
+/**
+ * Writes the render list and all rooms frustums as raw words, for the exact
+ * comparison; frustum parents are written as room index and list position.
+ * Returns the number of words (buf may be NULL to get the size).
+ */
+uint32_t CRender::DumpList(uint32_t *buf, uint32_t size)
+{
+    uint32_t n = 0;
+
+    Render_DumpWord(buf, size, &n, r_list_active_count);
+    Render_DumpWord(buf, size, &n, r_flags & R_DRAW_SKYBOX);
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        Render_DumpWord(buf, size, &n, r_list[i].room - m_rooms);
+        Render_DumpWord(buf, size, &n, r_list[i].active);
+        Render_DumpFloats(buf, size, &n, &r_list[i].dist, 1);
+    }
 
-            // Find fall-off
-            if(current_light->light_type == LT_SUN)
+    for(uint32_t i = 0; i < m_rooms_count; i++)
+    {
+        Render_DumpWord(buf, size, &n, m_rooms[i].is_in_r_list);
+        for(frustum_p f = m_rooms[i].frustum; f; f = f->next)
+        {
+            uint32_t parent_id = 0xFFFFFFFF;
+            for(uint32_t j = 0; (j < m_rooms_count) && (f->parent != m_camera->frustum) && (parent_id == 0xFFFFFFFF); j++)
             {
-                innerRadiuses[current_light_number] = 1e20f;
-                outerRadiuses[current_light_number] = 1e21f;
-                current_light_number++;
+                uint32_t pos = 0;
+                for(frustum_p pf = m_rooms[j].frustum; pf; pf = pf->next, pos++)
+                {
+                    if(pf == f->parent)
+                    {
+                        parent_id = (j << 16) | pos;
+                        break;
+                    }
+                }
             }
-            else if(distance <= current_light->outer + 1024.0f && (current_light->light_type == LT_POINT || current_light->light_type == LT_SHADOW))
+
+            Render_DumpWord(buf, size, &n, ((uint32_t)f->vertex_count << 16) | f->parents_count);
+            Render_DumpWord(buf, size, &n, parent_id);
+            Render_DumpWord(buf, size, &n, f->cam_pos == m_camera->gl_transform + 12);
+            Render_DumpFloats(buf, size, &n, f->norm, 4);
+            Render_DumpFloats(buf, size, &n, f->vertex, 3 * f->vertex_count);
+            Render_DumpFloats(buf, size, &n, f->planes, 4 * f->vertex_count);
+        }
+        Render_DumpWord(buf, size, &n, 0xFFFFFFFF);
+    }
+
+    return n;
+}
+
+/**
+ * Generates the list serially and on worker threads from the same camera and
+ * compares the results. Returns 1 if they are bit-identical, 0 if not, -1 if
+ * the parallel path was not taken (camera out of rooms or arena overflow).
+ */
+int CRender::CheckParallelList(struct camera_s *cam)
+{
+    uint32_t flags = r_flags;
+    uint32_t serial_size, parallel_size;
+    uint32_t *serial, *parallel;
+    int ret = -1;
+
+    r_flags &= ~R_PARALLEL_PORTALS;
+    this->GenWorldList(cam);
+    serial_size = this->DumpList(NULL, 0);
+    serial = (uint32_t*)malloc(serial_size * sizeof(uint32_t));
+    this->DumpList(serial, serial_size);
+
+    r_flags |= R_PARALLEL_PORTALS;
+    this->GenWorldList(cam);
+    if(m_list_parallel)
+    {
+        parallel_size = this->DumpList(NULL, 0);
+        parallel = (uint32_t*)malloc(parallel_size * sizeof(uint32_t));
+        this->DumpList(parallel, parallel_size);
+        ret = (parallel_size == serial_size) && !memcmp(serial, parallel, serial_size * sizeof(uint32_t));
+        free(parallel);
+    }
+    free(serial);
+
+    r_flags = (flags & ~R_DRAW_SKYBOX) | (r_flags & R_DRAW_SKYBOX);
+    return ret;
+}
+
+void CRender::ClearRoomLights()
+{
+    if(m_room_lights)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            free(m_room_lights[i].near_contents);
+            free(m_room_lights[i].lights);
+        }
+        free(m_room_lights);
+        m_room_lights = NULL;
+    }
+}
+
+/*
+ * Collects content's own lights (sun, point and shadow) and near rooms point
+ * and shadow lights with all per light values that are constant for the room.
+ */
+void CRender::GenRoomLights(struct room_lights_s *rl, struct room_content_s *content)
+{
+    uint32_t lights_count = content->lights_count;
+    bool water = (content->room_flags & TR_ROOM_FLAG_WATER);
+
+    free(rl->near_contents);
+    free(rl->lights);
+    rl->near_contents = NULL;
+    rl->lights = NULL;
+    rl->lights_count = 0;
+    rl->near_contents_count = content->near_room_list_size;
+    if(rl->near_contents_count > 0)
+    {
+        rl->near_contents = (struct room_content_s**)malloc(rl->near_contents_count * sizeof(struct room_content_s*));
+        for(uint16_t i = 0; i < rl->near_contents_count; i++)
+        {
+            rl->near_contents[i] = content->near_room_list[i]->content;
+            lights_count += rl->near_contents[i]->lights_count;
+        }
+    }
+
+    if(lights_count > 0xFFFF)
+    {
+        lights_count = 0xFFFF;
+    }
+    if(lights_count == 0)
+    {
+        return;
+    }
+
+    rl->lights = (struct light_s**)malloc(lights_count * (sizeof(struct light_s*) + 11 * sizeof(float)));
+    rl->pos_x  = (float*)(rl->lights + lights_count);
+    rl->pos_y  = rl->pos_x  + lights_count;
+    rl->pos_z  = rl->pos_y  + lights_count;
+    rl->range  = rl->pos_z  + lights_count;
+    rl->weight = rl->range  + lights_count;
+    rl->inner  = rl->weight + lights_count;
+    rl->outer  = rl->inner  + lights_count;
+    rl->colour = rl->outer  + lights_count;
+
+    for(uint32_t i = 0; (i < content->lights_count) && (rl->lights_count < lights_count); i++)
+    {
+        light_p light = content->lights + i;
+        if((light->light_type == LT_SUN) || (light->light_type == LT_POINT) || (light->light_type == LT_SHADOW))
+        {
+            rl->lights[rl->lights_count++] = light;
+        }
+    }
+
+    for(uint16_t j = 0; j < rl->near_contents_count; j++)
+    {
+        room_content_p near_content = rl->near_contents[j];
+        for(uint32_t i = 0; (i < near_content->lights_count) && (rl->lights_count < lights_count); i++)
+        {
+            light_p light = near_content->lights + i;
+            if((light->light_type == LT_POINT) || (light->light_type == LT_SHADOW))
             {
-                innerRadiuses[current_light_number] = std::fabs(current_light->inner);
-                outerRadiuses[current_light_number] = std::fabs(current_light->outer);
-                current_light_number++;
+                rl->lights[rl->lights_count++] = light;
             }
         }
+    }
+
+    for(uint16_t i = 0; i < rl->lights_count; i++)
+    {
+        light_p light = rl->lights[i];
+        GLfloat *colour = rl->colour + 4 * i;
+
+        colour[0] = std::fmin(std::fmax(light->colour[0], 0.0), 1.0);
+        colour[1] = std::fmin(std::fmax(light->colour[1], 0.0), 1.0);
+        colour[2] = std::fmin(std::fmax(light->colour[2], 0.0), 1.0);
+        colour[3] = std::fmin(std::fmax(light->colour[3], 0.0), 1.0);
+        if(water)
+        {
+            CalculateWaterTint(colour, 0);
+        }
+
+        rl->pos_x[i] = light->pos[0];
+        rl->pos_y[i] = light->pos[1];
+        rl->pos_z[i] = light->pos[2];
+        rl->weight[i] = 0.299f * colour[0] + 0.587f * colour[1] + 0.114f * colour[2];
+        if(light->light_type == LT_SUN)
+        {
+            // sun is unlimited and always outranks point lights
+            rl->inner[i] = 1e20f;
+            rl->outer[i] = 1e21f;
+            rl->range[i] = 1e21f;
+            rl->weight[i] += 1.0f;
+        }
+        else
+        {
+            rl->inner[i] = std::fabs(light->inner);
+            rl->outer[i] = std::fabs(light->outer);
+            rl->range[i] = rl->outer[i] + 1024.0f;
+        }
+    }
+}
+
+/**
+ * Sets up the light calculations for the given entity based on its current
+ * room. Returns the used shader, which will have been made current already.
+ */
+const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16])
+{
+    // Calculate lighting
+    const lit_shader_description *shader;
+
+    room_s *room = entity->self->room;
+    if((room != NULL) && (m_room_lights != NULL) && (room->content->original_room_id < m_rooms_count))
+    {
+        room_content_p content = room->content;
+        struct room_lights_s *rl = m_room_lights + content->original_room_id;
+        GLfloat ambient_component[4];
+
+        ambient_component[0] = content->ambient_lighting[0];
+        ambient_component[1] = content->ambient_lighting[1];
+        ambient_component[2] = content->ambient_lighting[2];
+        ambient_component[3] = 1.0f;
 
-        for(uint32_t room_index = 0; (current_light_number < MAX_NUM_LIGHTS) && (room_index < room->content->near_room_list_size); room_index++)
+        if(content->room_flags & TR_ROOM_FLAG_WATER)
         {
-            room_p near_room = room->content->near_room_list[room_index];
-            for(uint32_t i = 0; (i < near_room->content->lights_count) && (current_light_number < MAX_NUM_LIGHTS); i++)
+            CalculateWaterTint(ambient_component, 0);
+        }
+
+        // near rooms may be flipped since the list was built
+        for(uint16_t i = 0; i < rl->near_contents_count; i++)
+        {
+            if(rl->near_contents[i] != content->near_room_list[i]->content)
             {
-                current_light = &near_room->content->lights[i];
+                this->GenRoomLights(rl, content);
+                break;
+            }
+        }
 
-                float x = entity_pos[0] - current_light->pos[0];
-                float y = entity_pos[1] - current_light->pos[1];
-                float z = entity_pos[2] - current_light->pos[2];
+        GLenum current_light_number = 0;
+        uint16_t best[MAX_NUM_LIGHTS];
+        GLfloat positions[3*MAX_NUM_LIGHTS];
+        GLfloat colors[4*MAX_NUM_LIGHTS];
+        GLfloat innerRadiuses[1*MAX_NUM_LIGHTS];
+        GLfloat outerRadiuses[1*MAX_NUM_LIGHTS];
 
-                float distance = sqrtf(x * x + y * y + z * z);
+        if(rl->lights_count > 0)
+        {
+            float *entity_pos = entity->transform + 12;
+            float *score = (float*)Sys_GetTempMem(rl->lights_count * sizeof(float));
 
-                // Find color
-                colors[current_light_number*4 + 0] = std::fmin(std::fmax(current_light->colour[0], 0.0), 1.0);
-                colors[current_light_number*4 + 1] = std::fmin(std::fmax(current_light->colour[1], 0.0), 1.0);
-                colors[current_light_number*4 + 2] = std::fmin(std::fmax(current_light->colour[2], 0.0), 1.0);
-                colors[current_light_number*4 + 3] = std::fmin(std::fmax(current_light->colour[3], 0.0), 1.0);
+            // branchless pass over flat arrays, vectorizable by compiler
+            for(uint16_t i = 0; i < rl->lights_count; i++)
+            {
+                float x = entity_pos[0] - rl->pos_x[i];
+                float y = entity_pos[1] - rl->pos_y[i];
+                float z = entity_pos[2] - rl->pos_z[i];
+                float distance = sqrtf(x * x + y * y + z * z);
+                score[i] = rl->weight[i] * (rl->range[i] - distance) / rl->range[i];
+            }
 
-                // Find position
-                Mat4_vec3_mul(&positions[3*current_light_number], modelViewMatrix, current_light->pos);
+            // keep the strongest lights, sorted by score
+            for(uint16_t i = 0; i < rl->lights_count; i++)
+            {
+                float s = score[i];
+                if((s <= 0.0f) || ((current_light_number == MAX_NUM_LIGHTS) && (s <= score[best[MAX_NUM_LIGHTS - 1]])))
+                {
+                    continue;
+                }
 
-                // Find fall-off
-                if(distance <= current_light->outer + 1024.0f && (current_light->light_type == LT_POINT || current_light->light_type == LT_SHADOW))
+                uint32_t j = (current_light_number < MAX_NUM_LIGHTS) ? (current_light_number++) : (MAX_NUM_LIGHTS - 1);
+                for(; (j > 0) && (score[best[j - 1]] < s); j--)
                 {
-                    innerRadiuses[current_light_number] = std::fabs(current_light->inner);
-                    outerRadiuses[current_light_number] = std::fabs(current_light->outer);
-                    current_light_number++;
+                    best[j] = best[j - 1];
                 }
+                best[j] = i;
             }
+            Sys_ReturnTempMem(rl->lights_count * sizeof(float));
+        }
+
+        for(uint32_t i = 0; i < current_light_number; i++)
+        {
+            uint16_t l = best[i];
+            vec4_copy(colors + 4 * i, rl->colour + 4 * l);
+            Mat4_vec3_mul(&positions[3 * i], modelViewMatrix, rl->lights[l]->pos);
+            innerRadiuses[i] = rl->inner[l];
+            outerRadiuses[i] = rl->outer[l];
         }
 
         shader = shaderManager->getEntityShader(current_light_number);
         qglUseProgramObjectARB(shader->program);
         qglUniform4fvARB(shader->light_ambient, 1, ambient_component);
-        qglUniform4fvARB(shader->light_color, current_light_number, colors);
-        qglUniform3fvARB(shader->light_position, current_light_number, positions);
-        qglUniform1fvARB(shader->light_inner_radius, current_light_number, innerRadiuses);
-        qglUniform1fvARB(shader->light_outer_radius, current_light_number, outerRadiuses);
+        if(current_light_number > 0)
+        {
+            qglUniform4fvARB(shader->light_color, current_light_number, colors);
+            qglUniform3fvARB(shader->light_position, current_light_number, positions);
+            qglUniform1fvARB(shader->light_inner_radius, current_light_number, innerRadiuses);
+            qglUniform1fvARB(shader->light_outer_radius, current_light_number, outerRadiuses);
+        }
     }
     else
     {
@@ -1385,7 +2234,6 @@ m_drawFlags(0x00000000),
 m_max_lines(DEBUG_DRAWER_DEFAULT_BUFFER_SIZE),
 m_lines(0),
 m_need_realloc(false),
-m_gl_vbo(0),
 m_buffer(NULL),
 m_obb(NULL)
 {
@@ -1398,11 +2246,6 @@ CRenderDebugDrawer::~CRenderDebugDrawer()
 {
     free(m_buffer);
     m_buffer = NULL;
-    if(m_gl_vbo != 0)
-    {
-        qglDeleteBuffersARB(1, &m_gl_vbo);
-        m_gl_vbo = 0;
-    }
     OBB_Delete(m_obb);
     m_obb = NULL;
 }
@@ -1421,24 +2264,31 @@ void CRenderDebugDrawer::Reset()
         }
         m_need_realloc = false;
     }
-    if(m_gl_vbo == 0)
-    {
-        qglGenBuffersARB(1, &m_gl_vbo);
-    }
     m_lines = 0;
 }
 
 void CRenderDebugDrawer::Render()
 {
-    if((m_lines > 0) && (m_gl_vbo != 0))
+    // big debug sets (physics debug draw) are streamed in quarters of the ring
+    const uint32_t max_lines = GLStream_GetSize() / (4 * 12 * sizeof(GLfloat));
+    for(uint32_t first = 0; (first < m_lines) && (max_lines > 0);)
     {
-        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_gl_vbo);
-        qglBufferDataARB(GL_ARRAY_BUFFER_ARB, m_lines * 12 * sizeof(GLfloat), m_buffer, GL_STREAM_DRAW);
-        qglVertexPointer(3, GL_FLOAT, 6 * sizeof(GLfloat), (void*)0);
-        qglColorPointer(3, GL_FLOAT, 6 * sizeof(GLfloat),  (void*)(3 * sizeof(GLfloat)));
-        qglDrawArrays(GL_LINES, 0, 2 * m_lines);
-        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        uint32_t offset;
+        uint32_t count = (m_lines - first < max_lines) ? (m_lines - first) : (max_lines);
+        size_t buf_size = count * 12 * sizeof(GLfloat);
+        void *v = GLStream_Map(buf_size, &offset);
+        if(v == NULL)
+        {
+            break;
+        }
+        memcpy(v, m_buffer + 12 * first, buf_size);
+        GLStream_Unmap();
+        qglVertexPointer(3, GL_FLOAT, 6 * sizeof(GLfloat), (void*)((size_t)offset));
+        qglColorPointer(3, GL_FLOAT, 6 * sizeof(GLfloat),  (void*)(offset + 3 * sizeof(GLfloat)));
+        qglDrawArrays(GL_LINES, 0, 2 * count);
+        first += count;
     }
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 
     vec3_set_zero(m_color);
     m_lines = 0;
@@ -29,6 +29,9 @@
 #define R_DRAW_TRIGGERS         0x00040000      // Trigger sectors drawing
 #define R_DRAW_AI_BOXES         0x00080000      // AI boxes drawing
 #define R_DRAW_AI_OBJECTS       0x00100000      // AI objects drawing
+#define R_CPU_SKINNING          0x00200000      // Skinned meshes deformation on CPU (debug)
+#define R_OCCLUSION_CULLING     0x00400000      // Software occlusion culling of static meshes and entities
+#define R_PARALLEL_PORTALS      0x00800000      // Portal traversal from start portals on worker threads
 
 #define STENCIL_FRUSTUM 1
 
@@ -77,6 +80,7 @@ typedef struct render_settings_s
     int8_t    antialias;
     int8_t    antialias_samples;
     int8_t    texture_border;
+    int8_t    texture_format;                                                   // atlas pages storage: TEXTURE_FORMAT_*
     int8_t    z_depth;
     int8_t    fog_enabled;
     GLfloat   fog_color[4];
@@ -126,7 +130,6 @@ class CRenderDebugDrawer
         uint32_t m_lines;
         bool     m_need_realloc;
 
-        GLuint   m_gl_vbo;
         GLfloat  m_color[3];
         GLfloat *m_buffer;
 
@@ -144,6 +147,11 @@ class CRender
         void UpdateAnimTextures();
 
         void GenWorldList(struct camera_s *cam);
+        int  CheckParallelList(struct camera_s *cam);
+        void SetFixedTick(int32_t tick)                                         // < 0 - real time in shaders; else repeatable images
+        {
+            m_fixed_tick = tick;
+        }
         void DrawList();
         void DrawListDebugLines();
         void CleanList();
@@ -154,12 +162,16 @@ class CRender
 
         void DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices, const float *overrideNormals);
         void DrawSkinMesh(struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, uint32_t *map, float transform[16]);
+        void DrawSkinMeshVBO(struct base_mesh_s *mesh, GLuint vbo_skin_array);
         void DrawSkyBox(const float matrix[16]);
 
         void DrawSkeletalModel(const struct lit_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float mvpMatrix[16]);
+        void DrawSkeletalModelPerBone(const struct lit_shader_description *shader, struct ss_bone_frame_s *bframe);
+        void BenchmarkBonesUpload(struct ss_bone_frame_s *bframe, int iterations);
         void DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16]);
 
-        void DrawRoom(struct room_s *room, const float matrix[16], const float modelViewProjectionMatrix[16]);
+        void DrawRoom(struct room_s *room, const float modelViewProjectionMatrix[16]);
+        void DrawRoomObjects(struct room_s *room, const float matrix[16], const float modelViewProjectionMatrix[16]);
         void DrawRoomSprites(struct room_s *room);
 
         struct gl_text_line_s *OutTextXYZ(GLfloat x, GLfloat y, GLfloat z, const char *fmt, ...);
@@ -172,17 +184,53 @@ class CRender
             float              dist;
         };
 
+        // Portal clipping of a room drawn while an overlapped room is visible
+        struct room_clip_s
+        {
+            int8_t                      mode;                                   // ROOM_CLIP_*
+            GLint                       rect[4];                                // frustums screen bounds: x, y, w, h
+            GLint                       stencil_first;                          // frustums fans in m_stencil_offset range
+        };
+
+        // Entity lighting candidates of one room content: own and near rooms lights
+        struct room_lights_s
+        {
+            struct room_content_s     **near_contents;                          // near rooms contents at build time, checked on flipmaps
+            uint16_t                    near_contents_count;
+            uint16_t                    lights_count;
+            struct light_s            **lights;
+            float                      *pos_x;                                  // scoring arrays
+            float                      *pos_y;
+            float                      *pos_z;
+            float                      *range;                                  // outer + 1024; 1e21 for sun (unlimited)
+            float                      *weight;                                 // colour luminance
+            float                      *colour;                                 // 4 per light, clamped and water tinted
+            float                      *inner;
+            float                      *outer;
+        };
+
         void InitSettings();
+        void UploadAnimTextures();
+        void FillTransparencyBSP();
+        bool IsOBBNotOccluded(struct obb_s *obb);
+        void PrepareRoomsClip();
         int  AddRoom(struct room_s *room);
         int  ProcessRoom(struct portal_s *portal, struct frustum_s *frus);
+        bool GenWorldListParallel(struct room_s *curr_room);
+        struct frustum_s *MergeTraversal(uint32_t task_index);
+        uint32_t DumpList(uint32_t *buf, uint32_t size);
+        void GenRoomLights(struct room_lights_s *rl, struct room_content_s *content);
+        void ClearRoomLights();
         const lit_shader_description *SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16]);
 
         struct camera_s            *m_camera;
+        int32_t                     m_fixed_tick;
 
         struct room_s              *m_rooms;
         uint32_t                    m_rooms_count;
         struct anim_seq_s          *m_anim_sequences;
         uint32_t                    m_anim_sequences_count;
+        bool                        m_anim_sequences_in_shader;                 // all sequences fit to shader's table
 
         uint16_t                    m_active_transparency;
         GLuint                      m_active_texture;
@@ -190,12 +238,25 @@ class CRender
         uint32_t                    r_list_size;
         uint32_t                    r_list_active_count;
         struct render_list_s       *r_list;
+        struct room_s             **m_bsp_rooms;                                // rooms of the static transparency BSP part
+        uint32_t                    m_bsp_rooms_count;
+        bool                        m_bsp_static_valid;
+        int8_t                      m_bsp_vertex_source;                        // bound BSP vertices: 0 - static VBO, 1 - this frame's animated ones
+        GLuint                      m_bsp_stream_buffer;                        // animated BSP vertices: stream buffer or client memory
+        GLubyte                    *m_bsp_stream_base;
+        struct room_lights_s       *m_room_lights;                              // per room original content
+        struct room_clip_s         *m_room_clip;                                // per room, valid for rooms in r_list
+        uint32_t                    m_stencil_offset;                           // this frame's frustums fans in stream buffer
+        bool                        m_stencil_fallback;                         // stream map failed, stencil clip falls back to scissor
         class CFrustumManager      *frustumManager;
+        class CPortalTraversal     *portalTraversal;
+        bool                        m_list_parallel;                            // last list was generated by portalTraversal
 
     public:
         struct render_settings_s    settings;
         class shader_manager       *shaderManager;
         class CRenderDebugDrawer   *debugDrawer;
+        class COcclusionCuller     *occlusionCuller;
         class CDynamicBSP          *dynamicBSP;
         uint32_t                    r_flags;
 };
@@ -7,9 +7,12 @@
 //
 
 #include "shader_description.h"
+#include "../core/gl_program_cache.h"
+#include "../core/system.h"
 #include "../engine.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 shader_stage::shader_stage(GLenum type, const char *filename, const char *additionalDefines)
 {
@@ -18,23 +21,71 @@ shader_stage::shader_stage(GLenum type, const char *filename, const char *additi
     strncpy(shader_path, Engine_GetBasePath(), shader_path_base_len);
     shader_path[shader_path_base_len] = 0;
     strncat(shader_path, filename, shader_path_base_len - strlen(shader_path));
-    shader = qglCreateShaderObjectARB(type);
-    if (!loadShaderFromFile(shader, shader_path, additionalDefines))
+    this->shader = 0;
+    this->type = type;
+    this->source = readShaderFile(shader_path);
+    this->defines = (additionalDefines) ? (strdup(additionalDefines)) : (NULL);
+    if (!source)
         abort();
+
+    hash = GLProgramCache_Hash(GL_PROGRAM_CACHE_HASH_INIT, &type, sizeof(type));
+    if (defines)
+        hash = GLProgramCache_Hash(hash, defines, strlen(defines));
+    hash = GLProgramCache_Hash(hash, "\0", 1);
+    hash = GLProgramCache_Hash(hash, source, strlen(source));
 }
 
 shader_stage::~shader_stage()
 {
-    qglDeleteObjectARB(shader);
+    if (shader)
+        qglDeleteObjectARB(shader);
+    free(source);
+    free(defines);
+}
+
+GLhandleARB shader_stage::get() const
+{
+    if (!shader)
+    {
+        shader = qglCreateShaderObjectARB(type);
+        if (!loadShaderFromBuff(shader, source, defines))
+            abort();
+    }
+    return shader;
 }
 
-shader_description::shader_description(const shader_stage &vertex, const shader_stage &fragment)
+shader_description::shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library)
 {
+    const GLint attribs[2] = { SHADER_ATTRIB_BONE_INDEX, SHADER_ATTRIB_ANIM_FRAME };
+    uint64_t key = GLProgramCache_Hash(GL_PROGRAM_CACHE_HASH_INIT, attribs, sizeof(attribs));
+    key = GLProgramCache_Hash(key, &vertex.hash, sizeof(uint64_t));
+    key = GLProgramCache_Hash(key, &fragment.hash, sizeof(uint64_t));
+    if(library)
+    {
+        key = GLProgramCache_Hash(key, &library->hash, sizeof(uint64_t));
+    }
+
     program = qglCreateProgramObjectARB();
-    qglAttachObjectARB(program, vertex.shader);
-    qglAttachObjectARB(program, fragment.shader);
-    qglLinkProgramARB(program);
-    //printInfoLog(program);
+    if(!GLProgramCache_Load(program, key))
+    {
+        qglAttachObjectARB(program, vertex.get());
+        qglAttachObjectARB(program, fragment.get());
+        if(library)
+        {
+            qglAttachObjectARB(program, library->get());
+        }
+        qglBindAttribLocationARB(program, SHADER_ATTRIB_BONE_INDEX, "boneIndex");
+        qglBindAttribLocationARB(program, SHADER_ATTRIB_ANIM_FRAME, "animFrame");
+        GLProgramCache_Link(program, key);
+    }
+
+    // Binaries are checked by the cache, but a program linked here may fail as well
+    qglGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &linked);
+    if(!linked)
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "shader program link failed, see gl log");
+        printInfoLog(program);
+    }
 
     sampler = qglGetUniformLocationARB(program, "color_map");
 }
@@ -51,16 +102,19 @@ text_shader_description::text_shader_description(const shader_stage &vertex, con
     colorReplace = qglGetUniformLocationARB(program, "colorReplace");
 }
 
-unlit_shader_description::unlit_shader_description(const shader_stage &vertex, const shader_stage &fragment)
-: shader_description(vertex, fragment)
+unlit_shader_description::unlit_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library)
+: shader_description(vertex, fragment, library)
 {
     model_view_projection = qglGetUniformLocationARB(program, "modelViewProjection");
+    anim_sequence = qglGetUniformLocationARB(program, "animSequence");
+    anim_frames = qglGetUniformLocationARB(program, "animFrames");
 }
 
-lit_shader_description::lit_shader_description(const shader_stage &vertex, const shader_stage &fragment)
-: unlit_shader_description(vertex, fragment)
+lit_shader_description::lit_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library)
+: unlit_shader_description(vertex, fragment, library)
 {
     model_view = qglGetUniformLocationARB(program, "modelView");
+    bone_transform = qglGetUniformLocationARB(program, "boneTransform");
     number_of_lights = qglGetUniformLocationARB(program, "number_of_lights");
     light_position = qglGetUniformLocationARB(program, "light_position");
     light_color = qglGetUniformLocationARB(program, "light_color");
@@ -69,8 +123,8 @@ lit_shader_description::lit_shader_description(const shader_stage &vertex, const
     light_ambient = qglGetUniformLocationARB(program, "light_ambient");
 }
 
-unlit_tinted_shader_description::unlit_tinted_shader_description(const shader_stage &vertex, const shader_stage &fragment)
-: unlit_shader_description(vertex, fragment)
+unlit_tinted_shader_description::unlit_tinted_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library)
+: unlit_shader_description(vertex, fragment, library)
 {
     current_tick = qglGetUniformLocationARB(program, "fCurrentTick");
     tint_mult = qglGetUniformLocationARB(program, "tintMult");
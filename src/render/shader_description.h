@@ -3,14 +3,29 @@
 
 #include <SDL2/SDL_platform.h>
 #include <SDL2/SDL_opengl.h>
+#include <stdint.h>
 #include "../core/gl_util.h"
 
+// Generic vertex attributes slots; chosen to not alias the conventional ones
+// (gl_Vertex = 0, gl_Normal = 2, gl_Color = 3, gl_MultiTexCoord0 = 8).
+#define SHADER_ATTRIB_BONE_INDEX    6
+#define SHADER_ATTRIB_ANIM_FRAME    7
+
+/*!
+ * Shader stage source; it is compiled on first use, so stages of programs
+ * loaded from the program binary cache are never compiled.
+ */
 struct shader_stage
 {
-    GLhandleARB shader;
+    mutable GLhandleARB shader;
+    GLenum type;
+    char *source;
+    char *defines;
+    uint64_t hash;                              // type, defines and source
     
     shader_stage(GLenum type, const char *filename, const char *additionalDefines = 0);
     ~shader_stage();
+    GLhandleARB get() const;
 };
 
 /*!
@@ -24,8 +39,9 @@ struct shader_description
 {
     GLhandleARB program;
     GLint sampler;
+    GLint linked;
     
-    shader_description(const shader_stage &vertex, const shader_stage &fragment);
+    shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library = 0);
     ~shader_description();
 };
 
@@ -42,12 +58,15 @@ struct text_shader_description : public shader_description
 
 /*!
  * A shader description type that contains transform information. This comes in the form of a model view projection matrix.
+ * Also contains animated textures table, if animated textures vertex library is linked.
  */
 struct unlit_shader_description : public shader_description
 {
     GLint model_view_projection;
+    GLint anim_sequence;
+    GLint anim_frames;
     
-    unlit_shader_description(const shader_stage &vertex, const shader_stage &fragment);
+    unlit_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library = 0);
 };
 
 /*!
@@ -58,6 +77,7 @@ struct unlit_shader_description : public shader_description
 struct lit_shader_description : public unlit_shader_description
 {
     GLint model_view;
+    GLint bone_transform;
     GLint number_of_lights;
     GLint light_position;
     GLint light_color;
@@ -65,7 +85,7 @@ struct lit_shader_description : public unlit_shader_description
     GLint light_outer_radius;
     GLint light_ambient;
     
-    lit_shader_description(const shader_stage &vertex, const shader_stage &fragment);
+    lit_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library = 0);
 };
 
 struct unlit_tinted_shader_description : public unlit_shader_description
@@ -73,7 +93,7 @@ struct unlit_tinted_shader_description : public unlit_shader_description
     GLint current_tick;
     GLint tint_mult;
     
-    unlit_tinted_shader_description(const shader_stage &vertex, const shader_stage &fragment);
+    unlit_tinted_shader_description(const shader_stage &vertex, const shader_stage &fragment, const shader_stage *library = 0);
 };
 
 #endif /* defined(__OpenTomb__shader_description__) */
@@ -2,11 +2,73 @@
 #include <sstream>
 
 #include "shader_manager.h"
+#include "../core/gl_program_cache.h"
+#include "../core/system.h"
+#include "../skeletal_model.h"
+#include "../engine.h"
 
 shader_manager::shader_manager()
 {
+    std::string cachePath = std::string(Engine_GetBasePath()) + GL_PROGRAM_CACHE_FILENAME;
+    GLProgramCache_Begin(cachePath.c_str());
+
+    // Vertex uniforms (GL 2 guarantees only 512 components) go to the bones palette
+    // first, then to the animated textures tables; whatever does not fit is drawn
+    // by slower paths (one bone per draw call, texture animation on CPU)
+    GLint maxVertexUniforms = 0;
+    qglGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS_ARB, &maxVertexUniforms);
+    int budget = maxVertexUniforms / 4 - SHADER_RESERVED_VERTEX_UNIFORMS;
+    bone_palette_size = budget / 4;
+    bone_palette_size = (bone_palette_size > SS_BONE_PALETTE_SIZE) ? (SS_BONE_PALETTE_SIZE) : (bone_palette_size);
+    bone_palette_size = (bone_palette_size < 1) ? (1) : (bone_palette_size);
+    budget -= 4 * bone_palette_size;
+    anim_sequences_size = budget / 3;
+    anim_sequences_size = (anim_sequences_size > MAX_ANIM_SEQUENCES) ? (MAX_ANIM_SEQUENCES) : (anim_sequences_size);
+    anim_sequences_size = (anim_sequences_size < 0) ? (0) : (anim_sequences_size);
+    anim_frames_size = (budget - anim_sequences_size) / 2;
+    anim_frames_size = (anim_frames_size > MAX_ANIM_FRAMES) ? (MAX_ANIM_FRAMES) : (anim_frames_size);
+    anim_frames_size = (anim_frames_size < 1) ? (0) : (anim_frames_size);
+    anim_sequences_size = (anim_frames_size > 0) ? (anim_sequences_size) : (0);
+
+    bool linked = createMeshShaders();
+    if (!linked && (anim_sequences_size > 0))
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "mesh shaders with animated textures tables (%d, %d) are not linked, retry without them", anim_sequences_size, anim_frames_size);
+        deleteMeshShaders();
+        anim_sequences_size = 0;
+        anim_frames_size = 0;
+        linked = createMeshShaders();
+    }
+    if (!linked && (bone_palette_size > 1))
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "mesh shaders with %d bones palette are not linked, retry with one bone", bone_palette_size);
+        deleteMeshShaders();
+        bone_palette_size = 1;
+        createMeshShaders();
+    }
+
+    text = new text_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/text.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/text.fsh"));
+
+    GLProgramCache_End();
+}
+
+/**
+ * Builds room, static mesh and entity programs with current uniform tables sizes;
+ * false if some of them is not linked.
+ */
+bool shader_manager::createMeshShaders()
+{
+    bool linked = true;
+
+    // Animated textures library, linked into every program that draws meshes
+    std::ostringstream animDefines;
+    animDefines << "#define MAX_ANIM_SEQUENCES " << anim_sequences_size << std::endl;
+    animDefines << "#define MAX_ANIM_FRAMES " << anim_frames_size << std::endl;
+    shader_stage animTextureShader(GL_VERTEX_SHADER_ARB, "shaders/anim_texture.vsh", animDefines.str().c_str());
+
     //Color mult prog
-    static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh"));
+    static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh"), &animTextureShader);
+    linked = linked && static_mesh_shader->linked;
 
     //Room prog
     shader_stage roomFragmentShader(GL_FRAGMENT_SHADER_ARB, "shaders/room.fsh");
@@ -18,20 +80,42 @@ shader_manager::shader_manager()
             stream << "#define IS_WATER " << isWater << std::endl;
             stream << "#define IS_FLICKER " << isFlicker << std::endl;
 
-            room_shaders[isWater][isFlicker] = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/room.vsh", stream.str().c_str()), roomFragmentShader);
+            room_shaders[isWater][isFlicker] = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/room.vsh", stream.str().c_str()), roomFragmentShader, &animTextureShader);
+            linked = linked && room_shaders[isWater][isFlicker]->linked;
         }
     }
 
     // Entity prog
-    shader_stage entityVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh");
+    std::ostringstream entityDefines;
+    entityDefines << "#define MAX_BONES " << bone_palette_size << std::endl;
+    shader_stage entityVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh", entityDefines.str().c_str());
     for (int i = 0; i <= MAX_NUM_LIGHTS; i++) {
         std::ostringstream stream;
         stream << "#define NUMBER_OF_LIGHTS " << i << std::endl;
 
-        entity_shader[i] = new lit_shader_description(entityVertexShader, shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str()));
+        entity_shader[i] = new lit_shader_description(entityVertexShader, shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str()), &animTextureShader);
+        linked = linked && entity_shader[i]->linked;
     }
+    return linked;
+}
 
-    text = new text_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/text.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/text.fsh"));
+void shader_manager::deleteMeshShaders()
+{
+    delete static_mesh_shader;
+    static_mesh_shader = NULL;
+    for (int isWater = 0; isWater < 2; isWater++)
+    {
+        for (int isFlicker = 0; isFlicker < 2; isFlicker++)
+        {
+            delete room_shaders[isWater][isFlicker];
+            room_shaders[isWater][isFlicker] = NULL;
+        }
+    }
+    for (int i = 0; i <= MAX_NUM_LIGHTS; i++)
+    {
+        delete entity_shader[i];
+        entity_shader[i] = NULL;
+    }
 }
 
 shader_manager::~shader_manager()
@@ -49,3 +133,35 @@ const unlit_tinted_shader_description *shader_manager::getRoomShader(bool isFlic
 {
     return room_shaders[isWater ? 1 : 0][isFlickering ? 1 : 0];
 }
+
+/**
+ * Animated textures table is the same for all programs, so it is sent to all of them at once.
+ */
+void shader_manager::setAnimTextures(const GLfloat *sequences, int sequences_count, const GLfloat *frames, int frames_count) const
+{
+    if ((sequences_count > anim_sequences_size) || (frames_count > anim_frames_size))
+    {
+        return;
+    }
+
+    const unlit_shader_description *shaders[4 + 1 + MAX_NUM_LIGHTS + 1];
+    int shaders_count = 0;
+
+    shaders[shaders_count++] = room_shaders[0][0];
+    shaders[shaders_count++] = room_shaders[0][1];
+    shaders[shaders_count++] = room_shaders[1][0];
+    shaders[shaders_count++] = room_shaders[1][1];
+    shaders[shaders_count++] = static_mesh_shader;
+    for (int i = 0; i <= MAX_NUM_LIGHTS; i++)
+    {
+        shaders[shaders_count++] = entity_shader[i];
+    }
+
+    for (int i = 0; i < shaders_count; i++)
+    {
+        qglUseProgramObjectARB(shaders[i]->program);
+        qglUniform4fvARB(shaders[i]->anim_sequence, sequences_count, sequences);
+        qglUniform4fvARB(shaders[i]->anim_frames, 2 * frames_count, frames);
+    }
+    qglUseProgramObjectARB(0);
+}
@@ -6,23 +6,43 @@
 // Highest number of lights that will show up in the entity shader.
 #define MAX_NUM_LIGHTS 8
 
+// Max animated textures table size (see anim_texture.vsh); smaller if vertex uniforms
+// do not fit. Levels that do not fit are animated on CPU.
+#define MAX_ANIM_SEQUENCES 24
+#define MAX_ANIM_FRAMES 48
+
+// Vertex uniforms (vec4) kept for matrices and driver's own uniforms when tables are sized
+#define SHADER_RESERVED_VERTEX_UNIFORMS 16
+
 class shader_manager {
     unlit_tinted_shader_description *room_shaders[2][2];
     unlit_tinted_shader_description *static_mesh_shader;
     lit_shader_description *entity_shader[MAX_NUM_LIGHTS+1];
     text_shader_description *text;
+    int bone_palette_size;
+    int anim_sequences_size;
+    int anim_frames_size;
+
+    bool createMeshShaders();
+    void deleteMeshShaders();
 
 public:
     shader_manager();
     ~shader_manager();
     
     const lit_shader_description *getEntityShader(unsigned numberOfLights) const;
+
+    int getBonePaletteSize() const { return bone_palette_size; }
+    int getAnimSequencesSize() const { return anim_sequences_size; }
+    int getAnimFramesSize() const { return anim_frames_size; }
     
     const unlit_tinted_shader_description *getStaticMeshShader() const { return static_mesh_shader; }
     
     const unlit_tinted_shader_description *getRoomShader(bool isFlickering, bool isWater) const;
     
     const text_shader_description *getTextShader() const { return text; }
+
+    void setAnimTextures(const GLfloat *sequences, int sequences_count, const GLfloat *frames, int frames_count) const;
 };
 
 #endif /* defined(__OpenTomb__shader_manager__) */
@@ -233,6 +233,40 @@ void Room_Disable(struct room_s *room)
 }
 
 
+/**
+ * Moves room collision and all its entities in / out of the physics world;
+ * unlike Room_Disable, frozen objects are restored exactly as they were.
+ */
+void Room_SetPhysicsFrozen(struct room_s *room, int frozen)
+{
+    if(room->content->physics_body)
+    {
+        Physics_SetObjectFrozen(room->content->physics_body, frozen);
+    }
+
+    if(room->content->physics_alt_tween)
+    {
+        Physics_SetObjectFrozen(room->content->physics_alt_tween, frozen);
+    }
+
+    for(uint32_t i = 0; i < room->content->static_mesh_count; i++)
+    {
+        if(room->content->static_mesh[i].physics_body)
+        {
+            Physics_SetObjectFrozen(room->content->static_mesh[i].physics_body, frozen);
+        }
+    }
+
+    for(engine_container_p cont = room->containers; cont; cont = cont->next)
+    {
+        if((cont->object_type == OBJECT_ENTITY) && ((entity_p)cont->object)->physics)
+        {
+            Physics_SetCollisionFrozen(((entity_p)cont->object)->physics, frozen);
+        }
+    }
+}
+
+
 int  Room_AddObject(struct room_s *room, struct engine_container_s *cont)
 {
     engine_container_p curr = room->containers;
@@ -782,6 +816,152 @@ int Sectors_SimilarCeiling(room_sector_p s1, room_sector_p s2, int ignore_doors)
 }
 
 
+static uint32_t sectors_occupancy_frame = 0;                                    // sectors start with 0: all occupied until the first frame
+
+void Sectors_NewOccupancyFrame()
+{
+    sectors_occupancy_frame++;
+}
+
+
+void Room_MarkSectorsOccupied(struct room_s *room, float bb_min[3], float bb_max[3], int is_static)
+{
+    int x0 = floorf((bb_min[0] - room->transform[12 + 0]) / TR_METERING_SECTORSIZE);
+    int x1 = floorf((bb_max[0] - room->transform[12 + 0]) / TR_METERING_SECTORSIZE);
+    int y0 = floorf((bb_min[1] - room->transform[12 + 1]) / TR_METERING_SECTORSIZE);
+    int y1 = floorf((bb_max[1] - room->transform[12 + 1]) / TR_METERING_SECTORSIZE);
+
+    x0 = (x0 > 0) ? (x0) : (0);
+    y0 = (y0 > 0) ? (y0) : (0);
+    x1 = (x1 < room->sectors_x - 1) ? (x1) : (room->sectors_x - 1);
+    y1 = (y1 < room->sectors_y - 1) ? (y1) : (room->sectors_y - 1);
+    for(int x = x0; x <= x1; x++)
+    {
+        room_sector_p rs = room->content->sectors + x * room->sectors_y;
+        for(int y = y0; y <= y1; y++)
+        {
+            if(is_static)
+            {
+                rs[y].occupied = 0x01;
+            }
+            else
+            {
+                rs[y].occupied_frame = sectors_occupancy_frame;
+            }
+        }
+    }
+}
+
+
+int Sector_IsOccupied(struct room_sector_s *rs)
+{
+    return rs->occupied || (rs->occupied_frame == sectors_occupancy_frame);
+}
+
+/*
+ * Triangles in the same vertices order as in room trimesh, so the normales
+ * are the same; [ceiling][NE split][A - skipped by door A, B - by door B].
+ */
+static const uint8_t sector_triangles[2][2][2][3] =
+{
+    {{{3, 2, 0}, {2, 1, 0}}, {{3, 2, 1}, {3, 1, 0}}},
+    {{{0, 2, 3}, {0, 1, 2}}, {{0, 1, 3}, {1, 2, 3}}}
+};
+
+static int Sector_HeightTest(struct room_sector_s *rs, struct engine_container_s *cont, float pos[3], float max_dist, int ceiling, struct collision_result_s *result)
+{
+    const float eps = 1.0f;
+    room_p r0 = (cont) ? (cont->room) : (NULL);
+
+    for(int steps = 0; rs && r0 && (steps < 16); steps++)
+    {
+        room_p owner = rs->owner_room;
+        uint8_t config = (ceiling) ? (rs->ceiling_penetration_config) : (rs->floor_penetration_config);
+        uint8_t diagonal = (ceiling) ? (rs->ceiling_diagonal_type) : (rs->floor_diagonal_type);
+        room_p next = (ceiling) ? (rs->room_above) : (rs->room_below);
+        float lx = pos[0] - owner->transform[12 + 0] - rs->index_x * TR_METERING_SECTORSIZE;
+        float ly = pos[1] - owner->transform[12 + 1] - rs->index_y * TR_METERING_SECTORSIZE;
+        float d;
+        int ne, in_a;
+
+        if(Sector_IsOccupied(rs) || rs->portal_to_room || (config == TR_PENETRATION_CONFIG_WALL) ||
+           !Room_IsInNearRoomsList(r0, owner) || Room_IsInOverlappedRoomsList(r0, owner) ||
+           (cont->collision_heavy && (owner != r0)))
+        {
+            return 0;
+        }
+
+        // on sector edges or split line the ray may hit either side
+        ne = (diagonal == TR_SECTOR_DIAGONAL_TYPE_NE);
+        d = (ne) ? (lx - ly) : (lx + ly - TR_METERING_SECTORSIZE);
+        if((lx < eps) || (ly < eps) || (lx > TR_METERING_SECTORSIZE - eps) || (ly > TR_METERING_SECTORSIZE - eps) || (fabs(d) < eps))
+        {
+            return 0;
+        }
+
+        in_a = (ne) ? ((d > 0.0f) != (ceiling != 0)) : (d < 0.0f);
+        if((config != TR_PENETRATION_CONFIG_GHOST) &&
+           !(in_a && (config == TR_PENETRATION_CONFIG_DOOR_VERTICAL_A)) &&
+           !(!in_a && (config == TR_PENETRATION_CONFIG_DOOR_VERTICAL_B)))
+        {
+            const uint8_t *tri = sector_triangles[ceiling != 0][ne][(in_a) ? (0) : (1)];
+            float (*corners)[3] = (ceiling) ? (rs->ceiling_corners) : (rs->floor_corners);
+            float v0[3], v1[3], v2[3], n[3], t, h, dist;
+
+            vec3_add(v0, corners[tri[0]], owner->transform + 12);
+            vec3_add(v1, corners[tri[1]], owner->transform + 12);
+            vec3_add(v2, corners[tri[2]], owner->transform + 12);
+            vec3_sub(v1, v1, v0);
+            vec3_sub(v2, v2, v0);
+            vec3_cross(n, v1, v2);
+            vec3_norm(n, t);
+            h = v0[2] - (n[0] * (pos[0] - v0[0]) + n[1] * (pos[1] - v0[1])) / n[2];
+            dist = (ceiling) ? (h - pos[2]) : (pos[2] - h);
+            if(dist < eps)
+            {
+                return 0;                                                       // start on or behind surface
+            }
+
+            result->obj = NULL;
+            result->hit = 0x00;
+            result->fraction = 1.0f;
+            if(dist <= max_dist)
+            {
+                result->obj = owner->self;
+                result->hit = 0x01;
+                result->bone_num = 0;
+                vec3_copy(result->normale, n);
+                result->point[0] = pos[0];
+                result->point[1] = pos[1];
+                result->point[2] = h;
+                result->fraction = dist / max_dist;
+            }
+            return 1;
+        }
+
+        if(next == NULL)
+        {
+            return 0;
+        }
+        rs = Room_GetSectorRaw(next->real_room, pos);
+    }
+
+    return 0;
+}
+
+
+int Sector_FloorTest(struct room_sector_s *rs, struct engine_container_s *cont, float pos[3], float max_dist, struct collision_result_s *result)
+{
+    return Sector_HeightTest(rs, cont, pos, max_dist, 0, result);
+}
+
+
+int Sector_CeilingTest(struct room_sector_s *rs, struct engine_container_s *cont, float pos[3], float max_dist, struct collision_result_s *result)
+{
+    return Sector_HeightTest(rs, cont, pos, max_dist, 1, result);
+}
+
+
 /////////////////////////////////////////
 static bool Room_IsBoxForPath(room_box_p curr_box, room_box_p next_box, box_validition_options_p op)
 {
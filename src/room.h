@@ -111,6 +111,7 @@ struct frustum_s;
 struct base_mesh_s;
 struct physics_object_s;
 struct trigger_header_s;
+struct collision_result_s;
 
 
 typedef struct room_zone_s
@@ -193,6 +194,9 @@ typedef struct room_sector_s
     float                       floor_corners[4][3];
     uint8_t                     floor_diagonal_type;
     uint8_t                     floor_penetration_config;
+
+    uint8_t                     occupied;               // static mesh with collision in sector column
+    uint32_t                    occupied_frame;         // kinematic object in column at this occupancy frame
 }room_sector_t, *room_sector_p;
 
 
@@ -298,6 +302,7 @@ typedef struct room_s
 void Room_Clear(struct room_s *room);
 void Room_Enable(struct room_s *room);
 void Room_Disable(struct room_s *room);
+void Room_SetPhysicsFrozen(struct room_s *room, int frozen);
 int  Room_AddObject(struct room_s *room, struct engine_container_s *cont);
 int  Room_RemoveObject(struct room_s *room, struct engine_container_s *cont);
 
@@ -329,6 +334,24 @@ void Sector_LowestCeilingCorner(room_sector_p rs, float v[3]);
 int Sectors_SimilarFloor(room_sector_p s1, room_sector_p s2, int ignore_doors);
 int Sectors_SimilarCeiling(room_sector_p s1, room_sector_p s2, int ignore_doors);
 
+/*
+ * Sectors occupancy: static meshes mark their columns once on level load,
+ * kinematic objects every occupancy frame. Analytic height tests answer only
+ * in free columns, everything else is left for Bullet.
+ */
+void Sectors_NewOccupancyFrame();
+void Room_MarkSectorsOccupied(struct room_s *room, float bb_min[3], float bb_max[3], int is_static);
+int  Sector_IsOccupied(struct room_sector_s *rs);
+
+/*
+ * The same hit as of filtered vertical height test ray from pos, resolved
+ * from sector corners, diagonal splits and rooms below / above. Returns 0 if
+ * not sure (occupied column, walls, doors, edges, rooms that the ray filter
+ * of cont treats specially), then the caller must cast the ray.
+ */
+int  Sector_FloorTest(struct room_sector_s *rs, struct engine_container_s *cont, float pos[3], float max_dist, struct collision_result_s *result);
+int  Sector_CeilingTest(struct room_sector_s *rs, struct engine_container_s *cont, float pos[3], float max_dist, struct collision_result_s *result);
+
 int  Room_IsInBox(room_box_p box, float pos[3]);
 int  Room_FindPath(room_box_p *path_buf, uint32_t max_boxes, room_sector_p from, room_sector_p to, box_validition_options_p op);
 void Room_GetOverlapCenter(room_box_p b1, room_box_p b2, float pos[3]);
@@ -390,6 +390,10 @@ int Script_ParseRender(lua_State *lua, struct render_settings_s *rs)
         rs->texture_border = lua_tonumber(lua, -1);
         lua_pop(lua, 1);
 
+        lua_getfield(lua, -1, "texture_format");
+        rs->texture_format = lua_tonumber(lua, -1);
+        lua_pop(lua, 1);
+
         lua_getfield(lua, -1, "z_depth");
         rs->z_depth = lua_tonumber(lua, -1);
         lua_pop(lua, 1);
@@ -392,7 +392,7 @@ int lua_AddCharacterHair(lua_State *lua)
             {
                 ent->character->hair_count++;
                 ent->character->hairs = (struct hair_s**)realloc(ent->character->hairs, (sizeof(struct hair_s*) * ent->character->hair_count));
-                ent->character->hairs[ent->character->hair_count - 1] = Hair_Create(hair_setup, ent->physics);
+                ent->character->hairs[ent->character->hair_count - 1] = Hair_Create(hair_setup, ent->physics, ent->bf);
                 if(!ent->character->hairs[ent->character->hair_count - 1])
                 {
                     ent->character->hair_count--;
@@ -494,6 +494,7 @@ int lua_SetCharacterRagdollActivity(lua_State *lua)
         {
             if(lua_toboolean(lua, 2))
             {
+                Entity_UpdatePose(ent);
                 if(ent->character->ragdoll && Ragdoll_Create(ent->physics, ent->bf, ent->character->ragdoll))
                 {
                     ent->type_flags |=  ENTITY_TYPE_DYNAMIC;
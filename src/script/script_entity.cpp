@@ -2220,6 +2220,7 @@ int lua_ResetRigidBodies(lua_State * lua)
         entity_p ent = World_GetEntityByID(lua_tointeger(lua, 1));
         if(ent)
         {
+            Entity_UpdatePose(ent);
             Physics_GenRigidBody(ent->physics, ent->bf);
         }
         else
@@ -2577,6 +2578,7 @@ int lua_SetEntityBodyMass(lua_State *lua)
                 if(mass > 0.0) dynamic = true;
                 Physics_SetBodyMass(ent->physics, mass, i);
             }
+            Entity_UpdatePose(ent);
             Entity_UpdateRigidBody(ent, 1);
 
             if(dynamic)
@@ -1,5 +1,6 @@
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "core/system.h"
 #include "core/gl_util.h"
@@ -11,6 +12,7 @@
 
 
 void SSBoneFrame_InitSSAnim(struct ss_animation_s *ss_anim, uint32_t anim_type_id);
+void SSBoneFrame_GenSkinVBO(ss_bone_frame_p bf, ss_bone_tag_p btag);
 
 void SkeletalModel_Clear(skeletal_model_p model)
 {
@@ -182,6 +184,7 @@ void SSBoneFrame_CreateFromModel(ss_bone_frame_p bf, skeletal_model_p model)
     vec3_set_zero(bf->centre);
     vec3_set_zero(bf->pos);
     bf->transform = NULL;
+    bf->pose_time = 0.0f;
     bf->bone_tag_count = 0;
     bf->bone_tags = NULL;
     
@@ -201,6 +204,7 @@ void SSBoneFrame_CreateFromModel(ss_bone_frame_p bf, skeletal_model_p model)
             bf->bone_tags[i].mesh_skin = NULL;
             bf->bone_tags[i].mesh_slot = NULL;
             bf->bone_tags[i].skin_map = NULL;
+            bf->bone_tags[i].vbo_skin_array = 0;
             bf->bone_tags[i].alt_anim = NULL;
             bf->bone_tags[i].body_part = model->mesh_tree[i].body_part;
 
@@ -265,6 +269,10 @@ void SSBoneFrame_Clear(ss_bone_frame_p bf)
             {
                 free(bf->bone_tags[i].skin_map);
             }
+            if(bf->bone_tags[i].vbo_skin_array)
+            {
+                qglDeleteBuffersARB(1, &bf->bone_tags[i].vbo_skin_array);
+            }
         }
         
         free(bf->bone_tags);
@@ -305,22 +313,39 @@ void SSBoneFrame_Copy(struct ss_bone_frame_s *dst, struct ss_bone_frame_s *src)
 }
 
 
-void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time)
+/*
+ * Updates only root offset and bounding box; enough for not visible entities
+ * whose bones are not used by anyone.
+ */
+void SSBoneFrame_UpdateBounds(struct ss_bone_frame_s *bf)
 {
     float t = 1.0f - bf->animations.lerp;
-    ss_bone_tag_p btag = bf->bone_tags;
-    bone_tag_p src_btag, next_btag;
     skeletal_model_p model = bf->animations.model;
     animation_frame_p curr_anim = model->animations + bf->animations.current_animation;
     animation_frame_p next_anim = model->animations + bf->animations.next_animation;
     bone_frame_p curr_bf = curr_anim->frames + bf->animations.current_frame;
     bone_frame_p next_bf = next_anim->frames + bf->animations.next_frame;
-    
+
     vec3_interpolate_macro(bf->bb_max, curr_bf->bb_max, next_bf->bb_max, bf->animations.lerp, t);
     vec3_interpolate_macro(bf->bb_min, curr_bf->bb_min, next_bf->bb_min, bf->animations.lerp, t);
     vec3_interpolate_macro(bf->centre, curr_bf->centre, next_bf->centre, bf->animations.lerp, t);
     vec3_interpolate_macro(bf->pos, curr_bf->pos, next_bf->pos, bf->animations.lerp, t);
-    
+}
+
+
+void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time)
+{
+    float t = 1.0f - bf->animations.lerp;
+    ss_bone_tag_p btag = bf->bone_tags;
+    bone_tag_p src_btag, next_btag;
+    skeletal_model_p model = bf->animations.model;
+    animation_frame_p curr_anim = model->animations + bf->animations.current_animation;
+    animation_frame_p next_anim = model->animations + bf->animations.next_animation;
+    bone_frame_p curr_bf = curr_anim->frames + bf->animations.current_frame;
+    bone_frame_p next_bf = next_anim->frames + bf->animations.next_frame;
+
+    SSBoneFrame_UpdateBounds(bf);
+
     next_btag = next_bf->bone_tags;
     src_btag = curr_bf->bone_tags;
     for(uint16_t k = 0; k < curr_bf->bone_tag_count; k++, btag++, src_btag++, next_btag++)
@@ -863,5 +888,54 @@ void SSBoneFrame_FillSkinnedMeshMap(ss_bone_frame_p bf)
                 }
             }
         }
+        SSBoneFrame_GenSkinVBO(bf, tree_tag);
+    }
+}
+
+/**
+ * Builds GPU skinning buffer for the bone's skin mesh: a copy of skin mesh vertices,
+ * where vertices that are mapped to the parent mesh take parent space position,
+ * followed by per vertex bone indexes (0 - own bone, 1 - parent bone).
+ * Faces elements of the skin mesh stay valid for that buffer.
+ */
+void SSBoneFrame_GenSkinVBO(ss_bone_frame_p bf, ss_bone_tag_p btag)
+{
+    base_mesh_p mesh_skin = btag->mesh_skin;
+    uint32_t *ch = btag->skin_map;
+
+    if(btag->vbo_skin_array)
+    {
+        qglDeleteBuffersARB(1, &btag->vbo_skin_array);
+        btag->vbo_skin_array = 0;
+    }
+
+    // skins with animated textures or out of palette bones stay on CPU path (see CRender::DrawSkinMesh)
+    if(btag->parent && mesh_skin->vertex_count && !mesh_skin->animated_vertex_count &&
+       (bf->bone_tag_count <= SS_BONE_PALETTE_SIZE) && (qglGenBuffersARB != NULL))
+    {
+        GLfloat own_index = (GLfloat)(btag - bf->bone_tags);
+        GLfloat parent_index = (GLfloat)(btag->parent - bf->bone_tags);
+        size_t vertices_size = mesh_skin->vertex_count * sizeof(vertex_t);
+        size_t buf_size = vertices_size + mesh_skin->vertex_count * sizeof(GLfloat);
+        vertex_p v = (vertex_p)malloc(buf_size);
+        GLfloat *bone_index = (GLfloat*)((uint8_t*)v + vertices_size);
+        base_mesh_p parent_mesh = btag->parent->mesh_base;
+
+        memcpy(v, mesh_skin->vertices, vertices_size);
+        for(uint32_t i = 0; i < mesh_skin->vertex_count; i++, ch++)
+        {
+            bone_index[i] = own_index;
+            if(*ch != 0xFFFFFFFF)
+            {
+                vec3_copy(v[i].position, parent_mesh->vertices[*ch].position);
+                bone_index[i] = parent_index;
+            }
+        }
+
+        qglGenBuffersARB(1, &btag->vbo_skin_array);
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, btag->vbo_skin_array);
+        qglBufferDataARB(GL_ARRAY_BUFFER_ARB, buf_size, v, GL_STATIC_DRAW_ARB);
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        free(v);
     }
 }
\ No newline at end of file
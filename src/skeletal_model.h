@@ -25,6 +25,8 @@ extern "C" {
 #define SS_CHANGING_BY_STATE    (0x03)      // 0x03 - new frame, new anim (by state change info);
 #define SS_CHANGING_HEAVY       (0x04)      // 0x04 - rough change by set animation;
 
+#define SS_BONE_PALETTE_SIZE    (24)        // max bones uploaded to entity shader at once; less if vertex uniforms do not fit
+
     
 #define ANIM_EXT_TARGET_TO              (1)
     
@@ -42,6 +44,8 @@ extern "C" {
 #define ANIM_TYPE_MISK_4                (0x0103)
 
 #include <stdint.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
 
 struct base_mesh_s;
 
@@ -66,6 +70,7 @@ typedef struct ss_bone_tag_s
     struct base_mesh_s     *mesh_slot;
     struct ss_animation_s  *alt_anim;
     uint32_t               *skin_map;                                           // vertices map for skin mesh
+    GLuint                  vbo_skin_array;                                     // skin mesh vertices (mapped ones in parent space) + bone indexes
     float                   offset[3];                                          // model position offset
 
     float                   qrotate[4];                                         // quaternion rotation
@@ -124,6 +129,7 @@ typedef struct ss_bone_frame_s
     float                       bb_max[3];                                      // bounding box max coordinates
     float                       centre[3];                                      // bounding box centre
     float                      *transform;
+    float                       pose_time;                                      // time passed since the last bones update (animation LOD)
 
     struct ss_animation_s       animations;                                     // animations list
 }ss_bone_frame_t, *ss_bone_frame_p;
@@ -258,6 +264,7 @@ void SSBoneFrame_CreateFromModel(ss_bone_frame_p bf, skeletal_model_p model);
 void SSBoneFrame_Clear(ss_bone_frame_p bf);
 void SSBoneFrame_Copy(struct ss_bone_frame_s *dst, struct ss_bone_frame_s *src);
 void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time);
+void SSBoneFrame_UpdateBounds(struct ss_bone_frame_s *bf);
 void SSBoneFrame_RotateBone(struct ss_bone_frame_s *bf, const float q_rotate[4], int bone);
 int  SSBoneFrame_CheckTargetBoneLimit(struct ss_bone_frame_s *bf, struct ss_animation_s *ss_anim);
 void SSBoneFrame_TargetBoneToSlerp(struct ss_bone_frame_s *bf, struct ss_animation_s *ss_anim, float time);
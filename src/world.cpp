@@ -94,6 +94,10 @@ extern "C" {
     uint32_t                        cinematic_frames_count;
     struct camera_frame_s          *cinematic_frames;
     struct flyby_camera_sequence_s *flyby_camera_sequences;
+
+    int16_t                         physics_hops;           // near rooms hops to keep physics awake, < 0 - all rooms
+    uint16_t                        physics_frozen;         // some rooms may be frozen
+    uint32_t                        physics_active_rooms;
 } global_world;
 
 
@@ -163,6 +167,9 @@ void World_Prepare()
     global_world.cinematic_frames = NULL;
     global_world.cinematic_frames_count = 0;
     global_world.flyby_camera_sequences = NULL;
+    global_world.physics_hops = WORLD_PHYSICS_HOPS_DEFAULT;
+    global_world.physics_frozen = 0;
+    global_world.physics_active_rooms = 0;
     global_world.skeletal_models = NULL;
     global_world.skeletal_models_count = 0;
     global_world.sky_box = NULL;
@@ -197,6 +204,14 @@ void World_Open(const char *path, int trv)
     World_GenBoxes(tr);                 // Generate boxes.
     Gui_DrawLoadScreen(440);
 
+    {
+        char level_name[LEVEL_NAME_MAX_LEN];
+        char cache_name[1024];
+        Engine_GetLevelName(level_name, path);
+        snprintf(cache_name, sizeof(cache_name), "%sbvh_cache_%s.bin", Engine_GetBasePath(), level_name);
+        Physics_BvhCacheBegin(cache_name, path);   // static meshes and rooms collision
+    }
+
     World_GenRooms(tr);                 // Build all rooms
     Gui_DrawLoadScreen(480);
 
@@ -255,6 +270,7 @@ void World_Open(const char *path, int trv)
     // Fix initial room states
     World_FixRooms();
     World_UpdateFlipCollisions();
+    Physics_BvhCacheEnd();
     Gui_DrawLoadScreen(970);
 
     if(global_world.tex_atlas)
@@ -658,6 +674,141 @@ void World_GetRoomInfo(struct room_s **rooms, uint32_t *rooms_count)
 }
 
 
+static void World_MarkPhysicsRoom(uint8_t *hops, room_p room, uint8_t room_hops)
+{
+    uint32_t index = room->real_room - global_world.rooms;
+    if((index < global_world.rooms_count) && (hops[index] < room_hops))
+    {
+        hops[index] = room_hops;
+    }
+}
+
+/**
+ * Wakes rooms up to physics_hops near rooms away from the seed rooms (player,
+ * cameras); moving actors and dynamic entities keep their own near rooms
+ * awake, so they never lose the floor. Other rooms with all their content are
+ * frozen out of the physics world.
+ */
+void World_UpdatePhysicsActivity(struct room_s **seeds, uint32_t seeds_count)
+{
+    uint8_t *hops;
+    uint8_t max_hops = global_world.physics_hops + 1;
+    room_p r = global_world.rooms;
+
+    global_world.physics_active_rooms = global_world.rooms_count;
+    if((global_world.physics_hops < 0) || (global_world.rooms_count == 0))
+    {
+        if(global_world.physics_frozen)
+        {
+            for(uint32_t i = 0; i < global_world.rooms_count; ++i, ++r)
+            {
+                Room_SetPhysicsFrozen(r, 0);
+            }
+            global_world.physics_frozen = 0;
+        }
+        return;
+    }
+
+    // hops[i] is 1 + how far room i spreads activity, 0 - frozen room
+    hops = (uint8_t*)Sys_GetTempMem(global_world.rooms_count);
+    memset(hops, 0, global_world.rooms_count);
+    for(uint32_t i = 0; i < seeds_count; ++i)
+    {
+        if(seeds[i])
+        {
+            World_MarkPhysicsRoom(hops, seeds[i], max_hops);
+        }
+    }
+    for(std::pair<const uint32_t, entity_p> &it : global_world.entity_tree)
+    {
+        entity_p ent = it.second;
+        if(ent->self->room && (ent->state_flags & ENTITY_STATE_ENABLED) &&
+           (ent->character || (ent->type_flags & ENTITY_TYPE_DYNAMIC)))
+        {
+            World_MarkPhysicsRoom(hops, ent->self->room, 2);
+        }
+    }
+
+    max_hops = (max_hops > 2) ? (max_hops) : (2);
+    for(uint8_t level = max_hops; level > 1; --level)
+    {
+        for(uint32_t i = 0; i < global_world.rooms_count; ++i)
+        {
+            room_p room = global_world.rooms + i;
+            if(hops[i] == level)
+            {
+                for(uint16_t j = 0; j < room->content->near_room_list_size; ++j)
+                {
+                    World_MarkPhysicsRoom(hops, room->content->near_room_list[j], level - 1);
+                }
+            }
+        }
+    }
+
+    // alternate rooms share the state of their real room, so flips keep content consistent
+    global_world.physics_active_rooms = 0;
+    for(uint32_t i = 0; i < global_world.rooms_count; ++i, ++r)
+    {
+        int frozen = (hops[r->real_room - global_world.rooms] == 0);
+        Room_SetPhysicsFrozen(r, frozen);
+        global_world.physics_active_rooms += (!frozen && (r->real_room == r)) ? (1) : (0);
+    }
+    global_world.physics_frozen = 1;
+
+    Sys_ReturnTempMem(global_world.rooms_count);
+}
+
+
+/**
+ * Marks sectors columns around kinematic objects and vehicles, that height
+ * tests can hit. Margin covers objects movement until the next update.
+ */
+void World_UpdateSectorsOccupancy()
+{
+    const float margin = TR_METERING_STEP;
+
+    Sectors_NewOccupancyFrame();
+    for(std::pair<const uint32_t, entity_p> &it : global_world.entity_tree)
+    {
+        entity_p ent = it.second;
+        if(ent->self->room && (ent->state_flags & ENTITY_STATE_COLLIDABLE) &&
+           (ent->self->collision_group & (COLLISION_GROUP_KINEMATIC | COLLISION_GROUP_VEHICLE)))
+        {
+            room_p r = ent->self->room->real_room;
+            float bb_min[3], bb_max[3];
+            for(int k = 0; k < 3; k++)
+            {
+                bb_min[k] = ent->obb->centre[k] - ent->obb->radius - margin;
+                bb_max[k] = ent->obb->centre[k] + ent->obb->radius + margin;
+            }
+            Room_MarkSectorsOccupied(r, bb_min, bb_max, 0);
+            for(uint16_t k = 0; k < r->content->near_room_list_size; k++)
+            {
+                Room_MarkSectorsOccupied(r->content->near_room_list[k]->real_room, bb_min, bb_max, 0);
+            }
+        }
+    }
+}
+
+
+void World_SetPhysicsHops(int hops)
+{
+    global_world.physics_hops = (hops > 254) ? (254) : (hops);
+}
+
+
+int  World_GetPhysicsHops()
+{
+    return global_world.physics_hops;
+}
+
+
+uint32_t World_GetPhysicsActiveRoomsCount()
+{
+    return global_world.physics_active_rooms;
+}
+
+
 void World_GetAnimSeqInfo(struct anim_seq_s **seq, uint32_t *seq_count)
 {
     *seq = global_world.anim_sequences;
@@ -1351,39 +1502,45 @@ void World_GenTextures(class VT_Level *tr)
 
     qglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     qglPixelZoom(1, 1);
-    global_world.tex_atlas->createTextures(global_world.textures);
-
-    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);   // Mag filter is always linear.
+    int mip_levels = global_world.tex_atlas->createTextures(global_world.textures, renderer.settings.texture_format, renderer.settings.mipmaps);
+    Con_Printf("atlas: %d pages, %d mip levels, %d KB", global_world.tex_count, mip_levels, (int)(global_world.tex_atlas->getUploadedSize() / 1024));
 
-    // Select mipmap mode
-    switch(renderer.settings.mipmap_mode)
+    // Sampling parameters are per texture object
+    for(uint32_t i = 0; i < global_world.tex_count; i++)
     {
-        case 0:
-            qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-            break;
+        qglBindTexture(GL_TEXTURE_2D, global_world.textures[i]);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);   // Mag filter is always linear.
 
-        case 1:
-            qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-            break;
+        // Select mipmap mode
+        switch(renderer.settings.mipmap_mode)
+        {
+            case 0:
+                qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+                break;
 
-        case 2:
-            qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-            break;
+            case 1:
+                qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+                break;
 
-        case 3:
-        default:
-            qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            break;
-    };
+            case 2:
+                qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+                break;
+
+            case 3:
+            default:
+                qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                break;
+        };
 
-    // Set mipmaps number
-    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, renderer.settings.mipmaps);
+        // Set mipmaps number: only CPU built levels are present
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mip_levels);
 
-    // Set anisotropy degree
-    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, renderer.settings.anisotropy);
+        // Set anisotropy degree
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, renderer.settings.anisotropy);
 
-    // Read lod bias
-    qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, renderer.settings.lod_bias);
+        // Read lod bias
+        qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, renderer.settings.lod_bias);
+    }
 }
 
 
@@ -1803,6 +1960,8 @@ void World_GenRoom(struct room_s *room, class VT_Level *tr)
         sector->owner_room = room;
         sector->trigger = NULL;
         sector->box = NULL;
+        sector->occupied = 0x00;
+        sector->occupied_frame = 0;
 
         if(tr->game_version < TR_III)
         {
@@ -2473,6 +2632,30 @@ void World_GenRoomCollision()
 
         Sys_ReturnTempMem(buff_size);
     }
+
+    // static meshes may stick out to the near rooms sectors
+    r = global_world.rooms;
+    for(uint32_t i = 0; i < global_world.rooms_count; i++, r++)
+    {
+        for(uint32_t j = 0; j < r->content->static_mesh_count; j++)
+        {
+            static_mesh_p sm = r->content->static_mesh + j;
+            if(sm->physics_body)
+            {
+                float bb_min[3], bb_max[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    bb_min[k] = sm->obb->centre[k] - sm->obb->radius;
+                    bb_max[k] = sm->obb->centre[k] + sm->obb->radius;
+                }
+                Room_MarkSectorsOccupied(r, bb_min, bb_max, 1);
+                for(uint16_t k = 0; k < r->content->near_room_list_size; k++)
+                {
+                    Room_MarkSectorsOccupied(r->content->near_room_list[k], bb_min, bb_max, 1);
+                }
+            }
+        }
+    }
 }
 
 
@@ -8,6 +8,8 @@
 #define FLIP_STATE_ON       (0x01)
 #define FLIP_STATE_BY_FLAG  (0x03)
 
+#define WORLD_PHYSICS_HOPS_DEFAULT  (3)
+
 
 void World_Prepare();
 void World_Open(const char *path, int trv);
@@ -54,5 +56,11 @@ void World_UpdateFlipCollisions();
 uint32_t World_GetFlipMap(uint32_t flip_index);
 uint32_t World_GetFlipState(uint32_t flip_index);
 
+void World_UpdatePhysicsActivity(struct room_s **seeds, uint32_t seeds_count);
+void World_UpdateSectorsOccupancy();
+void World_SetPhysicsHops(int hops);
+int  World_GetPhysicsHops();
+uint32_t World_GetPhysicsActiveRoomsCount();
+
 
 #endif